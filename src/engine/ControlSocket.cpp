@@ -370,6 +370,11 @@ int CControlSocket::CheckOverwriteFile()
 	{
 		if (!wxFile::Exists(pData->localFile))
 			return FZ_REPLY_OK;
+
+		// Segments of a download get written into the same file, the other
+		// segments have created it.
+		if (pData->transferSettings.segmentStart >= 0)
+			return FZ_REPLY_OK;
 	}
 
 	CDirentry entry;
@@ -901,6 +906,20 @@ bool CRealControlSocket::Send(const char *buffer, int len)
 	return true;
 }
 
+void CRealControlSocket::LogConnectAttempts()
+{
+	auto const attempts = m_pSocket->GetConnectAttempts();
+	if (attempts.size() < 2)
+		return;
+
+	for (auto const& attempt : attempts) {
+		if (attempt.error)
+			LogMessage(MessageType::Debug_Info, _T("Attempt to connect to %s started after %d ms, failed after %d ms: %s"), attempt.address, (int)attempt.start, (int)attempt.duration, CSocket::GetErrorDescription(attempt.error));
+		else
+			LogMessage(MessageType::Debug_Info, _T("Attempt to connect to %s started after %d ms, connected after %d ms"), attempt.address, (int)attempt.start, (int)attempt.duration);
+	}
+}
+
 void CRealControlSocket::OnSocketEvent(CSocketEvent &event)
 {
 	if (!m_pBackend)
@@ -919,6 +938,7 @@ void CRealControlSocket::OnSocketEvent(CSocketEvent &event)
 			LogMessage(MessageType::Status, _("Connection attempt failed with \"%s\", trying next address."), CSocket::GetErrorDescription(event.GetError()));
 		break;
 	case CSocketEvent::connection:
+		LogConnectAttempts();
 		if (event.GetError()) {
 			LogMessage(MessageType::Status, _("Connection attempt failed with \"%s\"."), CSocket::GetErrorDescription(event.GetError()));
 			OnClose(event.GetError());
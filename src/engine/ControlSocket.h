@@ -274,7 +274,7 @@ public:
 
 protected:
 	virtual int DoClose(int nErrorCode = FZ_REPLY_DISCONNECTED);
-	void ResetSocket();
+	virtual void ResetSocket();
 
 	virtual void OnSocketEvent(CSocketEvent &event);
 	virtual void OnConnect();
@@ -284,6 +284,9 @@ protected:
 
 	bool Send(const char *buffer, int len);
 
+	// Debug output of the timings if multiple addresses got tried
+	void LogConnectAttempts();
+
 	CSocket* m_pSocket;
 
 	CBackend* m_pBackend;
@@ -54,7 +54,13 @@ bool CFileZillaEngine::GetTransferStatus(CTransferStatus &status, bool &changed)
 
 int CFileZillaEngine::CacheLookup(const CServerPath& path, CDirectoryListing& listing)
 {
-	return impl_->CacheLookup(path, listing);
+	bool is_outdated = false;
+	return impl_->CacheLookup(path, listing, is_outdated);
+}
+
+int CFileZillaEngine::CacheLookup(const CServerPath& path, CDirectoryListing& listing, bool& is_outdated)
+{
+	return impl_->CacheLookup(path, listing, is_outdated);
 }
 
 int CFileZillaEngine::Cancel()
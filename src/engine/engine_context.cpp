@@ -6,6 +6,7 @@
 #include "pathcache.h"
 #include "ratelimiter.h"
 #include "socket.h"
+#include "tlssessioncache.h"
 
 class CFileZillaEngineContext::Impl
 {
@@ -25,6 +26,7 @@ public:
 	CRateLimiter limiter_;
 	CDirectoryCache directory_cache_;
 	CPathCache path_cache_;
+	CTlsSessionCache tls_session_cache_;
 };
 
 CFileZillaEngineContext::CFileZillaEngineContext(COptionsBase & options)
@@ -66,3 +68,8 @@ CPathCache& CFileZillaEngineContext::GetPathCache()
 {
 	return impl_->path_cache_;
 }
+
+CTlsSessionCache& CFileZillaEngineContext::GetTlsSessionCache()
+{
+	return impl_->tls_session_cache_;
+}
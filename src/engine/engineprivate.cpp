@@ -23,6 +23,7 @@ CFileZillaEnginePrivate::CFileZillaEnginePrivate(CFileZillaEngineContext& contex
 	, m_rateLimiter(context.GetRateLimiter())
 	, directory_cache_(context.GetDirectoryCache())
 	, path_cache_(context.GetPathCache())
+	, tls_session_cache_(context.GetTlsSessionCache())
 	, parent_(parent)
 {
 	m_engineList.push_back(this);
@@ -800,7 +801,7 @@ bool CFileZillaEnginePrivate::GetTransferStatus(CTransferStatus &status, bool &c
 	return transfer_status_.Get(status, changed);
 }
 
-int CFileZillaEnginePrivate::CacheLookup(const CServerPath& path, CDirectoryListing& listing)
+int CFileZillaEnginePrivate::CacheLookup(const CServerPath& path, CDirectoryListing& listing, bool& is_outdated)
 {
 	// TODO: Possible optimization: Atomically get current server. The cache has its own mutex.
 	wxCriticalSectionLocker lock(mutex_);
@@ -810,7 +811,7 @@ int CFileZillaEnginePrivate::CacheLookup(const CServerPath& path, CDirectoryList
 
 	wxASSERT(m_pControlSocket->GetCurrentServer());
 
-	bool is_outdated = false;
+	is_outdated = false;
 	if (!directory_cache_.Lookup(listing, *m_pControlSocket->GetCurrentServer(), path, true, is_outdated))
 		return FZ_REPLY_ERROR;
 
@@ -885,6 +886,15 @@ void CTransferStatusManager::SetMadeProgress()
 	status_->madeProgress = true;
 }
 
+void CTransferStatusManager::SetWritten(wxFileOffset writtenBytes)
+{
+	wxCriticalSectionLocker lock(mutex_);
+	if (!status_)
+		return;
+
+	status_->writtenOffset = status_->startOffset + writtenBytes;
+}
+
 void CTransferStatusManager::Update(wxFileOffset transferredBytes)
 {
 	CNotification* notification = 0;
@@ -13,6 +13,7 @@ class CControlSocket;
 class CLogging;
 class CRateLimiter;
 class CSocketEventDispatcher;
+class CTlsSessionCache;
 
 enum EngineNotificationType
 {
@@ -37,6 +38,7 @@ public:
 	void Reset();
 	void SetStartTime();
 	void SetMadeProgress();
+	void SetWritten(wxFileOffset writtenBytes);
 	void Update(wxFileOffset transferredBytes);
 
 	bool Get(CTransferStatus &status, bool &changed);
@@ -74,7 +76,7 @@ public:
 
 	bool GetTransferStatus(CTransferStatus &status, bool &changed);
 
-	int CacheLookup(CServerPath const& path, CDirectoryListing& listing);
+	int CacheLookup(CServerPath const& path, CDirectoryListing& listing, bool& is_outdated);
 
 	static bool IsActive(CFileZillaEngine::_direction direction);
 	void SetActive(int direction);
@@ -88,6 +90,7 @@ public:
 	CRateLimiter& GetRateLimiter() { return m_rateLimiter; }
 	CDirectoryCache& GetDirectoryCache() { return directory_cache_; }
 	CPathCache& GetPathCache() { return path_cache_; }
+	CTlsSessionCache& GetTlsSessionCache() { return tls_session_cache_; }
 
 	void SendDirectoryListingNotification(const CServerPath& path, bool onList, bool modified, bool failed);
 
@@ -195,6 +198,7 @@ protected:
 	CRateLimiter& m_rateLimiter;
 	CDirectoryCache& directory_cache_;
 	CPathCache& path_cache_;
+	CTlsSessionCache& tls_session_cache_;
 
 	CFileZillaEngine& parent_;
 
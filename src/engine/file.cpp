@@ -33,7 +33,9 @@ bool CFile::Open(wxString const& f, mode m, disposition d)
 	else {
 		dispositionFlags = OPEN_EXISTING;
 	}
-	hFile_ = CreateFile(f, (m == read) ? GENERIC_READ : GENERIC_WRITE, FILE_SHARE_READ, 0, dispositionFlags, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	// Segmented downloads open the same file for writing once per segment
+	DWORD const shareMode = (m == write) ? (FILE_SHARE_READ | FILE_SHARE_WRITE) : FILE_SHARE_READ;
+	hFile_ = CreateFile(f, (m == read) ? GENERIC_READ : GENERIC_WRITE, shareMode, 0, dispositionFlags, FILE_FLAG_SEQUENTIAL_SCAN, 0);
 
 	return hFile_ != INVALID_HANDLE_VALUE;
 }
@@ -29,6 +29,8 @@ public:
 
 	bool Opened() const;
 
+	// A file opened for writing can be opened for writing again at the same
+	// time, e.g. by the engines downloading different segments of it.
 	bool Open(wxString const& f, mode m, disposition d = existing);
 	void Close();
 
@@ -43,6 +43,9 @@ CRawTransferOpData::CRawTransferOpData()
 	, bPasv(true)
 	, bTriedPasv()
 	, bTriedActive()
+	, bCompress()
+	, bAborted()
+	, bPipelined()
 	, port()
 {
 }
@@ -53,6 +56,7 @@ CFtpTransferOpData::CFtpTransferOpData()
 	tranferCommandSent = false;
 	resumeOffset = 0;
 	binary = true;
+	compress = true;
 }
 
 CFtpFileTransferOpData::CFtpFileTransferOpData(bool is_download, const wxString& local_file, const wxString& remote_file, const CServerPath& remote_path)
@@ -91,6 +95,8 @@ enum rawtransferStates
 {
 	rawtransfer_init = 0,
 	rawtransfer_type,
+	rawtransfer_mode,
+	rawtransfer_mode_level,
 	rawtransfer_port_pasv,
 	rawtransfer_rest,
 	rawtransfer_transfer,
@@ -185,12 +191,14 @@ CFtpControlSocket::CFtpControlSocket(CFileZillaEnginePrivate *pEngine) : CRealCo
 	m_pIPResolver = 0;
 	m_pTransferSocket = 0;
 	m_sentRestartOffset = false;
+	m_metadataRepliesSaved = 0;
 	m_bufferLen = 0;
 	m_repliesToSkip = 0;
 	m_pendingReplies = 1;
 	m_pTlsSocket = 0;
 	m_protectDataChannel = false;
 	m_lastTypeBinary = -1;
+	m_lastModeZ = 0;
 
 	// Enable TCP_NODELAY, speeds things up a bit.
 	// Enable SO_KEEPALIVE, lots of clueless users have broken routers and
@@ -366,6 +374,7 @@ void CFtpControlSocket::ParseLine(wxString line)
 void CFtpControlSocket::OnConnect()
 {
 	m_lastTypeBinary = -1;
+	m_lastModeZ = 0;
 
 	SetAlive();
 
@@ -2232,6 +2241,30 @@ int CFtpControlSocket::FileTransfer(const wxString localFile, const CServerPath
 	return ParseSubcommandResult(FZ_REPLY_OK);
 }
 
+void CFtpControlSocket::UseCachedFileDetails(CFtpFileTransferOpData& data, CDirentry const& entry)
+{
+	data.remoteFileSize = entry.size.GetValue();
+	if (entry.has_date())
+		data.fileTime = entry.time;
+
+	bool const wantTime = data.download &&
+		m_pEngine->GetOptions().GetOptionVal(OPTION_PRESERVE_TIMESTAMPS) &&
+		CServerCapabilities::GetCapability(*m_pCurrentServer, mdtm_command) == yes;
+
+	// SIZE is not needed, MDTM only if the listing lacks the time
+	int saved = 1;
+	if (wantTime && !entry.has_time())
+		data.opState = filetransfer_mdtm;
+	else {
+		data.opState = filetransfer_resumetest;
+		if (wantTime)
+			++saved;
+	}
+
+	m_metadataRepliesSaved += saved;
+	LogMessage(MessageType::Debug_Info, _T("Took file details from directory listing, saved %d round trips (%d on this connection)"), saved, m_metadataRepliesSaved);
+}
+
 int CFtpControlSocket::FileTransferParseResponse()
 {
 	LogMessage(MessageType::Debug_Verbose, _T("FileTransferParseResponse()"));
@@ -2357,6 +2390,8 @@ int CFtpControlSocket::FileTransferSubcommandResult(int prevResult)
 			bool found = m_pEngine->GetDirectoryCache().LookupFile(entry, *m_pCurrentServer, pData->tryAbsolutePath ? pData->remotePath : m_CurrentPath, pData->remoteFile, dirDidExist, matchedCase);
 			if (!found)
 			{
+				// A single listing of the directory answers this and all
+				// following files in it, instead of SIZE and MDTM for each.
 				if (!dirDidExist)
 					pData->opState = filetransfer_waitlist;
 				else if (pData->download &&
@@ -2375,21 +2410,7 @@ int CFtpControlSocket::FileTransferSubcommandResult(int prevResult)
 				else
 				{
 					if (matchedCase)
-					{
-						pData->remoteFileSize = entry.size.GetValue();
-						if (entry.has_date())
-							pData->fileTime = entry.time;
-
-						if (pData->download &&
-							!entry.has_time() &&
-							m_pEngine->GetOptions().GetOptionVal(OPTION_PRESERVE_TIMESTAMPS) &&
-							CServerCapabilities::GetCapability(*m_pCurrentServer, mdtm_command) == yes)
-						{
-							pData->opState = filetransfer_mdtm;
-						}
-						else
-							pData->opState = filetransfer_resumetest;
-					}
+						UseCachedFileDetails(*pData, entry);
 					else
 						pData->opState = filetransfer_size;
 				}
@@ -2402,17 +2423,28 @@ int CFtpControlSocket::FileTransferSubcommandResult(int prevResult)
 				ResetOperation(FZ_REPLY_INTERNALERROR);
 				return FZ_REPLY_ERROR;
 			}
-			else if (pData->opState == filetransfer_resumetest)
-			{
-				int res = CheckOverwriteFile();
-				if (res != FZ_REPLY_OK)
-					return res;
-			}
 		}
 		else
 		{
 			pData->tryAbsolutePath = true;
-			pData->opState = filetransfer_size;
+
+			// Cannot list the directory without entering it, but it may
+			// still be known from an earlier listing.
+			CDirentry entry;
+			bool dirDidExist;
+			bool matchedCase;
+			bool found = m_pEngine->GetDirectoryCache().LookupFile(entry, *m_pCurrentServer, pData->remotePath, pData->remoteFile, dirDidExist, matchedCase);
+			if (found && matchedCase && !entry.is_unsure())
+				UseCachedFileDetails(*pData, entry);
+			else
+				pData->opState = filetransfer_size;
+		}
+
+		if (pData->opState == filetransfer_resumetest)
+		{
+			int res = CheckOverwriteFile();
+			if (res != FZ_REPLY_OK)
+				return res;
 		}
 	}
 	else if (pData->opState == filetransfer_waitlist) {
@@ -2434,21 +2466,8 @@ int CFtpControlSocket::FileTransferSubcommandResult(int prevResult)
 					pData->opState = filetransfer_resumetest;
 			}
 			else {
-				if (matchedCase && !entry.is_unsure()) {
-					pData->remoteFileSize = entry.size.GetValue();
-					if (entry.has_date())
-						pData->fileTime = entry.time;
-
-					if (pData->download &&
-						!entry.has_time() &&
-						m_pEngine->GetOptions().GetOptionVal(OPTION_PRESERVE_TIMESTAMPS) &&
-						CServerCapabilities::GetCapability(*m_pCurrentServer, mdtm_command) == yes)
-					{
-						pData->opState = filetransfer_mdtm;
-					}
-					else
-						pData->opState = filetransfer_resumetest;
-				}
+				if (matchedCase && !entry.is_unsure())
+					UseCachedFileDetails(*pData, entry);
 				else
 					pData->opState = filetransfer_size;
 			}
@@ -2476,7 +2495,7 @@ int CFtpControlSocket::FileTransferSubcommandResult(int prevResult)
 					return SendNextCommand();
 				}
 			}
-			else if (pData->download && pData->fileTime.IsValid())
+			else if (pData->download && pData->fileTime.IsValid() && pData->transferSettings.segmentStart < 0)
 			{
 				delete pData->pIOThread;
 				pData->pIOThread = 0;
@@ -2561,7 +2580,42 @@ int CFtpControlSocket::FileTransferSend()
 				// Potentially racy
 				bool didExist = wxFile::Exists(pData->localFile);
 
-				if (pData->resume) {
+				wxFileOffset const segmentStart = pData->transferSettings.segmentStart;
+				if (segmentStart >= 0) {
+					// Other engines are downloading the other segments into the
+					// same file at the same time, leave their parts alone.
+					CreateLocalDir(pData->localFile);
+
+					if (!pFile->Open(pData->localFile, CFile::write, CFile::existing)) {
+						LogMessage(MessageType::Error, _("Failed to open \"%s\" for writing"), pData->localFile);
+						ResetOperation(FZ_REPLY_ERROR);
+						return FZ_REPLY_ERROR;
+					}
+
+					// Never delete the file on failure, other segments may be
+					// done already.
+					pData->fileDidExist = true;
+
+					// All segments extend the file to the same size, so it can't
+					// shrink if they race each other here.
+					if (pData->remoteFileSize > 0 && pFile->Length() < pData->remoteFileSize) {
+						if (pFile->Seek(pData->remoteFileSize, CFile::begin) != pData->remoteFileSize || !pFile->Truncate())
+							LogMessage(MessageType::Debug_Warning, _T("Could not preallocate the file"));
+					}
+
+					if (pFile->Seek(segmentStart, CFile::begin) != segmentStart) {
+						LogMessage(MessageType::Error, _("Could not seek to offset %s within file"), wxLongLong(segmentStart).ToString());
+						ResetOperation(FZ_REPLY_ERROR);
+						return FZ_REPLY_ERROR;
+					}
+					LogMessage(MessageType::Status, _("Downloading bytes %s to %s of the file"), wxLongLong(segmentStart).ToString(), wxLongLong(pData->transferSettings.segmentEnd).ToString());
+
+					pData->localFileSize = segmentStart;
+					pData->resumeOffset = segmentStart;
+					pData->compress = false;
+					m_pEngine->transfer_status_.Init(pData->transferSettings.segmentEnd - segmentStart, 0, false);
+				}
+				else if (pData->resume) {
 					if (!pFile->Open(pData->localFile, CFile::write, CFile::existing)) {
 						LogMessage(MessageType::Error, _("Failed to open \"%s\" for appending/writing"), pData->localFile);
 						ResetOperation(FZ_REPLY_ERROR);
@@ -2604,14 +2658,16 @@ int CFtpControlSocket::FileTransferSend()
 					pData->localFileSize = 0;
 				}
 
-				if (pData->resume)
-					pData->resumeOffset = pData->localFileSize;
-				else
-					pData->resumeOffset = 0;
+				if (segmentStart < 0) {
+					if (pData->resume)
+						pData->resumeOffset = pData->localFileSize;
+					else
+						pData->resumeOffset = 0;
 
-				m_pEngine->transfer_status_.Init(pData->remoteFileSize, startOffset, false);
+					m_pEngine->transfer_status_.Init(pData->remoteFileSize, startOffset, false);
+				}
 
-				if (m_pEngine->GetOptions().GetOptionVal(OPTION_PREALLOCATE_SPACE)) {
+				if (segmentStart < 0 && m_pEngine->GetOptions().GetOptionVal(OPTION_PREALLOCATE_SPACE)) {
 					// Try to preallocate the file in order to reduce fragmentation
 					wxFileOffset sizeToPreallocate = pData->remoteFileSize - startOffset;
 					if (sizeToPreallocate > 0) {
@@ -2685,7 +2741,8 @@ int CFtpControlSocket::FileTransferSend()
 				m_pEngine->transfer_status_.Init(len, startOffset, false);
 			}
 			pData->pIOThread = new CIOThread;
-			if (!pData->pIOThread->Create(std::move(pFile), !pData->download, pData->binary)) {
+			bool const truncate = !pData->download || pData->transferSettings.segmentStart < 0;
+			if (!pData->pIOThread->Create(std::move(pFile), !pData->download, pData->binary, truncate)) {
 				// CIOThread will delete pFile
 				delete pData->pIOThread;
 				pData->pIOThread = 0;
@@ -2697,6 +2754,12 @@ int CFtpControlSocket::FileTransferSend()
 
 		m_pTransferSocket = new CTransferSocket(m_pEngine, this, pData->download ? TransferMode::download : TransferMode::upload);
 		m_pTransferSocket->m_binaryMode = pData->transferSettings.binary;
+		if (pData->download && pData->transferSettings.segmentStart >= 0 &&
+			(pData->remoteFileSize < 0 || pData->transferSettings.segmentEnd < pData->remoteFileSize))
+		{
+			// Last segment simply runs until the end of the file
+			m_pTransferSocket->SetDownloadLimit(pData->transferSettings.segmentEnd - pData->transferSettings.segmentStart);
+		}
 
 		if (pData->download)
 			cmd = _T("RETR ");
@@ -2765,6 +2828,16 @@ void CFtpControlSocket::TransferEnd()
 	if (pData->pOldData->transferEndReason == TransferEndReason::successful)
 		pData->pOldData->transferEndReason = reason;
 
+	if (reason == TransferEndReason::successful && m_pTransferSocket->DownloadLimitReached() &&
+		(pData->opState == rawtransfer_transfer || pData->opState == rawtransfer_waitfinish))
+	{
+		// Got the whole segment while the server is still sending. Tell it to
+		// stop, the reply to ABOR gets skipped once the transfer command
+		// itself got its final reply.
+		if (SendCommand(_T("ABOR")))
+			pData->bAborted = true;
+	}
+
 	switch (m_pCurOpData->opState)
 	{
 	case rawtransfer_transfer:
@@ -2958,6 +3031,7 @@ int CFtpControlSocket::RawCommandSend()
 	m_CurrentPath.clear();
 
 	m_lastTypeBinary = -1;
+	m_lastModeZ = -1;
 
 	CRawCommandOpData *pData = static_cast<CRawCommandOpData *>(m_pCurOpData);
 
@@ -3951,9 +4025,14 @@ int CFtpControlSocket::Transfer(const wxString& cmd, CFtpTransferOpData* oldData
 		}
 	}
 
+	// Resume tests rely on counting the bytes received, don't compress those.
+	pData->bCompress = pData->pOldData->compress && m_pCurrentServer->GetCompressionLevel() > 0 &&
+		CServerCapabilities::GetCapability(*m_pCurrentServer, mode_z_support) == yes &&
+		m_pTransferSocket->GetTransferMode() != TransferMode::resumetest;
+
 	if ((pData->pOldData->binary && m_lastTypeBinary == 1) ||
 		(!pData->pOldData->binary && m_lastTypeBinary == 0))
-		pData->opState = rawtransfer_port_pasv;
+		pData->opState = rawtransfer_mode;
 	else
 		pData->opState = rawtransfer_type;
 
@@ -3988,11 +4067,58 @@ int CFtpControlSocket::TransferParseResponse()
 			error = true;
 		else
 		{
-			pData->opState = rawtransfer_port_pasv;
+			pData->opState = rawtransfer_mode;
 			m_lastTypeBinary = pData->pOldData->binary ? 1 : 0;
 		}
 		break;
+	case rawtransfer_mode:
+		if (code != 2 && code != 3) {
+			if (!pData->bCompress) {
+				// Only sent in case MODE Z might still be active. Servers
+				// without MODE Z support need not know MODE S either, for
+				// them it's the default anyhow.
+				LogMessage(MessageType::Debug_Info, _T("MODE S failed, assuming stream mode"));
+				m_lastModeZ = 0;
+				pData->opState = rawtransfer_port_pasv;
+				break;
+			}
+
+			// Not fatal, transfer uncompressed instead
+			LogMessage(MessageType::Status, _("Server does not accept MODE Z, transferring without compression"));
+			CServerCapabilities::SetCapability(*m_pCurrentServer, mode_z_support, no);
+			pData->bCompress = false;
+		}
+		else {
+			m_lastModeZ = pData->bCompress ? 1 : 0;
+			pData->opState = pData->bCompress ? rawtransfer_mode_level : rawtransfer_port_pasv;
+		}
+		break;
+	case rawtransfer_mode_level:
+		// Servers are free to ignore the level, so is the reply
+		pData->opState = rawtransfer_port_pasv;
+		break;
 	case rawtransfer_port_pasv:
+		if (pData->bPipelined) {
+			// The server already got the transfer command, there's no
+			// going back to try something else.
+			if ((code != 2 && code != 3) ||
+				!(GetPassiveCommand(*pData) == _T("EPSV") ? ParseEpsvResponse(pData) : ParsePasvResponse(pData)))
+			{
+				LogMessage(MessageType::Debug_Warning, _T("Passive command failed after pipelining the transfer command, not pipelining in future"));
+				CServerCapabilities::SetCapability(*m_pCurrentServer, transfer_pipelining, no);
+				error = true;
+				break;
+			}
+
+			pData->opState = rawtransfer_transfer;
+			if (!ActivateTransferSocket(*pData)) {
+				error = true;
+				break;
+			}
+
+			// Transfer command is out already, wait for its reply
+			return FZ_REPLY_WOULDBLOCK;
+		}
 		if (code != 2 && code != 3)
 		{
 			if (!m_pEngine->GetOptions().GetOptionVal(OPTION_ALLOW_TRANSFERMODEFALLBACK))
@@ -4052,6 +4178,11 @@ int CFtpControlSocket::TransferParseResponse()
 			pData->opState = rawtransfer_waitfinish;
 		break;
 	case rawtransfer_waittransferpre:
+		if (code != 1 && pData->bAborted) {
+			// Final reply without preliminary reply, fine after ABOR.
+			ResetOperation(FZ_REPLY_OK);
+			return FZ_REPLY_OK;
+		}
 		if (code != 1) {
 			if (pData->pOldData->transferEndReason == TransferEndReason::successful)
 				pData->pOldData->transferEndReason = TransferEndReason::transfer_command_failure_immediate;
@@ -4070,7 +4201,8 @@ int CFtpControlSocket::TransferParseResponse()
 			pData->opState = rawtransfer_waitsocket;
 		break;
 	case rawtransfer_waittransfer:
-		if (code != 2 && code != 3) {
+		// After ABOR, servers report the transfer as aborted.
+		if (code != 2 && code != 3 && !pData->bAborted) {
 			if (pData->pOldData->transferEndReason == TransferEndReason::successful)
 				pData->pOldData->transferEndReason = TransferEndReason::transfer_command_failure;
 			error = true;
@@ -4137,9 +4269,31 @@ int CFtpControlSocket::TransferSend()
 			cmd = _T("TYPE A");
 		measureRTT = true;
 		break;
+	case rawtransfer_mode:
+		if (m_lastModeZ == (pData->bCompress ? 1 : 0)) {
+			pData->opState = rawtransfer_port_pasv;
+			return SendNextCommand();
+		}
+		if (pData->bCompress)
+			cmd = _T("MODE Z");
+		else
+			cmd = _T("MODE S");
+		break;
+	case rawtransfer_mode_level:
+		cmd = wxString::Format(_T("OPTS MODE Z LEVEL %d"), m_pCurrentServer->GetCompressionLevel());
+		break;
 	case rawtransfer_port_pasv:
 		if (pData->bPasv) {
 			cmd = GetPassiveCommand(*pData);
+			if (CanPipelineTransfer(*pData)) {
+				// Saves a round trip per transfer. The data connection gets
+				// established once the reply to the passive command is in.
+				if (!SendCommand(cmd))
+					return FZ_REPLY_ERROR;
+				cmd = pData->cmd;
+				pData->bPipelined = true;
+				pData->pOldData->tranferCommandSent = true;
+			}
 		}
 		else {
 			wxString address;
@@ -4179,21 +4333,13 @@ int CFtpControlSocket::TransferSend()
 		measureRTT = true;
 		break;
 	case rawtransfer_transfer:
-		if (pData->bPasv)
-		{
-			if (!m_pTransferSocket->SetupPassiveTransfer(pData->host, pData->port))
-			{
-				LogMessage(MessageType::Error, _("Could not establish connection to server"));
-				ResetOperation(FZ_REPLY_ERROR);
-				return FZ_REPLY_ERROR;
-			}
+		if (!ActivateTransferSocket(*pData)) {
+			ResetOperation(FZ_REPLY_ERROR);
+			return FZ_REPLY_ERROR;
 		}
 
 		cmd = pData->cmd;
 		pData->pOldData->tranferCommandSent = true;
-
-		m_pEngine->transfer_status_.SetStartTime();
-		m_pTransferSocket->SetActive();
 		break;
 	case rawtransfer_waitfinish:
 	case rawtransfer_waittransferpre:
@@ -4495,6 +4641,44 @@ void CFtpControlSocket::operator()(CEventBase const& ev)
 	CRealControlSocket::operator()(ev);
 }
 
+bool CFtpControlSocket::CanPipelineTransfer(CRawTransferOpData const& data)
+{
+	if (!m_pEngine->GetOptions().GetOptionVal(OPTION_FTP_PIPELINING))
+		return false;
+
+	if (CServerCapabilities::GetCapability(*m_pCurrentServer, transfer_pipelining) == no)
+		return false;
+
+	// Only on the first attempt, fallbacks need to see the reply first
+	if (data.bTriedActive)
+		return false;
+
+	// A failed REST would make the server send the whole file, so never
+	// pipeline past it.
+	if (data.pOldData->resumeOffset > 0 || m_sentRestartOffset)
+		return false;
+
+	return true;
+}
+
+bool CFtpControlSocket::ActivateTransferSocket(CRawTransferOpData& data)
+{
+	if (data.bPasv) {
+		if (!m_pTransferSocket->SetupPassiveTransfer(data.host, data.port)) {
+			LogMessage(MessageType::Error, _("Could not establish connection to server"));
+			return false;
+		}
+	}
+
+	if (data.bCompress)
+		m_pTransferSocket->EnableCompression(m_pCurrentServer->GetCompressionLevel());
+
+	m_pEngine->transfer_status_.SetStartTime();
+	m_pTransferSocket->SetActive();
+
+	return true;
+}
+
 wxString CFtpControlSocket::GetPassiveCommand(CRawTransferOpData& data)
 {
 	wxString ret = _T("PASV");
@@ -11,6 +11,7 @@
 
 class CTransferSocket;
 class CFtpTransferOpData;
+class CFtpFileTransferOpData;
 class CRawTransferOpData;
 class CTlsSocket;
 
@@ -48,6 +49,10 @@ protected:
 	int FileTransferSend();
 	int FileTransferTestResumeCapability();
 
+	// Fills in remote size and time from a cached listing entry
+	// instead of asking with SIZE and MDTM.
+	void UseCachedFileDetails(CFtpFileTransferOpData& data, CDirentry const& entry);
+
 	virtual int RawCommand(const wxString& command);
 	int RawCommandSend();
 	int RawCommandParseResponse();
@@ -102,6 +107,14 @@ protected:
 	int LogonSend();
 
 	wxString GetPassiveCommand(CRawTransferOpData& data);
+
+	// Whether the transfer command may be sent right after the passive
+	// command instead of waiting for its reply.
+	bool CanPipelineTransfer(CRawTransferOpData const& data);
+
+	// Connects the data connection in passive mode and starts
+	// the transfer socket.
+	bool ActivateTransferSocket(CRawTransferOpData& data);
 	bool ParsePasvResponse(CRawTransferOpData* pData);
 	bool ParseEpsvResponse(CRawTransferOpData* pData);
 
@@ -129,6 +142,9 @@ protected:
 	// So we always sent a REST 0 for a normal transfer following a restarted one
 	bool m_sentRestartOffset;
 
+	// SIZE/MDTM round trips avoided thanks to the directory cache
+	int m_metadataRepliesSaved;
+
 	char m_receiveBuffer[RECVBUFFERSIZE];
 	int m_bufferLen;
 	int m_repliesToSkip; // Set to the amount of pending replies if cancelling an action
@@ -141,6 +157,7 @@ protected:
 	bool m_protectDataChannel;
 
 	int m_lastTypeBinary;
+	int m_lastModeZ;
 
 	// Used by keepalive code so that we're not using keep alive
 	// till the end of time. Stop after a couple of minutes.
@@ -169,6 +186,10 @@ public:
 
 	wxLongLong resumeOffset;
 	bool binary;
+
+	// MODE Z allowed. Not for download segments, they rely on REST
+	// addressing the exact offset, which compressed streams don't promise.
+	bool compress;
 };
 
 class CFtpFileTransferOpData : public CFileTransferOpData, public CFtpTransferOpData
@@ -193,6 +214,16 @@ public:
 	bool bTriedPasv;
 	bool bTriedActive;
 
+	// Use MODE Z if the server supports it
+	bool bCompress;
+
+	// Sent ABOR after receiving all of a download segment
+	bool bAborted;
+
+	// Transfer command got sent right after PASV/EPSV without waiting for
+	// its reply
+	bool bPipelined;
+
 	wxString host;
 	int port;
 };
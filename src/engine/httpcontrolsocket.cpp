@@ -2,12 +2,11 @@
 
 #include "ControlSocket.h"
 #include "engineprivate.h"
+#include "file.h"
 #include "httpcontrolsocket.h"
 #include "local_filesys.h"
 #include "tlssocket.h"
 
-#include <wx/file.h>
-
 #include <errno.h>
 
 #define FZ_REPLY_REDIRECTED FZ_REPLY_ALREADYCONNECTED
@@ -46,10 +45,22 @@ public:
 
 		m_totalSize = -1;
 		m_receivedData = 0;
+		m_rangeStart = -1;
+
+		m_keepAlive = true;
+		m_reusedConnection = false;
 	}
 
 	virtual ~CHttpOpData() {}
 
+	// Whatever Content-Length or Transfer-Encoding say, informational,
+	// 204 and 304 responses never have a body. Neither have responses to
+	// HEAD requests, but those don't get sent.
+	bool HasBody() const
+	{
+		return m_responseCode >= 200 && m_responseCode != 204 && m_responseCode != 304;
+	}
+
 	bool m_gotHeader;
 	int m_responseCode;
 	wxString m_responseString;
@@ -59,6 +70,16 @@ public:
 	wxLongLong m_totalSize;
 	wxLongLong m_receivedData;
 
+	// First byte position from Content-Range, -1 if there is none
+	wxLongLong m_rangeStart;
+
+	// Whether the connection can be used for further requests once the
+	// response is complete.
+	bool m_keepAlive;
+
+	// Request got sent on a connection kept alive from an earlier request
+	bool m_reusedConnection;
+
 	COpData* m_pOpData;
 
 	enum transferEncodings
@@ -84,6 +105,7 @@ public:
 		: CFileTransferOpData(is_download, local_file, remote_file, remote_path), CHttpOpData(this)
 	{
 		pFile = 0;
+		segmentLeft = -1;
 	}
 
 	virtual ~CHttpFileTransferOpData()
@@ -91,7 +113,11 @@ public:
 		delete pFile;
 	}
 
-	wxFile* pFile;
+	CFile* pFile;
+
+	// Only used for segmented downloads, -1 once the server turned out
+	// to ignore the Range header and sends the whole file.
+	wxFileOffset segmentLeft;
 };
 
 CHttpControlSocket::CHttpControlSocket(CFileZillaEnginePrivate *pEngine)
@@ -101,6 +127,8 @@ CHttpControlSocket::CHttpControlSocket(CFileZillaEnginePrivate *pEngine)
 	m_recvBufferPos = 0;
 	m_pTlsSocket = 0;
 	m_pHttpOpData = 0;
+	m_connectedPort = 0;
+	m_connectedTls = false;
 }
 
 CHttpControlSocket::~CHttpControlSocket()
@@ -225,7 +253,7 @@ int CHttpControlSocket::DoReceive()
 		int read = m_pBackend->Read(m_pRecvBuffer + m_recvBufferPos, len, error);
 		if (read == -1)
 		{
-			if (error != EAGAIN)
+			if (error != EAGAIN && !RetryOnNewConnection())
 			{
 				ResetOperation(FZ_REPLY_ERROR | FZ_REPLY_DISCONNECTED);
 			}
@@ -245,7 +273,8 @@ int CHttpControlSocket::DoReceive()
 		if (!m_pHttpOpData->m_gotHeader) {
 			if (!read)
 			{
-				ResetOperation(FZ_REPLY_ERROR | FZ_REPLY_DISCONNECTED);
+				if (!RetryOnNewConnection())
+					ResetOperation(FZ_REPLY_ERROR | FZ_REPLY_DISCONNECTED);
 				return 0;
 			}
 
@@ -272,12 +301,8 @@ int CHttpControlSocket::DoReceive()
 				ProcessData(0, 0);
 				return 0;
 			}
-			else
-			{
-				m_pHttpOpData->m_receivedData += m_recvBufferPos;
-				ProcessData(m_pRecvBuffer, m_recvBufferPos);
-				m_recvBufferPos = 0;
-			}
+			else if (ProcessIdentityData(m_pHttpOpData) != FZ_REPLY_WOULDBLOCK)
+				return 0;
 		}
 	}
 	while (m_pSocket);
@@ -332,7 +357,7 @@ enum filetransferStates
 
 int CHttpControlSocket::FileTransfer(const wxString localFile, const CServerPath &remotePath,
 							  const wxString &remoteFile, bool download,
-							  const CFileTransferCommand::t_transferSettings&)
+							  const CFileTransferCommand::t_transferSettings& transferSettings)
 {
 	LogMessage(MessageType::Debug_Verbose, _T("CHttpControlSocket::FileTransfer()"));
 
@@ -353,6 +378,12 @@ int CHttpControlSocket::FileTransfer(const wxString localFile, const CServerPath
 	CHttpFileTransferOpData *pData = new CHttpFileTransferOpData(download, localFile, remoteFile, remotePath);
 	m_pCurOpData = pData;
 	m_pHttpOpData = pData;
+	pData->transferSettings = transferSettings;
+
+	if (transferSettings.segmentStart >= 0 && localFile.empty()) {
+		ResetOperation(FZ_REPLY_CRITICALERROR | FZ_REPLY_NOTSUPPORTED);
+		return FZ_REPLY_ERROR;
+	}
 
 	m_current_uri = wxURI(m_pCurrentServer->FormatServer() + pData->remotePath.FormatFilename(pData->remoteFile));
 
@@ -443,8 +474,15 @@ int CHttpControlSocket::FileTransferSend()
 	if( m_current_uri.HasPort() ) {
 		hostWithPort += _T(":") + m_current_uri.GetPort();
 	}
-	wxString command = wxString::Format(_T("%s\r\nHost: %s\r\nUser-Agent: %s\r\nConnection: close\r\n"), action, hostWithPort, wxString(PACKAGE_STRING, wxConvLocal));
-	if( pData->resume ) {
+	// HTTP/1.1 connections are persistent by default
+	wxString command = wxString::Format(_T("%s\r\nHost: %s\r\nUser-Agent: %s\r\n"), action, hostWithPort, wxString(PACKAGE_STRING, wxConvLocal));
+	wxFileOffset const segmentStart = pData->transferSettings.segmentStart;
+	if (segmentStart >= 0) {
+		wxFileOffset const segmentEnd = pData->transferSettings.segmentEnd;
+		command += wxString::Format(_T("Range: bytes=%") + wxString(wxFileOffsetFmtSpec) + _T("d-%") + wxString(wxFileOffsetFmtSpec) + _T("d\r\n"), segmentStart, segmentEnd - 1);
+		pData->segmentLeft = segmentEnd - segmentStart;
+	}
+	else if( pData->resume ) {
 		command += wxString::Format(_T("Range: bytes=%") + wxString(wxFileOffsetFmtSpec) + _T("d-\r\n"), pData->localFileSize);
 	}
 	command += _T("\r\n");
@@ -460,6 +498,20 @@ int CHttpControlSocket::InternalConnect(wxString host, unsigned short port, bool
 {
 	LogMessage(MessageType::Debug_Verbose, _T("CHttpControlSocket::InternalConnect()"));
 
+	if (m_pBackend) {
+		if (m_pSocket->GetState() == CSocket::connected && host == m_connectedHost && port == m_connectedPort && tls == m_connectedTls) {
+			LogMessage(MessageType::Status, _("Reusing existing connection to %s"), host);
+			if (m_pHttpOpData)
+				m_pHttpOpData->m_reusedConnection = true;
+			return FZ_REPLY_OK;
+		}
+		ResetSocket();
+	}
+
+	m_connectedHost = host;
+	m_connectedPort = port;
+	m_connectedTls = tls;
+
 	CHttpConnectOpData* pData = new CHttpConnectOpData;
 	pData->pNextOpData = m_pCurOpData;
 	m_pCurOpData = pData;
@@ -512,15 +564,30 @@ int CHttpControlSocket::FileTransferParseResponse(char* p, unsigned int len)
 	CHttpFileTransferOpData *pData = static_cast<CHttpFileTransferOpData *>(m_pCurOpData);
 
 	if (!p) {
+		if (pData->segmentLeft > 0) {
+			LogMessage(MessageType::Error, _("Connection closed before the whole segment has been received"));
+			ResetOperation(FZ_REPLY_ERROR);
+			return FZ_REPLY_ERROR;
+		}
 		ResetOperation(FZ_REPLY_OK);
 		return FZ_REPLY_OK;
 	}
 
 	if (m_pEngine->transfer_status_.Empty()) {
-		m_pEngine->transfer_status_.Init(pData->m_totalSize.GetValue(), 0, false);
+		if (pData->segmentLeft != -1)
+			m_pEngine->transfer_status_.Init(pData->segmentLeft, 0, false);
+		else
+			m_pEngine->transfer_status_.Init(pData->m_totalSize.GetValue(), 0, false);
 		m_pEngine->transfer_status_.SetStartTime();
 	}
 
+	if (pData->segmentLeft != -1) {
+		// Never write past the segment, it belongs to another one
+		if (static_cast<wxFileOffset>(len) > pData->segmentLeft)
+			len = static_cast<unsigned int>(pData->segmentLeft);
+		pData->segmentLeft -= len;
+	}
+
 	if (pData->localFile.empty())
 	{
 		char* q = new char[len];
@@ -531,7 +598,7 @@ int CHttpControlSocket::FileTransferParseResponse(char* p, unsigned int len)
 	{
 		wxASSERT(pData->pFile);
 
-		if (pData->pFile->Write(p, len) != len)
+		if (pData->pFile->Write(p, len) != static_cast<ssize_t>(len))
 		{
 			LogMessage(MessageType::Error, _("Failed to write to file %s"), pData->localFile);
 			ResetOperation(FZ_REPLY_ERROR);
@@ -606,6 +673,10 @@ int CHttpControlSocket::ParseHeader(CHttpOpData* pData)
 
 			pData->m_responseCode = (m_pRecvBuffer[9] - '0') * 100 + (m_pRecvBuffer[10] - '0') * 10 + m_pRecvBuffer[11] - '0';
 
+			if (m_pRecvBuffer[7] == '0') {
+				// HTTP/1.0 servers close the connection after each response
+				pData->m_keepAlive = false;
+			}
 			if( pData->m_responseCode == 416 ) {
 				CHttpFileTransferOpData* pTransfer = reinterpret_cast<CHttpFileTransferOpData*>(pData->m_pOpData);
 				if( pTransfer->resume ) {
@@ -687,7 +758,29 @@ int CHttpControlSocket::ParseHeader(CHttpOpData* pData)
 
 				if( pData->m_pOpData && pData->m_pOpData->opId == Command::transfer) {
 					CHttpFileTransferOpData* pTransfer = reinterpret_cast<CHttpFileTransferOpData*>(pData->m_pOpData);
-					if( pTransfer->resume && pData->m_responseCode != 206 ) {
+					wxFileOffset const segmentStart = pTransfer->transferSettings.segmentStart;
+					if (segmentStart >= 0) {
+						if (pData->m_responseCode == 206) {
+							if (pData->m_rangeStart != segmentStart) {
+								LogMessage(MessageType::Error, _("Server sent a different byte range than requested"));
+								ResetOperation(FZ_REPLY_ERROR);
+								return FZ_REPLY_ERROR;
+							}
+						}
+						else if (segmentStart > 0) {
+							// The server ignores the Range header. Only a single
+							// stream makes sense then, which the first segment
+							// takes care of.
+							LogMessage(MessageType::Error, _("Server does not support byte ranges"));
+							ResetOperation(FZ_REPLY_CRITICALERROR | FZ_REPLY_NOTSUPPORTED);
+							return FZ_REPLY_ERROR;
+						}
+						else {
+							LogMessage(MessageType::Status, _("Server does not support byte ranges, downloading the whole file"));
+							pTransfer->segmentLeft = -1;
+						}
+					}
+					else if( pTransfer->resume && pData->m_responseCode != 206 ) {
 						pTransfer->resume = false;
 						int res = OpenFile(pTransfer);
 						if( res != FZ_REPLY_OK ) {
@@ -698,24 +791,22 @@ int CHttpControlSocket::ParseHeader(CHttpOpData* pData)
 
 				pData->m_gotHeader = true;
 
+				if (!pData->HasBody()) {
+					pData->m_totalSize = 0;
+					pData->m_transferEncoding = CHttpOpData::identity;
+				}
+
 				memmove(m_pRecvBuffer, m_pRecvBuffer + 2, m_recvBufferPos - 2);
 				m_recvBufferPos -= 2;
 
-				if (m_recvBufferPos)
-				{
-					int res;
-					if (pData->m_transferEncoding == pData->chunked)
-						res = OnChunkedData(pData);
-					else
-					{
-						pData->m_receivedData += m_recvBufferPos;
-						res = ProcessData(m_pRecvBuffer, m_recvBufferPos);
-						m_recvBufferPos = 0;
-					}
-					return res;
+				if (pData->m_transferEncoding == pData->chunked) {
+					if (m_recvBufferPos)
+						return OnChunkedData(pData);
+					return FZ_REPLY_WOULDBLOCK;
 				}
 
-				return FZ_REPLY_WOULDBLOCK;
+				// Also completes responses with empty body
+				return ProcessIdentityData(pData);
 			}
 			if (m_recvBufferPos > 12 && !memcmp(m_pRecvBuffer, "Location: ", 10))
 			{
@@ -731,6 +822,22 @@ int CHttpControlSocket::ParseHeader(CHttpOpData* pData)
 				else
 					pData->m_transferEncoding = CHttpOpData::unknown;
 			}
+			else if (i > 12 && !memcmp(m_pRecvBuffer, "Connection: ", 12))
+			{
+				// Tokens are case-insensitive
+				if (!wxStricmp(m_pRecvBuffer + 12, "close"))
+					pData->m_keepAlive = false;
+			}
+			else if (i > 21 && !memcmp(m_pRecvBuffer, "Content-Range: bytes ", 21))
+			{
+				// Only the first byte position is of interest
+				pData->m_rangeStart = 0;
+				char* p = m_pRecvBuffer + 21;
+				while (*p >= '0' && *p <= '9')
+					pData->m_rangeStart = pData->m_rangeStart * 10 + *p++ - '0';
+				if (p == m_pRecvBuffer + 21 || *p != '-')
+					pData->m_rangeStart = -1;
+			}
 			else if (i > 16 && !memcmp(m_pRecvBuffer, "Content-Length: ", 16))
 			{
 				pData->m_totalSize = 0;
@@ -889,14 +996,20 @@ int CHttpControlSocket::ResetOperation(int nErrorCode)
 
 	if (!m_pCurOpData || !m_pCurOpData->pNextOpData)
 	{
-		if (m_pBackend)
-		{
-			if (nErrorCode == FZ_REPLY_OK)
-				LogMessage(MessageType::Status, _("Disconnected from server"));
-			else
-				LogMessage(MessageType::Error, _("Disconnected from server"));
+		if (nErrorCode == FZ_REPLY_OK && m_pBackend && m_pHttpOpData && CanKeepAlive(m_pHttpOpData)) {
+			LogMessage(MessageType::Debug_Info, _T("Keeping connection open for further requests"));
+			m_recvBufferPos = 0;
+		}
+		else {
+			if (m_pBackend)
+			{
+				if (nErrorCode == FZ_REPLY_OK)
+					LogMessage(MessageType::Status, _("Disconnected from server"));
+				else
+					LogMessage(MessageType::Error, _("Disconnected from server"));
+			}
+			ResetSocket();
 		}
-		ResetSocket();
 		m_pHttpOpData = 0;
 	}
 
@@ -908,14 +1021,18 @@ void CHttpControlSocket::OnClose(int error)
 	LogMessage(MessageType::Debug_Verbose, _T("CHttpControlSocket::OnClose(%d)"), error);
 
 	if (error) {
+		if (RetryOnNewConnection())
+			return;
 		LogMessage(MessageType::Error, _("Disconnected from server: %s"), CSocket::GetErrorDescription(error));
 		ResetOperation(FZ_REPLY_ERROR | FZ_REPLY_DISCONNECTED);
 		return;
 	}
 
-	// HTTP socket isn't connected outside operations
-	if (!m_pCurOpData)
+	// Server closed a connection kept open for further requests
+	if (!m_pCurOpData) {
+		ResetSocket();
 		return;
+	}
 
 	if (m_pCurOpData->pNextOpData) {
 		ResetOperation(FZ_REPLY_ERROR | FZ_REPLY_DISCONNECTED);
@@ -923,7 +1040,8 @@ void CHttpControlSocket::OnClose(int error)
 	}
 
 	if (!m_pHttpOpData->m_gotHeader) {
-		ResetOperation(FZ_REPLY_ERROR | FZ_REPLY_DISCONNECTED);
+		if (!RetryOnNewConnection())
+			ResetOperation(FZ_REPLY_ERROR | FZ_REPLY_DISCONNECTED);
 		return;
 	}
 
@@ -960,6 +1078,81 @@ void CHttpControlSocket::ResetHttpData(CHttpOpData* pData)
 
 	pData->m_totalSize = -1;
 	pData->m_receivedData = 0;
+	pData->m_rangeStart = -1;
+
+	pData->m_keepAlive = true;
+	pData->m_reusedConnection = false;
+}
+
+int CHttpControlSocket::ProcessIdentityData(CHttpOpData* pData)
+{
+	unsigned int len = m_recvBufferPos;
+	m_recvBufferPos = 0;
+
+	if (pData->m_totalSize != -1) {
+		wxLongLong const remaining = pData->m_totalSize - pData->m_receivedData;
+		if (remaining < len) {
+			// More than announced, don't trust the connection any longer
+			LogMessage(MessageType::Debug_Warning, _T("Server sent more data than announced in Content-Length"));
+			pData->m_keepAlive = false;
+			len = remaining.GetLo();
+		}
+	}
+
+	if (len) {
+		pData->m_receivedData += len;
+		int res = ProcessData(m_pRecvBuffer, len);
+		if (res != FZ_REPLY_WOULDBLOCK)
+			return res;
+	}
+
+	// Without a length, the body ends when the server closes the connection
+	if (pData->m_totalSize != -1 && pData->m_receivedData == pData->m_totalSize)
+		return ProcessData(0, 0);
+
+	return FZ_REPLY_WOULDBLOCK;
+}
+
+bool CHttpControlSocket::CanKeepAlive(CHttpOpData* pData) const
+{
+	if (!pData->m_keepAlive || !pData->m_gotHeader)
+		return false;
+
+	if (m_pSocket->GetState() != CSocket::connected)
+		return false;
+
+	// Only if the end of the body is known without the server closing
+	// the connection.
+	if (pData->m_transferEncoding == CHttpOpData::chunked)
+		return pData->m_chunkData.getTrailer;
+
+	return pData->m_totalSize != -1 && pData->m_receivedData == pData->m_totalSize;
+}
+
+bool CHttpControlSocket::RetryOnNewConnection()
+{
+	// The server may close a connection kept open from an earlier request
+	// just as the next request got sent. Try again once on a fresh
+	// connection if there hasn't been any response yet.
+	if (!m_pHttpOpData || !m_pHttpOpData->m_reusedConnection)
+		return false;
+
+	if (m_pHttpOpData->m_responseCode != -1 || m_recvBufferPos)
+		return false;
+
+	if (!m_pCurOpData || m_pCurOpData->opId != Command::transfer)
+		return false;
+
+	LogMessage(MessageType::Status, _("Server closed the connection, reconnecting"));
+
+	m_pHttpOpData->m_reusedConnection = false;
+	ResetSocket();
+
+	int res = InternalConnect(m_connectedHost, m_connectedPort, m_connectedTls);
+	if (res == FZ_REPLY_OK)
+		FileTransferSend();
+
+	return true;
 }
 
 int CHttpControlSocket::ProcessData(char* p, int len)
@@ -1006,6 +1199,14 @@ int CHttpControlSocket::ParseSubcommandResult(int prevResult)
 	return FZ_REPLY_ERROR;
 }
 
+void CHttpControlSocket::ResetSocket()
+{
+	// Gets deleted as backend
+	m_pTlsSocket = 0;
+
+	CRealControlSocket::ResetSocket();
+}
+
 int CHttpControlSocket::Disconnect()
 {
 	DoClose();
@@ -1015,16 +1216,34 @@ int CHttpControlSocket::Disconnect()
 int CHttpControlSocket::OpenFile( CHttpFileTransferOpData* pData)
 {
 	delete pData->pFile;
-	pData->pFile = new wxFile();
+	pData->pFile = new CFile();
 	CreateLocalDir(pData->localFile);
 
-	if (!pData->pFile->Open(pData->localFile, pData->resume ? wxFile::write_append : wxFile::write))
+	wxFileOffset const segmentStart = pData->transferSettings.segmentStart;
+
+	// Other engines are downloading the other segments into the same
+	// file at the same time, leave their parts alone.
+	bool const keep = pData->resume || segmentStart >= 0;
+	if (!pData->pFile->Open(pData->localFile, CFile::write, keep ? CFile::existing : CFile::truncate))
 	{
 		LogMessage(MessageType::Error, _("Failed to open \"%s\" for writing"), pData->localFile);
 		ResetOperation(FZ_REPLY_ERROR);
 		return FZ_REPLY_ERROR;
 	}
-	wxFileOffset end = pData->pFile->SeekEnd();
+
+	if (segmentStart >= 0) {
+		if (pData->pFile->Seek(segmentStart, CFile::begin) != segmentStart) {
+			LogMessage(MessageType::Error, _("Could not seek to offset %s within file"), wxLongLong(segmentStart).ToString());
+			ResetOperation(FZ_REPLY_ERROR);
+			return FZ_REPLY_ERROR;
+		}
+		LogMessage(MessageType::Status, _("Downloading bytes %s to %s of the file"), wxLongLong(segmentStart).ToString(), wxLongLong(pData->transferSettings.segmentEnd).ToString());
+		pData->resume = false;
+		pData->localFileSize = segmentStart;
+		return FZ_REPLY_OK;
+	}
+
+	wxFileOffset end = pData->pFile->Seek(0, CFile::end);
 	if( !end ) {
 		pData->resume = false;
 	}
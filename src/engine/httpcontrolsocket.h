@@ -48,6 +48,15 @@ protected:
 
 	int ProcessData(char* p, int len);
 
+	// Passes on body data not using chunked encoding, up to the announced
+	// length. Completes the operation once all of it got received.
+	int ProcessIdentityData(CHttpOpData* pData);
+
+	bool CanKeepAlive(CHttpOpData* pData) const;
+	bool RetryOnNewConnection();
+
+	virtual void ResetSocket();
+
 	char* m_pRecvBuffer;
 	unsigned int m_recvBufferPos;
 	static const unsigned int m_recvBufferLen = 4096;
@@ -57,6 +66,11 @@ protected:
 	CTlsSocket* m_pTlsSocket;
 
 	wxURI m_current_uri;
+
+	// Target of the current connection, to reuse it for further requests
+	wxString m_connectedHost;
+	unsigned short m_connectedPort;
+	bool m_connectedTls;
 };
 
 #endif //__HTTPCONTROLSOCKET_H__
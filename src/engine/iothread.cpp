@@ -9,6 +9,7 @@ CIOThread::CIOThread()
 	: wxThread(wxTHREAD_JOINABLE), m_evtHandler(0)
 	, m_read()
 	, m_binary()
+	, m_truncate()
 	, m_condition(m_mutex)
 	, m_curAppBuf()
 	, m_curThreadBuf()
@@ -38,14 +39,14 @@ void CIOThread::Close()
 	if (m_pFile) {
 		// The file might have been preallocated and the transfer stopped before being completed
 		// so always truncate the file to the actually written size before closing it.
-		if (!m_read)
+		if (!m_read && m_truncate)
 			m_pFile->Truncate();
 
 		m_pFile.reset();
 	}
 }
 
-bool CIOThread::Create(std::unique_ptr<CFile> && pFile, bool read, bool binary)
+bool CIOThread::Create(std::unique_ptr<CFile> && pFile, bool read, bool binary, bool truncate)
 {
 	wxASSERT(pFile);
 
@@ -54,6 +55,7 @@ bool CIOThread::Create(std::unique_ptr<CFile> && pFile, bool read, bool binary)
 	m_pFile = std::move(pFile);
 	m_read = read;
 	m_binary = binary;
+	m_truncate = truncate;
 
 	if (read) {
 		m_curAppBuf = BUFFERCOUNT - 1;
@@ -161,6 +163,8 @@ wxThread::ExitCode CIOThread::Entry()
 				m_error = true;
 				m_running = false;
 			}
+			else
+				m_written += m_bufferLens[m_curThreadBuf];
 
 			if (m_appWaiting) {
 				if (!m_evtHandler) {
@@ -237,6 +241,7 @@ bool CIOThread::Finalize(int len)
 
 	if (!WriteToFile(m_buffers[m_curAppBuf], len))
 		return false;
+	m_written += len;
 
 #ifndef __WXMSW__
 	if (!m_binary && m_wasCarriageReturn)
@@ -423,6 +428,12 @@ bool CIOThread::DoWrite(const char* pBuffer, int len)
 	return false;
 }
 
+wxFileOffset CIOThread::GetWritten()
+{
+	wxMutexLocker locker(m_mutex);
+	return m_written;
+}
+
 wxString CIOThread::GetError()
 {
 	wxMutexLocker locker(m_mutex);
@@ -29,7 +29,10 @@ public:
 	CIOThread();
 	virtual ~CIOThread();
 
-	bool Create(std::unique_ptr<CFile> && pFile, bool read, bool binary);
+	// If truncate is false, writes stop short of truncating the file to the
+	// written size on close. Needed if the file is shared with other
+	// transfers writing to other parts of it.
+	bool Create(std::unique_ptr<CFile> && pFile, bool read, bool binary, bool truncate = true);
 	virtual void Destroy(); // Only call that might be blocking
 
 	// Call before first call to one of the GetNext*Buffer functions
@@ -53,6 +56,10 @@ public:
 
 	bool Finalize(int len);
 
+	// Number of bytes handed over through the write buffers that have been
+	// written to the file already
+	wxFileOffset GetWritten();
+
 	wxString GetError();
 
 protected:
@@ -68,6 +75,7 @@ protected:
 
 	bool m_read;
 	bool m_binary;
+	bool m_truncate;
 	std::unique_ptr<CFile> m_pFile;
 
 	char* m_buffers[BUFFERCOUNT];
@@ -88,6 +96,8 @@ protected:
 
 	bool m_wasCarriageReturn;
 
+	wxFileOffset m_written{};
+
 	wxString m_error_description;
 
 #ifdef SIMULATE_IO
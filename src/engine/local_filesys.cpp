@@ -7,6 +7,10 @@
 #include <wx/filename.h>
 #include <wx/msgdlg.h>
 
+#ifndef __WXMSW__
+#include <fcntl.h>
+#endif
+
 #ifdef __WXMSW__
 const wxChar CLocalFileSystem::path_separator = '\\';
 #else
@@ -15,6 +19,7 @@ const wxChar CLocalFileSystem::path_separator = '/';
 
 CLocalFileSystem::CLocalFileSystem()
 	: m_dirs_only()
+	, m_metadata(true)
 #ifdef __WXMSW__
 	, m_hFind(INVALID_HANDLE_VALUE)
 	, m_found()
@@ -298,10 +303,13 @@ enum CLocalFileSystem::local_fileType CLocalFileSystem::GetFileInfo(const wxStri
 }
 
 #ifndef __WXMSW__
-enum CLocalFileSystem::local_fileType CLocalFileSystem::GetFileInfo(const char* path, bool &isLink, wxLongLong* size, CDateTime* modificationTime, int *mode)
+namespace {
+// do_stat(buf, follow_links) has to behave like stat or lstat
+template<typename Stat>
+enum CLocalFileSystem::local_fileType DoGetFileInfo(Stat const& do_stat, bool &isLink, wxLongLong* size, CDateTime* modificationTime, int *mode)
 {
 	struct stat buf;
-	int result = lstat(path, &buf);
+	int result = do_stat(buf, false);
 	if (result)
 	{
 		isLink = false;
@@ -311,14 +319,14 @@ enum CLocalFileSystem::local_fileType CLocalFileSystem::GetFileInfo(const char*
 			*mode = -1;
 		if (modificationTime)
 			*modificationTime = CDateTime();
-		return unknown;
+		return CLocalFileSystem::unknown;
 	}
 
 #ifdef S_ISLNK
 	if (S_ISLNK(buf.st_mode))
 	{
 		isLink = true;
-		int result = stat(path, &buf);
+		int result = do_stat(buf, true);
 		if (result)
 		{
 			if (size)
@@ -327,7 +335,7 @@ enum CLocalFileSystem::local_fileType CLocalFileSystem::GetFileInfo(const char*
 				*mode = -1;
 			if (modificationTime)
 				*modificationTime = CDateTime();
-			return unknown;
+			return CLocalFileSystem::unknown;
 		}
 	}
 	else
@@ -344,13 +352,37 @@ enum CLocalFileSystem::local_fileType CLocalFileSystem::GetFileInfo(const char*
 	{
 		if (size)
 			*size = -1;
-		return dir;
+		return CLocalFileSystem::dir;
 	}
 
 	if (size)
 		*size = buf.st_size;
 
-	return file;
+	return CLocalFileSystem::file;
+}
+}
+
+enum CLocalFileSystem::local_fileType CLocalFileSystem::GetFileInfo(const char* path, bool &isLink, wxLongLong* size, CDateTime* modificationTime, int *mode)
+{
+	return DoGetFileInfo([path](struct stat& buf, bool follow_links) {
+		return follow_links ? stat(path, &buf) : lstat(path, &buf);
+	}, isLink, size, modificationTime, mode);
+}
+
+enum CLocalFileSystem::local_fileType CLocalFileSystem::GetEntryInfo(const char* name, bool &isLink, wxLongLong* size, CDateTime* modificationTime, int *mode)
+{
+#if HAVE_FSTATAT
+	// Relative to the open directory, so its path doesn't have to be
+	// resolved again for every entry
+	int const fd = dirfd(m_dir);
+	return DoGetFileInfo([fd, name](struct stat& buf, bool follow_links) {
+		return fstatat(fd, name, &buf, follow_links ? 0 : AT_SYMLINK_NOFOLLOW);
+	}, isLink, size, modificationTime, mode);
+#else
+	AllocPathBuffer(name);
+	strcpy(m_file_part, name);
+	return GetFileInfo(m_raw_path, isLink, size, modificationTime, mode);
+#endif
 }
 #endif
 
@@ -397,11 +429,12 @@ bool CLocalFileSystem::ConvertCDateTimeToFileTime(FILETIME &ft, const CDateTime&
 }
 #endif
 
-bool CLocalFileSystem::BeginFindFiles(wxString path, bool dirs_only)
+bool CLocalFileSystem::BeginFindFiles(wxString path, bool dirs_only, bool metadata)
 {
 	EndFindFiles();
 
 	m_dirs_only = dirs_only;
+	m_metadata = metadata;
 #ifdef __WXMSW__
 	if (path.Last() != '/' && path.Last() != '\\') {
 		m_find_path = path + _T("\\");
@@ -430,6 +463,7 @@ bool CLocalFileSystem::BeginFindFiles(wxString path, bool dirs_only)
 	if (!m_dir)
 		return false;
 
+#if !HAVE_FSTATAT
 	const wxCharBuffer p = path.fn_str();
 	const int len = strlen(p);
 	m_raw_path = new char[len + 2048 + 2];
@@ -442,6 +476,7 @@ bool CLocalFileSystem::BeginFindFiles(wxString path, bool dirs_only)
 	}
 	else
 		m_file_part = m_raw_path + len;
+#endif
 
 	return true;
 #endif
@@ -503,12 +538,10 @@ bool CLocalFileSystem::GetNextFile(wxString& name)
 
 		if (m_dirs_only) {
 #if HAVE_STRUCT_DIRENT_D_TYPE
-			if (entry->d_type == DT_LNK)
+			if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN)
 			{
 				bool wasLink;
-				AllocPathBuffer(entry->d_name);
-				strcpy(m_file_part, entry->d_name);
-				if (GetFileInfo(m_raw_path, wasLink, 0, 0, 0) != dir)
+				if (GetEntryInfo(entry->d_name, wasLink, 0, 0, 0) != dir)
 					continue;
 			}
 			else if (entry->d_type != DT_DIR)
@@ -516,9 +549,7 @@ bool CLocalFileSystem::GetNextFile(wxString& name)
 #else
 			// Solaris doesn't have d_type
 			bool wasLink;
-			AllocPathBuffer(entry->d_name);
-			strcpy(m_file_part, entry->d_name);
-			if (GetFileInfo(m_raw_path, wasLink, 0, 0, 0) != dir)
+			if (GetEntryInfo(entry->d_name, wasLink, 0, 0, 0) != dir)
 				continue;
 #endif
 		}
@@ -633,9 +664,7 @@ bool CLocalFileSystem::GetNextFile(wxString& name, bool &isLink, bool &is_dir, w
 		{
 			if (entry->d_type == DT_LNK)
 			{
-				AllocPathBuffer(entry->d_name);
-				strcpy(m_file_part, entry->d_name);
-				enum local_fileType type = GetFileInfo(m_raw_path, isLink, size, modificationTime, mode);
+				enum local_fileType type = GetEntryInfo(entry->d_name, isLink, size, modificationTime, mode);
 				if (type != dir)
 					continue;
 
@@ -643,14 +672,28 @@ bool CLocalFileSystem::GetNextFile(wxString& name, bool &isLink, bool &is_dir, w
 				is_dir = true;
 				return true;
 			}
-			else if (entry->d_type != DT_DIR)
+			else if (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN)
 				continue;
 		}
+
+		if (!m_metadata && entry->d_type != DT_LNK && entry->d_type != DT_UNKNOWN)
+		{
+			// The type is all that's needed and known already
+			isLink = false;
+			is_dir = entry->d_type == DT_DIR;
+			if (size)
+				*size = -1;
+			if (modificationTime)
+				*modificationTime = CDateTime();
+			if (mode)
+				*mode = 0;
+
+			name = wxString(entry->d_name, *wxConvFileName);
+			return true;
+		}
 #endif
 
-		AllocPathBuffer(entry->d_name);
-		strcpy(m_file_part, entry->d_name);
-		enum local_fileType type = GetFileInfo(m_raw_path, isLink, size, modificationTime, mode);
+		enum local_fileType type = GetEntryInfo(entry->d_name, isLink, size, modificationTime, mode);
 
 		if (type == unknown) // Happens for example in case of permission denied
 		{
@@ -286,6 +286,7 @@ CServer& CServer::operator=(const CServer &op)
 	m_timezoneOffset = op.m_timezoneOffset;
 	m_pasvMode = op.m_pasvMode;
 	m_maximumMultipleConnections = op.m_maximumMultipleConnections;
+	m_compressionLevel = op.m_compressionLevel;
 	m_encodingType = op.m_encodingType;
 	m_customEncoding = op.m_customEncoding;
 	m_postLoginCommands = op.m_postLoginCommands;
@@ -612,6 +613,21 @@ int CServer::MaximumMultipleConnections() const
 	return m_maximumMultipleConnections;
 }
 
+bool CServer::SetCompressionLevel(int level)
+{
+	if (level < 0 || level > 9)
+		return false;
+
+	m_compressionLevel = level;
+
+	return true;
+}
+
+int CServer::GetCompressionLevel() const
+{
+	return m_compressionLevel;
+}
+
 wxString CServer::FormatHost(bool always_omit_port /*=false*/) const
 {
 	wxString host = m_host;
@@ -660,6 +676,7 @@ void CServer::Initialize()
 	m_timezoneOffset = 0;
 	m_pasvMode = MODE_DEFAULT;
 	m_maximumMultipleConnections = 0;
+	m_compressionLevel = 0;
 	m_encodingType = ENCODING_AUTO;
 	m_customEncoding.clear();
 	m_bypassProxy = false;
@@ -29,6 +29,7 @@ enum capabilityNames
 	list_hidden_support, // LIST -a command
 	rest_stream, // supports REST+STOR in addition to APPE
 	epsv_command,
+	transfer_pipelining, // set to 'no' if sending the transfer command before the PASV/EPSV reply failed
 
 	// FTPS and HTTPS
 	tls_resume, // Does the server support resuming of TLS sessions?
@@ -17,6 +17,7 @@
 #endif
 #include <filezilla.h>
 #include "socket.h"
+#include <wx/stopwatch.h>
 #include <errno.h>
 #ifndef __WXMSW__
   #include <sys/types.h>
@@ -30,6 +31,16 @@
     #include <signal.h>
   #endif
 #endif
+#if HAVE_LINUX_TLS_H
+  #include <linux/tls.h>
+  // Older C libraries lack these
+  #ifndef TCP_ULP
+    #define TCP_ULP 31
+  #endif
+  #ifndef SOL_TLS
+    #define SOL_TLS 282
+  #endif
+#endif
 
 // Fixups needed on FreeBSD
 #if !defined(EAI_ADDRFAMILY) && defined(EAI_FAMILY)
@@ -53,6 +64,11 @@ union sockaddr_u
 #define WAIT_CLOSE	 0x10
 #define WAIT_EVENTCOUNT 5
 
+// How long in milliseconds a connection attempt gets before an attempt to
+// the next address is raced against it, see RFC 8305
+#define CONNECTION_ATTEMPT_DELAY 250
+#define MAX_CONNECTION_ATTEMPTS 8
+
 class CSocketThread;
 static std::list<CSocketThread*> waiting_socket_threads;
 
@@ -454,28 +470,62 @@ protected:
 		}
 	}
 
-	int TryConnectHost(struct addrinfo *addr)
+	struct connect_attempt
 	{
-		if (m_pSocket->m_pEvtHandler) {
-			CSocketEvent *evt = new CSocketEvent(m_pSocket->m_pEvtHandler, m_pSocket, CSocketEvent::hostaddress, CSocket::AddressToString(addr->ai_addr, addr->ai_addrlen).c_str());
-			m_pSocket->dispatcher_.SendEvent(evt);
+		addrinfo* addr{};
+		int fd{-1};
+		long start{};
+		bool done{};
+		int error{};
+#ifdef __WXMSW__
+		WSAEVENT event{WSA_INVALID_EVENT};
+#endif
+	};
+
+	// Interleaves the address families, starting with the family of the
+	// first address returned by getaddrinfo, as described in RFC 8305.
+	static std::vector<addrinfo*> SortAddresses(addrinfo* addressList)
+	{
+		std::deque<addrinfo*> preferred;
+		std::deque<addrinfo*> other;
+		for (addrinfo* addr = addressList; addr; addr = addr->ai_next) {
+			if (addr->ai_family == addressList->ai_family)
+				preferred.push_back(addr);
+			else
+				other.push_back(addr);
 		}
 
-		int fd = CreateSocketFd(addr);
-		if (fd == -1) {
-			if (m_pSocket->m_pEvtHandler) {
-				int res = GetLastSocketError();
-				CSocketEvent *evt = new CSocketEvent(m_pSocket->GetEventHandler(), m_pSocket, addr->ai_next ? CSocketEvent::connection_next : CSocketEvent::connection, res);
-				m_pSocket->dispatcher_.SendEvent(evt);
+		std::vector<addrinfo*> ret;
+		while (!preferred.empty() || !other.empty()) {
+			if (!preferred.empty()) {
+				ret.push_back(preferred.front());
+				preferred.pop_front();
+			}
+			if (!other.empty()) {
+				ret.push_back(other.front());
+				other.pop_front();
 			}
+		}
+		return ret;
+	}
 
-			return 0;
+	// Call only while locked
+	// Returns 0 if the connection attempt is under way, else an error code.
+	int StartAttempt(connect_attempt& attempt)
+	{
+		if (m_pSocket->m_pEvtHandler) {
+			CSocketEvent *evt = new CSocketEvent(m_pSocket->m_pEvtHandler, m_pSocket, CSocketEvent::hostaddress, CSocket::AddressToString(attempt.addr->ai_addr, attempt.addr->ai_addrlen).c_str());
+			m_pSocket->dispatcher_.SendEvent(evt);
 		}
 
-		CSocket::DoSetFlags(fd, m_pSocket->m_flags, m_pSocket->m_flags);
-		CSocket::DoSetBufferSizes(fd, m_pSocket->m_buffer_sizes[0], m_pSocket->m_buffer_sizes[1]);
+		attempt.fd = CreateSocketFd(attempt.addr);
+		if (attempt.fd == -1)
+			return GetLastSocketError();
 
-		int res = connect(fd, addr->ai_addr, addr->ai_addrlen);
+		CSocket::DoSetFlags(attempt.fd, m_pSocket->m_flags, m_pSocket->m_flags);
+		CSocket::DoSetBufferSizes(attempt.fd, m_pSocket->m_buffer_sizes[0], m_pSocket->m_buffer_sizes[1]);
+
+		int res = connect(attempt.fd, attempt.addr->ai_addr, attempt.addr->ai_addrlen);
 		if (res == -1) {
 #ifdef __WXMSW__
 			// Map to POSIX error codes
@@ -489,53 +539,236 @@ protected:
 #endif
 		}
 
-		if (res == EINPROGRESS) {
+		if (!res) {
+			attempt.done = true;
+			return 0;
+		}
 
-			m_pSocket->m_fd = fd;
+		if (res != EINPROGRESS) {
+			CloseSocketFd(attempt.fd);
+			return res;
+		}
 
-			bool wait_successful;
-			do {
-				wait_successful = DoWait(WAIT_CONNECT);
-				if ((m_triggered & WAIT_CONNECT))
-					break;
-			} while (wait_successful);
+#ifdef __WXMSW__
+		attempt.event = WSACreateEvent();
+		if (attempt.event == WSA_INVALID_EVENT || WSAEventSelect(attempt.fd, attempt.event, FD_CONNECT)) {
+			res = ConvertMSWErrorCode(WSAGetLastError());
+			CloseAttempt(attempt);
+			return res;
+		}
+#endif
 
-			if (!wait_successful) {
-				CloseSocketFd(fd);
-				if (m_pSocket)
-					m_pSocket->m_fd = -1;
-				return -1;
-			}
-			m_triggered &= ~WAIT_CONNECT;
+		return 0;
+	}
 
-			res = m_triggered_errors[0];
+	static void CloseAttempt(connect_attempt& attempt)
+	{
+#ifdef __WXMSW__
+		if (attempt.event != WSA_INVALID_EVENT) {
+			if (attempt.fd != -1)
+				WSAEventSelect(attempt.fd, 0, 0);
+			WSACloseEvent(attempt.event);
+			attempt.event = WSA_INVALID_EVENT;
 		}
+#endif
+		CloseSocketFd(attempt.fd);
+	}
 
-		if (res) {
-			if (m_pSocket->m_pEvtHandler) {
-				CSocketEvent *evt = new CSocketEvent(m_pSocket->GetEventHandler(), m_pSocket, addr->ai_next ? CSocketEvent::connection_next : CSocketEvent::connection, res);
-				m_pSocket->dispatcher_.SendEvent(evt);
+	// Call only while locked
+	void RecordAttempt(connect_attempt const& attempt, long now, int error)
+	{
+		CSocket::connect_attempt_info info;
+		info.address = CSocket::AddressToString(attempt.addr->ai_addr, attempt.addr->ai_addrlen);
+		info.start = attempt.start;
+		info.duration = now - attempt.start;
+		info.error = error;
+		m_pSocket->m_connect_attempts.push_back(info);
+	}
+
+	// Call only while locked
+	// Waits until at least one of the attempts has finished or the timeout
+	// in milliseconds has passed, a negative timeout waits indefinitely.
+	// Returns false if connecting should be aborted.
+	bool WaitForAttempts(std::vector<connect_attempt>& attempts, long timeout)
+	{
+#ifdef __WXMSW__
+		std::vector<WSAEVENT> events;
+		events.push_back(m_sync_event);
+		for (auto const& attempt : attempts)
+			events.push_back(attempt.event);
+
+		m_sync.Unlock();
+		DWORD res = WSAWaitForMultipleEvents(events.size(), &events[0], false, timeout >= 0 ? static_cast<DWORD>(timeout) : WSA_INFINITE, false);
+		m_sync.Lock();
+
+		if (res == WSA_WAIT_EVENT_0)
+			WSAResetEvent(m_sync_event);
+#else
+		fd_set readfds;
+		fd_set writefds;
+		FD_ZERO(&readfds);
+		FD_ZERO(&writefds);
+
+		FD_SET(m_pipe[0], &readfds);
+		int max = m_pipe[0];
+		for (auto const& attempt : attempts) {
+			FD_SET(attempt.fd, &writefds);
+			max = wxMax(max, attempt.fd);
+		}
+
+		timeval tv;
+		tv.tv_sec = timeout / 1000;
+		tv.tv_usec = (timeout % 1000) * 1000;
+
+		m_sync.Unlock();
+		int res = select(max + 1, &readfds, &writefds, 0, timeout >= 0 ? &tv : 0);
+		int const select_error = errno;
+		m_sync.Lock();
+
+		if (res > 0 && FD_ISSET(m_pipe[0], &readfds)) {
+			char buffer[100];
+			int damn_spurious_warning = read(m_pipe[0], buffer, 100);
+			(void)damn_spurious_warning;
+		}
+#endif
+
+		// Close() or Connect() got called in the meantime
+		if (m_quit || !m_pSocket || m_pSocket->m_state != CSocket::connecting || m_pHost)
+			return false;
+
+#ifdef __WXMSW__
+		if (res == WSA_WAIT_FAILED)
+			return false;
+
+		for (auto& attempt : attempts) {
+			WSANETWORKEVENTS events;
+			if (!WSAEnumNetworkEvents(attempt.fd, attempt.event, &events) && (events.lNetworkEvents & FD_CONNECT)) {
+				attempt.done = true;
+				attempt.error = ConvertMSWErrorCode(events.iErrorCode[FD_CONNECT_BIT]);
 			}
+		}
+#else
+		if (res == -1)
+			return select_error == EINTR;
 
-			CloseSocketFd(fd);
-			m_pSocket->m_fd = -1;
+		if (res > 0) {
+			for (auto& attempt : attempts) {
+				if (FD_ISSET(attempt.fd, &writefds)) {
+					int error;
+					socklen_t len = sizeof(error);
+					if (getsockopt(attempt.fd, SOL_SOCKET, SO_ERROR, &error, &len))
+						error = errno;
+					attempt.done = true;
+					attempt.error = error;
+				}
+			}
 		}
-		else {
-			m_pSocket->m_fd = fd;
-			m_pSocket->m_state = CSocket::connected;
+#endif
 
-			if (m_pSocket->m_pEvtHandler) {
-				CSocketEvent *evt = new CSocketEvent(m_pSocket->GetEventHandler(), m_pSocket, CSocketEvent::connection, 0);
-				m_pSocket->dispatcher_.SendEvent(evt);
+		return true;
+	}
+
+	// Call only while locked
+	// Races connection attempts to all addresses against each other. The
+	// next attempt gets started if the previous one did not succeed or fail
+	// within CONNECTION_ATTEMPT_DELAY, the first attempt to succeed wins.
+	// Returns 1 on success, 0 if all attempts failed and -1 if connecting
+	// got aborted.
+	int TryConnectHosts(addrinfo* addressList)
+	{
+		std::vector<addrinfo*> const addresses = SortAddresses(addressList);
+		std::vector<connect_attempt> attempts;
+		size_t next = 0;
+
+		wxStopWatch timer;
+		long nextStart = 0;
+
+		for (;;) {
+			if (next < addresses.size() && attempts.size() < MAX_CONNECTION_ATTEMPTS && (attempts.empty() || timer.Time() >= nextStart)) {
+				connect_attempt attempt;
+				attempt.addr = addresses[next++];
+				attempt.start = timer.Time();
+				int error = StartAttempt(attempt);
+				if (error) {
+					RecordAttempt(attempt, timer.Time(), error);
+					if (m_pSocket->m_pEvtHandler) {
+						bool const more = next < addresses.size() || !attempts.empty();
+						CSocketEvent *evt = new CSocketEvent(m_pSocket->GetEventHandler(), m_pSocket, more ? CSocketEvent::connection_next : CSocketEvent::connection, error);
+						m_pSocket->dispatcher_.SendEvent(evt);
+					}
+				}
+				else {
+					attempts.push_back(attempt);
+					nextStart = attempt.start + CONNECTION_ATTEMPT_DELAY;
+				}
 			}
+			else {
+				if (attempts.empty())
+					return 0;
 
-			// We're now interested in all the other nice events
-			m_waiting |= WAIT_READ | WAIT_WRITE;
+				long timeout = -1;
+				if (next < addresses.size() && attempts.size() < MAX_CONNECTION_ATTEMPTS)
+					timeout = wxMax(0L, nextStart - timer.Time());
 
-			return 1;
-		}
+				if (!WaitForAttempts(attempts, timeout)) {
+					for (auto& attempt : attempts)
+						CloseAttempt(attempt);
+					return -1;
+				}
+			}
 
-		return 0;
+			for (size_t i = 0; i < attempts.size(); ) {
+				connect_attempt& attempt = attempts[i];
+				if (!attempt.done) {
+					++i;
+					continue;
+				}
+
+				long const now = timer.Time();
+				RecordAttempt(attempt, now, attempt.error);
+
+				if (!attempt.error) {
+					for (auto& other : attempts) {
+						if (&other != &attempt) {
+							RecordAttempt(other, now, ECONNABORTED);
+							CloseAttempt(other);
+						}
+					}
+#ifdef __WXMSW__
+					if (attempt.event != WSA_INVALID_EVENT) {
+						WSAEventSelect(attempt.fd, 0, 0);
+						WSACloseEvent(attempt.event);
+					}
+#endif
+
+					m_pSocket->m_fd = attempt.fd;
+					m_pSocket->m_state = CSocket::connected;
+
+					if (m_pSocket->m_pEvtHandler) {
+						CSocketEvent *evt = new CSocketEvent(m_pSocket->GetEventHandler(), m_pSocket, CSocketEvent::connection, 0);
+						m_pSocket->dispatcher_.SendEvent(evt);
+					}
+
+					// We're now interested in all the other nice events
+					m_waiting |= WAIT_READ | WAIT_WRITE;
+
+					return 1;
+				}
+
+				int const error = attempt.error;
+				CloseAttempt(attempt);
+				attempts.erase(attempts.begin() + i);
+
+				if (m_pSocket->m_pEvtHandler) {
+					bool const more = next < addresses.size() || !attempts.empty();
+					CSocketEvent *evt = new CSocketEvent(m_pSocket->GetEventHandler(), m_pSocket, more ? CSocketEvent::connection_next : CSocketEvent::connection, error);
+					m_pSocket->dispatcher_.SendEvent(evt);
+				}
+
+				// No need to wait any longer for the next address
+				nextStart = 0;
+			}
+		}
 	}
 
 	// Only call while locked
@@ -601,20 +834,15 @@ protected:
 			return false;
 		}
 
-		for (struct addrinfo *addr = addressList; addr; addr = addr->ai_next) {
-			res = TryConnectHost(addr);
-			if (res == -1) {
-				freeaddrinfo(addressList);
-				if (m_pSocket)
-					m_pSocket->m_state = CSocket::closed;
-				return false;
-			}
-			else if (res) {
-				freeaddrinfo(addressList);
-				return true;
-			}
-		}
+		res = TryConnectHosts(addressList);
 		freeaddrinfo(addressList);
+		if (res == -1) {
+			if (m_pSocket && m_pSocket->m_state == CSocket::connecting && !m_pHost)
+				m_pSocket->m_state = CSocket::closed;
+			return false;
+		}
+		else if (res)
+			return true;
 
 		if (m_pSocket->m_pEvtHandler) {
 			CSocketEvent *evt = new CSocketEvent(m_pSocket->GetEventHandler(), m_pSocket, CSocketEvent::connection, ECONNABORTED);
@@ -1066,6 +1294,7 @@ int CSocket::Connect(wxString host, unsigned int port, address_family family /*=
 
 	m_host = host;
 	m_port = port;
+	m_connect_attempts.clear();
 	int res = m_pSocketThread->Connect();
 	if (res) {
 		m_state = none;
@@ -1382,6 +1611,72 @@ int CSocket::Write(const void* buffer, unsigned int size, int& error)
 	return res;
 }
 
+int CSocket::EnableKernelTls(void const* cryptoInfo, unsigned int size)
+{
+#if HAVE_LINUX_TLS_H
+	// Fails with ENOENT if the tls kernel module isn't available
+	if (setsockopt(m_fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == -1)
+		return GetLastSocketError();
+
+	if (setsockopt(m_fd, SOL_TLS, TLS_TX, cryptoInfo, size) == -1)
+		return GetLastSocketError();
+
+	return 0;
+#else
+	(void)cryptoInfo;
+	(void)size;
+	return EOPNOTSUPP;
+#endif
+}
+
+int CSocket::WriteTlsRecord(unsigned char type, const void *buffer, unsigned int size, int& error)
+{
+#if HAVE_LINUX_TLS_H
+	char control[CMSG_SPACE(sizeof(type))] = {};
+
+	struct iovec iov;
+	iov.iov_base = const_cast<void*>(buffer);
+	iov.iov_len = size;
+
+	struct msghdr msg = {};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_TLS;
+	cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(type));
+	*CMSG_DATA(cmsg) = type;
+
+	int res = sendmsg(m_fd, &msg, MSG_NOSIGNAL);
+	if (res == -1) {
+		error = GetLastSocketError();
+		if (error == EAGAIN) {
+			if (m_pSocketThread) {
+				m_pSocketThread->m_sync.Lock();
+				if (!(m_pSocketThread->m_waiting & WAIT_WRITE)) {
+					m_pSocketThread->m_waiting |= WAIT_WRITE;
+					m_pSocketThread->WakeupThread(true);
+				}
+				m_pSocketThread->m_sync.Unlock();
+			}
+		}
+	}
+	else
+		error = 0;
+
+	return res;
+#else
+	(void)type;
+	(void)buffer;
+	(void)size;
+	error = EOPNOTSUPP;
+	return -1;
+#endif
+}
+
 wxString CSocket::AddressToString(const struct sockaddr* addr, int addr_len, bool with_port /*=true*/, bool strip_zone_index/*=false*/)
 {
 	char hostbuf[NI_MAXHOST];
@@ -1727,3 +2022,16 @@ wxString CSocket::GetPeerHost() const
 {
 	return m_host;
 }
+
+std::vector<CSocket::connect_attempt_info> CSocket::GetConnectAttempts() const
+{
+	if (m_pSocketThread)
+		m_pSocketThread->m_sync.Lock();
+
+	std::vector<connect_attempt_info> ret = m_connect_attempts;
+
+	if (m_pSocketThread)
+		m_pSocketThread->m_sync.Unlock();
+
+	return ret;
+}
@@ -0,0 +1,64 @@
+#include <filezilla.h>
+#include "tlssessioncache.h"
+
+CTlsSessionCache::CTlsSessionCache()
+{
+}
+
+CTlsSessionCache::~CTlsSessionCache()
+{
+}
+
+void CTlsSessionCache::Store(wxString const& host, unsigned int port, std::vector<unsigned char> && data)
+{
+	wxCriticalSectionLocker lock(mutex_);
+
+	if (data.empty()) {
+		m_cache.erase(tKey(host.Lower(), port));
+		return;
+	}
+
+	CCacheEntry & entry = m_cache[tKey(host.Lower(), port)];
+	entry.data = std::move(data);
+	entry.time = CMonotonicTime::Now();
+
+	// Prune the oldest session if there are too many
+	if (m_cache.size() > TLS_SESSION_CACHE_SIZE) {
+		auto oldest = m_cache.begin();
+		for (auto it = m_cache.begin(); it != m_cache.end(); ++it) {
+			if (it->second.time < oldest->second.time)
+				oldest = it;
+		}
+		m_cache.erase(oldest);
+	}
+}
+
+std::vector<unsigned char> CTlsSessionCache::Lookup(wxString const& host, unsigned int port)
+{
+	wxCriticalSectionLocker lock(mutex_);
+
+	auto it = m_cache.find(tKey(host.Lower(), port));
+	if (it == m_cache.end())
+		return std::vector<unsigned char>();
+
+	if ((CDateTime::Now() - it->second.time.GetTime()).GetSeconds() > TLS_SESSION_CACHE_TIMEOUT) {
+		m_cache.erase(it);
+		return std::vector<unsigned char>();
+	}
+
+	return it->second.data;
+}
+
+void CTlsSessionCache::Remove(wxString const& host, unsigned int port)
+{
+	wxCriticalSectionLocker lock(mutex_);
+
+	m_cache.erase(tKey(host.Lower(), port));
+}
+
+void CTlsSessionCache::Clear()
+{
+	wxCriticalSectionLocker lock(mutex_);
+
+	m_cache.clear();
+}
@@ -0,0 +1,42 @@
+#ifndef __TLSSESSIONCACHE_H__
+#define __TLSSESSIONCACHE_H__
+
+#include <map>
+#include <vector>
+
+const int TLS_SESSION_CACHE_TIMEOUT = 3600; // In seconds
+const size_t TLS_SESSION_CACHE_SIZE = 50;
+
+// Keeps the session data of the last TLS connection to each host and port,
+// so that new control connections of all engines can resume it instead
+// of doing a full handshake.
+class CTlsSessionCache final
+{
+public:
+	CTlsSessionCache();
+	~CTlsSessionCache();
+
+	void Store(wxString const& host, unsigned int port, std::vector<unsigned char> && data);
+
+	// Returns an empty vector if there is no session, or it is too old
+	std::vector<unsigned char> Lookup(wxString const& host, unsigned int port);
+
+	void Remove(wxString const& host, unsigned int port);
+
+	void Clear();
+
+protected:
+	typedef std::pair<wxString, unsigned int> tKey;
+
+	struct CCacheEntry
+	{
+		std::vector<unsigned char> data;
+		CMonotonicTime time;
+	};
+
+	wxCriticalSection mutex_;
+
+	std::map<tKey, CCacheEntry> m_cache;
+};
+
+#endif //__TLSSESSIONCACHE_H__
@@ -2,11 +2,24 @@
 #include "engineprivate.h"
 #include "tlssocket.h"
 #include "ControlSocket.h"
+#include "tlssessioncache.h"
 
 #include <gnutls/gnutls.h>
 #include <gnutls/x509.h>
 #include <errno.h>
 
+#if HAVE_LINUX_TLS_H && GNUTLS_VERSION_NUMBER >= 0x030400
+#define HAVE_KERNEL_TLS 1
+#include <linux/tls.h>
+#endif
+
+// Records are collected up to this size before writing them to the
+// socket, and reads from the socket are done in chunks of this size.
+// GnuTLS on its own does one socket call per record, or even two when
+// receiving as it first reads just the record header.
+unsigned int const tls_send_buffer_size = 65536;
+unsigned int const tls_recv_buffer_size = 65536;
+
 char const ciphers[] = "SECURE256:+SECURE128:+ARCFOUR-128:-3DES-CBC:-MD5:+SIGN-ALL:-SIGN-RSA-MD5:+CTYPE-X509:-CTYPE-OPENPGP:-VERS-SSL3.0";
 
 #define TLSDEBUG 0
@@ -132,6 +145,13 @@ void CTlsSocket::Uninit()
 	m_peekData = 0;
 	m_peekDataLen = 0;
 
+	m_kernelSend = false;
+	m_sendBuffer.clear();
+	m_recvBuffer.clear();
+	m_recvBufferPos = 0;
+	m_recvBufferLen = 0;
+	m_closePostponed = false;
+
 	delete [] m_implicitTrustedCert.data;
 	m_implicitTrustedCert.data = 0;
 
@@ -203,6 +223,11 @@ ssize_t CTlsSocket::PushFunction(const void* data, size_t len)
 #if TLSDEBUG
 	m_pOwner->LogMessage(MessageType::Debug_Debug, _T("CTlsSocket::PushFunction(%d)"), len);
 #endif
+	if (m_coalesceWrites && m_sendBuffer.size() < tls_send_buffer_size) {
+		m_sendBuffer.insert(m_sendBuffer.end(), static_cast<char const*>(data), static_cast<char const*>(data) + len);
+		return len;
+	}
+
 	if (!m_canWriteToSocket)
 	{
 		gnutls_transport_set_errno(m_session, EAGAIN);
@@ -215,6 +240,21 @@ ssize_t CTlsSocket::PushFunction(const void* data, size_t len)
 		return -1;
 	}
 
+	if (m_kernelSend) {
+		// GnuTLS's record state is out of sync with the kernel's, whatever
+		// it sends on its own, e.g. an alert, must not reach the socket.
+		m_pOwner->LogMessage(MessageType::Debug_Warning, _T("GnuTLS tried to send %d bytes while kernel TLS is enabled"), static_cast<int>(len));
+		gnutls_transport_set_errno(m_session, 0);
+		return -1;
+	}
+
+	// Anything still in the send buffer has to go out first
+	int const flushError = FlushSendBuffer();
+	if (flushError) {
+		gnutls_transport_set_errno(m_session, (flushError == EAGAIN) ? EAGAIN : 0);
+		return -1;
+	}
+
 	int error;
 	int written = m_pSocketBackend->Write(data, len, error);
 
@@ -248,16 +288,37 @@ ssize_t CTlsSocket::PullFunction(void* data, size_t len)
 		return -1;
 	}
 
-	if (m_socketClosed)
+	if (m_recvBufferPos < m_recvBufferLen) {
+		size_t const available = m_recvBufferLen - m_recvBufferPos;
+		if (len > available)
+			len = available;
+		memcpy(data, &m_recvBuffer[m_recvBufferPos], len);
+		m_recvBufferPos += len;
+		return len;
+	}
+
+	if (m_socketClosed) {
+		if (m_closePostponed) {
+			// All buffered records have been read, now report the close
+			m_closePostponed = false;
+			CSocketEvent *evt = new CSocketEvent(this, m_pSocketBackend, CSocketEvent::close);
+			CSocketEventSource::dispatcher_.SendEvent(evt);
+		}
 		return 0;
+	}
 
 	if (!m_canReadFromSocket) {
 		gnutls_transport_set_errno(m_session, EAGAIN);
 		return -1;
 	}
 
+	// Small reads, e.g. of the record header, go through the receive buffer
+	bool const buffered = len < tls_recv_buffer_size;
+	if (buffered && m_recvBuffer.empty())
+		m_recvBuffer.resize(tls_recv_buffer_size);
+
 	int error;
-	int read = m_pSocketBackend->Read(data, len, error);
+	int read = buffered ? m_pSocketBackend->Read(&m_recvBuffer[0], tls_recv_buffer_size, error) : m_pSocketBackend->Read(data, len, error);
 	if (read < 0) {
 		m_canReadFromSocket = false;
 		if (error == EAGAIN) {
@@ -279,6 +340,13 @@ ssize_t CTlsSocket::PullFunction(void* data, size_t len)
 	if (!read) {
 		m_socket_eof = true;
 	}
+	else if (buffered) {
+		m_recvBufferLen = read;
+		if (static_cast<size_t>(read) > len)
+			read = len;
+		memcpy(data, &m_recvBuffer[0], read);
+		m_recvBufferPos = read;
+	}
 
 #if TLSDEBUG
 	m_pOwner->LogMessage(MessageType::Debug_Debug, _T("  returning %d"), read);
@@ -320,6 +388,14 @@ void CTlsSocket::OnSocketEvent(CSocketEvent& event)
 
 				if (peeked)
 					return;
+
+				if (m_tlsState == TlsState::conn && m_recvBufferPos < m_recvBufferLen) {
+					// OnRead has triggered a read event if needed. Reading
+					// the remaining records brings us back here.
+					m_pOwner->LogMessage(MessageType::Debug_Verbose, _T("CTlsSocket::OnSocketEvent(): buffered data, postponing close event"));
+					m_closePostponed = true;
+					return;
+				}
 			}
 
 			m_pOwner->LogMessage(MessageType::Debug_Info, _T("CTlsSocket::OnSocketEvent(): close event received"));
@@ -369,8 +445,16 @@ void CTlsSocket::OnSend()
 	if (!m_session)
 		return;
 
+	if (m_kernelSend) {
+		if (m_tlsState == TlsState::closing)
+			ContinueShutdown();
+		else if (m_tlsState == TlsState::conn)
+			TriggerEvents();
+		return;
+	}
+
 	const int direction = gnutls_record_get_direction(m_session);
-	if (!direction && !m_lastWriteFailed)
+	if (!direction && !m_lastWriteFailed && m_sendBuffer.empty())
 		return;
 
 	if (m_tlsState == TlsState::handshake)
@@ -379,11 +463,39 @@ void CTlsSocket::OnSend()
 		ContinueShutdown();
 	else if (m_tlsState == TlsState::conn)
 	{
+		if (!m_sendBuffer.empty()) {
+			int const error = FlushSendBuffer();
+			if (!error)
+				m_canTriggerWrite = true;
+			else if (error != EAGAIN) {
+				Failure(0, error);
+				return;
+			}
+		}
 		CheckResumeFailedReadWrite();
 		TriggerEvents();
 	}
 }
 
+int CTlsSocket::FlushSendBuffer()
+{
+	while (!m_sendBuffer.empty()) {
+		if (!m_canWriteToSocket)
+			return EAGAIN;
+
+		int error;
+		int written = m_pSocketBackend->Write(&m_sendBuffer[0], m_sendBuffer.size(), error);
+		if (written < 0) {
+			if (error == EAGAIN)
+				m_canWriteToSocket = false;
+			return error;
+		}
+		m_sendBuffer.erase(m_sendBuffer.begin(), m_sendBuffer.begin() + written);
+	}
+
+	return 0;
+}
+
 bool CTlsSocket::CopySessionData(const CTlsSocket* pPrimarySocket)
 {
 	gnutls_datum_t d;
@@ -393,9 +505,15 @@ bool CTlsSocket::CopySessionData(const CTlsSocket* pPrimarySocket)
 		return true;
 	}
 
-	// Set session data
-	res = gnutls_session_set_data(m_session, d.data, d.size );
+	bool ret = SetSessionData(d.data, d.size);
 	gnutls_free(d.data);
+
+	return ret;
+}
+
+bool CTlsSocket::SetSessionData(void const* data, size_t size)
+{
+	int res = gnutls_session_set_data(m_session, data, size);
 	if (res) {
 		m_pOwner->LogMessage(MessageType::Debug_Info, _T("gnutls_session_set_data failed: %d. Going to reinitialize session."), res);
 		UninitSession();
@@ -408,6 +526,25 @@ bool CTlsSocket::CopySessionData(const CTlsSocket* pPrimarySocket)
 	return true;
 }
 
+void CTlsSocket::StoreSessionData()
+{
+	CServer const* server = m_pOwner->GetCurrentServer();
+	if (!server)
+		return;
+
+	gnutls_datum_t d;
+	int res = gnutls_session_get_data2(m_session, &d);
+	if (res) {
+		m_pOwner->LogMessage(MessageType::Debug_Warning, _T("gnutls_session_get_data2 failed: %d"), res);
+		return;
+	}
+
+	std::vector<unsigned char> data(d.data, d.data + d.size);
+	gnutls_free(d.data);
+
+	m_pOwner->GetEngine()->GetTlsSessionCache().Store(server->GetHost(), server->GetPort(), std::move(data));
+}
+
 bool CTlsSocket::ResumedSession() const
 {
 	return gnutls_session_is_resumed(m_session) != 0;
@@ -444,7 +581,20 @@ int CTlsSocket::Handshake(const CTlsSocket* pPrimarySocket, bool try_resume)
 	}
 	else {
 		hostname = m_pSocket->GetPeerHost();
+
+		// Try to resume the session of an earlier connection to the same
+		// server, possibly from another engine.
+		CServer const* server = m_pOwner->GetCurrentServer();
+		if (server) {
+			std::vector<unsigned char> data = m_pOwner->GetEngine()->GetTlsSessionCache().Lookup(server->GetHost(), server->GetPort());
+			if (!data.empty()) {
+				m_usedCachedSession = true;
+				if (!SetSessionData(&data[0], data.size()))
+					return FZ_REPLY_ERROR;
+			}
+		}
 	}
+	m_isPrimary = !pPrimarySocket;
 
 	if( !hostname.empty() && !IsIpAddress(hostname) ) {
 		const wxWX2MBbuf utf8 = hostname.mb_str(wxConvUTF8);
@@ -506,6 +656,13 @@ int CTlsSocket::ContinueHandshake()
 	else if (res == GNUTLS_E_AGAIN || res == GNUTLS_E_INTERRUPTED)
 		return FZ_REPLY_WOULDBLOCK;
 
+	if (m_usedCachedSession) {
+		// Don't try the same session again
+		CServer const* server = m_pOwner->GetCurrentServer();
+		if (server)
+			m_pOwner->GetEngine()->GetTlsSessionCache().Remove(server->GetHost(), server->GetPort());
+	}
+
 	Failure(res, ECONNABORTED);
 
 	return FZ_REPLY_ERROR;
@@ -561,7 +718,10 @@ int CTlsSocket::Read(void *buffer, unsigned int len, int& error)
 			TriggerEvents();
 		else {
 			// Peer did already initiate a shutdown, reply to it
-			gnutls_bye(m_session, GNUTLS_SHUT_WR);
+			if (m_kernelSend)
+				SendKernelCloseNotify();
+			else
+				gnutls_bye(m_session, GNUTLS_SHUT_WR);
 			// Note: Theoretically this could return a write error.
 			// But we ignore it, since it is perfectly valid for peer
 			// to close the connection after sending its shutdown
@@ -572,6 +732,19 @@ int CTlsSocket::Read(void *buffer, unsigned int len, int& error)
 		return res;
 	}
 
+	if (res == GNUTLS_E_REHANDSHAKE && m_kernelSend) {
+		// GnuTLS can't send handshake messages anymore, refuse like a
+		// client without renegotiation support.
+		m_pOwner->LogMessage(MessageType::Debug_Info, _T("Refusing renegotiation, kernel TLS is enabled"));
+		int const alertError = SendKernelAlert(100); // no_renegotiation
+		if (alertError && alertError != EAGAIN) {
+			Failure(0, alertError);
+			error = ECONNABORTED;
+			return -1;
+		}
+		return Read(buffer, len, error);
+	}
+
 	if (res == GNUTLS_E_INTERRUPTED || res == GNUTLS_E_AGAIN) {
 		error = EAGAIN;
 		m_lastReadFailed = true;
@@ -595,11 +768,40 @@ int CTlsSocket::Write(const void *buffer, unsigned int len, int& error)
 		return -1;
 	}
 
+	if (m_kernelSend) {
+		// The kernel encrypts, plain data goes straight to the socket
+		int written = m_pSocketBackend->Write(buffer, len, error);
+		if (written < 0) {
+			if (error == EAGAIN) {
+				m_canWriteToSocket = false;
+				m_canTriggerWrite = true;
+			}
+			else {
+				Failure(0, error);
+				error = ECONNABORTED;
+			}
+		}
+		else
+			TriggerEvents();
+		return written;
+	}
+
 	if (m_lastWriteFailed) {
 		error = EAGAIN;
 		return -1;
 	}
 
+	int const flushError = FlushSendBuffer();
+	if (flushError) {
+		if (flushError != EAGAIN) {
+			Failure(0, flushError);
+			error = ECONNABORTED;
+		}
+		else
+			error = EAGAIN;
+		return -1;
+	}
+
 	if (m_writeSkip >= len) {
 		m_writeSkip -= len;
 		return len;
@@ -608,7 +810,33 @@ int CTlsSocket::Write(const void *buffer, unsigned int len, int& error)
 	len -= m_writeSkip;
 	buffer = (char*)buffer + m_writeSkip;
 
-	int res = gnutls_record_send(m_session, buffer, len);
+	// Encrypt as many records as fit into the send buffer so that
+	// they go out with a single write to the socket.
+	unsigned int sent = 0;
+	int res;
+	m_coalesceWrites = true;
+	do {
+		res = gnutls_record_send(m_session, (char const*)buffer + sent, len - sent);
+		if (res > 0)
+			sent += res;
+	} while (res > 0 && sent < len && m_sendBuffer.size() < tls_send_buffer_size);
+	m_coalesceWrites = false;
+
+	if (sent) {
+		int const flushResult = FlushSendBuffer();
+		if (flushResult && flushResult != EAGAIN) {
+			Failure(0, flushResult);
+			error = ECONNABORTED;
+			return -1;
+		}
+
+		error = 0;
+		int written = sent + m_writeSkip;
+		m_writeSkip = 0;
+
+		TriggerEvents();
+		return written;
+	}
 
 	while ((res == GNUTLS_E_INTERRUPTED || res == GNUTLS_E_AGAIN) && m_canWriteToSocket)
 		res = gnutls_record_send(m_session, 0, 0);
@@ -780,6 +1008,19 @@ int CTlsSocket::Shutdown()
 
 	m_tlsState = TlsState::closing;
 
+	if (m_kernelSend) {
+		int const error = SendKernelCloseNotify();
+		if (!error) {
+			m_tlsState = TlsState::closed;
+			return 0;
+		}
+		if (error == EAGAIN)
+			return EAGAIN;
+
+		Failure(0, 0);
+		return ECONNABORTED;
+	}
+
 	int res = gnutls_bye(m_session, GNUTLS_SHUT_WR);
 	while ((res == GNUTLS_E_INTERRUPTED || res == GNUTLS_E_AGAIN) && m_canWriteToSocket)
 		res = gnutls_bye(m_session, GNUTLS_SHUT_WR);
@@ -800,6 +1041,19 @@ void CTlsSocket::ContinueShutdown()
 {
 	m_pOwner->LogMessage(MessageType::Debug_Verbose, _T("CTlsSocket::ContinueShutdown()"));
 
+	if (m_kernelSend) {
+		int const error = SendKernelCloseNotify();
+		if (!error) {
+			m_tlsState = TlsState::closed;
+
+			CSocketEvent *evt = new CSocketEvent(m_pEvtHandler, this, CSocketEvent::close);
+			CSocketEventSource::dispatcher_.SendEvent(evt);
+		}
+		else if (error != EAGAIN)
+			Failure(0, ECONNABORTED);
+		return;
+	}
+
 	int res = gnutls_bye(m_session, GNUTLS_SHUT_WR);
 	while ((res == GNUTLS_E_INTERRUPTED || res == GNUTLS_E_AGAIN) && m_canWriteToSocket)
 		res = gnutls_bye(m_session, GNUTLS_SHUT_WR);
@@ -817,6 +1071,103 @@ void CTlsSocket::ContinueShutdown()
 		Failure(res, ECONNABORTED);
 }
 
+#if HAVE_KERNEL_TLS
+namespace {
+template<typename CryptoInfo>
+int SetKernelCryptoInfo(CSocket& socket, int cipher_type, gnutls_datum_t const& key, gnutls_datum_t const& iv, unsigned char const* seq)
+{
+	CryptoInfo info{};
+	if (key.size != sizeof(info.key) || iv.size < sizeof(info.salt))
+		return EINVAL;
+
+	info.info.version = TLS_1_2_VERSION;
+	info.info.cipher_type = cipher_type;
+	memcpy(info.key, key.data, sizeof(info.key));
+	memcpy(info.salt, iv.data, sizeof(info.salt));
+	// GnuTLS uses the sequence number as explicit nonce
+	memcpy(info.iv, seq, sizeof(info.iv));
+	memcpy(info.rec_seq, seq, sizeof(info.rec_seq));
+
+	int error = socket.EnableKernelTls(&info, sizeof(info));
+
+	memset(&info, 0, sizeof(info));
+	return error;
+}
+}
+#endif
+
+bool CTlsSocket::EnableKernelSend()
+{
+#if HAVE_KERNEL_TLS
+	if (m_tlsState != TlsState::conn || m_kernelSend)
+		return m_kernelSend;
+
+	// Nothing GnuTLS encrypted may still be pending
+	if (!m_sendBuffer.empty() || m_lastWriteFailed || m_writeSkip)
+		return false;
+
+	if (gnutls_protocol_get_version(m_session) != GNUTLS_TLS1_2) {
+		m_pOwner->LogMessage(MessageType::Debug_Info, _T("Not using kernel TLS, protocol is not TLS 1.2"));
+		return false;
+	}
+
+	int cipher_type;
+	gnutls_cipher_algorithm_t const cipher = gnutls_cipher_get(m_session);
+	if (cipher == GNUTLS_CIPHER_AES_128_GCM)
+		cipher_type = TLS_CIPHER_AES_GCM_128;
+#ifdef TLS_CIPHER_AES_GCM_256
+	else if (cipher == GNUTLS_CIPHER_AES_256_GCM)
+		cipher_type = TLS_CIPHER_AES_GCM_256;
+#endif
+	else {
+		m_pOwner->LogMessage(MessageType::Debug_Info, _T("Not using kernel TLS, unsupported cipher %s"), GetCipherName());
+		return false;
+	}
+
+	gnutls_datum_t iv;
+	gnutls_datum_t key;
+	unsigned char seq[8];
+	int res = gnutls_record_get_state(m_session, 0, 0, &iv, &key, seq);
+	if (res) {
+		LogError(res, _T("gnutls_record_get_state"), MessageType::Debug_Warning);
+		return false;
+	}
+
+	int error;
+	if (cipher_type == TLS_CIPHER_AES_GCM_128)
+		error = SetKernelCryptoInfo<tls12_crypto_info_aes_gcm_128>(*m_pSocket, cipher_type, key, iv, seq);
+#ifdef TLS_CIPHER_AES_GCM_256
+	else
+		error = SetKernelCryptoInfo<tls12_crypto_info_aes_gcm_256>(*m_pSocket, cipher_type, key, iv, seq);
+#endif
+	if (error) {
+		m_pOwner->LogMessage(MessageType::Debug_Info, _T("Not using kernel TLS: %s"), CSocket::GetErrorDescription(error));
+		return false;
+	}
+
+	m_pOwner->LogMessage(MessageType::Debug_Info, _T("Kernel TLS enabled for sending"));
+	m_kernelSend = true;
+	return true;
+#else
+	return false;
+#endif
+}
+
+int CTlsSocket::SendKernelCloseNotify()
+{
+	return SendKernelAlert(0); // close_notify
+}
+
+int CTlsSocket::SendKernelAlert(unsigned char description)
+{
+	// Alert level warning
+	unsigned char const alert[2] = { 1, description };
+
+	int error;
+	m_pSocket->WriteTlsRecord(21, alert, sizeof(alert), error);
+	return error;
+}
+
 void CTlsSocket::TrustCurrentCert(bool trusted)
 {
 	if (m_tlsState != TlsState::verifycert)
@@ -827,6 +1178,10 @@ void CTlsSocket::TrustCurrentCert(bool trusted)
 
 	if (trusted)
 	{
+		// Only sessions with trusted certificates may be resumed
+		if (m_isPrimary)
+			StoreSessionData();
+
 		m_tlsState = TlsState::conn;
 
 		if (m_lastWriteFailed)
@@ -44,6 +44,11 @@ public:
 
 	bool ResumedSession() const;
 
+	// Linux only: Lets the kernel encrypt all further outgoing data,
+	// which is then written to the socket as is. Requires TLS 1.2 with
+	// AES-GCM. Returns false if GnuTLS keeps doing the encryption.
+	bool EnableKernelSend();
+
 	static wxString ListTlsCiphers(wxString priority);
 
 protected:
@@ -51,6 +56,10 @@ protected:
 	bool InitSession();
 	void UninitSession();
 	bool CopySessionData(const CTlsSocket* pPrimarySocket);
+	bool SetSessionData(void const* data, size_t size);
+
+	// Puts the session of a control connection into the engine-wide cache
+	void StoreSessionData();
 
 	virtual void OnRateAvailable(enum CRateLimiter::rate_direction direction);
 
@@ -68,6 +77,10 @@ protected:
 
 	gnutls_certificate_credentials_t m_certCredentials{};
 
+	// Not a data connection resuming the session of a control connection
+	bool m_isPrimary{};
+	bool m_usedCachedSession{};
+
 	void LogError(int code, const wxString& function, MessageType logLegel = MessageType::Error);
 	void PrintAlert();
 
@@ -87,6 +100,15 @@ protected:
 	void OnRead();
 	void OnSend();
 
+	// Returns 0 once the send buffer is empty, EAGAIN if the socket
+	// would block, or the socket error.
+	int FlushSendBuffer();
+
+	// Send warning alerts while kernel TLS is enabled.
+	// Return 0 or the socket error
+	int SendKernelCloseNotify();
+	int SendKernelAlert(unsigned char description);
+
 	bool ExtractCert(gnutls_datum_t const* datum, CCertificate& out);
 
 	bool m_canReadFromSocket{true};
@@ -118,6 +140,23 @@ protected:
 	char* m_peekData{};
 	unsigned int m_peekDataLen{};
 
+	// kTLS TX is enabled, records are encrypted and written by the kernel
+	bool m_kernelSend{};
+
+	// While set, PushFunction appends records to m_sendBuffer instead
+	// of writing them to the socket right away.
+	bool m_coalesceWrites{};
+	std::vector<char> m_sendBuffer;
+
+	// Data read from the socket, not yet passed to GnuTLS
+	std::vector<char> m_recvBuffer;
+	size_t m_recvBufferPos{};
+	size_t m_recvBufferLen{};
+
+	// The socket got closed with records left in m_recvBuffer. The close
+	// gets reported once they have been read.
+	bool m_closePostponed{};
+
 	gnutls_datum_t m_implicitTrustedCert;
 
 	bool m_socket_eof{};
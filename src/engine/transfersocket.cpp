@@ -10,6 +10,12 @@
 #include "proxy.h"
 #include "servercapabilities.h"
 
+#include <zlib.h>
+
+namespace {
+int const zlib_buffer_size = 65536;
+}
+
 CTransferSocket::CTransferSocket(CFileZillaEnginePrivate *pEngine, CFtpControlSocket *pControlSocket, TransferMode transferMode)
 : CEventHandler(pEngine->socket_event_dispatcher_.event_loop_)
 , CSocketEventHandler(pEngine->socket_event_dispatcher_)
@@ -43,6 +49,15 @@ CTransferSocket::CTransferSocket(CFileZillaEnginePrivate *pEngine, CFtpControlSo
 	m_shutdown = false;
 
 	m_madeProgress = 0;
+
+	m_downloadLimit = -1;
+
+	m_pZlibStream = 0;
+	m_pZlibBuffer = 0;
+	m_pZlibOut = 0;
+	m_zlibOutLen = 0;
+	m_zlibOutputPending = false;
+	m_zlibStreamEnd = false;
 }
 
 CTransferSocket::~CTransferSocket()
@@ -51,6 +66,7 @@ CTransferSocket::~CTransferSocket()
 	if (m_transferEndReason == TransferEndReason::none)
 		m_transferEndReason = TransferEndReason::successful;
 	ResetSocket();
+	ResetCompression();
 
 	if (m_pControlSocket) {
 		if (m_transferMode == TransferMode::upload || m_transferMode == TransferMode::download) {
@@ -239,6 +255,8 @@ void CTransferSocket::OnConnect()
 		if (CServerCapabilities::GetCapability(*m_pControlSocket->m_pCurrentServer, tls_resume) == unknown)	{
 			CServerCapabilities::SetCapability(*m_pControlSocket->m_pCurrentServer, tls_resume, m_pTlsSocket->ResumedSession() ? yes : no);
 		}
+		if (m_transferMode == TransferMode::upload && m_pEngine->GetOptions().GetOptionVal(OPTION_KERNEL_TLS))
+			m_pTlsSocket->EnableKernelSend();
 	}
 
 	if (m_bActive)
@@ -269,7 +287,7 @@ void CTransferSocket::OnReceive()
 		{
 			char *pBuffer = new char[4096];
 			int error;
-			int numread = m_pBackend->Read(pBuffer, 4096, error);
+			int numread = Read(pBuffer, 4096, error);
 			if (numread < 0)
 			{
 				delete [] pBuffer;
@@ -312,8 +330,12 @@ void CTransferSocket::OnReceive()
 			if (!CheckGetNextWriteBuffer())
 				return;
 
+			int len = m_transferBufferLen;
+			if (m_downloadLimit >= 0 && len > m_downloadLimit)
+				len = static_cast<int>(m_downloadLimit);
+
 			int error;
-			int numread = m_pBackend->Read(m_pTransferBuffer, m_transferBufferLen, error);
+			int numread = Read(m_pTransferBuffer, len, error);
 			if (numread < 0)
 			{
 				if (error != EAGAIN) {
@@ -336,6 +358,14 @@ void CTransferSocket::OnReceive()
 				m_pTransferBuffer += numread;
 				m_transferBufferLen -= numread;
 
+				if (m_downloadLimit > 0) {
+					m_downloadLimit -= numread;
+					if (!m_downloadLimit) {
+						FinalizeWrite();
+						return;
+					}
+				}
+
 				if (!CheckGetNextWriteBuffer())
 					return;
 			}
@@ -421,7 +451,7 @@ void CTransferSocket::OnSend()
 		if (!CheckGetNextReadBuffer())
 			return;
 
-		written = m_pBackend->Write(m_pTransferBuffer, m_transferBufferLen, error);
+		written = Write(m_pTransferBuffer, m_transferBufferLen, error);
 		if (written <= 0)
 			break;
 
@@ -491,6 +521,12 @@ void CTransferSocket::OnClose(int error)
 		return;
 	}
 
+	if (m_pZlibStream && (m_pZlibStream->avail_in || m_zlibOutputPending)) {
+		// Still got compressed data which didn't fit into the last buffer
+		OnReceive();
+		return;
+	}
+
 	char buffer[100];
 	int numread = m_pBackend->Peek(&buffer, 100, error);
 	if (numread > 0) {
@@ -519,6 +555,14 @@ void CTransferSocket::OnClose(int error)
 			return;
 		}
 	}
+
+	// Same as in Read, a truncated stream would give a truncated file
+	if (m_pZlibStream && !m_zlibStreamEnd && m_wireBytes > 0) {
+		m_pControlSocket->LogMessage(MessageType::Error, _("Compressed data ended before the end of the stream"));
+		TransferEnd(TransferEndReason::transfer_failure);
+		return;
+	}
+
 	TransferEnd(TransferEndReason::successful);
 }
 
@@ -590,6 +634,11 @@ void CTransferSocket::TransferEnd(TransferEndReason reason)
 
 	ResetSocket();
 
+	if (m_pZlibStream && m_payloadBytes > 0) {
+		m_pControlSocket->LogMessage(MessageType::Status, _("Compressed transfer: %s bytes of data took %s bytes on the wire (%d%%)"),
+			m_payloadBytes.ToString(), m_wireBytes.ToString(), static_cast<int>((m_wireBytes * 100 / m_payloadBytes).GetLo()));
+	}
+
 	m_pEngine->SendEvent<CFileZillaEngineEvent>(engineTransferEnd);
 }
 
@@ -655,6 +704,13 @@ CSocket* CTransferSocket::CreateSocketServer()
 	return pServer;
 }
 
+void CTransferSocket::SetDownloadLimit(wxFileOffset limit)
+{
+	wxASSERT(m_transferMode == TransferMode::download);
+	wxASSERT(limit > 0);
+	m_downloadLimit = limit;
+}
+
 bool CTransferSocket::CheckGetNextWriteBuffer()
 {
 	CFtpFileTransferOpData *pData = static_cast<CFtpFileTransferOpData *>(static_cast<CRawTransferOpData *>(m_pControlSocket->m_pCurOpData)->pOldData);
@@ -673,6 +729,10 @@ bool CTransferSocket::CheckGetNextWriteBuffer()
 			return false;
 		}
 
+		// Lags behind what got received, the buffers in between are yet
+		// to be written.
+		m_pEngine->transfer_status_.SetWritten(pData->pIOThread->GetWritten());
+
 		m_transferBufferLen = BUFFERSIZE;
 	}
 
@@ -694,6 +754,17 @@ bool CTransferSocket::CheckGetNextReadBuffer()
 		}
 		else if (res == IO_Success)
 		{
+			if (m_pZlibStream) {
+				int error;
+				if (!FinishCompressed(error)) {
+					if (error != EAGAIN) {
+						m_pControlSocket->LogMessage(MessageType::Error, _T("Could not write to transfer socket: %s"), CSocket::GetErrorDescription(error));
+						TransferEnd(TransferEndReason::transfer_failure);
+					}
+					return false;
+				}
+			}
+
 			if (m_pTlsSocket)
 			{
 				m_shutdown = true;
@@ -825,3 +896,188 @@ void CTransferSocket::operator()(CEventBase const& ev)
 {
 	Dispatch<CIOThreadEvent>(ev, this, &CTransferSocket::OnIOThreadEvent);
 }
+
+void CTransferSocket::EnableCompression(int level)
+{
+	ResetCompression();
+
+	m_pZlibStream = new z_stream;
+	memset(m_pZlibStream, 0, sizeof(z_stream));
+
+	int res;
+	if (m_transferMode == TransferMode::upload)
+		res = deflateInit(m_pZlibStream, level);
+	else
+		res = inflateInit(m_pZlibStream);
+	if (res != Z_OK) {
+		m_pControlSocket->LogMessage(MessageType::Debug_Warning, _T("Could not initialize zlib: %d"), res);
+		delete m_pZlibStream;
+		m_pZlibStream = 0;
+		return;
+	}
+
+	m_pZlibBuffer = new char[zlib_buffer_size];
+}
+
+void CTransferSocket::ResetCompression()
+{
+	if (m_pZlibStream) {
+		if (m_transferMode == TransferMode::upload)
+			deflateEnd(m_pZlibStream);
+		else
+			inflateEnd(m_pZlibStream);
+		delete m_pZlibStream;
+		m_pZlibStream = 0;
+	}
+	delete [] m_pZlibBuffer;
+	m_pZlibBuffer = 0;
+
+	m_pZlibOut = 0;
+	m_zlibOutLen = 0;
+	m_zlibOutputPending = false;
+	m_zlibStreamEnd = false;
+	m_wireBytes = 0;
+	m_payloadBytes = 0;
+}
+
+int CTransferSocket::Read(char* buffer, int len, int& error)
+{
+	if (!m_pZlibStream)
+		return m_pBackend->Read(buffer, len, error);
+
+	m_pZlibStream->next_out = reinterpret_cast<Bytef*>(buffer);
+	m_pZlibStream->avail_out = len;
+
+	for (;;) {
+		if (!m_pZlibStream->avail_in && !m_zlibOutputPending) {
+			int numread = m_pBackend->Read(m_pZlibBuffer, zlib_buffer_size, error);
+			if (numread < 0)
+				return numread;
+			if (!numread) {
+				// A connection closed without sending anything at all is an
+				// empty file or listing, some servers don't bother compressing
+				// those. Otherwise the end of the stream must have been seen.
+				if (m_zlibStreamEnd || m_wireBytes == 0)
+					return 0;
+
+				m_pControlSocket->LogMessage(MessageType::Error, _("Compressed data ended before the end of the stream"));
+				error = ECONNABORTED;
+				return -1;
+			}
+
+			m_wireBytes += numread;
+			if (m_zlibStreamEnd) {
+				// Some servers send garbage after the end of the stream.
+				continue;
+			}
+
+			m_pZlibStream->next_in = reinterpret_cast<Bytef*>(m_pZlibBuffer);
+			m_pZlibStream->avail_in = numread;
+		}
+
+		int res = inflate(m_pZlibStream, Z_SYNC_FLUSH);
+		if (res == Z_STREAM_END) {
+			m_zlibStreamEnd = true;
+			m_pZlibStream->avail_in = 0;
+		}
+		else if (res != Z_OK && res != Z_BUF_ERROR) {
+			m_pControlSocket->LogMessage(MessageType::Error, _("Could not decompress data: %s"), m_pZlibStream->msg ? wxString(m_pZlibStream->msg, wxConvLocal) : wxString::Format(_T("%d"), res));
+			error = ECONNABORTED;
+			return -1;
+		}
+
+		// If the output buffer got filled, there may be more output without further input.
+		m_zlibOutputPending = !m_zlibStreamEnd && !m_pZlibStream->avail_out;
+
+		int const produced = len - m_pZlibStream->avail_out;
+		if (produced) {
+			m_payloadBytes += produced;
+			return produced;
+		}
+	}
+}
+
+int CTransferSocket::Write(char const* buffer, int len, int& error)
+{
+	if (!m_pZlibStream)
+		return m_pBackend->Write(buffer, len, error);
+
+	if (!FlushCompressed(error))
+		return -1;
+
+	m_pZlibStream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(buffer));
+	m_pZlibStream->avail_in = len;
+	m_pZlibStream->next_out = reinterpret_cast<Bytef*>(m_pZlibBuffer);
+	m_pZlibStream->avail_out = zlib_buffer_size;
+
+	int res = deflate(m_pZlibStream, Z_NO_FLUSH);
+	if (res != Z_OK && res != Z_BUF_ERROR) {
+		m_pControlSocket->LogMessage(MessageType::Error, _("Could not compress data: %d"), res);
+		error = ECONNABORTED;
+		return -1;
+	}
+
+	int const consumed = len - m_pZlibStream->avail_in;
+	m_payloadBytes += consumed;
+
+	// The rest gets passed again by the caller, don't keep pointing into
+	// its buffer.
+	m_pZlibStream->next_in = 0;
+	m_pZlibStream->avail_in = 0;
+
+	m_pZlibOut = m_pZlibBuffer;
+	m_zlibOutLen = zlib_buffer_size - m_pZlibStream->avail_out;
+
+	// Input has been consumed, so a full socket buffer isn't an error yet.
+	if (!FlushCompressed(error) && error != EAGAIN)
+		return -1;
+
+	return consumed;
+}
+
+bool CTransferSocket::FlushCompressed(int& error)
+{
+	while (m_zlibOutLen) {
+		int written = m_pBackend->Write(m_pZlibOut, m_zlibOutLen, error);
+		if (written < 0)
+			return false;
+		if (!written) {
+			error = EAGAIN;
+			return false;
+		}
+
+		m_wireBytes += written;
+		m_pZlibOut += written;
+		m_zlibOutLen -= written;
+	}
+
+	return true;
+}
+
+bool CTransferSocket::FinishCompressed(int& error)
+{
+	for (;;) {
+		if (!FlushCompressed(error))
+			return false;
+
+		if (m_zlibStreamEnd)
+			return true;
+
+		m_pZlibStream->next_in = 0;
+		m_pZlibStream->avail_in = 0;
+		m_pZlibStream->next_out = reinterpret_cast<Bytef*>(m_pZlibBuffer);
+		m_pZlibStream->avail_out = zlib_buffer_size;
+
+		int res = deflate(m_pZlibStream, Z_FINISH);
+		if (res == Z_STREAM_END)
+			m_zlibStreamEnd = true;
+		else if (res != Z_OK && res != Z_BUF_ERROR) {
+			m_pControlSocket->LogMessage(MessageType::Error, _("Could not compress data: %d"), res);
+			error = ECONNABORTED;
+			return false;
+		}
+
+		m_pZlibOut = m_pZlibBuffer;
+		m_zlibOutLen = zlib_buffer_size - m_pZlibStream->avail_out;
+	}
+}
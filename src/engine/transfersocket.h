@@ -19,6 +19,7 @@ enum class TransferMode
 
 class CIOThread;
 class CTlsSocket;
+struct z_stream_s;
 class CTransferSocket : public CEventHandler, public CSocketEventHandler
 {
 public:
@@ -30,6 +31,19 @@ public:
 
 	void SetActive();
 
+	// MODE Z: Data on the wire is a zlib stream. Level is used for
+	// uploads, on downloads the server picks its own.
+	// Has to be called before SetActive.
+	void EnableCompression(int level);
+
+	TransferMode GetTransferMode() const { return m_transferMode; }
+
+	// Downloads: End the transfer successfully once that many bytes
+	// have been received, without waiting for the server to close the
+	// connection.
+	void SetDownloadLimit(wxFileOffset limit);
+	bool DownloadLimitReached() const { return m_downloadLimit == 0; }
+
 	CDirectoryListingParser *m_pDirectoryListingParser;
 
 	bool m_binaryMode;
@@ -41,6 +55,18 @@ protected:
 	bool CheckGetNextReadBuffer();
 	void FinalizeWrite();
 
+	// Like m_pBackend->Read/Write, but going through the zlib stream
+	// if compression is enabled.
+	int Read(char* buffer, int len, int& error);
+	int Write(char const* buffer, int len, int& error);
+
+	// Write out pending compressed data, returns false with error set
+	// if that's not possible right now.
+	bool FlushCompressed(int& error);
+	// Terminates the compressed stream on uploads
+	bool FinishCompressed(int& error);
+	void ResetCompression();
+
 	void TransferEnd(TransferEndReason reason);
 
 	bool InitBackend();
@@ -100,6 +126,21 @@ protected:
 	// Initially 0, 2 if made progress
 	// On uploads, 1 after first WSAE_WOULDBLOCK
 	int m_madeProgress;
+
+	// Bytes left until the download limit, -1 if unlimited
+	wxFileOffset m_downloadLimit;
+
+	z_stream_s* m_pZlibStream;
+	char* m_pZlibBuffer;
+	char* m_pZlibOut;
+	int m_zlibOutLen;
+	bool m_zlibOutputPending;
+	bool m_zlibStreamEnd;
+
+	// Compressed bytes on the data connection and the bytes of data
+	// they stand for.
+	wxLongLong m_wireBytes;
+	wxLongLong m_payloadBytes;
 };
 
 #endif
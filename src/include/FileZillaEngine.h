@@ -62,6 +62,9 @@ public:
 
 	int CacheLookup(CServerPath const& path, CDirectoryListing& listing);
 
+	// As above, is_outdated is set if the listing is older than the cache timeout
+	int CacheLookup(CServerPath const& path, CDirectoryListing& listing, bool& is_outdated);
+
 private:
 	CFileZillaEnginePrivate* const impl_;
 };
@@ -149,9 +149,18 @@ public:
 	public:
 		t_transferSettings()
 			: binary(true)
+			, segmentStart(-1)
+			, segmentEnd(-1)
 		{}
 
 		bool binary;
+
+		// Downloads only: If segmentStart isn't negative, only the bytes from
+		// segmentStart up to segmentEnd get transferred and written to the
+		// same position in the local file, leaving the rest of the file alone.
+		// Used to download a file in parts over multiple connections.
+		wxFileOffset segmentStart;
+		wxFileOffset segmentEnd;
 	};
 
 	// For uploads, set download to false.
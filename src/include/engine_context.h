@@ -9,6 +9,7 @@ class COptionsBase;
 class CPathCache;
 class CRateLimiter;
 class CSocketEventDispatcher;
+class CTlsSessionCache;
 
 // There can be multiple engines, but there can be at most one context
 class CFileZillaEngineContext
@@ -23,6 +24,7 @@ public:
 	CRateLimiter& GetRateLimiter();
 	CDirectoryCache& GetDirectoryCache();
 	CPathCache& GetPathCache();
+	CTlsSessionCache& GetTlsSessionCache();
 
 protected:
 	COptionsBase& options_;
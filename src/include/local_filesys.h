@@ -40,7 +40,10 @@ public:
 	static bool RecursiveDelete(const wxString& path, wxWindow* parent);
 	static bool RecursiveDelete(std::list<wxString> dirsToVisit, wxWindow* parent);
 
-	bool BeginFindFiles(wxString path, bool dirs_only);
+	// If metadata is false, GetNextFile only looks up size, time and mode of
+	// entries if it needs to anyhow to find out their type. Otherwise they
+	// are returned as unknown. Saves a stat for each entry on most systems.
+	bool BeginFindFiles(wxString path, bool dirs_only, bool metadata = true);
 	bool GetNextFile(wxString& name);
 	bool GetNextFile(wxString& name, bool &isLink, bool &is_dir, wxLongLong* size, CDateTime* modificationTime, int* mode);
 	void EndFindFiles();
@@ -59,10 +62,14 @@ protected:
 #ifndef __WXMSW__
 	static enum local_fileType GetFileInfo(const char* path, bool &isLink, wxLongLong* size, CDateTime* modificationTime, int* mode);
 	void AllocPathBuffer(const char* file);  // Ensures m_raw_path is large enough to hold path and filename
+
+	// Like GetFileInfo for an entry of the directory being enumerated
+	enum local_fileType GetEntryInfo(const char* name, bool &isLink, wxLongLong* size, CDateTime* modificationTime, int* mode);
 #endif
 
 	// State for directory enumeration
 	bool m_dirs_only;
+	bool m_metadata;
 #ifdef __WXMSW__
 	WIN32_FIND_DATA m_find_data;
 	HANDLE m_hFind;
@@ -237,6 +237,10 @@ public:
 	// SFTP uploads: Set to true if currentOffset >= startOffset + 65536.
 	bool madeProgress{};
 
+	// Downloads written through a buffer: Offset up to which the received
+	// data has been written to the local file. -1 if not tracked.
+	wxFileOffset writtenOffset{-1};
+
 	bool list{};
 };
 
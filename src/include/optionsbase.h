@@ -51,6 +51,8 @@ enum engineOptions
 	OPTION_SOCKET_BUFFERSIZE_SEND,
 
 	OPTION_FTP_SENDKEEPALIVE,
+	OPTION_FTP_PIPELINING, // Don't wait for the PASV/EPSV reply before sending the transfer command
+	OPTION_KERNEL_TLS, // Linux only: let the kernel encrypt FTPS uploads
 
 	OPTION_FTP_PROXY_TYPE,
 	OPTION_FTP_PROXY_HOST,
@@ -85,6 +85,10 @@ public:
 	int MaximumMultipleConnections() const;
 	bool GetBypassProxy() const;
 
+	// zlib level for MODE Z transfers, 0 if compression is disabled.
+	// Not compared in ==, < and related operators
+	int GetCompressionLevel() const;
+
 	// Return true if URL could be parsed correctly, false otherwise.
 	// If parsing fails, pError is filled with the reason and the CServer instance may be left an undefined state.
 	bool ParseUrl(wxString host, unsigned int port, wxString user, wxString pass, wxString &error, CServerPath &path);
@@ -106,6 +110,7 @@ public:
 	bool SetTimezoneOffset(int minutes);
 	void SetPasvMode(PasvMode pasvMode);
 	void MaximumMultipleConnections(int maximum);
+	bool SetCompressionLevel(int level);
 
 	wxString FormatHost(bool always_omit_port = false) const;
 	wxString FormatServer(const bool always_include_prefix = false) const;
@@ -158,6 +163,7 @@ protected:
 	int m_timezoneOffset;
 	PasvMode m_pasvMode;
 	int m_maximumMultipleConnections;
+	int m_compressionLevel;
 	CharsetEncoding m_encodingType;
 	wxString m_customEncoding;
 	wxString m_name;
@@ -139,7 +139,10 @@ public:
 	// Returns 0 on success, else an error code. Note: EINPROGRESS is
 	// not really an error. On success, you should still wait for the
 	// connection event.
-	// If host is a name that can be resolved, a hostaddress socket event gets sent.
+	// If host is a name that can be resolved, a hostaddress socket event gets sent
+	// for each address tried. If there are multiple addresses, connection
+	// attempts to them get started in a staggered fashion and raced against
+	// each other (RFC 8305, "Happy Eyeballs").
 	// Once connections got established, a connection event gets sent. If
 	// connection could not be established, a close event gets sent.
 	int Connect(wxString host, unsigned int port, address_family family = unspec);
@@ -159,6 +162,23 @@ public:
 	// Returns the hostname passed to Connect()
 	wxString GetPeerHost() const;
 
+	struct connect_attempt_info
+	{
+		wxString address;
+
+		// In milliseconds since the address got resolved
+		long start;
+		long duration;
+
+		// 0 for the attempt that got connected. Attempts which were still
+		// pending at that time fail with ECONNABORTED.
+		int error;
+	};
+
+	// Timings of the attempts to the individual addresses of the
+	// host during the last call to Connect()
+	std::vector<connect_attempt_info> GetConnectAttempts() const;
+
 	// -1 on error
 	int GetLocalPort(int& error);
 	int GetRemotePort(int& error);
@@ -195,6 +215,16 @@ public:
 
 	void SetSynchronousReadCallback(CCallback* cb);
 
+	// Linux only: Hands encryption of all further data written to the
+	// socket to the kernel. cryptoInfo is one of the tls12_crypto_info_*
+	// structures from linux/tls.h.
+	// Returns 0 on success, else an error code.
+	int EnableKernelTls(void const* cryptoInfo, unsigned int size);
+
+	// With kernel TLS enabled, writes a record of the given content type
+	// other than application data, e.g. an alert.
+	int WriteTlsRecord(unsigned char type, const void *buffer, unsigned int size, int& error);
+
 protected:
 	static int DoSetFlags(int fd, int flags, int flags_mask);
 	static int DoSetBufferSizes(int fd, int size_read, int size_write);
@@ -219,6 +249,8 @@ protected:
 	int m_buffer_sizes[2];
 
 	CCallback* m_synchronous_read_cb{};
+
+	std::vector<connect_attempt_info> m_connect_attempts;
 };
 
 #ifdef __WXMSW__
@@ -384,7 +384,7 @@ regular_dir:
 		int totalDirCount = 0;
 		int hidden = 0;
 
-		int num = m_fileData.size();
+		unsigned int const first = m_fileData.size();
 		CLocalFileData data;
 		bool wasLink;
 		while (local_filesystem.GetNextFile(data.name, wasLink, data.dir, &data.size, &data.time, &data.attributes)) {
@@ -394,21 +394,27 @@ regular_dir:
 			}
 
 			m_fileData.push_back(data);
-			if (!filter.FilenameFiltered(data.name, m_dir.GetPath(), data.dir, data.size, true, data.attributes, data.time)) {
-				if (data.dir)
-					totalDirCount++;
-				else {
-					if (data.size != -1)
-						totalSize += data.size;
-					else
-						unknown_sizes++;
-					totalFileCount++;
-				}
-				m_indexMapping.push_back(num);
+		}
+
+		// Huge directories get filtered on all cores
+		wxString const path = m_dir.GetPath();
+		ParallelFilter(m_indexMapping, first, m_fileData.size(), CFilterManager::CanFilterConcurrently(true), [&](unsigned int i) {
+			CLocalFileData const& entry = m_fileData[i];
+			return !filter.FilenameFiltered(entry.name, path, entry.dir, entry.size, true, entry.attributes, entry.time);
+		});
+		hidden = m_fileData.size() - m_indexMapping.size();
+
+		for (unsigned int i = first; i < m_indexMapping.size(); ++i) {
+			CLocalFileData const& entry = m_fileData[m_indexMapping[i]];
+			if (entry.dir)
+				totalDirCount++;
+			else {
+				if (entry.size != -1)
+					totalSize += entry.size;
+				else
+					unknown_sizes++;
+				totalFileCount++;
 			}
-			else
-				hidden++;
-			num++;
 		}
 
 		if (m_pFilelistStatusBar)
@@ -1094,19 +1100,27 @@ void CLocalListView::ApplyCurrentFilter()
 	int totalDirCount = 0;
 	int hidden = 0;
 
+	const wxString path = m_dir.GetPath();
+
 	m_indexMapping.clear();
 	if (m_hasParent)
 		m_indexMapping.push_back(0);
+	ParallelFilter(m_indexMapping, min, m_fileData.size(), CFilterManager::CanFilterConcurrently(true), [&](unsigned int i) {
+		const CLocalFileData& data = m_fileData[i];
+		return data.comparison_flags != fill &&
+			!filter.FilenameFiltered(data.name, path, data.dir, data.size, true, data.attributes, data.time);
+	});
+
+	hidden = m_fileData.size() - m_indexMapping.size();
 	for (unsigned int i = min; i < m_fileData.size(); i++)
 	{
-		const CLocalFileData& data = m_fileData[i];
-		if (data.comparison_flags == fill)
-			continue;
-		if (filter.FilenameFiltered(data.name, m_dir.GetPath(), data.dir, data.size, true, data.attributes, data.time)) {
-			hidden++;
-			continue;
-		}
+		if (m_fileData[i].comparison_flags == fill)
+			hidden--;
+	}
 
+	for (unsigned int i = min; i < m_indexMapping.size(); i++)
+	{
+		const CLocalFileData& data = m_fileData[m_indexMapping[i]];
 		if (data.dir)
 			totalDirCount++;
 		else
@@ -1117,8 +1131,6 @@ void CLocalListView::ApplyCurrentFilter()
 				unknown_sizes++;
 			totalFileCount++;
 		}
-
-		m_indexMapping.push_back(i);
 	}
 	SetItemCount(m_indexMapping.size());
 
@@ -430,7 +430,7 @@ void CLocalTreeView::DisplayDir(wxTreeItemId parent, const wxString& dirname, co
 
 	{
 		wxLogNull log;
-		if (!local_filesystem.BeginFindFiles(dirname, true))
+		if (!local_filesystem.BeginFindFiles(dirname, true, CFilterManager::FiltersUseMetadata(true)))
 		{
 			if (!knownSubdir.empty())
 			{
@@ -530,7 +530,7 @@ wxString CLocalTreeView::HasSubdir(const wxString& dirname)
 	CFilterManager filter;
 
 	CLocalFileSystem local_filesystem;
-	if (!local_filesystem.BeginFindFiles(dirname, true))
+	if (!local_filesystem.BeginFindFiles(dirname, true, CFilterManager::FiltersUseMetadata(true)))
 		return wxString();
 
 	wxString file;
@@ -732,7 +732,7 @@ void CLocalTreeView::RefreshListing()
 
 		// Step 1: Check if directory exists
 		CLocalFileSystem local_filesystem;
-		if (!local_filesystem.BeginFindFiles(dir.dir, true))
+		if (!local_filesystem.BeginFindFiles(dir.dir, true, CFilterManager::FiltersUseMetadata(true)))
 		{
 			// Dir does exist (listed in parent) but may not be accessible.
 			// Recurse into children anyhow, they might be accessible again.
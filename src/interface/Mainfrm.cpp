@@ -43,6 +43,7 @@
 #include "splitter.h"
 #include "bookmarks_dialog.h"
 #include "search.h"
+#include "synchronization.h"
 #include "power_management.h"
 #include "welcome_dialog.h"
 #include "context_control.h"
@@ -790,6 +791,19 @@ void CMainFrame::OnMenuHandler(wxCommandEvent &event)
 		CManualTransfer dlg(m_pQueueView);
 		dlg.Run(this, pState);
 	}
+	else if (event.GetId() == XRCID("ID_MENU_TRANSFER_SYNCHRONIZE_DOWNLOAD") || event.GetId() == XRCID("ID_MENU_TRANSFER_SYNCHRONIZE_UPLOAD") ||
+		event.GetId() == XRCID("ID_MENU_TRANSFER_SYNCHRONIZE_DRYRUN_DOWNLOAD") || event.GetId() == XRCID("ID_MENU_TRANSFER_SYNCHRONIZE_DRYRUN_UPLOAD")) {
+		CState* pState = CContextManager::Get()->GetCurrentContext();
+		if (!pState || !pState->GetSynchronization()) {
+			wxBell();
+			return;
+		}
+
+		bool const download = event.GetId() == XRCID("ID_MENU_TRANSFER_SYNCHRONIZE_DOWNLOAD") || event.GetId() == XRCID("ID_MENU_TRANSFER_SYNCHRONIZE_DRYRUN_DOWNLOAD");
+		bool const dryRun = event.GetId() == XRCID("ID_MENU_TRANSFER_SYNCHRONIZE_DRYRUN_DOWNLOAD") || event.GetId() == XRCID("ID_MENU_TRANSFER_SYNCHRONIZE_DRYRUN_UPLOAD");
+		if (!pState->GetSynchronization()->Start(download, dryRun))
+			wxBell();
+	}
 	else if (event.GetId() == XRCID("ID_BOOKMARK_ADD") || event.GetId() == XRCID("ID_BOOKMARK_MANAGE")) {
 		CServer server;
 		CState* pState = CContextManager::Get()->GetCurrentContext();
@@ -71,6 +71,7 @@ public:
 	bool ConnectToSite(CSiteManagerItemData_Site & data, bool newTab = false);
 
 	CFileZillaEngineContext& GetEngineContext() { return m_engineContext; }
+	CAsyncRequestQueue* GetAsyncRequestQueue() { return m_pAsyncRequestQueue; }
 protected:
 	void FixTabOrder();
 
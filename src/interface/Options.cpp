@@ -84,6 +84,8 @@ static const t_Option options[OPTIONS_NUM] =
 														 // to enable a large TCP window scale
 	{ "Socket send buffer size (v2)", number, _T("262144"), normal },
 	{ "FTP Keep-alive commands", number, _T("0"), normal },
+	{ "FTP pipelining", number, _T("0"), normal },
+	{ "Kernel TLS", number, _T("0"), normal },
 	{ "FTP Proxy type", number, _T("0"), normal },
 	{ "FTP Proxy host", string, _T(""), normal },
 	{ "FTP Proxy user", string, _T(""), normal },
@@ -183,6 +185,8 @@ static const t_Option options[OPTIONS_NUM] =
 	{ "Strip VMS revisions", number, _T("0"), normal },
 	{ "Show Site Manager on startup", number, _T("0"), normal },
 	{ "Prompt password change", number, _T("0"), normal },
+	{ "Download segments", number, _T("1"), normal },
+	{ "Download segments minimum size", number, _T("64"), normal }, // In MiB
 
 	// Default/internal options
 	{ "Config Location", string, _T(""), default_only },
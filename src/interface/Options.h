@@ -85,6 +85,8 @@ enum interfaceOptions
 	OPTION_STRIP_VMS_REVISION,
 	OPTION_INTERFACE_SITEMANAGER_ON_STARTUP,
 	OPTION_PROMPTPASSWORDSAVE,
+	OPTION_DOWNLOAD_SEGMENTS,
+	OPTION_DOWNLOAD_SEGMENTS_MINSIZE,
 
 	// Default/internal options
 	OPTION_DEFAULT_SETTINGSDIR, // guaranteed to be (back)slash-terminated
@@ -22,6 +22,7 @@
 #include <wx/progdlg.h>
 #include <wx/sound.h>
 #include "local_filesys.h"
+#include "parallel.h"
 #include "statusbar.h"
 #include "recursive_operation.h"
 #include "auto_ascii_files.h"
@@ -209,6 +210,11 @@ EVT_COMMAND(wxID_ANY, fzEVT_GRANTEXCLUSIVEENGINEACCESS, CQueueView::OnExclusiveE
 EVT_SIZE(CQueueView::OnSize)
 END_EVENT_TABLE()
 
+// Lists the directories of a folder upload. Directories are handed out to a
+// few scanning threads, each passes the entries of a directory on in one
+// batch, preceded by the directory itself. Filtering and queueing the
+// entries is done by the queue, which hands the subdirectories back through
+// ProcessDirectory.
 class CFolderProcessingThread final : public wxThread
 {
 	struct t_internalDirPair
@@ -223,9 +229,9 @@ public:
 		m_pFolderItem = pFolderItem;
 
 		m_didSendEvent = false;
-		m_threadWaiting = false;
-		m_throttleWait = false;
 		m_processing_entries = false;
+		m_busyScanners = 0;
+		m_stop = false;
 
 		t_internalDirPair* pair = new t_internalDirPair;
 		pair->localPath = pFolderItem->GetLocalPath();
@@ -250,10 +256,7 @@ public:
 		m_didSendEvent = false;
 		m_processing_entries = true;
 
-		if (m_throttleWait) {
-			m_throttleWait = false;
-			m_condition.Signal();
-		}
+		m_condition.Broadcast();
 	}
 
 	class t_dirPair : public CFolderProcessingEntry
@@ -280,10 +283,7 @@ public:
 
 		m_dirsToCheck.push_back(pair);
 
-		if (m_threadWaiting) {
-			m_threadWaiting = false;
-			m_condition.Signal();
-		}
+		m_condition.Broadcast();
 	}
 
 	void CheckFinished()
@@ -293,10 +293,7 @@ public:
 
 		m_processing_entries = false;
 
-		if (m_threadWaiting && (!m_dirsToCheck.empty() || m_entryList.empty())) {
-			m_threadWaiting = false;
-			m_condition.Signal();
-		}
+		m_condition.Broadcast();
 
 		m_sync.Unlock();
 	}
@@ -308,112 +305,135 @@ public:
 
 protected:
 
-	void AddEntry(CFolderProcessingEntry* entry)
+	// Has to be called with m_sync locked
+	void AddEntries(std::list<CFolderProcessingEntry*> &entries)
 	{
-		m_sync.Lock();
-		m_entryList.push_back(entry);
+		// Wait if the queue is lagging behind. This limits the memory used
+		// for entries which have not been queued yet.
+		while (m_didSendEvent && m_entryList.size() >= 1000 && !m_stop)
+			m_condition.Wait();
 
-		// Wait if there are more than 100 items to queue,
-		// don't send notification if there are less than 10.
-		// This reduces overhead
-		bool send;
+		if (m_stop)
+			return;
 
-		if (m_didSendEvent) {
-			send = false;
-			if (m_entryList.size() >= 100) {
-				m_throttleWait = true;
-				m_condition.Wait();
-			}
-		}
-		else if (m_entryList.size() < 20)
-			send = false;
-		else
-			send = true;
+		m_entryList.splice(m_entryList.end(), entries);
 
-		if (send)
+		if (!m_didSendEvent) {
 			m_didSendEvent = true;
 
-		m_sync.Unlock();
-
-		if (send) {
 			// We send the notification after leaving the critical section, else we
 			// could get into a deadlock. wxWidgets event system does internal
 			// locking.
+			m_sync.Unlock();
 			m_pOwner->QueueEvent(new wxCommandEvent(fzEVT_FOLDERTHREAD_FILES, wxID_ANY));
+			m_sync.Lock();
 		}
 	}
 
-	ExitCode Entry()
+	void Scan(bool own_thread)
 	{
-#ifdef __WXDEBUG__
-		wxMutexGuiEnter();
-		wxASSERT(m_pFolderItem->GetTopLevelItem() && m_pFolderItem->GetTopLevelItem()->GetType() == QueueItemType::Server);
-		wxMutexGuiLeave();
-#endif
-
-		wxASSERT(!m_pFolderItem->Download());
-
 		CLocalFileSystem localFileSystem;
 
-		while (!TestDestroy() && !m_pFolderItem->m_remove) {
-			m_sync.Lock();
+		m_sync.Lock();
+		while (true) {
+			// TestDestroy may only be called from this thread itself
+			if (m_stop || m_pFolderItem->m_remove || (own_thread && TestDestroy())) {
+				m_stop = true;
+				m_condition.Broadcast();
+				break;
+			}
+
 			if (m_dirsToCheck.empty()) {
+				if (m_busyScanners) {
+					// Others might still find subdirectories
+					m_condition.Wait();
+					continue;
+				}
+
 				if (!m_didSendEvent && !m_entryList.empty()) {
 					m_didSendEvent = true;
 					m_sync.Unlock();
 					m_pOwner->QueueEvent(new wxCommandEvent(fzEVT_FOLDERTHREAD_FILES, wxID_ANY));
+					m_sync.Lock();
 					continue;
 				}
 
 				if (!m_didSendEvent && !m_processing_entries) {
-					m_sync.Unlock();
+					// Everything has been queued
+					m_stop = true;
+					m_condition.Broadcast();
 					break;
 				}
-				m_threadWaiting = true;
+
 				m_condition.Wait();
-				if (m_dirsToCheck.empty()) {
-					m_sync.Unlock();
-					break;
-				}
-				m_sync.Unlock();
 				continue;
 			}
 
 			const t_internalDirPair *pair = m_dirsToCheck.front();
 			m_dirsToCheck.pop_front();
+			++m_busyScanners;
 
 			m_sync.Unlock();
 
-			if (!localFileSystem.BeginFindFiles(pair->localPath.GetPath(), false)) {
-				delete pair;
-				continue;
-			}
+			std::list<CFolderProcessingEntry*> entries;
+			if (localFileSystem.BeginFindFiles(pair->localPath.GetPath(), false)) {
+				t_dirPair* pair2 = new t_dirPair;
+				pair2->localPath = pair->localPath;
+				pair2->remotePath = pair->remotePath;
+				entries.push_back(pair2);
 
-			t_dirPair* pair2 = new t_dirPair;
-			pair2->localPath = pair->localPath;
-			pair2->remotePath = pair->remotePath;
-			AddEntry(pair2);
+				t_newEntry* entry = new t_newEntry;
 
-			t_newEntry* entry = new t_newEntry;
-
-			wxString name;
-			bool is_link;
-			bool is_dir;
-			while (localFileSystem.GetNextFile(name, is_link, is_dir, &entry->size, &entry->time, &entry->attributes)) {
-				if (is_link)
-					continue;
+				wxString name;
+				bool is_link;
+				bool is_dir;
+				while (localFileSystem.GetNextFile(name, is_link, is_dir, &entry->size, &entry->time, &entry->attributes)) {
+					if (is_link)
+						continue;
 
-				entry->name = name;
-				entry->dir = is_dir;
+					entry->name = name;
+					entry->dir = is_dir;
 
-				AddEntry(entry);
+					entries.push_back(entry);
 
-				entry = new t_newEntry;
+					entry = new t_newEntry;
+				}
+				delete entry;
+				localFileSystem.EndFindFiles();
 			}
-			delete entry;
-
 			delete pair;
+
+			m_sync.Lock();
+
+			// Still counts as busy while waiting to add the entries, the
+			// others must not consider the scan complete in the meantime.
+			if (!entries.empty())
+				AddEntries(entries);
+			for (auto iter = entries.begin(); iter != entries.end(); ++iter)
+				delete *iter;
+
+			if (!--m_busyScanners)
+				m_condition.Broadcast();
 		}
+		m_sync.Unlock();
+	}
+
+	ExitCode Entry()
+	{
+#ifdef __WXDEBUG__
+		wxMutexGuiEnter();
+		wxASSERT(m_pFolderItem->GetTopLevelItem() && m_pFolderItem->GetTopLevelItem()->GetType() == QueueItemType::Server);
+		wxMutexGuiLeave();
+#endif
+
+		wxASSERT(!m_pFolderItem->Download());
+
+		// Listing mostly waits on the file system, especially on network
+		// shares, so use a few threads even on machines with few cores.
+		unsigned int const scanners = std::min(std::max(wxThread::GetCPUCount(), 4), 8);
+		RunParallel(scanners, [this](unsigned int scanner) {
+			Scan(!scanner);
+		});
 
 		m_pOwner->QueueEvent(new wxCommandEvent(fzEVT_FOLDERTHREAD_COMPLETE, wxID_ANY));
 		return 0;
@@ -429,10 +449,10 @@ protected:
 
 	wxMutex m_sync;
 	wxCondition m_condition;
-	bool m_threadWaiting;
-	bool m_throttleWait;
 	bool m_didSendEvent;
 	bool m_processing_entries;
+	int m_busyScanners;
+	bool m_stop;
 };
 
 CQueueView::CQueueView(CQueue* parent, int index, CMainFrame* pMainFrame, CAsyncRequestQueue *pAsyncRequestQueue)
@@ -506,7 +526,7 @@ bool CQueueView::QueueFile(const bool queueOnly, const bool download,
 						   const wxString& sourceFile, const wxString& targetFile,
 						   const CLocalPath& localPath, const CServerPath& remotePath,
 						   const CServer& server, const wxLongLong size, enum CEditHandler::fileType edit,
-						   QueuePriority priority)
+						   QueuePriority priority, CFileExistsNotification::OverwriteAction onetime_action)
 {
 	CServerItem* pServerItem = CreateServerItem(server);
 
@@ -533,6 +553,8 @@ bool CQueueView::QueueFile(const bool queueOnly, const bool download,
 		fileItem->m_edit = edit;
 		if (edit != CEditHandler::none)
 			fileItem->m_onetime_action = CFileExistsNotification::overwrite;
+		else if (onetime_action != CFileExistsNotification::unknown)
+			fileItem->m_onetime_action = onetime_action;
 	}
 
 	fileItem->SetPriorityRaw(priority);
@@ -687,11 +709,23 @@ void CQueueView::ProcessNotification(t_EngineData* pEngineData, std::unique_ptr<
 			CTransferStatus const* pStatus = transferStatusNotification.GetStatus();
 
 			if (pEngineData->active) {
-				if (pStatus && pStatus->madeProgress && !pStatus->list &&
-					pEngineData->pItem->GetType() == QueueItemType::File)
-				{
+				if (pStatus && !pStatus->list && pEngineData->pItem->GetType() == QueueItemType::File) {
 					CFileItem* pItem = (CFileItem*)pEngineData->pItem;
-					pItem->set_made_progress(true);
+
+					// Only the first segment gets more than asked for, if the
+					// server ignores the Range header. The first data received
+					// always gets notified, even if done before making progress.
+					if (pItem->m_segment && pItem->m_segment->GetsWholeFile(pStatus->totalSize))
+						MergeSegments(*pItem);
+
+					if (pStatus->madeProgress) {
+						pItem->set_made_progress(true);
+
+						// Gets saved as the resume point, so only count what
+						// has made it to the file.
+						if (pItem->m_segment)
+							pItem->m_segment->done = (pStatus->writtenOffset != -1) ? pStatus->writtenOffset : pStatus->currentOffset;
+					}
 				}
 				pEngineData->pStatusLineCtrl->SetTransferStatus(pStatus);
 			}
@@ -710,6 +744,141 @@ void CQueueView::ProcessNotification(t_EngineData* pEngineData, std::unique_ptr<
 	}
 }
 
+void CQueueView::SplitDownload(CServerItem& serverItem, CFileItem& fileItem)
+{
+	if (!fileItem.Download() || fileItem.Ascii() || fileItem.m_edit != CEditHandler::none ||
+		fileItem.m_segment || fileItem.made_progress())
+	{
+		return;
+	}
+
+	// Segments rely on REST or Range requests to start in the middle of the file
+	switch (serverItem.GetServer().GetProtocol())
+	{
+	case FTP:
+	case FTPS:
+	case FTPES:
+	case INSECURE_FTP:
+	case HTTP:
+	case HTTPS:
+		break;
+	default:
+		return;
+	}
+
+	int segments = COptions::Get()->GetOptionVal(OPTION_DOWNLOAD_SEGMENTS);
+	segments = std::min(segments, COptions::Get()->GetOptionVal(OPTION_NUMTRANSFERS));
+	const int maxConnections = serverItem.GetServer().MaximumMultipleConnections();
+	if (maxConnections)
+		segments = std::min(segments, maxConnections);
+	if (segments < 2)
+		return;
+
+	const wxLongLong size = fileItem.GetSize();
+	const wxLongLong minSize = wxLongLong(COptions::Get()->GetOptionVal(OPTION_DOWNLOAD_SEGMENTS_MINSIZE)) * 1024 * 1024;
+	if (size < minSize || size < segments)
+		return;
+
+	// Existing files need the usual overwrite or resume prompt
+	const wxString localFile = fileItem.GetLocalPath().GetPath() + fileItem.GetLocalFile();
+	if (CLocalFileSystem::GetFileType(localFile) != CLocalFileSystem::unknown)
+		return;
+
+	const wxLongLong segmentSize = size / segments;
+
+	auto const& targetFile = fileItem.GetTargetFile();
+	for (int i = segments - 1; i > 0; --i) {
+		const wxLongLong start = segmentSize * i;
+		const wxLongLong end = (i == segments - 1) ? size : start + segmentSize;
+
+		CFileItem* segment = new CFileItem(&serverItem, fileItem.queued(), true, fileItem.GetSourceFile(), targetFile ? *targetFile : wxString(),
+			fileItem.GetLocalPath(), fileItem.GetRemotePath(), end - start);
+		segment->SetPriorityRaw(fileItem.GetPriority());
+		segment->m_defaultFileExistsAction = fileItem.m_defaultFileExistsAction;
+		segment->m_segment = CSparseOptional<CFileItem::t_segment>(CFileItem::t_segment(start, end));
+		InsertItem(&serverItem, segment);
+
+		// Get the other segments going before anything else
+		serverItem.ScheduleFirst(segment);
+	}
+
+	fileItem.m_segment = CSparseOptional<CFileItem::t_segment>(CFileItem::t_segment(0, segmentSize));
+	UpdateItemSize(&fileItem, segmentSize);
+
+	CommitChanges();
+}
+
+CFileItem* CQueueView::MergeSegments(CFileItem& fileItem)
+{
+	CServerItem* pServerItem = static_cast<CServerItem*>(fileItem.GetTopLevelItem());
+	if (!pServerItem)
+		return 0;
+
+	wxString const localFile = fileItem.GetLocalPath().GetPath() + fileItem.GetLocalFile();
+
+	std::vector<CFileItem*> segments;
+	bool merged = false;
+	for (unsigned int i = 0; i < pServerItem->GetChildrenCount(false); ++i) {
+		CQueueItem* pItem = pServerItem->GetChild(i, false);
+		if (pItem->GetType() != QueueItemType::File)
+			continue;
+
+		CFileItem* pFileItem = static_cast<CFileItem*>(pItem);
+		if (!pFileItem->Download() || pFileItem->GetRemoteFile() != fileItem.GetRemoteFile() ||
+			pFileItem->GetLocalPath().GetPath() + pFileItem->GetLocalFile() != localFile)
+		{
+			continue;
+		}
+
+		if (pFileItem->m_segment)
+			segments.push_back(pFileItem);
+		else
+			merged = true;
+	}
+
+	CFileItem* first = 0;
+	wxLongLong size = 0;
+	for (auto const& segment : segments) {
+		if (!first || segment->m_segment->start < first->m_segment->start)
+			first = segment;
+		if (segment->m_segment->FileSize() > size)
+			size = segment->m_segment->FileSize();
+	}
+	if (merged)
+		first = 0;
+
+	// Active segments find out about the server on their own
+	for (auto const& segment : segments) {
+		if (segment != first && segment != &fileItem && !segment->IsActive())
+			RemoveItem(segment, true);
+	}
+	CommitChanges();
+
+	if (!first)
+		return 0;
+
+	if (first != &fileItem && first->IsActive()) {
+		// Still busy with its own part, gets the rest afterwards. Unless its
+		// transfer turns out to get the whole file anyhow.
+		first->m_segment->Merge(size);
+		return first;
+	}
+
+	DownloadWholeFile(*first, size);
+	return first;
+}
+
+void CQueueView::DownloadWholeFile(CFileItem& fileItem, wxLongLong size)
+{
+	fileItem.m_segment.clear();
+
+	// The segments have created the file already
+	fileItem.m_onetime_action = CFileExistsNotification::overwrite;
+
+	UpdateItemSize(&fileItem, size);
+	RefreshItem(&fileItem);
+}
+
 bool CQueueView::CanStartTransfer(const CServerItem& server_item, struct t_EngineData *&pEngineData)
 {
 	const CServer &server = server_item.GetServer();
@@ -731,6 +900,12 @@ bool CQueueView::CanStartTransfer(const CServerItem& server_item, struct t_Engin
 		if (*pBrowsingServer == server)
 		{
 			active_count++;
+
+			// Recursive operations may list directories over additional connections
+			CRecursiveOperation* pRecursiveOperation = pState->GetRecursiveOperationHandler();
+			if (pRecursiveOperation)
+				active_count += pRecursiveOperation->GetListingEngineCount();
+
 			browsingStateOnSameServer = pState;
 			break;
 		}
@@ -865,6 +1040,9 @@ bool CQueueView::TryStartNextTransfer()
 			return false;
 	}
 
+	if (bestMatch.fileItem->GetType() == QueueItemType::File)
+		SplitDownload(*bestMatch.serverItem, *bestMatch.fileItem);
+
 	// Now we have both inactive engine and file.
 	// Assign the file to the engine.
 
@@ -1033,9 +1211,24 @@ void CQueueView::ProcessReply(t_EngineData* pEngineData, COperationNotification
 			return;
 		}
 		if (replyCode == FZ_REPLY_OK) {
+			CFileItem* pItem = pEngineData->pItem;
+			if (pItem->m_segment && pItem->m_segment->Merged()) {
+				// Got its own part, but the other segments could not get theirs
+				DownloadWholeFile(*pItem, pItem->m_segment->FileSize());
+				ResetEngine(*pEngineData, retry);
+				return;
+			}
 			ResetEngine(*pEngineData, success);
 			return;
 		}
+
+		if ((replyCode & FZ_REPLY_NOTSUPPORTED) == FZ_REPLY_NOTSUPPORTED && pEngineData->pItem->m_segment) {
+			// The server ignores Range requests
+			CFileItem* first = MergeSegments(*pEngineData->pItem);
+			ResetEngine(*pEngineData, (first == pEngineData->pItem) ? retry : remove);
+			return;
+		}
+
 		// Increase error count only if item didn't make any progress. This keeps
 		// user interaction at a minimum if connection is unstable.
 
@@ -1056,6 +1249,9 @@ void CQueueView::ProcessReply(t_EngineData* pEngineData, COperationNotification
 			else if (replyCode & FZ_REPLY_DISCONNECTED)
 				pEngineData->pItem->SetStatusMessage(CFileItem::disconnected);
 			else if ((replyCode & FZ_REPLY_WRITEFAILED) == FZ_REPLY_WRITEFAILED) {
+				// Unknown how much of the segment made it to disk
+				if (pEngineData->pItem->m_segment)
+					pEngineData->pItem->m_segment->done = 0;
 				pEngineData->pItem->SetStatusMessage(CFileItem::local_file_unwriteable);
 				ResetEngine(*pEngineData, failure);
 				return;
@@ -1425,6 +1621,18 @@ void CQueueView::SendNextCommand(t_EngineData& engineData)
 
 			CFileTransferCommand::t_transferSettings transferSettings;
 			transferSettings.binary = !fileItem->Ascii();
+			if (fileItem->m_segment) {
+				CFileItem::t_segment& segment = *fileItem->m_segment;
+				segment.start += segment.done;
+				segment.done = 0;
+				if (segment.start >= segment.end) {
+					// Previous attempt got all of it but failed afterwards
+					ResetEngine(engineData, success);
+					return;
+				}
+				transferSettings.segmentStart = segment.start.GetValue();
+				transferSettings.segmentEnd = segment.end.GetValue();
+			}
 			int res = engineData.pEngine->Execute(CFileTransferCommand(fileItem->GetLocalPath().GetPath() + fileItem->GetLocalFile(), fileItem->GetRemotePath(),
 												fileItem->GetRemoteFile(), fileItem->Download(), transferSettings));
 			wxASSERT((res & FZ_REPLY_BUSY) != FZ_REPLY_BUSY);
@@ -1994,6 +2202,8 @@ void CQueueView::ImportQueue(TiXmlElement* pElement, bool updateSelections)
 					dataType = GetTextElementInt(pFile, "TransferMode", 1);
 				bool binary = dataType != 0;
 				int overwrite_action = GetTextElementInt(pFile, "OverwriteAction", CFileExistsNotification::unknown);
+				wxLongLong segmentStart = GetTextElementLongLong(pFile, "SegmentStart", -1);
+				wxLongLong segmentEnd = GetTextElementLongLong(pFile, "SegmentEnd", -1);
 
 				CServerPath remotePath;
 				if (!localFile.empty() && !remoteFile.empty() && remotePath.SetSafePath(safeRemotePath) &&
@@ -2019,6 +2229,8 @@ void CQueueView::ImportQueue(TiXmlElement* pElement, bool updateSelections)
 					fileItem->SetAscii(!binary);
 					fileItem->SetPriorityRaw(QueuePriority(priority));
 					fileItem->m_errorCount = errorCount;
+					if (download && segmentStart >= 0 && segmentEnd > segmentStart)
+						fileItem->m_segment = CSparseOptional<CFileItem::t_segment>(CFileItem::t_segment(segmentStart, segmentEnd));
 					InsertItem(pServerItem, fileItem);
 
 					if (overwrite_action > 0 && overwrite_action < CFileExistsNotification::ACTION_COUNT)
@@ -2717,6 +2929,21 @@ void CQueueView::OnAskPassword(wxCommandEvent&)
 	}
 }
 
+int CQueueView::GetActiveTransferCount(const CServer& server)
+{
+	CServerItem* pServerItem = GetServerItem(server);
+	if (!pServerItem)
+		return 0;
+
+	return pServerItem->m_activeCount;
+}
+
+void CQueueView::ConnectionsClosed()
+{
+	if (m_activeMode)
+		AdvanceQueue(false);
+}
+
 void CQueueView::UpdateItemSize(CFileItem* pItem, wxLongLong size)
 {
 	wxASSERT(pItem);
@@ -127,7 +127,8 @@ public:
 		const wxString& localFile, const wxString& remoteFile,
 		const CLocalPath& localPath, const CServerPath& remotePath,
 		const CServer& server, const wxLongLong size, enum CEditHandler::fileType edit = CEditHandler::none,
-		QueuePriority priority = QueuePriority::normal);
+		QueuePriority priority = QueuePriority::normal,
+		CFileExistsNotification::OverwriteAction onetime_action = CFileExistsNotification::unknown);
 
 	void QueueFile_Finish(const bool start); // Need to be called after QueueFile
 	bool QueueFiles(const bool queueOnly, const CLocalPath& localPath, const CRemoteDataObject& dataObject);
@@ -145,6 +146,13 @@ public:
 
 	void UpdateItemSize(CFileItem* pItem, wxLongLong size);
 
+	// Number of transfers running on the given server
+	int GetActiveTransferCount(const CServer& server);
+
+	// Transfers held back by the server's connection limit may start
+	// once other connections to it have been closed
+	void ConnectionsClosed();
+
 	void RemoveAll();
 
 	void LoadQueue();
@@ -186,6 +194,18 @@ protected:
 	// whether it is allowed to start another transfer on that server item
 	bool CanStartTransfer(const CServerItem& server_item, struct t_EngineData *&pEngineData);
 
+	// Splits large FTP downloads into segments downloaded in parallel over
+	// multiple connections, see OPTION_DOWNLOAD_SEGMENTS. The item itself
+	// becomes the first segment, the others get queued right after it.
+	void SplitDownload(CServerItem& serverItem, CFileItem& fileItem);
+
+	// Called once a segment finds out that the server ignores Range
+	// requests. The file can only be downloaded in a single stream then:
+	// idle segments get removed and the first segment gets the whole file.
+	// Returns the first segment, 0 if it already downloads the whole file.
+	CFileItem* MergeSegments(CFileItem& fileItem);
+	void DownloadWholeFile(CFileItem& fileItem, wxLongLong size);
+
 	bool ProcessFolderItems(int type = -1);
 	void ProcessUploadFolderItems();
 
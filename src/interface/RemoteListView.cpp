@@ -444,6 +444,30 @@ bool CRemoteListView::IsItemValid(unsigned int item) const
 	return true;
 }
 
+namespace {
+// Erases the elements at the given ascending indexes, moving every
+// remaining element at most once.
+template<typename T>
+void EraseSortedIndexes(std::vector<T>& v, std::vector<unsigned int> const& indexes)
+{
+	if (indexes.empty())
+		return;
+
+	auto out = v.begin() + indexes.front();
+	auto next = indexes.cbegin();
+	for (unsigned int i = indexes.front(); i < v.size(); i++)
+	{
+		if (next != indexes.cend() && *next == i)
+		{
+			++next;
+			continue;
+		}
+		*out++ = std::move(v[i]);
+	}
+	v.erase(out, v.end());
+}
+}
+
 void CRemoteListView::UpdateDirectoryListing_Added(std::shared_ptr<CDirectoryListing> const& pDirectoryListing)
 {
 	const unsigned int to_add = pDirectoryListing->GetCount() - m_pDirectoryListing->GetCount();
@@ -451,7 +475,7 @@ void CRemoteListView::UpdateDirectoryListing_Added(std::shared_ptr<CDirectoryLis
 
 	m_indexMapping[0] = pDirectoryListing->GetCount();
 
-	std::list<unsigned int> added;
+	std::vector<unsigned int> added;
 
 	CFilterManager filter;
 	const wxString path = m_pDirectoryListing->path.GetPath();
@@ -484,41 +508,61 @@ void CRemoteListView::UpdateDirectoryListing_Added(std::shared_ptr<CDirectoryLis
 				m_pFilelistStatusBar->AddFile(entry.size);
 		}
 
-		// Find correct position in index mapping
-		std::vector<unsigned int>::iterator start = m_indexMapping.begin();
-		if (m_hasParent)
-			++start;
-		CFileListCtrl<CGenericFileData>::CSortComparisonObject compare = GetSortComparisonObject();
-		std::vector<unsigned int>::iterator insertPos = std::lower_bound(start, m_indexMapping.end(), i, compare);
-		compare.Destroy();
+		added.push_back(i);
+	}
 
-		const int item = insertPos - m_indexMapping.begin();
-		m_indexMapping.insert(insertPos, i);
+	m_fileData.push_back(last);
 
-		for (auto iter = added.begin(); iter != added.end(); ++iter)
-		{
-			unsigned int &pos = *iter;
-			if (pos >= (unsigned int)item)
-				pos++;
-		}
-		added.push_back(item);
+	if (added.empty())
+	{
+		if (m_pFilelistStatusBar)
+			m_pFilelistStatusBar->SetHidden(m_pDirectoryListing->GetCount() + 1 - m_indexMapping.size());
+		return;
 	}
 
-	m_fileData.push_back(last);
+	// The existing mapping is already sorted. Sort only the new items and
+	// look up their positions, then merge both in a single pass.
+	std::vector<unsigned int>::iterator start = m_indexMapping.begin();
+	if (m_hasParent)
+		++start;
+	CFileListCtrl<CGenericFileData>::CSortComparisonObject compare = GetSortComparisonObject();
+	std::sort(added.begin(), added.end(), compare);
 
-	std::list<bool> selected;
-	unsigned int start;
-	added.push_back(m_indexMapping.size());
-	start = added.front();
+	std::vector<unsigned int> insertPos;
+	insertPos.reserve(added.size());
+	for (auto const& index : added)
+	{
+		start = std::lower_bound(start, m_indexMapping.end(), index, compare);
+		insertPos.push_back(start - m_indexMapping.begin());
+	}
+	compare.Destroy();
+
+	std::vector<unsigned int> indexMapping;
+	indexMapping.reserve(m_indexMapping.size() + added.size());
+	unsigned int copied = 0;
+	for (unsigned int k = 0; k < added.size(); k++)
+	{
+		indexMapping.insert(indexMapping.end(), m_indexMapping.begin() + copied, m_indexMapping.begin() + insertPos[k]);
+		indexMapping.push_back(added[k]);
+		copied = insertPos[k];
+
+		// From now on the item number of the new entry
+		insertPos[k] += k;
+	}
+	indexMapping.insert(indexMapping.end(), m_indexMapping.begin() + copied, m_indexMapping.end());
+	m_indexMapping.swap(indexMapping);
 
 	SetItemCount(m_indexMapping.size());
 
-	for (unsigned int i = start; i < m_indexMapping.size(); i++)
+	// Items after the first insertion move down, so do their selections
+	std::list<bool> selected;
+	unsigned int next = 0;
+	for (unsigned int i = insertPos.front(); i < m_indexMapping.size(); i++)
 	{
-		if (i == added.front())
+		if (next < insertPos.size() && i == insertPos[next])
 		{
 			selected.push_front(false);
-			added.pop_front();
+			next++;
 		}
 		bool is_selected = GetItemState(i, wxLIST_STATE_SELECTED) != 0;
 		selected.push_back(is_selected);
@@ -545,7 +589,7 @@ void CRemoteListView::UpdateDirectoryListing_Removed(std::shared_ptr<CDirectoryL
 	}
 	wxASSERT(!IsComparing());
 
-	std::list<unsigned int> removedItems;
+	std::vector<unsigned int> removedItems;
 
 	// Get indexes of the removed items in the listing
 	unsigned int j = 0;
@@ -574,29 +618,22 @@ void CRemoteListView::UpdateDirectoryListing_Removed(std::shared_ptr<CDirectoryL
 	// Number of items left to remove
 	unsigned int toRemove = removed;
 
-	std::list<int> removedIndexes;
+	std::vector<unsigned int> removedIndexes;
 
 	const int size = m_indexMapping.size();
 	for (int i = size - 1; i >= 0; i--)
 	{
-		bool removed = false;
-
 		unsigned int& index = m_indexMapping[i];
 
 		// j is the offset the index has to be adjusted
-		int j = 0;
-		for (std::list<unsigned int>::const_iterator iter = removedItems.begin(); iter != removedItems.end(); ++iter, ++j)
-		{
-			if (*iter > index)
-				break;
+		std::vector<unsigned int>::const_iterator iter = std::lower_bound(removedItems.cbegin(), removedItems.cend(), index);
+		const int j = iter - removedItems.cbegin();
 
-			if (*iter == index)
-			{
-				removedIndexes.push_back(i);
-				removed = true;
-				toRemove--;
-				break;
-			}
+		const bool removed = iter != removedItems.cend() && *iter == index;
+		if (removed)
+		{
+			removedIndexes.push_back(i);
+			toRemove--;
 		}
 
 		// Get old selection
@@ -647,18 +684,13 @@ void CRemoteListView::UpdateDirectoryListing_Removed(std::shared_ptr<CDirectoryL
 	}
 
 	// Erase file data
-	for (std::list<unsigned int>::reverse_iterator iter = removedItems.rbegin(); iter != removedItems.rend(); ++iter)
-	{
-		m_fileData.erase(m_fileData.begin() + *iter);
-	}
+	EraseSortedIndexes(m_fileData, removedItems);
 
 	// Erase indexes
 	wxASSERT(!toRemove);
 	wxASSERT(removedIndexes.size() == removed);
-	for (auto iter = removedIndexes.begin(); iter != removedIndexes.end(); ++iter)
-	{
-		m_indexMapping.erase(m_indexMapping.begin() + *iter);
-	}
+	std::reverse(removedIndexes.begin(), removedIndexes.end());
+	EraseSortedIndexes(m_indexMapping, removedIndexes);
 
 	wxASSERT(m_indexMapping.size() == pDirectoryListing->GetCount() + 1);
 
@@ -792,11 +824,13 @@ void CRemoteListView::SetDirectoryListing(std::shared_ptr<CDirectoryListing> con
 		m_indexMapping.push_back(m_pDirectoryListing->GetCount());
 
 		const wxString path = m_pDirectoryListing->path.GetPath();
+		const CDirectoryListing& listing = *m_pDirectoryListing;
+		const unsigned int count = listing.GetCount();
 
-		CFilterManager filter;
-		for (unsigned int i = 0; i < m_pDirectoryListing->GetCount(); i++)
+		m_fileData.reserve(count + 1);
+		for (unsigned int i = 0; i < count; i++)
 		{
-			const CDirentry& entry = (*m_pDirectoryListing)[i];
+			const CDirentry& entry = listing[i];
 			CGenericFileData data;
 			if (entry.is_dir())
 			{
@@ -807,13 +841,19 @@ void CRemoteListView::SetDirectoryListing(std::shared_ptr<CDirectoryListing> con
 #endif
 			}
 			m_fileData.push_back(data);
+		}
 
-			if (filter.FilenameFiltered(entry.name, path, entry.is_dir(), entry.size, false, 0, entry.time))
-			{
-				hidden++;
-				continue;
-			}
+		// Huge listings get filtered on all cores
+		CFilterManager filter;
+		ParallelFilter(m_indexMapping, 0, count, CFilterManager::CanFilterConcurrently(false), [&](unsigned int i) {
+			const CDirentry& entry = listing[i];
+			return !filter.FilenameFiltered(entry.name, path, entry.is_dir(), entry.size, false, 0, entry.time);
+		});
+		hidden = count - (m_indexMapping.size() - 1);
 
+		for (unsigned int i = 1; i < m_indexMapping.size(); i++)
+		{
+			const CDirentry& entry = listing[m_indexMapping[i]];
 			if (entry.is_dir())
 				totalDirCount++;
 			else
@@ -824,8 +864,6 @@ void CRemoteListView::SetDirectoryListing(std::shared_ptr<CDirectoryListing> con
 					totalSize += entry.size;
 				totalFileCount++;
 			}
-
-			m_indexMapping.push_back(i);
 		}
 
 		CGenericFileData data;
@@ -1848,18 +1886,20 @@ void CRemoteListView::ApplyCurrentFilter()
 
 	const wxString path = m_pDirectoryListing->path.GetPath();
 
+	const CDirectoryListing& listing = *m_pDirectoryListing;
+	const unsigned int count = listing.GetCount();
+
 	m_indexMapping.clear();
-	const unsigned int count = m_pDirectoryListing->GetCount();
 	m_indexMapping.push_back(count);
-	for (unsigned int i = 0; i < count; i++)
-	{
-		const CDirentry& entry = (*m_pDirectoryListing)[i];
-		if (filter.FilenameFiltered(entry.name, path, entry.is_dir(), entry.size, false, 0, entry.time))
-		{
-			hidden++;
-			continue;
-		}
+	ParallelFilter(m_indexMapping, 0, count, CFilterManager::CanFilterConcurrently(false), [&](unsigned int i) {
+		const CDirentry& entry = listing[i];
+		return !filter.FilenameFiltered(entry.name, path, entry.is_dir(), entry.size, false, 0, entry.time);
+	});
+	hidden = count - (m_indexMapping.size() - 1);
 
+	for (unsigned int i = 1; i < m_indexMapping.size(); i++)
+	{
+		const CDirentry& entry = listing[m_indexMapping[i]];
 		if (entry.is_dir())
 			totalDirCount++;
 		else
@@ -1870,8 +1910,6 @@ void CRemoteListView::ApplyCurrentFilter()
 				totalSize += entry.size;
 			totalFileCount++;
 		}
-
-		m_indexMapping.push_back(i);
 	}
 
 	if (m_pFilelistStatusBar)
@@ -0,0 +1,220 @@
+#include <filezilla.h>
+#include "comparison_engine.h"
+
+#include <unordered_map>
+
+CComparisonEngine::CComparisonEngine(bool compareSizes, bool compareDates, wxTimeSpan const& threshold)
+	: m_compareSizes(compareSizes)
+	, m_compareDates(compareDates)
+	, m_threshold(threshold)
+{
+}
+
+wxString CComparisonEngine::MakeKey(wxString const& name)
+{
+#ifdef __WXMSW__
+	return name.Lower();
+#else
+	return name;
+#endif
+}
+
+void CComparisonEngine::CompareEntries(CComparisonEntry const& left, CComparisonEntry const& right, row& r) const
+{
+	r.leftFlags = r.rightFlags = normal;
+	r.identical = true;
+
+	if (m_compareDates) {
+		if (!left.date.IsValid() || !right.date.IsValid()) {
+			r.identical = !left.date.IsValid() && !right.date.IsValid();
+		}
+		else {
+			CDateTime leftDate = left.date;
+			CDateTime rightDate = right.date;
+
+			int cmp = leftDate.Compare(rightDate);
+			if (cmp < 0)
+				leftDate += m_threshold;
+			else if (cmp > 0)
+				rightDate += m_threshold;
+			int const cmp2 = leftDate.Compare(rightDate);
+			if (cmp && cmp == -cmp2)
+				cmp = 0;
+
+			if (cmp < 0)
+				r.rightFlags = newer;
+			else if (cmp > 0)
+				r.leftFlags = newer;
+			r.identical = !cmp;
+		}
+	}
+
+	if (m_compareSizes && !left.dir && left.size != right.size) {
+		if (r.leftFlags == normal && r.rightFlags == normal)
+			r.leftFlags = r.rightFlags = different;
+		r.identical = false;
+	}
+}
+
+std::vector<CComparisonEngine::row> CComparisonEngine::Compare(std::vector<CComparisonEntry> const& left, std::vector<CComparisonEntry> const& right,
+	std::function<bool(CComparisonEntry const&, CComparisonEntry const&)> const& less) const
+{
+	// Index the right side. A directory and a file of the same name are
+	// different entries. If names are not unique, only the first one is paired.
+	std::unordered_map<wxString, int, wxStringHash> files, dirs;
+	files.reserve(right.size());
+	for (size_t i = 0; i < right.size(); ++i) {
+		auto& index = right[i].dir ? dirs : files;
+		index.emplace(MakeKey(right[i].name), static_cast<int>(i));
+	}
+
+	std::vector<int> matches(left.size(), -1);
+	std::vector<bool> matched(right.size());
+	for (size_t i = 0; i < left.size(); ++i) {
+		auto const& index = left[i].dir ? dirs : files;
+		auto const it = index.find(MakeKey(left[i].name));
+		if (it != index.end() && !matched[it->second]) {
+			matches[i] = it->second;
+			matched[it->second] = true;
+		}
+	}
+
+	std::vector<row> rows;
+	rows.reserve(left.size() + right.size());
+
+	// Entries only on one side which are waiting for the next pair of entries
+	std::vector<int> lonelyLeft;
+	size_t nextRight = 0;
+
+	auto addLonely = [&](size_t rightEnd) {
+		std::vector<int> lonelyRight;
+		for (; nextRight < rightEnd; ++nextRight) {
+			if (!matched[nextRight])
+				lonelyRight.push_back(static_cast<int>(nextRight));
+		}
+
+		auto l = lonelyLeft.cbegin();
+		auto r = lonelyRight.cbegin();
+		while (l != lonelyLeft.cend() || r != lonelyRight.cend()) {
+			row lonelyRow;
+			if (r == lonelyRight.cend() || (l != lonelyLeft.cend() && (!less || !less(right[*r], left[*l])))) {
+				lonelyRow.left = *l++;
+				lonelyRow.leftFlags = lonely;
+			}
+			else {
+				lonelyRow.right = *r++;
+				lonelyRow.rightFlags = lonely;
+			}
+			rows.push_back(lonelyRow);
+		}
+		lonelyLeft.clear();
+	};
+
+	for (size_t i = 0; i < left.size(); ++i) {
+		int const j = matches[i];
+		if (j == -1) {
+			lonelyLeft.push_back(static_cast<int>(i));
+			continue;
+		}
+
+		// If both sides are sorted differently, j may lie before entries
+		// already placed. Nothing to catch up on in that case.
+		addLonely(std::max(nextRight, static_cast<size_t>(j) + 1));
+
+		row r;
+		r.left = static_cast<int>(i);
+		r.right = j;
+		CompareEntries(left[i], right[j], r);
+		rows.push_back(r);
+	}
+	addLonely(right.size());
+
+	return rows;
+}
+
+std::vector<CComparisonEngine::difference> CComparisonEngine::CompareTrees(tree const& left, tree const& right,
+	unknown_dirs const& leftUnknown, unknown_dirs const& rightUnknown) const
+{
+	std::vector<difference> differences;
+	CompareTree(left, right, leftUnknown, rightUnknown, wxString(), wxString(), differences);
+	return differences;
+}
+
+void CComparisonEngine::CompareTree(tree const& left, tree const& right, unknown_dirs const& leftUnknown, unknown_dirs const& rightUnknown,
+	wxString const& leftPath, wxString const& rightPath, std::vector<difference>& differences) const
+{
+	static std::vector<CComparisonEntry> const empty;
+
+	if (leftUnknown.find(leftPath) != leftUnknown.end() || rightUnknown.find(rightPath) != rightUnknown.end())
+		return;
+
+	auto const leftIt = left.find(leftPath);
+	auto const rightIt = right.find(rightPath);
+	auto const& leftEntries = (leftIt != left.end()) ? leftIt->second : empty;
+	auto const& rightEntries = (rightIt != right.end()) ? rightIt->second : empty;
+
+	for (auto const& r : Compare(leftEntries, rightEntries)) {
+		if (r.right == -1) {
+			AddLonely(left, leftUnknown, leftPath, rightPath, leftEntries, r.left, true, differences);
+			continue;
+		}
+		if (r.left == -1) {
+			AddLonely(right, rightUnknown, rightPath, leftPath, rightEntries, r.right, false, differences);
+			continue;
+		}
+
+		auto const& leftEntry = leftEntries[r.left];
+		auto const& rightEntry = rightEntries[r.right];
+		if (leftEntry.dir) {
+			CompareTree(left, right, leftUnknown, rightUnknown, leftPath + leftEntry.name + _T("/"), rightPath + rightEntry.name + _T("/"), differences);
+			continue;
+		}
+
+		if (!r.identical) {
+			difference d;
+			d.leftPath = leftPath;
+			d.rightPath = rightPath;
+			d.r = r;
+			d.left = &leftEntry;
+			d.right = &rightEntry;
+			differences.push_back(d);
+		}
+	}
+}
+
+void CComparisonEngine::AddLonely(tree const& t, unknown_dirs const& unknown, wxString const& path, wxString const& otherPath,
+	std::vector<CComparisonEntry> const& entries, int index, bool isLeft, std::vector<difference>& differences) const
+{
+	CComparisonEntry const& entry = entries[index];
+
+	wxString const subdir = path + entry.name + _T("/");
+	if (entry.dir && unknown.find(subdir) != unknown.end())
+		return;
+
+	difference d;
+	d.leftPath = isLeft ? path : otherPath;
+	d.rightPath = isLeft ? otherPath : path;
+	if (isLeft) {
+		d.left = &entry;
+		d.r.left = index;
+		d.r.leftFlags = lonely;
+	}
+	else {
+		d.right = &entry;
+		d.r.right = index;
+		d.r.rightFlags = lonely;
+	}
+	differences.push_back(d);
+
+	if (!entry.dir)
+		return;
+
+	wxString const otherSubdir = otherPath + entry.name + _T("/");
+
+	auto const it = t.find(subdir);
+	if (it == t.end())
+		return;
+
+	for (size_t i = 0; i < it->second.size(); ++i)
+		AddLonely(t, unknown, subdir, otherSubdir, it->second, static_cast<int>(i), isLeft, differences);
+}
@@ -0,0 +1,103 @@
+#ifndef __COMPARISON_ENGINE_H__
+#define __COMPARISON_ENGINE_H__
+
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+
+// Compares directory listings by looking up the entries of one side by name
+// in a hash table. Unlike a merge walk this works in linear time no matter
+// how either side is sorted.
+//
+// It doesn't touch any global state, so it can be used from any thread.
+
+struct CComparisonEntry final
+{
+	wxString name;
+	bool dir{};
+	wxLongLong size{-1};
+	CDateTime date;
+};
+
+class CComparisonEngine final
+{
+public:
+	enum t_flags
+	{
+		normal,
+		different, // Sizes differ, dates don't
+		newer,
+		lonely
+	};
+
+	// One row of a comparison. Entries existing on both sides share a row,
+	// the index of a missing entry is -1.
+	struct row final
+	{
+		int left{-1};
+		int right{-1};
+		t_flags leftFlags{normal};
+		t_flags rightFlags{normal};
+
+		// False if there is something to look at
+		bool identical{};
+	};
+
+	// Files are compared by size, date or both. Dates within threshold of
+	// each other count as the same.
+	CComparisonEngine(bool compareSizes, bool compareDates, wxTimeSpan const& threshold);
+
+	// Returns the rows in the order of left, entries only on the right side are
+	// placed next to their neighbours on the right side. If given, less is used
+	// to order entries from both sides falling between the same two rows.
+	std::vector<row> Compare(std::vector<CComparisonEntry> const& left, std::vector<CComparisonEntry> const& right,
+		std::function<bool(CComparisonEntry const&, CComparisonEntry const&)> const& less = nullptr) const;
+
+	// A directory tree, as lists of entries by path relative to the root.
+	// The root is the empty string, subdirectories are their parent's path
+	// followed by their name and a slash. Neither . nor .. may be listed.
+	typedef std::map<wxString, std::vector<CComparisonEntry>> tree;
+
+	// Paths as in tree of directories which could not be listed
+	typedef std::set<wxString> unknown_dirs;
+
+	struct difference final
+	{
+		// Of the containing directory on either side, as in tree. They only
+		// differ if names differ in case.
+		wxString leftPath;
+		wxString rightPath;
+
+		row r; // Indexes are into the lists of the containing directories
+		CComparisonEntry const* left{};
+		CComparisonEntry const* right{};
+	};
+
+	// Compares both trees recursively and returns everything but identical
+	// entries. Directories existing only on one side are reported together with
+	// their contents. The differences point into left and right, which must
+	// outlive them.
+	//
+	// Nothing is reported in or below directories unknown on either side,
+	// their missing contents would otherwise look like empty directories.
+	std::vector<difference> CompareTrees(tree const& left, tree const& right,
+		unknown_dirs const& leftUnknown = unknown_dirs(), unknown_dirs const& rightUnknown = unknown_dirs()) const;
+
+protected:
+	// Case-insensitive on MSW
+	static wxString MakeKey(wxString const& name);
+
+	void CompareEntries(CComparisonEntry const& left, CComparisonEntry const& right, row& r) const;
+
+	void CompareTree(tree const& left, tree const& right, unknown_dirs const& leftUnknown, unknown_dirs const& rightUnknown,
+		wxString const& leftPath, wxString const& rightPath, std::vector<difference>& differences) const;
+	void AddLonely(tree const& t, unknown_dirs const& unknown, wxString const& path, wxString const& otherPath,
+		std::vector<CComparisonEntry> const& entries, int index, bool isLeft, std::vector<difference>& differences) const;
+
+	bool const m_compareSizes;
+	bool const m_compareDates;
+	wxTimeSpan const m_threshold;
+};
+
+#endif //__COMPARISON_ENGINE_H__
@@ -1,6 +1,8 @@
 #ifndef __DIALOGEX_H__
 #define __DIALOGEX_H__
 
+#include <wx/dialog.h>
+
 #include "wrapengine.h"
 
 class wxDialogEx : public wxDialog, public CWrapEngine
@@ -0,0 +1,42 @@
+#ifndef __DOWNLOAD_SEGMENT_H__
+#define __DOWNLOAD_SEGMENT_H__
+
+// Part of a download split across several connections, each of the queue
+// items downloads its own part of the file.
+class CDownloadSegment final
+{
+public:
+	CDownloadSegment(wxLongLong segmentStart, wxLongLong segmentEnd)
+		: start(segmentStart)
+		, end(segmentEnd)
+	{}
+
+	// The server sends the whole file instead of the requested range if the
+	// transfer size differs from the segment size. Only possible for the
+	// first segment, the others get refused.
+	bool GetsWholeFile(wxLongLong totalSize) const { return totalSize != end - start; }
+
+	// The other segments found out that the server ignores Range requests
+	// while this one was already transferring.
+	void Merge(wxLongLong size)
+	{
+		if (size > wholeSize)
+			wholeSize = size;
+	}
+
+	// Set by Merge, the rest of the file still has to be downloaded once
+	// done with the own part.
+	bool Merged() const { return wholeSize > 0; }
+
+	// Of the whole file as far as known
+	wxLongLong FileSize() const { return (wholeSize > end) ? wholeSize : end; }
+
+	wxLongLong start; // Offset of the next byte to download
+	wxLongLong end; // Offset after the last byte of the segment
+	wxLongLong done{}; // Downloaded so far by the current attempt
+
+protected:
+	wxLongLong wholeSize{};
+};
+
+#endif //__DOWNLOAD_SEGMENT_H__
@@ -362,7 +362,10 @@ template<class CFileData> void CFileListCtrl<CFileData>::SortList(int column /*=
 	if (m_hasParent)
 		++start;
 	CSortComparisonObject object = GetSortComparisonObject();
-	std::sort(start, m_indexMapping.end(), object);
+	if (m_indexMapping.end() - start >= PARALLEL_SORT_MIN && object.PrepareConcurrentUse(start, m_indexMapping.end()))
+		ParallelSort(start, m_indexMapping.end(), object);
+	else
+		std::sort(start, m_indexMapping.end(), object);
 	object.Destroy();
 
 	if (updateSelections)
@@ -625,7 +628,7 @@ template<class CFileData> void CFileListCtrl<CFileData>::OnExitComparisonMode()
 	RefreshListOnly();
 }
 
-template<class CFileData> void CFileListCtrl<CFileData>::CompareAddFile(t_fileEntryFlags flags)
+template<class CFileData> void CFileListCtrl<CFileData>::CompareAddFile(t_fileEntryFlags flags, int item)
 {
 	if (flags == fill)
 	{
@@ -633,7 +636,7 @@ template<class CFileData> void CFileListCtrl<CFileData>::CompareAddFile(t_fileEn
 		return;
 	}
 
-	int index = m_originalIndexMapping[m_comparisonIndex];
+	int index = m_originalIndexMapping[item];
 	m_fileData[index].comparison_flags = flags;
 
 	m_indexMapping.push_back(index);
@@ -4,8 +4,11 @@
 #include "listctrlex.h"
 #include "systemimagelist.h"
 #include "listingcomparison.h"
+#include "parallel.h"
 
+#include <algorithm>
 #include <memory>
+#include <string>
 
 class CQueueView;
 class CFileListCtrl_SortComparisonObject;
@@ -45,6 +48,11 @@ public:
 	virtual bool operator()(int a, int b) const = 0;
 	virtual ~CFileListCtrlSortBase() {} // Without this empty destructor GCC complains
 
+	// Does all the lazy work for the given indexes up front, afterwards
+	// operator() can be called from multiple threads at once.
+	// Returns false if that is not supported.
+	virtual bool PrepareConcurrentUse(std::vector<unsigned int>::const_iterator, std::vector<unsigned int>::const_iterator) { return false; }
+
 	#define CMP(f, data1, data2) \
 		{\
 			int res = this->f(data1, data2);\
@@ -122,6 +130,65 @@ public:
 		return res;         //same length, compare first different digit in the sequence
 	}
 
+	// Builds a key for the name that, using plain lexicographical comparison,
+	// sorts like the comparison function of the given mode. Names only
+	// differing in case get the same key, use CmpCase to break the tie.
+	// In natural mode, leading zeros only get compared after the rest of
+	// the name. Unlike CmpNatural, the keys always form a strict weak order.
+	static std::wstring MakeSortKey(wxString const& name, NameSortMode mode)
+	{
+		std::wstring key;
+		key.reserve(name.size());
+
+		switch (mode)
+		{
+		case namesort_casesensitive:
+			for (auto const& c : name)
+				key += static_cast<wchar_t>(c.GetValue());
+			break;
+		default:
+		case namesort_caseinsensitive:
+			for (auto const& c : name)
+				key += static_cast<wchar_t>(wxTolower(c));
+			break;
+		case namesort_natural:
+			{
+				// Each run of digits becomes '0', the number of significant
+				// digits and the significant digits. '0' sorts the same
+				// against any non-digit as all the other digits do.
+				std::wstring zeros;
+				wxString::const_iterator it = name.begin();
+				while (it != name.end()) {
+					if (!wxIsdigit(*it)) {
+						key += static_cast<wchar_t>(wxTolower(*it));
+						++it;
+						continue;
+					}
+
+					int zeroCount = 0;
+					for (; *it == '0' && it + 1 != name.end() && wxIsdigit(*(it + 1)); ++it)
+						++zeroCount;
+
+					wxString::const_iterator const digits = it;
+					for (; it != name.end() && wxIsdigit(*it); ++it);
+
+					key += '0';
+					key += static_cast<wchar_t>(it - digits);
+					for (wxString::const_iterator d = digits; d != it; ++d)
+						key += static_cast<wchar_t>((*d).GetValue());
+					zeros += static_cast<wchar_t>(zeroCount + 1);
+				}
+				if (!zeros.empty()) {
+					key += static_cast<wchar_t>(0);
+					key += zeros;
+				}
+			}
+			break;
+		}
+
+		return key;
+	}
+
 	typedef int (* CompareFunction)(const wxString&, const wxString&);
 	static CompareFunction GetCmpFunction(NameSortMode mode)
 	{
@@ -189,20 +256,57 @@ public:
 		}
 	}
 
-	inline int CmpName(const value_type &data1, const value_type &data2) const
+	virtual bool PrepareConcurrentUse(std::vector<unsigned int>::const_iterator first, std::vector<unsigned int>::const_iterator last)
 	{
-		switch (m_nameSortMode)
-		{
-		case namesort_casesensitive:
-			return CmpCase(data1.name, data2.name);
+		if (m_nameSortMode != namesort_casesensitive && first != last) {
+			size_t const needed = static_cast<size_t>(*std::max_element(first, last)) + 1;
+			if (m_nameKeys.size() < needed)
+				m_nameKeys.resize(needed);
+
+			// Each index has its own key, so they can be built concurrently
+			size_t const count = last - first;
+			unsigned int const tasks = GetParallelTaskCount(count, PARALLEL_FILTER_MIN);
+			RunParallel(tasks, [&](unsigned int task) {
+				auto const end = first + GetParallelTaskStart(count, tasks, task + 1);
+				for (auto it = first + GetParallelTaskStart(count, tasks, task); it != end; ++it) {
+					std::wstring& key = m_nameKeys[*it];
+					if (key.empty())
+						key = MakeSortKey(m_listing[*it].name, m_nameSortMode);
+				}
+			});
+		}
 
-		default:
-		case namesort_caseinsensitive:
-			return CmpNoCase(data1.name, data2.name);
+		m_concurrent = true;
+		return true;
+	}
 
-		case namesort_natural:
-			return CmpNatural(data1.name, data2.name);
+	inline int CmpName(int a, int b) const
+	{
+		wxString const& name1 = m_listing[a].name;
+		wxString const& name2 = m_listing[b].name;
+
+		if (m_nameSortMode == namesort_casesensitive)
+			return CmpCase(name1, name2);
+
+		// Folding case and scanning for numbers on each comparison is
+		// expensive, so it's done only once per entry.
+		if (!m_concurrent) {
+			size_t const needed = static_cast<size_t>(std::max(a, b)) + 1;
+			if (m_nameKeys.size() < needed)
+				m_nameKeys.resize(needed);
+
+			std::wstring& key1 = m_nameKeys[a];
+			if (key1.empty())
+				key1 = MakeSortKey(name1, m_nameSortMode);
+			std::wstring& key2 = m_nameKeys[b];
+			if (key2.empty())
+				key2 = MakeSortKey(name2, m_nameSortMode);
 		}
+
+		int res = m_nameKeys[a].compare(m_nameKeys[b]);
+		if (!res)
+			res = CmpCase(name1, name2);
+		return res;
 	}
 
 	inline int CmpSize(const value_type &data1, const value_type &data2) const
@@ -239,6 +343,12 @@ protected:
 
 	const enum DirSortMode m_dirSortMode;
 	const enum NameSortMode m_nameSortMode;
+
+	// Indexed like the listing, filled in on demand
+	mutable std::vector<std::wstring> m_nameKeys;
+
+	// Set by PrepareConcurrentUse, nothing may be filled in on demand anymore
+	bool m_concurrent{};
 };
 
 template<class CFileData> class CFileListCtrl;
@@ -273,7 +383,7 @@ public:
 
 		CMP(CmpDir, data1, data2);
 
-		CMP_LESS(CmpName, data1, data2);
+		CMP_LESS(CmpName, a, b);
 	}
 };
 
@@ -295,7 +405,7 @@ public:
 
 		CMP(CmpSize, data1, data2);
 
-		CMP_LESS(CmpName, data1, data2);
+		CMP_LESS(CmpName, a, b);
 	}
 };
 
@@ -308,6 +418,18 @@ public:
 	{
 	}
 
+	virtual bool PrepareConcurrentUse(std::vector<unsigned int>::const_iterator first, std::vector<unsigned int>::const_iterator last)
+	{
+		// GetType uses a cache and is not thread-safe
+		for (auto it = first; it != last; ++it) {
+			DataEntry &type = m_fileData[*it];
+			if (type.fileType.empty())
+				type.fileType = m_pListView->GetType(this->m_listing[*it].name, this->m_listing[*it].is_dir());
+		}
+
+		return CFileListCtrlSort<Listing>::PrepareConcurrentUse(first, last);
+	}
+
 	bool operator()(int a, int b) const
 	{
 		typename Listing::value_type const& data1 = this->m_listing[a];
@@ -317,14 +439,16 @@ public:
 
 		DataEntry &type1 = m_fileData[a];
 		DataEntry &type2 = m_fileData[b];
-		if (type1.fileType.empty())
-			type1.fileType = m_pListView->GetType(data1.name, data1.is_dir());
-		if (type2.fileType.empty())
-			type2.fileType = m_pListView->GetType(data2.name, data2.is_dir());
+		if (!this->m_concurrent) {
+			if (type1.fileType.empty())
+				type1.fileType = m_pListView->GetType(data1.name, data1.is_dir());
+			if (type2.fileType.empty())
+				type2.fileType = m_pListView->GetType(data2.name, data2.is_dir());
+		}
 
 		CMP(CmpStringNoCase, type1.fileType, type2.fileType);
 
-		CMP_LESS(CmpName, data1, data2);
+		CMP_LESS(CmpName, a, b);
 	}
 
 protected:
@@ -350,7 +474,7 @@ public:
 
 		CMP(CmpTime, data1, data2);
 
-		CMP_LESS(CmpName, data1, data2);
+		CMP_LESS(CmpName, a, b);
 	}
 };
 
@@ -372,7 +496,7 @@ public:
 
 		CMP(CmpStringNoCase, *data1.permissions, *data2.permissions);
 
-		CMP_LESS(CmpName, data1, data2);
+		CMP_LESS(CmpName, a, b);
 	}
 };
 
@@ -394,7 +518,7 @@ public:
 
 		CMP(CmpStringNoCase, *data1.ownerGroup, *data2.ownerGroup);
 
-		CMP_LESS(CmpName, data1, data2);
+		CMP_LESS(CmpName, a, b);
 	}
 };
 
@@ -410,15 +534,12 @@ public:
 
 	bool operator()(int a, int b) const
 	{
-		typename Listing::value_type const& data1 = this->m_listing[a];
-		typename Listing::value_type const& data2 = this->m_listing[b];
-
 		if (this->m_listing[a].path < m_fileData[b].path)
 			return true;
 		if (this->m_listing[a].path != m_fileData[b].path)
 			return false;
 
-		CMP_LESS(CmpName, data1, data2);
+		CMP_LESS(CmpName, a, b);
 	}
 	std::vector<DataEntry>& m_fileData;
 };
@@ -454,6 +575,11 @@ public:
 		{
 			return m_pObject->operator ()(a, b);
 		}
+
+		bool PrepareConcurrentUse(std::vector<unsigned int>::const_iterator first, std::vector<unsigned int>::const_iterator last)
+		{
+			return m_pObject->PrepareConcurrentUse(first, last);
+		}
 	protected:
 		CFileListCtrlSortBase* m_pObject;
 	};
@@ -496,7 +622,7 @@ protected:
 	virtual void ScrollTopItem(int item);
 	virtual void OnPostScroll();
 	virtual void OnExitComparisonMode();
-	virtual void CompareAddFile(t_fileEntryFlags flags);
+	virtual void CompareAddFile(t_fileEntryFlags flags, int item);
 
 	int m_comparisonIndex;
 
@@ -1,5 +1,6 @@
 #include <filezilla.h>
 #include "filter.h"
+#include "filter_matcher.h"
 #include "filteredit.h"
 #include "filezillaapp.h"
 #include "inputdialog.h"
@@ -17,6 +18,9 @@ std::vector<CFilter> CFilterManager::m_globalFilters;
 std::vector<CFilterSet> CFilterManager::m_globalFilterSets;
 unsigned int CFilterManager::m_globalCurrentFilterSet = 0;
 bool CFilterManager::m_filters_disabled = false;
+CFilterMatcher CFilterManager::m_localMatcher;
+CFilterMatcher CFilterManager::m_remoteMatcher;
+bool CFilterManager::m_matchersCompiled = false;
 
 BEGIN_EVENT_TABLE(CFilterDialog, wxDialogEx)
 EVT_BUTTON(XRCID("wxID_OK"), CFilterDialog::OnOkOrApply)
@@ -35,28 +39,6 @@ EVT_BUTTON(XRCID("ID_REMOTE_ENABLEALL"), CFilterDialog::OnChangeAll)
 EVT_BUTTON(XRCID("ID_REMOTE_DISABLEALL"), CFilterDialog::OnChangeAll)
 END_EVENT_TABLE()
 
-CFilterCondition::CFilterCondition()
-{
-	type = filter_name;
-	condition = 0;
-	matchCase = true;
-	value = 0;
-}
-
-CFilter::CFilter()
-{
-	matchType = all;
-	filterDirs = true;
-	filterFiles = true;
-
-	// Filenames on Windows ignore case
-#ifdef __WXMSW__
-	matchCase = false;
-#else
-	matchCase = true;
-#endif
-}
-
 bool CFilter::HasConditionOfType(enum t_filterType type) const
 {
 	for (std::vector<CFilterCondition>::const_iterator iter = filters.begin(); iter != filters.end(); ++iter)
@@ -115,6 +97,7 @@ void CFilterDialog::OnOkOrApply(wxCommandEvent& event)
 	CompileRegexes();
 	m_globalFilterSets = m_filterSets;
 	m_globalCurrentFilterSet = m_currentFilterSet;
+	CompileMatchers();
 
 	SaveFilters();
 
@@ -524,6 +507,9 @@ CFilterManager::CFilterManager()
 
 		m_globalFilterSets.push_back(set);
 	}
+
+	if (!m_matchersCompiled)
+		CompileMatchers();
 }
 
 bool CFilterManager::HasActiveFilters(bool ignore_disabled /*=false*/)
@@ -551,297 +537,81 @@ bool CFilterManager::HasActiveFilters(bool ignore_disabled /*=false*/)
 	return false;
 }
 
-bool CFilterManager::HasSameLocalAndRemoteFilters() const
+bool CFilterManager::CanFilterConcurrently(bool local)
 {
-	const CFilterSet& set = m_globalFilterSets[m_globalCurrentFilterSet];
-	for (unsigned int i = 0; i < m_globalFilters.size(); i++)
-	{
-		if (set.local[i])
-		{
-			if (!set.remote[i])
-				return false;
-		}
-		else if (set.remote[i])
-			return false;
-	}
+	if (m_filters_disabled)
+		return true;
 
-	return true;
+	if (!m_matchersCompiled)
+		return false;
+
+	return !(local ? m_localMatcher : m_remoteMatcher).HasRegexes();
 }
 
-bool CFilterManager::FilenameFiltered(const wxString& name, const wxString& path, bool dir, wxLongLong size, bool local, int attributes, CDateTime const& date) const
+bool CFilterManager::FiltersUseMetadata(bool local)
 {
 	if (m_filters_disabled)
 		return false;
 
-	wxASSERT(m_globalCurrentFilterSet < m_globalFilterSets.size());
+	if (!m_matchersCompiled)
+		return true;
 
-	const CFilterSet& set = m_globalFilterSets[m_globalCurrentFilterSet];
+	return (local ? m_localMatcher : m_remoteMatcher).UsesMetadata();
+}
 
-	// Check active filters
-	for (unsigned int i = 0; i < m_globalFilters.size(); ++i) {
-		if (local) {
+void CFilterManager::CompileMatchers()
+{
+	std::vector<CFilter> local;
+	std::vector<CFilter> remote;
+
+	if (!m_globalFilterSets.empty()) {
+		wxASSERT(m_globalCurrentFilterSet < m_globalFilterSets.size());
+
+		const CFilterSet& set = m_globalFilterSets[m_globalCurrentFilterSet];
+		for (unsigned int i = 0; i < m_globalFilters.size(); ++i) {
 			if (set.local[i])
-				if (FilenameFilteredByFilter(m_globalFilters[i], name, path, dir, size, attributes, date))
-					return true;
-		}
-		else {
+				local.push_back(m_globalFilters[i]);
 			if (set.remote[i])
-				if (FilenameFilteredByFilter(m_globalFilters[i], name, path, dir, size, attributes, date))
-					return true;
+				remote.push_back(m_globalFilters[i]);
 		}
 	}
 
-	return false;
+	m_localMatcher = CFilterMatcher(local);
+	m_remoteMatcher = CFilterMatcher(remote);
+	m_matchersCompiled = true;
 }
 
-bool CFilterManager::FilenameFiltered(const std::list<CFilter> &filters, const wxString& name, const wxString& path, bool dir, wxLongLong size, bool local, int attributes, CDateTime const& date) const
-{
-	for( auto const& filter : filters ) {
-		if (FilenameFilteredByFilter(filter, name, path, dir, size, attributes, date))
-			return true;
-	}
-
-	return false;
-}
-
-static bool StringMatch(const wxString& subject, const wxString& filter, int condition, bool matchCase, std::shared_ptr<const wxRegEx> const& pRegEx)
+bool CFilterManager::HasSameLocalAndRemoteFilters() const
 {
-	bool match = false;
-
-	switch (condition)
+	const CFilterSet& set = m_globalFilterSets[m_globalCurrentFilterSet];
+	for (unsigned int i = 0; i < m_globalFilters.size(); i++)
 	{
-	case 0:
-		if (matchCase) {
-			if (subject.Contains(filter))
-				match = true;
-		}
-		else {
-			if (subject.Lower().Contains(filter.Lower()))
-				match = true;
-		}
-		break;
-	case 1:
-		if (matchCase) {
-			if (subject == filter)
-				match = true;
-		}
-		else {
-			if (!subject.CmpNoCase(filter))
-				match = true;
-		}
-		break;
-	case 2:
-		{
-			const wxString& left = subject.Left(filter.Len());
-			if (matchCase) {
-				if (left == filter)
-					match = true;
-			}
-			else {
-				if (!left.CmpNoCase(filter))
-					match = true;
-			}
-		}
-		break;
-	case 3:
+		if (set.local[i])
 		{
-			const wxString& right = subject.Right(filter.Len());
-			if (matchCase) {
-				if (right == filter)
-					match = true;
-			}
-			else {
-				if (!right.CmpNoCase(filter))
-					match = true;
-			}
-		}
-		break;
-	case 4:
-		wxASSERT(pRegEx);
-		if (pRegEx && pRegEx->Matches(subject))
-			match = true;
-		break;
-	case 5:
-		if (matchCase) {
-			if (!subject.Contains(filter))
-				match = true;
-		}
-		else {
-			if (!subject.Lower().Contains(filter.Lower()))
-				match = true;
+			if (!set.remote[i])
+				return false;
 		}
-		break;
+		else if (set.remote[i])
+			return false;
 	}
 
-	return match;
+	return true;
 }
 
-bool CFilterManager::FilenameFilteredByFilter(const CFilter& filter, const wxString& name, const wxString& path, bool dir, wxLongLong size, int attributes, CDateTime const& date)
+bool CFilterManager::FilenameFiltered(const wxString& name, const wxString& path, bool dir, wxLongLong size, bool local, int attributes, CDateTime const& date) const
 {
-	if (dir && !filter.filterDirs)
-		return false;
-	else if (!dir && !filter.filterFiles)
+	if (m_filters_disabled)
 		return false;
 
-	for (std::vector<CFilterCondition>::const_iterator iter = filter.filters.begin(); iter != filter.filters.end(); ++iter)
-	{
-		bool match = false;
-		const CFilterCondition& condition = *iter;
-
-		switch (condition.type)
-		{
-		case filter_name:
-			match = StringMatch(name, condition.strValue, condition.condition, filter.matchCase, condition.pRegEx);
-			break;
-		case filter_path:
-			match = StringMatch(path, condition.strValue, condition.condition, filter.matchCase, condition.pRegEx);
-			break;
-		case filter_size:
-			if (size == -1)
-				continue;
-			switch (condition.condition)
-			{
-			case 0:
-				if (size > condition.value)
-					match = true;
-				break;
-			case 1:
-				if (size == condition.value)
-					match = true;
-				break;
-			case 2:
-				if (size != condition.value)
-					match = true;
-				break;
-			case 3:
-				if (size < condition.value)
-					match = true;
-				break;
-			}
-			break;
-		case filter_attributes:
-#ifndef __WXMSW__
-			continue;
-#else
-			if (!attributes)
-				continue;
-
-			{
-				int flag = 0;
-				switch (condition.condition)
-				{
-				case 0:
-					flag = FILE_ATTRIBUTE_ARCHIVE;
-					break;
-				case 1:
-					flag = FILE_ATTRIBUTE_COMPRESSED;
-					break;
-				case 2:
-					flag = FILE_ATTRIBUTE_ENCRYPTED;
-					break;
-				case 3:
-					flag = FILE_ATTRIBUTE_HIDDEN;
-					break;
-				case 4:
-					flag = FILE_ATTRIBUTE_READONLY;
-					break;
-				case 5:
-					flag = FILE_ATTRIBUTE_SYSTEM;
-					break;
-				}
-
-				int set = (flag & attributes) ? 1 : 0;
-				if (set == condition.value)
-					match = true;
-			}
-#endif //__WXMSW__
-			break;
-		case filter_permissions:
-#ifdef __WXMSW__
-			continue;
-#else
-			if (attributes == -1)
-				continue;
+	wxASSERT(m_matchersCompiled);
 
-			{
-				int flag = 0;
-				switch (condition.condition)
-				{
-				case 0:
-					flag = S_IRUSR;
-					break;
-				case 1:
-					flag = S_IWUSR;
-					break;
-				case 2:
-					flag = S_IXUSR;
-					break;
-				case 3:
-					flag = S_IRGRP;
-					break;
-				case 4:
-					flag = S_IWGRP;
-					break;
-				case 5:
-					flag = S_IXGRP;
-					break;
-				case 6:
-					flag = S_IROTH;
-					break;
-				case 7:
-					flag = S_IWOTH;
-					break;
-				case 8:
-					flag = S_IXOTH;
-					break;
-				}
-
-				int set = (flag & attributes) ? 1 : 0;
-				if (set == condition.value)
-					match = true;
-			}
-#endif //__WXMSW__
-			break;
-		case filter_date:
-			if (date.IsValid()) {
-				int cmp = date.Compare( condition.date );
-				switch (condition.condition)
-				{
-				case 0: // Before
-					match = cmp < 0;
-					break;
-				case 1: // Equals
-					match = cmp == 0;
-					break;
-				case 2: // Not equals
-					match = cmp != 0;
-					break;
-				case 3: // After
-					match = cmp > 0;
-					break;
-				}
-			}
-			break;
-		default:
-			wxFAIL_MSG(_T("Unhandled filter type"));
-			break;
-		}
-		if (match) {
-			if (filter.matchType == CFilter::any)
-				return true;
-			else if (filter.matchType == CFilter::none)
-				return false;
-		}
-		else {
-			if (filter.matchType == CFilter::all)
-				return false;
-		}
-	}
-
-	if (filter.matchType != CFilter::any || filter.filters.empty())
-		return true;
+	return (local ? m_localMatcher : m_remoteMatcher).Matches(name, path, dir, size, attributes, date);
+}
 
-	return false;
+bool CFilterManager::FilenameFilteredByFilter(const CFilter& filter, const wxString& name, const wxString& path, bool dir, wxLongLong size, int attributes, CDateTime const& date)
+{
+	// Use CFilterMatcher directly when matching many entries
+	return CFilterMatcher(std::vector<CFilter>(1, filter)).Matches(name, path, dir, size, attributes, date);
 }
 
 bool CFilterManager::CompileRegexes(CFilter& filter)
@@ -27,15 +27,13 @@ enum t_filterType
 class CFilterCondition
 {
 public:
-	CFilterCondition();
-
-	enum t_filterType type;
-	int condition;
+	enum t_filterType type{filter_name};
+	int condition{};
 
 	wxString strValue; // All other types
 	wxLongLong value; // If type is size
 	CDateTime date; // If type is date
-	bool matchCase;
+	bool matchCase{true};
 	std::shared_ptr<wxRegEx> pRegEx;
 };
 
@@ -49,14 +47,18 @@ public:
 		none
 	};
 
-	CFilter();
-
 	wxString name;
 
-	bool filterFiles;
-	bool filterDirs;
-	enum t_matchType matchType;
-	bool matchCase;
+	bool filterFiles{true};
+	bool filterDirs{true};
+	enum t_matchType matchType{all};
+
+	// Filenames on Windows ignore case
+#ifdef __WXMSW__
+	bool matchCase{false};
+#else
+	bool matchCase{true};
+#endif
 
 	std::vector<CFilterCondition> filters;
 
@@ -72,6 +74,7 @@ public:
 	std::vector<bool> remote;
 };
 
+class CFilterMatcher;
 class TiXmlElement;
 class CFilterManager
 {
@@ -80,10 +83,20 @@ public:
 
 	// Note: Under non-windows, attributes are permissions
 	bool FilenameFiltered(const wxString& name, const wxString& path, bool dir, wxLongLong size, bool local, int attributes, CDateTime const& date) const;
-	bool FilenameFiltered(const std::list<CFilter> &filters, const wxString& name, const wxString& path, bool dir, wxLongLong size, bool local, int attributes, CDateTime const& date) const;
 	static bool FilenameFilteredByFilter(const CFilter& filter, const wxString& name, const wxString& path, bool dir, wxLongLong size, int attributes, CDateTime const& date);
 	static bool HasActiveFilters(bool ignore_disabled = false);
 
+	// Whether FilenameFiltered can be called from multiple threads at once.
+	// wxRegEx isn't thread-safe, so this is false if regexes are in use.
+	static bool CanFilterConcurrently(bool local);
+
+	// Whether FilenameFiltered looks at anything but names and paths
+	static bool FiltersUseMetadata(bool local);
+
+	// Prepares the active filters for matching, has to be called after
+	// changing filters or filter sets.
+	static void CompileMatchers();
+
 	bool HasSameLocalAndRemoteFilters() const;
 
 	static void ToggleFilters();
@@ -106,6 +119,10 @@ protected:
 	static unsigned int m_globalCurrentFilterSet;
 
 	static bool m_filters_disabled;
+
+	static CFilterMatcher m_localMatcher;
+	static CFilterMatcher m_remoteMatcher;
+	static bool m_matchersCompiled;
 };
 
 class CMainFrame;
@@ -0,0 +1,403 @@
+#include <filezilla.h>
+#include "filter_matcher.h"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+#include <sys/stat.h>
+
+namespace {
+// Same folding as wxString::Lower and CmpNoCase
+std::wstring Lower(wxString const& s)
+{
+	std::wstring ret;
+	ret.reserve(s.size());
+	for (auto const& c : s)
+		ret += static_cast<wchar_t>(wxTolower(c));
+	return ret;
+}
+
+bool StringMatch(std::wstring const& subject, std::wstring const& value, int condition)
+{
+	switch (condition)
+	{
+	case 0:
+		return subject.find(value) != std::wstring::npos;
+	case 1:
+		return subject == value;
+	case 2:
+		return subject.size() >= value.size() && !subject.compare(0, value.size(), value);
+	case 3:
+		return subject.size() >= value.size() && !subject.compare(subject.size() - value.size(), value.size(), value);
+	case 5:
+		return subject.find(value) == std::wstring::npos;
+	default:
+		return false;
+	}
+}
+
+int GetConditionFlag(CFilterCondition const& condition)
+{
+	switch (condition.type)
+	{
+#ifdef __WXMSW__
+	case filter_attributes:
+		switch (condition.condition)
+		{
+		case 0:
+			return FILE_ATTRIBUTE_ARCHIVE;
+		case 1:
+			return FILE_ATTRIBUTE_COMPRESSED;
+		case 2:
+			return FILE_ATTRIBUTE_ENCRYPTED;
+		case 3:
+			return FILE_ATTRIBUTE_HIDDEN;
+		case 4:
+			return FILE_ATTRIBUTE_READONLY;
+		case 5:
+			return FILE_ATTRIBUTE_SYSTEM;
+		}
+		break;
+#else
+	case filter_permissions:
+		switch (condition.condition)
+		{
+		case 0:
+			return S_IRUSR;
+		case 1:
+			return S_IWUSR;
+		case 2:
+			return S_IXUSR;
+		case 3:
+			return S_IRGRP;
+		case 4:
+			return S_IWGRP;
+		case 5:
+			return S_IXGRP;
+		case 6:
+			return S_IROTH;
+		case 7:
+			return S_IWOTH;
+		case 8:
+			return S_IXOTH;
+		}
+		break;
+#endif
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+// Back references would get renumbered in a combined regex
+bool CanCombineRegex(wxString const& pattern)
+{
+	for (size_t i = 0; i + 1 < pattern.size(); ++i) {
+		if (pattern[i] == '\\') {
+			if (wxIsdigit(pattern[i + 1]))
+				return false;
+			++i;
+		}
+	}
+	return true;
+}
+}
+
+// Converts name and path at most once per entry, and only if needed
+class CFilterMatcher::subjects final
+{
+public:
+	subjects(wxString const& name, wxString const& path)
+		: m_name(name), m_path(path)
+	{
+	}
+
+	std::wstring const& get(bool path, bool matchCase)
+	{
+		int const i = (path ? 2 : 0) + (matchCase ? 1 : 0);
+		if (!m_done[i]) {
+			wxString const& s = path ? m_path : m_name;
+			m_values[i] = matchCase ? s.ToStdWstring() : Lower(s);
+			m_done[i] = true;
+		}
+		return m_values[i];
+	}
+
+private:
+	wxString const& m_name;
+	wxString const& m_path;
+
+	std::wstring m_values[4];
+	bool m_done[4]{};
+};
+
+CFilterMatcher::CFilterMatcher(std::vector<CFilter> const& filters)
+{
+	// Regexes to combine, grouped by files, dirs and path
+	std::map<std::tuple<bool, bool, bool>, std::vector<CFilterCondition const*>> regexes;
+
+	for (auto const& f : filters) {
+		if (!f.filterFiles && !f.filterDirs)
+			continue;
+
+		// The conditions of a filter matching any condition are independent
+		// from each other, so are those of a filter with only one condition.
+		bool const split = f.matchType == CFilter::any || (f.matchType == CFilter::all && f.filters.size() == 1);
+
+		filter residual;
+		residual.files = f.filterFiles;
+		residual.dirs = f.filterDirs;
+		residual.matchType = f.matchType;
+		residual.matchCase = f.matchCase;
+
+		for (auto const& c : f.filters) {
+			bool const path = c.type == filter_path;
+			if (split && (c.type == filter_name || path)) {
+				if (c.condition >= 1 && c.condition <= 3) {
+					lookup_kind const kind = static_cast<lookup_kind>(c.condition - 1);
+					auto it = std::find_if(m_lookups.begin(), m_lookups.end(), [&](lookup const& l) {
+						return l.files == f.filterFiles && l.dirs == f.filterDirs && l.path == path && l.matchCase == f.matchCase && l.kind == kind;
+					});
+					if (it == m_lookups.end()) {
+						lookup l;
+						l.files = f.filterFiles;
+						l.dirs = f.filterDirs;
+						l.path = path;
+						l.matchCase = f.matchCase;
+						l.kind = kind;
+						it = m_lookups.insert(m_lookups.end(), l);
+					}
+
+					std::wstring value = f.matchCase ? c.strValue.ToStdWstring() : Lower(c.strValue);
+					if (kind != equals)
+						it->lengths.insert(value.size());
+					it->values.insert(std::move(value));
+					continue;
+				}
+				else if (c.condition == 4) {
+					// Invalid regexes never match
+					if (c.pRegEx)
+						regexes[std::make_tuple(f.filterFiles, f.filterDirs, path)].push_back(&c);
+					continue;
+				}
+			}
+
+			condition prepared;
+			prepared.type = c.type;
+			prepared.condition = c.condition;
+			prepared.value = f.matchCase ? c.strValue.ToStdWstring() : Lower(c.strValue);
+			prepared.size = c.value;
+			prepared.date = c.date;
+			prepared.flag = GetConditionFlag(c);
+			prepared.regex = c.pRegEx;
+			wxASSERT_MSG(c.type != filter_time, _T("Unhandled filter type"));
+			residual.conditions.push_back(prepared);
+		}
+
+		// An empty filter matches everything, but a split one must not
+		if (!split || !residual.conditions.empty() || f.filters.empty())
+			m_filters.push_back(residual);
+	}
+
+	for (auto const& group : regexes) {
+		regex r;
+		r.files = std::get<0>(group.first);
+		r.dirs = std::get<1>(group.first);
+		r.path = std::get<2>(group.first);
+
+		auto const& conditions = group.second;
+		if (conditions.size() > 1 &&
+			std::all_of(conditions.begin(), conditions.end(), [](CFilterCondition const* c) { return CanCombineRegex(c->strValue); }))
+		{
+			wxString pattern;
+			for (auto const& c : conditions) {
+				if (!pattern.empty())
+					pattern += '|';
+				pattern += _T("(") + c->strValue + _T(")");
+			}
+
+			r.regex = std::make_shared<wxRegEx>(pattern);
+			if (r.regex->IsValid()) {
+				m_regexes.push_back(r);
+				continue;
+			}
+		}
+
+		for (auto const& c : conditions) {
+			r.regex = c->pRegEx;
+			m_regexes.push_back(r);
+		}
+	}
+}
+
+bool CFilterMatcher::UsesMetadata() const
+{
+	for (auto const& f : m_filters) {
+		for (auto const& c : f.conditions) {
+			if (c.type != filter_name && c.type != filter_path)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+bool CFilterMatcher::HasRegexes() const
+{
+	if (!m_regexes.empty())
+		return true;
+
+	for (auto const& f : m_filters) {
+		for (auto const& c : f.conditions) {
+			if (c.regex)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+bool CFilterMatcher::Matches(wxString const& name, wxString const& path, bool dir, wxLongLong size, int attributes, CDateTime const& date) const
+{
+	subjects s(name, path);
+
+	for (auto const& l : m_lookups) {
+		if (!(dir ? l.dirs : l.files))
+			continue;
+
+		std::wstring const& subject = s.get(l.path, l.matchCase);
+		switch (l.kind)
+		{
+		case equals:
+			if (l.values.count(subject))
+				return true;
+			break;
+		case begins_with:
+			for (auto const& len : l.lengths) {
+				if (len > subject.size())
+					break;
+				if (l.values.count(subject.substr(0, len)))
+					return true;
+			}
+			break;
+		case ends_with:
+			for (auto const& len : l.lengths) {
+				if (len > subject.size())
+					break;
+				if (l.values.count(subject.substr(subject.size() - len)))
+					return true;
+			}
+			break;
+		}
+	}
+
+	for (auto const& f : m_filters) {
+		if ((dir ? f.dirs : f.files) && FilterMatches(f, s, name, path, size, attributes, date))
+			return true;
+	}
+
+	// Most expensive, so last
+	for (auto const& r : m_regexes) {
+		if ((dir ? r.dirs : r.files) && r.regex->Matches(r.path ? path : name))
+			return true;
+	}
+
+	return false;
+}
+
+bool CFilterMatcher::FilterMatches(filter const& f, subjects& s, wxString const& name, wxString const& path, wxLongLong size, int attributes, CDateTime const& date)
+{
+	for (auto const& c : f.conditions) {
+		bool match = false;
+
+		switch (c.type)
+		{
+		case filter_name:
+		case filter_path:
+			if (c.condition == 4)
+				match = c.regex && c.regex->Matches(c.type == filter_path ? path : name);
+			else
+				match = StringMatch(s.get(c.type == filter_path, f.matchCase), c.value, c.condition);
+			break;
+		case filter_size:
+			if (size == -1)
+				continue;
+			switch (c.condition)
+			{
+			case 0:
+				match = size > c.size;
+				break;
+			case 1:
+				match = size == c.size;
+				break;
+			case 2:
+				match = size != c.size;
+				break;
+			case 3:
+				match = size < c.size;
+				break;
+			}
+			break;
+		case filter_attributes:
+#ifndef __WXMSW__
+			continue;
+#else
+			if (!attributes)
+				continue;
+
+			match = ((c.flag & attributes) ? 1 : 0) == c.size;
+#endif //__WXMSW__
+			break;
+		case filter_permissions:
+#ifdef __WXMSW__
+			continue;
+#else
+			if (attributes == -1)
+				continue;
+
+			match = ((c.flag & attributes) ? 1 : 0) == c.size;
+#endif //__WXMSW__
+			break;
+		case filter_date:
+			if (date.IsValid()) {
+				int cmp = date.Compare(c.date);
+				switch (c.condition)
+				{
+				case 0: // Before
+					match = cmp < 0;
+					break;
+				case 1: // Equals
+					match = cmp == 0;
+					break;
+				case 2: // Not equals
+					match = cmp != 0;
+					break;
+				case 3: // After
+					match = cmp > 0;
+					break;
+				}
+			}
+			break;
+		default:
+			break;
+		}
+
+		if (match) {
+			if (f.matchType == CFilter::any)
+				return true;
+			else if (f.matchType == CFilter::none)
+				return false;
+		}
+		else {
+			if (f.matchType == CFilter::all)
+				return false;
+		}
+	}
+
+	if (f.matchType != CFilter::any || f.conditions.empty())
+		return true;
+
+	return false;
+}
@@ -0,0 +1,99 @@
+#ifndef __FILTER_MATCHER_H__
+#define __FILTER_MATCHER_H__
+
+#include "filter.h"
+
+#include <set>
+#include <string>
+#include <unordered_set>
+
+// A number of filters prepared for matching them against many entries.
+// An entry is filtered if any of the filters matches, just like with
+// CFilterManager::FilenameFiltered.
+//
+// Equals, begins with and ends with conditions of all filters are merged
+// into hash sets, so their number does not matter. Regular expressions get
+// combined into a single one where possible. Everything else is evaluated
+// condition by condition, with the patterns prepared up front.
+class CFilterMatcher final
+{
+public:
+	CFilterMatcher() = default;
+
+	// Regexes have to be compiled already, see CFilterManager::CompileRegexes
+	explicit CFilterMatcher(std::vector<CFilter> const& filters);
+
+	// Note: Under non-windows, attributes are permissions
+	bool Matches(wxString const& name, wxString const& path, bool dir, wxLongLong size, int attributes, CDateTime const& date) const;
+
+	bool empty() const { return m_lookups.empty() && m_regexes.empty() && m_filters.empty(); }
+
+	// wxRegEx isn't thread-safe. Unless this returns false, Matches must
+	// not be called from multiple threads at once.
+	bool HasRegexes() const;
+
+	// False if only names and paths get matched. Size, attributes and date
+	// passed to Matches don't matter then.
+	bool UsesMetadata() const;
+
+private:
+	class subjects;
+
+	enum lookup_kind
+	{
+		equals,
+		begins_with,
+		ends_with
+	};
+
+	struct lookup
+	{
+		bool files;
+		bool dirs;
+		bool path;
+		bool matchCase;
+		lookup_kind kind;
+
+		std::unordered_set<std::wstring> values;
+
+		// All distinct lengths of the values, subjects get cut to these
+		// for begins with and ends with
+		std::set<size_t> lengths;
+	};
+	std::vector<lookup> m_lookups;
+
+	struct regex
+	{
+		bool files;
+		bool dirs;
+		bool path;
+		std::shared_ptr<wxRegEx> regex;
+	};
+	std::vector<regex> m_regexes;
+
+	// Filters that could not be merged into the above
+	struct condition
+	{
+		t_filterType type;
+		int condition;
+		std::wstring value; // Lowercased if not matching case
+		wxLongLong size;
+		CDateTime date;
+		int flag; // Attribute or permission bit
+		std::shared_ptr<wxRegEx> regex;
+	};
+
+	struct filter
+	{
+		bool files;
+		bool dirs;
+		CFilter::t_matchType matchType;
+		bool matchCase;
+		std::vector<condition> conditions;
+	};
+	std::vector<filter> m_filters;
+
+	static bool FilterMatches(filter const& f, subjects& s, wxString const& name, wxString const& path, wxLongLong size, int attributes, CDateTime const& date);
+};
+
+#endif //__FILTER_MATCHER_H__
@@ -1,5 +1,6 @@
 #include <filezilla.h>
 #include "listingcomparison.h"
+#include "comparison_engine.h"
 #include "filter.h"
 #include "Options.h"
 #include "state.h"
@@ -102,101 +103,35 @@ bool CComparisonManager::CompareListings()
 	m_pLeft->StartComparison();
 	m_pRight->StartComparison();
 
-	wxString localFile, remoteFile;
-	bool localDir = false;
-	bool remoteDir = false;
-	wxLongLong localSize, remoteSize;
-	CDateTime localDate, remoteDate;
+	std::vector<CComparisonEntry> left, right;
+	ReadListing(m_pLeft, left);
+	ReadListing(m_pRight, right);
 
 	const int dirSortMode = COptions::Get()->GetOptionVal(OPTION_FILELIST_DIRSORT);
 
 	const bool hide_identical = COptions::Get()->GetOptionVal(OPTION_COMPARE_HIDEIDENTICAL) != 0;
 
-	bool gotLocal = m_pLeft->GetNextFile(localFile, localDir, localSize, localDate);
-	bool gotRemote = m_pRight->GetNextFile(remoteFile, remoteDir, remoteSize, remoteDate);
+	// Matching is done by name, the order only matters for placing entries
+	// which exist on one side only.
+	auto const less = [this, dirSortMode](CComparisonEntry const& a, CComparisonEntry const& b) {
+		return CompareFiles(dirSortMode, a.name, b.name, a.dir, b.dir) < 0;
+	};
 
-	while (gotLocal && gotRemote)
+	CComparisonEngine engine(!mode, mode != 0, threshold);
+	for (auto const& row : engine.Compare(left, right, less))
 	{
-		int cmp = CompareFiles(dirSortMode, localFile, remoteFile, localDir, remoteDir);
-		if (!cmp)
-		{
-			if (!mode)
-			{
-				const CComparableListing::t_fileEntryFlags flag = (localDir || localSize == remoteSize) ? CComparableListing::normal : CComparableListing::different;
-
-				if (!hide_identical || flag != CComparableListing::normal || localFile == _T(".."))
-				{
-					m_pLeft->CompareAddFile(flag);
-					m_pRight->CompareAddFile(flag);
-				}
-			}
-			else
-			{
-				if (!localDate.IsValid() || !remoteDate.IsValid())
-				{
-					if (!hide_identical || localDate.IsValid() || remoteDate.IsValid() || localFile == _T(".."))
-					{
-						const CComparableListing::t_fileEntryFlags flag = CComparableListing::normal;
-						m_pLeft->CompareAddFile(flag);
-						m_pRight->CompareAddFile(flag);
-					}
-				}
-				else
-				{
-					CComparableListing::t_fileEntryFlags localFlag, remoteFlag;
-
-					int cmp = localDate.Compare(remoteDate);
-					if( cmp < 0 )
-						localDate += threshold;
-					else if( cmp > 0 ) {
-						remoteDate += threshold;
-					}
-					int cmp2 = localDate.Compare(remoteDate);
-					if( cmp && cmp == -cmp2) {
-						cmp = 0;
-					}
-
-					localFlag = CComparableListing::normal;
-					remoteFlag = CComparableListing::normal;
-					if( cmp < 0 ) {
-						remoteFlag = CComparableListing::newer;
-					}
-					else if( cmp > 0 ) {
-						localFlag = CComparableListing::newer;
-					}
-					if (!hide_identical || localFlag != CComparableListing::normal || remoteFlag != CComparableListing::normal || localFile == _T(".."))
-					{
-						m_pLeft->CompareAddFile(localFlag);
-						m_pRight->CompareAddFile(remoteFlag);
-					}
-				}
-			}
-			gotLocal = m_pLeft->GetNextFile(localFile, localDir, localSize, localDate);
-			gotRemote = m_pRight->GetNextFile(remoteFile, remoteDir, remoteSize, remoteDate);
+		if (row.left != -1 && row.right != -1 && hide_identical && row.identical && left[row.left].name != _T(".."))
 			continue;
-		}
 
-		if (cmp < 0) {
-			m_pLeft->CompareAddFile(CComparableListing::lonely);
-			m_pRight->CompareAddFile(CComparableListing::fill);
-			gotLocal = m_pLeft->GetNextFile(localFile, localDir, localSize, localDate);
-		}
-		else {
-			m_pLeft->CompareAddFile(CComparableListing::fill);
-			m_pRight->CompareAddFile(CComparableListing::lonely);
-			gotRemote = m_pRight->GetNextFile(remoteFile, remoteDir, remoteSize, remoteDate);
-		}
-	}
-	while (gotLocal) {
-		m_pLeft->CompareAddFile(CComparableListing::lonely);
-		m_pRight->CompareAddFile(CComparableListing::fill);
-		gotLocal = m_pLeft->GetNextFile(localFile, localDir, localSize, localDate);
-	}
-	while (gotRemote)
-	{
-		m_pLeft->CompareAddFile(CComparableListing::fill);
-		m_pRight->CompareAddFile(CComparableListing::lonely);
-		gotRemote = m_pRight->GetNextFile(remoteFile, remoteDir, remoteSize, remoteDate);
+		if (row.left != -1)
+			m_pLeft->CompareAddFile(GetFlags(row.leftFlags), row.left);
+		else
+			m_pLeft->CompareAddFile(CComparableListing::fill, -1);
+
+		if (row.right != -1)
+			m_pRight->CompareAddFile(GetFlags(row.rightFlags), row.right);
+		else
+			m_pRight->CompareAddFile(CComparableListing::fill, -1);
 	}
 
 	m_pRight->FinishComparison();
@@ -205,6 +140,31 @@ bool CComparisonManager::CompareListings()
 	return true;
 }
 
+void CComparisonManager::ReadListing(CComparableListing* pListing, std::vector<CComparisonEntry>& entries)
+{
+	CComparisonEntry entry;
+	while (pListing->GetNextFile(entry.name, entry.dir, entry.size, entry.date))
+	{
+		entries.push_back(entry);
+		entry.date = CDateTime();
+	}
+}
+
+CComparableListing::t_fileEntryFlags CComparisonManager::GetFlags(int flags)
+{
+	switch (flags)
+	{
+	case CComparisonEngine::different:
+		return CComparableListing::different;
+	case CComparisonEngine::newer:
+		return CComparableListing::newer;
+	case CComparisonEngine::lonely:
+		return CComparableListing::lonely;
+	default:
+		return CComparableListing::normal;
+	}
+}
+
 int CComparisonManager::CompareFiles(const int dirSortMode, const wxString& local, const wxString& remote, bool localDir, bool remoteDir)
 {
 	switch (dirSortMode)
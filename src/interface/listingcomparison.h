@@ -21,7 +21,8 @@ public:
 	virtual bool CanStartComparison(wxString* pError) = 0;
 	virtual void StartComparison() = 0;
 	virtual bool GetNextFile(wxString& name, bool &dir, wxLongLong &size, CDateTime& date) = 0;
-	virtual void CompareAddFile(t_fileEntryFlags flags) = 0;
+	// item is the position in the order returned by GetNextFile, -1 for fill
+	virtual void CompareAddFile(t_fileEntryFlags flags, int item) = 0;
 	virtual void FinishComparison() = 0;
 	virtual void ScrollTopItem(int item) = 0;
 	virtual void OnExitComparisonMode() = 0;
@@ -46,6 +47,7 @@ private:
 };
 
 class CState;
+struct CComparisonEntry;
 class CComparisonManager
 {
 public:
@@ -59,6 +61,9 @@ public:
 	void SetListings(CComparableListing* pLeft, CComparableListing* pRight);
 
 protected:
+	static void ReadListing(CComparableListing* pListing, std::vector<CComparisonEntry>& entries);
+	static CComparableListing::t_fileEntryFlags GetFlags(int flags);
+
 	int CompareFiles(const int dirSortMode, const wxString& local, const wxString& remote, bool localDir, bool remoteDir);
 
 	CState* m_pState;
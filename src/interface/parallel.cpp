@@ -0,0 +1,59 @@
+#include <filezilla.h>
+#include "parallel.h"
+
+namespace {
+class CParallelTaskThread final : public wxThread
+{
+public:
+	CParallelTaskThread(std::function<void(unsigned int)> const& task, unsigned int index)
+		: wxThread(wxTHREAD_JOINABLE)
+		, m_task(task)
+		, m_index(index)
+	{
+	}
+
+protected:
+	virtual ExitCode Entry()
+	{
+		m_task(m_index);
+		return 0;
+	}
+
+	std::function<void(unsigned int)> const& m_task;
+	unsigned int const m_index;
+};
+}
+
+unsigned int GetParallelTaskCount(size_t count, size_t minPerTask)
+{
+	int const cpus = wxThread::GetCPUCount();
+	if (cpus < 2 || count < minPerTask * 2)
+		return 1;
+
+	// Past a certain point more threads only add overhead
+	size_t const tasks = std::min(count / minPerTask, static_cast<size_t>(std::min(cpus, 16)));
+	return static_cast<unsigned int>(tasks);
+}
+
+void RunParallel(unsigned int tasks, std::function<void(unsigned int)> const& task)
+{
+	std::vector<CParallelTaskThread*> threads;
+	for (unsigned int i = 1; i < tasks; ++i) {
+		CParallelTaskThread* thread = new CParallelTaskThread(task, i);
+		if (thread->Create() != wxTHREAD_NO_ERROR || thread->Run() != wxTHREAD_NO_ERROR) {
+			// Out of threads, do it ourselves
+			delete thread;
+			task(i);
+			continue;
+		}
+		threads.push_back(thread);
+	}
+
+	if (tasks)
+		task(0);
+
+	for (auto thread : threads) {
+		thread->Wait();
+		delete thread;
+	}
+}
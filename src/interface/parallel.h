@@ -0,0 +1,92 @@
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+// Helpers to spread CPU-bound work on huge file listings over all cores.
+// They are fork-join: the calling thread takes part in the work and only
+// returns once all of it is done, so callers need no further locking.
+
+// Below these sizes it's not worth starting threads
+#define PARALLEL_FILTER_MIN 5000
+#define PARALLEL_SORT_MIN 10000
+
+// Number of tasks to split count items into so that each gets at least
+// minPerTask items. Returns 1 if the work should not be split at all.
+unsigned int GetParallelTaskCount(size_t count, size_t minPerTask);
+
+// Calls task(0) ... task(tasks - 1), each on its own thread.
+void RunParallel(unsigned int tasks, std::function<void(unsigned int)> const& task);
+
+// First item of the given task if splitting count items evenly
+inline size_t GetParallelTaskStart(size_t count, unsigned int tasks, unsigned int task)
+{
+	return count * task / tasks;
+}
+
+// Appends all indexes in [first, last) for which keep returns true to out,
+// in ascending order. If concurrent is true, keep is called from several
+// threads at once.
+template<typename Keep>
+void ParallelFilter(std::vector<unsigned int>& out, unsigned int first, unsigned int last, bool concurrent, Keep const& keep)
+{
+	unsigned int const tasks = concurrent ? GetParallelTaskCount(last - first, PARALLEL_FILTER_MIN) : 1;
+	if (tasks < 2) {
+		for (unsigned int i = first; i < last; ++i) {
+			if (keep(i))
+				out.push_back(i);
+		}
+		return;
+	}
+
+	std::vector<std::vector<unsigned int>> results(tasks);
+	RunParallel(tasks, [&](unsigned int task) {
+		unsigned int const begin = first + GetParallelTaskStart(last - first, tasks, task);
+		unsigned int const end = first + GetParallelTaskStart(last - first, tasks, task + 1);
+		std::vector<unsigned int>& result = results[task];
+		for (unsigned int i = begin; i < end; ++i) {
+			if (keep(i))
+				result.push_back(i);
+		}
+	});
+
+	for (auto const& result : results)
+		out.insert(out.end(), result.begin(), result.end());
+}
+
+// Like std::sort, but sorts chunks of the range concurrently and then
+// merges them. comp gets called from several threads at once.
+template<typename Iterator, typename Compare>
+void ParallelSort(Iterator first, Iterator last, Compare comp)
+{
+	size_t const count = last - first;
+	unsigned int const tasks = GetParallelTaskCount(count, PARALLEL_SORT_MIN);
+	if (tasks < 2) {
+		std::sort(first, last, comp);
+		return;
+	}
+
+	std::vector<Iterator> bounds;
+	for (unsigned int task = 0; task <= tasks; ++task)
+		bounds.push_back(first + GetParallelTaskStart(count, tasks, task));
+
+	RunParallel(tasks, [&](unsigned int task) {
+		std::sort(bounds[task], bounds[task + 1], comp);
+	});
+
+	// Merge neighbouring runs pairwise until only one is left
+	for (unsigned int width = 1; width < tasks; width *= 2) {
+		unsigned int const merges = (tasks + 2 * width - 1) / (2 * width);
+		RunParallel(merges, [&](unsigned int merge) {
+			unsigned int const low = merge * 2 * width;
+			unsigned int const middle = std::min(low + width, tasks);
+			unsigned int const high = std::min(low + 2 * width, tasks);
+			if (middle < high)
+				std::inplace_merge(bounds[low], bounds[middle], bounds[high], comp);
+		});
+	}
+}
+
+#endif //__PARALLEL_H__
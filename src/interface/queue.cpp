@@ -349,6 +349,10 @@ void CFileItem::SaveItem(TiXmlElement* pElement) const
 	AddTextElementRaw(file, "DataType", Ascii() ? "0" : "1");
 	if (m_defaultFileExistsAction != CFileExistsNotification::unknown)
 		AddTextElement(file, "OverwriteAction", m_defaultFileExistsAction);
+	if (m_segment) {
+		AddTextElement(file, "SegmentStart", (m_segment->start + m_segment->done).ToString());
+		AddTextElement(file, "SegmentEnd", m_segment->end.ToString());
+	}
 }
 
 bool CFileItem::TryRemoveAll()
@@ -477,6 +481,12 @@ void CServerItem::RemoveFileItemFromList(CFileItem* pItem)
 	wxFAIL_MSG(_T("File item not deleted from m_fileList"));
 }
 
+void CServerItem::ScheduleFirst(CFileItem* pItem)
+{
+	RemoveFileItemFromList(pItem);
+	m_fileList[pItem->queued() ? 0 : 1][static_cast<int>(pItem->GetPriority())].push_front(pItem);
+}
+
 void CServerItem::SetDefaultFileExistsAction(CFileExistsNotification::OverwriteAction action, const TransferDirection direction)
 {
 	for (auto iter = m_children.begin() + m_removed_at_front; iter != m_children.end(); ++iter) {
@@ -853,6 +863,10 @@ wxString CQueueViewBase::OnGetItemText(CQueueItem* pItem, ColumnId column) const
 			switch (column)
 			{
 			case colLocalName:
+				if (pFileItem->m_segment) {
+					return _T("  ") + pFileItem->GetLocalPath().GetPath() + pFileItem->GetLocalFile() +
+						wxString::Format(_(" (bytes %s to %s)"), pFileItem->m_segment->start.ToString(), (pFileItem->m_segment->end - 1).ToString());
+				}
 				return _T("  ") + pFileItem->GetLocalPath().GetPath() + pFileItem->GetLocalFile();
 			case colDirection:
 				if (pFileItem->Download())
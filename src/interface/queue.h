@@ -2,6 +2,7 @@
 #define __QUEUE_H__
 
 #include "aui_notebook_ex.h"
+#include "download_segment.h"
 #include "listctrlex.h"
 #include "edithandler.h"
 #include "optional.h"
@@ -121,6 +122,10 @@ public:
 
 	void SetChildPriority(CFileItem* pItem, QueuePriority oldPriority, QueuePriority newPriority);
 
+	// Makes the item the next one returned by GetIdleChild among the
+	// items of the same priority.
+	void ScheduleFirst(CFileItem* pItem);
+
 	int m_activeCount;
 
 protected:
@@ -254,6 +259,10 @@ public:
 		}
 	}
 
+	// Set on downloads split across several connections
+	typedef CDownloadSegment t_segment;
+	CSparseOptional<t_segment> m_segment;
+
 protected:
 	wxString const m_sourceFile;
 	CSparseOptional<wxString> m_targetFile;
@@ -48,7 +48,8 @@ namespace server_table_column_names
 		encoding,
 		bypass_proxy,
 		post_login_commands,
-		name
+		name,
+		compression_level
 	};
 }
 
@@ -68,7 +69,8 @@ _column server_table_columns[] = {
 	{ _T("encoding"), Column_type::text, 0 },
 	{ _T("bypass_proxy"), Column_type::integer, 0 },
 	{ _T("post_login_commands"), Column_type::text, 0 },
-	{ _T("name"), Column_type::text, 0 }
+	{ _T("name"), Column_type::text, 0 },
+	{ _T("compression_level"), Column_type::integer, 0 }
 };
 
 namespace file_table_column_names
@@ -86,7 +88,9 @@ namespace file_table_column_names
 		error_count,
 		priority,
 		ascii_file,
-		default_exists_action
+		default_exists_action,
+		segment_start,
+		segment_end
 	};
 }
 
@@ -102,7 +106,9 @@ _column file_table_columns[] = {
 	{ _T("error_count"), Column_type::integer, 0 },
 	{ _T("priority"), Column_type::integer, 0 },
 	{ _T("ascii_file"), Column_type::integer, 0 },
-	{ _T("default_exists_action"), Column_type::integer, 0 }
+	{ _T("default_exists_action"), Column_type::integer, 0 },
+	{ _T("segment_start"), Column_type::integer, 0 },
+	{ _T("segment_end"), Column_type::integer, 0 }
 };
 
 namespace path_table_column_names
@@ -295,10 +301,20 @@ bool CQueueStorage::Impl::MigrateSchema()
 	if (sqlite3_exec(db_, "PRAGMA user_version", int_callback, &version, 0) != SQLITE_OK)
 		return false;
 
-	if (version < 1)
-		return sqlite3_exec(db_, "PRAGMA user_version = 1", 0, 0, 0) == SQLITE_OK;
+	if (version >= 3)
+		return true;
 
-	return true;
+	// These fail on a new database without tables, CreateTables adds the
+	// columns then.
+	if (version < 2) {
+		// Version 2 added servers.compression_level.
+		sqlite3_exec(db_, "ALTER TABLE servers ADD COLUMN compression_level INTEGER", 0, 0, 0);
+	}
+	// Version 3 added files.segment_start and files.segment_end
+	sqlite3_exec(db_, "ALTER TABLE files ADD COLUMN segment_start INTEGER", 0, 0, 0);
+	sqlite3_exec(db_, "ALTER TABLE files ADD COLUMN segment_end INTEGER", 0, 0, 0);
+
+	return sqlite3_exec(db_, "PRAGMA user_version = 3", 0, 0, 0) == SQLITE_OK;
 }
 
 
@@ -685,6 +701,7 @@ bool CQueueStorage::Impl::SaveServer(const CServerItem& item)
 		Bind(insertServerQuery_, server_table_column_names::name, server.GetName());
 	else
 		BindNull(insertServerQuery_, server_table_column_names::name);
+	Bind(insertServerQuery_, server_table_column_names::compression_level, server.GetCompressionLevel());
 
 	int res;
 	do {
@@ -750,6 +767,15 @@ bool CQueueStorage::Impl::SaveFile(wxLongLong server, const CFileItem& file)
 	else
 		BindNull(insertFileQuery_, file_table_column_names::default_exists_action);
 
+	if (file.m_segment) {
+		Bind(insertFileQuery_, file_table_column_names::segment_start, (file.m_segment->start + file.m_segment->done).GetValue());
+		Bind(insertFileQuery_, file_table_column_names::segment_end, file.m_segment->end.GetValue());
+	}
+	else {
+		BindNull(insertFileQuery_, file_table_column_names::segment_start);
+		BindNull(insertFileQuery_, file_table_column_names::segment_end);
+	}
+
 	int res;
 	do {
 		res = sqlite3_step(insertFileQuery_);
@@ -787,6 +813,8 @@ bool CQueueStorage::Impl::SaveDirectory(wxLongLong server, const CFolderItem& di
 	BindNull(insertFileQuery_, file_table_column_names::ascii_file);
 
 	BindNull(insertFileQuery_, file_table_column_names::default_exists_action);
+	BindNull(insertFileQuery_, file_table_column_names::segment_start);
+	BindNull(insertFileQuery_, file_table_column_names::segment_end);
 
 	int res;
 	do {
@@ -952,6 +980,7 @@ wxLongLong_t CQueueStorage::Impl::ParseServerFromRow(CServer& server)
 
 	server.SetBypassProxy(GetColumnInt(selectServersQuery_, server_table_column_names::bypass_proxy) == 1 );
 	server.SetName( GetColumnText(selectServersQuery_, server_table_column_names::name) );
+	server.SetCompressionLevel(GetColumnInt(selectServersQuery_, server_table_column_names::compression_level));
 
 	return GetColumnInt64(selectServersQuery_, server_table_column_names::id);
 }
@@ -992,6 +1021,8 @@ wxLongLong_t CQueueStorage::Impl::ParseFileFromRow(CFileItem** pItem)
 
 		bool ascii = GetColumnInt(selectFilesQuery_, file_table_column_names::ascii_file) != 0;
 		int overwrite_action = GetColumnInt(selectFilesQuery_, file_table_column_names::default_exists_action, CFileExistsNotification::unknown);
+		wxLongLong segmentStart = GetColumnInt64(selectFilesQuery_, file_table_column_names::segment_start, -1);
+		wxLongLong segmentEnd = GetColumnInt64(selectFilesQuery_, file_table_column_names::segment_end, -1);
 
 		if (sourceFile.empty() || localPath.empty() ||
 			remotePath.empty() ||
@@ -1009,6 +1040,9 @@ wxLongLong_t CQueueStorage::Impl::ParseFileFromRow(CFileItem** pItem)
 
 		if (overwrite_action > 0 && overwrite_action < CFileExistsNotification::ACTION_COUNT)
 			fileItem->m_defaultFileExistsAction = (CFileExistsNotification::OverwriteAction)overwrite_action;
+
+		if (download && segmentStart >= 0 && segmentEnd > segmentStart)
+			fileItem->m_segment = CSparseOptional<CFileItem::t_segment>(CFileItem::t_segment(segmentStart, segmentEnd));
 	}
 
 	return GetColumnInt64(selectFilesQuery_, file_table_column_names::id);
@@ -2,10 +2,38 @@
 #include "recursive_operation.h"
 #include "commandqueue.h"
 #include "chmoddialog.h"
+#include "asyncrequestqueue.h"
 #include "filter.h"
+#include "Mainfrm.h"
 #include "Options.h"
 #include "queue.h"
 #include "local_filesys.h"
+#include "StatusView.h"
+#include "synchronization.h"
+
+// Passes the notifications of the additional listing engines on
+class CListingEngineHandler final : public wxEvtHandler
+{
+public:
+	CListingEngineHandler(CRecursiveOperation& owner)
+		: m_owner(owner)
+	{
+	}
+
+protected:
+	void OnEngineEvent(wxFzEvent& event)
+	{
+		m_owner.OnListingEngineEvent(event.engine_);
+	}
+
+	CRecursiveOperation& m_owner;
+
+	DECLARE_EVENT_TABLE()
+};
+
+BEGIN_EVENT_TABLE(CListingEngineHandler, wxEvtHandler)
+EVT_FZ_NOTIFICATION(wxID_ANY, CListingEngineHandler::OnEngineEvent)
+END_EVENT_TABLE()
 
 CRecursiveOperation::CNewDir::CNewDir()
 {
@@ -15,9 +43,10 @@ CRecursiveOperation::CNewDir::CNewDir()
 	doVisit = true;
 }
 
-CRecursiveOperation::CRecursiveOperation(CState* pState)
+CRecursiveOperation::CRecursiveOperation(CState* pState, CMainFrame* pMainFrame)
 	: CStateEventHandler(pState),
-	  m_operationMode(recursive_none)
+	  m_operationMode(recursive_none),
+	  m_pMainFrame(pMainFrame)
 {
 	pState->RegisterHandler(this, STATECHANGE_REMOTE_DIR, false);
 	pState->RegisterHandler(this, STATECHANGE_REMOTE_LINKNOTDIR, false);
@@ -30,6 +59,9 @@ CRecursiveOperation::~CRecursiveOperation()
 		m_pChmodDlg->Destroy();
 		m_pChmodDlg = 0;
 	}
+
+	StopListingEngines();
+	delete m_pListingEngineHandler;
 }
 
 void CRecursiveOperation::OnStateChange(CState* pState, enum t_statechange_notifications notification, const wxString&, const void* data2)
@@ -56,6 +88,9 @@ void CRecursiveOperation::StartRecursiveOperation(enum OperationMode mode, const
 	if (mode == recursive_chmod && !m_pChmodDlg)
 		return;
 
+	if (mode == recursive_synchronize && !m_pSynchronization)
+		return;
+
 	if ((mode == recursive_download || mode == recursive_addtoqueue || mode == recursive_download_flatten || mode == recursive_addtoqueue_flatten) && !m_pQueue)
 		return;
 
@@ -77,7 +112,7 @@ void CRecursiveOperation::StartRecursiveOperation(enum OperationMode mode, const
 
 	m_allowParent = allowParent;
 
-	m_filters = filters;
+	m_filters = CFilterMatcher(std::vector<CFilter>(filters.begin(), filters.end()));
 
 	NextOperation();
 }
@@ -107,7 +142,7 @@ bool CRecursiveOperation::NextOperation()
 	if (m_operationMode == recursive_none)
 		return false;
 
-	while (!m_dirsToVisit.empty())
+	while (!m_primaryBusy && !m_dirsToVisit.empty())
 	{
 		const CNewDir& dirToVisit = m_dirsToVisit.front();
 		if (m_operationMode == recursive_delete && !dirToVisit.doVisit)
@@ -117,13 +152,41 @@ bool CRecursiveOperation::NextOperation()
 			continue;
 		}
 
-		CListCommand* cmd = new CListCommand(dirToVisit.parent, dirToVisit.subdir, dirToVisit.link ? LIST_FLAG_LINK : 0);
+		CNewDir dir = dirToVisit;
+		m_dirsToVisit.pop_front();
+
+		if (ProcessCachedListing(dir))
+			continue;
+
+		m_primaryDir = dir;
+		m_primaryBusy = true;
+
+		CListCommand* cmd = new CListCommand(m_primaryDir.parent, m_primaryDir.subdir, m_primaryDir.link ? LIST_FLAG_LINK : 0);
 		m_pState->m_pCommandQueue->ProcessCommand(cmd);
+	}
+
+	if (m_operationMode == recursive_none)
+		return false;
+
+	StartListingEngines();
+
+	if (m_primaryBusy)
 		return true;
+	for (auto const& listingEngine : m_listingEngines)
+	{
+		if (listingEngine.busy)
+			return true;
 	}
 
+	// Completed, so don't let StopRecursiveOperation abort the synchronization
+	CSynchronization* pSynchronization = m_pSynchronization;
+	m_pSynchronization = 0;
+
 	StopRecursiveOperation();
 	m_pState->m_pCommandQueue->ProcessCommand(new CListCommand(m_finalDir));
+
+	if (pSynchronization)
+		pSynchronization->RemoteListingComplete();
 	return false;
 }
 
@@ -175,22 +238,26 @@ void CRecursiveOperation::ProcessDirectoryListing(const CDirectoryListing* pDire
 		return;
 	}
 
-	wxASSERT(!m_dirsToVisit.empty());
+	wxASSERT(m_primaryBusy);
 
-	if (!m_pState->IsRemoteConnected() || m_dirsToVisit.empty())
+	if (!m_pState->IsRemoteConnected() || !m_primaryBusy)
 	{
 		StopRecursiveOperation();
 		return;
 	}
 
-	CNewDir dir = m_dirsToVisit.front();
-	m_dirsToVisit.pop_front();
+	m_primaryBusy = false;
+	ProcessDirectoryListing(m_primaryDir, *pDirectoryListing);
+
+	NextOperation();
+}
+
+void CRecursiveOperation::ProcessDirectoryListing(CNewDir dir, const CDirectoryListing& directoryListing)
+{
+	const CDirectoryListing* pDirectoryListing = &directoryListing;
 
 	if (!BelowRecursionRoot(pDirectoryListing->path, dir))
-	{
-		NextOperation();
 		return;
-	}
 
 	if (m_operationMode == recursive_delete && dir.doVisit && !dir.subdir.empty())
 	{
@@ -202,17 +269,13 @@ void CRecursiveOperation::ProcessDirectoryListing(const CDirectoryListing* pDire
 	}
 
 	if (dir.link && !dir.recurse)
-	{
-		NextOperation();
 		return;
-	}
 
 	// Check if we have already visited the directory
 	if (!m_visitedDirs.insert(pDirectoryListing->path).second)
-	{
-		NextOperation();
 		return;
-	}
+
+	m_pState->NotifyHandlers(STATECHANGE_REMOTE_RECURSION_LISTING, wxString(), pDirectoryListing);
 
 	const CServer* pServer = m_pState->GetServer();
 	wxASSERT(pServer);
@@ -231,8 +294,6 @@ void CRecursiveOperation::ProcessDirectoryListing(const CDirectoryListing* pDire
 		}
 	}
 
-	CFilterManager filter;
-
 	// Is operation restricted to a single child?
 	bool restrict = !dir.restrict.empty();
 
@@ -242,6 +303,8 @@ void CRecursiveOperation::ProcessDirectoryListing(const CDirectoryListing* pDire
 
 	bool added = false;
 
+	std::vector<CComparisonEntry> synchronizeEntries;
+
 	for (int i = pDirectoryListing->GetCount() - 1; i >= 0; --i)
 	{
 		const CDirentry& entry = (*pDirectoryListing)[i];
@@ -251,9 +314,23 @@ void CRecursiveOperation::ProcessDirectoryListing(const CDirectoryListing* pDire
 			if (entry.name != dir.restrict)
 				continue;
 		}
-		else if (filter.FilenameFiltered(m_filters, entry.name, path, entry.is_dir(), entry.size, false, 0, entry.time))
+		else if (m_filters.Matches(entry.name, path, entry.is_dir(), entry.size, 0, entry.time))
 			continue;
 
+		if (m_operationMode == recursive_synchronize)
+		{
+			// Links could lead anywhere, leave them alone
+			if (entry.is_link())
+				continue;
+
+			CComparisonEntry synchronizeEntry;
+			synchronizeEntry.name = entry.name;
+			synchronizeEntry.dir = entry.is_dir();
+			synchronizeEntry.size = entry.size;
+			synchronizeEntry.date = entry.time;
+			synchronizeEntries.push_back(synchronizeEntry);
+		}
+
 		if (entry.is_dir() && (!entry.is_link() || m_operationMode != recursive_delete))
 		{
 			if (dir.recurse)
@@ -330,7 +407,29 @@ void CRecursiveOperation::ProcessDirectoryListing(const CDirectoryListing* pDire
 	if (m_operationMode == recursive_delete && !filesToDelete.empty())
 		m_pState->m_pCommandQueue->ProcessCommand(new CDeleteCommand(pDirectoryListing->path, filesToDelete));
 
-	NextOperation();
+	if (m_operationMode == recursive_synchronize && m_pSynchronization)
+		m_pSynchronization->AddRemoteListing(pDirectoryListing->path, std::move(synchronizeEntries));
+}
+
+bool CRecursiveOperation::ProcessCachedListing(const CNewDir& dir)
+{
+	if (!CanListInParallel() || dir.link)
+		return false;
+
+	CServerPath path = dir.parent;
+	if (!dir.subdir.empty() && !path.AddSegment(dir.subdir))
+		return false;
+
+	CDirectoryListing listing;
+	bool is_outdated = false;
+	if (m_pState->m_pEngine->CacheLookup(path, listing, is_outdated) != FZ_REPLY_OK)
+		return false;
+
+	if (is_outdated || listing.failed() || listing.get_unsure_flags())
+		return false;
+
+	ProcessDirectoryListing(dir, listing);
+	return true;
 }
 
 void CRecursiveOperation::SetChmodDialog(CChmodDialog* pChmodDialog)
@@ -352,12 +451,29 @@ void CRecursiveOperation::StopRecursiveOperation()
 	}
 	m_dirsToVisit.clear();
 	m_visitedDirs.clear();
+	m_primaryBusy = false;
+
+	bool const hadListingEngines = !m_listingEngines.empty();
+	StopListingEngines();
+	if (hadListingEngines && m_pMainFrame->GetQueue())
+		m_pMainFrame->GetQueue()->ConnectionsClosed();
 
 	if (m_pChmodDlg)
 	{
 		m_pChmodDlg->Destroy();
 		m_pChmodDlg = 0;
 	}
+
+	if (m_pSynchronization)
+	{
+		m_pSynchronization->Stop();
+		m_pSynchronization = 0;
+	}
+}
+
+void CRecursiveOperation::SetSynchronization(CSynchronization* pSynchronization)
+{
+	m_pSynchronization = pSynchronization;
 }
 
 void CRecursiveOperation::ListingFailed(int error)
@@ -371,12 +487,18 @@ void CRecursiveOperation::ListingFailed(int error)
 		return;
 	}
 
-	wxASSERT(!m_dirsToVisit.empty());
-	if (m_dirsToVisit.empty())
+	wxASSERT(m_primaryBusy);
+	if (!m_primaryBusy)
 		return;
 
-	CNewDir dir = m_dirsToVisit.front();
-	m_dirsToVisit.pop_front();
+	m_primaryBusy = false;
+	RetryDirectory(m_primaryDir, error);
+
+	NextOperation();
+}
+
+void CRecursiveOperation::RetryDirectory(CNewDir dir, int error)
+{
 	if ((error & FZ_REPLY_CRITICALERROR) != FZ_REPLY_CRITICALERROR && !dir.second_try)
 	{
 		// Retry, could have been a temporary socket creating failure
@@ -384,8 +506,15 @@ void CRecursiveOperation::ListingFailed(int error)
 		dir.second_try = true;
 		m_dirsToVisit.push_front(dir);
 	}
-
-	NextOperation();
+	else if (m_operationMode == recursive_synchronize && m_pSynchronization)
+	{
+		// Giving up, the synchronization must not mistake it for an empty directory
+		CServerPath path = dir.parent;
+		if (dir.subdir.empty() || path.AddSegment(dir.subdir))
+			m_pSynchronization->RemoteListingFailed(path);
+		else
+			m_pSynchronization->RemoteListingFailed(dir.parent);
+	}
 }
 
 void CRecursiveOperation::SetQueue(CQueueView* pQueue)
@@ -408,12 +537,12 @@ void CRecursiveOperation::LinkIsNotDir()
 	if (m_operationMode == recursive_none)
 		return;
 
-	wxASSERT(!m_dirsToVisit.empty());
-	if (m_dirsToVisit.empty())
+	wxASSERT(m_primaryBusy);
+	if (!m_primaryBusy)
 		return;
 
-	CNewDir dir = m_dirsToVisit.front();
-	m_dirsToVisit.pop_front();
+	CNewDir dir = m_primaryDir;
+	m_primaryBusy = false;
 
 	const CServer* pServer = m_pState->GetServer();
 	if (!pServer)
@@ -433,7 +562,7 @@ void CRecursiveOperation::LinkIsNotDir()
 		NextOperation();
 		return;
 	}
-	else if (m_operationMode != recursive_list )
+	else if (m_operationMode != recursive_list && m_operationMode != recursive_synchronize)
 	{
 		CLocalPath localPath = dir.localDir;
 		wxString localFile = dir.subdir;
@@ -445,3 +574,205 @@ void CRecursiveOperation::LinkIsNotDir()
 
 	NextOperation();
 }
+
+bool CRecursiveOperation::CanListInParallel() const
+{
+	switch (m_operationMode)
+	{
+	case recursive_download:
+	case recursive_addtoqueue:
+	case recursive_download_flatten:
+	case recursive_addtoqueue_flatten:
+	case recursive_list:
+	case recursive_synchronize:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void CRecursiveOperation::StartListingEngines()
+{
+	if (!CanListInParallel())
+		return;
+
+	const CServer* pServer = m_pState->GetServer();
+	if (!pServer)
+		return;
+
+	// Passwords cannot be asked for once per engine
+	if (pServer->GetLogonType() == ASK || pServer->GetLogonType() == INTERACTIVE)
+		return;
+
+	// Directories with the link flag are left to the state's engine, only it
+	// reports if they turn out to be files.
+	auto nextDir = [this]() {
+		auto it = m_dirsToVisit.begin();
+		while (it != m_dirsToVisit.end() && it->link)
+			++it;
+		return it;
+	};
+
+	for (size_t i = 0; i < m_listingEngines.size(); )
+	{
+		if (m_listingEngines[i].busy || !m_listingEngines[i].connected)
+		{
+			++i;
+			continue;
+		}
+
+		auto it = nextDir();
+		if (it == m_dirsToVisit.end())
+			return;
+
+		CNewDir dir = *it;
+		m_dirsToVisit.erase(it);
+		if (ProcessCachedListing(dir))
+			continue;
+
+		t_listingEngine& listingEngine = m_listingEngines[i++];
+		listingEngine.dir = dir;
+		listingEngine.listedPath.clear();
+
+		int res = listingEngine.pEngine->Execute(CListCommand(listingEngine.dir.parent, listingEngine.dir.subdir));
+		if (res == FZ_REPLY_WOULDBLOCK)
+			listingEngine.busy = true;
+		else
+			RetryDirectory(listingEngine.dir, res);
+	}
+
+	// The state's engine counts as one of the connections. Only connect more
+	// engines if there is more than enough work for the existing ones.
+	int count = COptions::Get()->GetOptionVal(OPTION_NUMTRANSFERS);
+	if (pServer->MaximumMultipleConnections()) {
+		count = std::min(count, pServer->MaximumMultipleConnections());
+
+		// Transfers on the same server share the limit. The queue in turn
+		// counts these engines before starting more transfers.
+		if (m_pMainFrame->GetQueue())
+			count -= m_pMainFrame->GetQueue()->GetActiveTransferCount(*pServer);
+	}
+	--count;
+
+	int pending = 0;
+	for (auto it = nextDir(); it != m_dirsToVisit.end(); ++it)
+	{
+		if (!it->link)
+			++pending;
+	}
+	for (auto const& listingEngine : m_listingEngines)
+	{
+		if (!listingEngine.connected)
+			--pending;
+	}
+
+	while (pending > 0 && static_cast<int>(m_listingEngines.size()) < count)
+	{
+		if (!m_pListingEngineHandler)
+			m_pListingEngineHandler = new CListingEngineHandler(*this);
+
+		t_listingEngine listingEngine;
+		listingEngine.pEngine = new CFileZillaEngine(m_pMainFrame->GetEngineContext());
+		listingEngine.pEngine->Init(m_pListingEngineHandler);
+
+		if (listingEngine.pEngine->Execute(CConnectCommand(*pServer, false)) != FZ_REPLY_WOULDBLOCK)
+		{
+			delete listingEngine.pEngine;
+			return;
+		}
+
+		m_listingEngines.push_back(listingEngine);
+		--pending;
+	}
+}
+
+void CRecursiveOperation::StopListingEngines()
+{
+	for (auto & listingEngine : m_listingEngines)
+	{
+		if (m_pMainFrame->GetAsyncRequestQueue())
+			m_pMainFrame->GetAsyncRequestQueue()->ClearPending(listingEngine.pEngine);
+		delete listingEngine.pEngine;
+	}
+	m_listingEngines.clear();
+}
+
+void CRecursiveOperation::OnListingEngineEvent(CFileZillaEngine* pEngine)
+{
+	auto find = [this](CFileZillaEngine* pEngine) {
+		for (size_t i = 0; i < m_listingEngines.size(); ++i)
+		{
+			if (m_listingEngines[i].pEngine == pEngine)
+				return static_cast<int>(i);
+		}
+		return -1;
+	};
+
+	int index = find(pEngine);
+	if (index == -1)
+		return;
+
+	std::unique_ptr<CNotification> pNotification;
+	while ((pNotification = pEngine->GetNextNotification()))
+	{
+		switch (pNotification->GetID())
+		{
+		case nId_logmsg:
+			if (m_pMainFrame->GetStatusView())
+				m_pMainFrame->GetStatusView()->AddToLog(static_cast<CLogmsgNotification&>(*pNotification.get()));
+			break;
+		case nId_listing:
+			{
+				auto const& listingNotification = static_cast<CDirectoryListingNotification const&>(*pNotification.get());
+				if (!listingNotification.Failed())
+					m_listingEngines[index].listedPath = listingNotification.GetPath();
+			}
+			break;
+		case nId_asyncrequest:
+			if (m_pMainFrame->GetAsyncRequestQueue())
+				m_pMainFrame->GetAsyncRequestQueue()->AddRequest(pEngine, unique_static_cast<CAsyncRequestNotification>(std::move(pNotification)));
+			break;
+		case nId_operation:
+			{
+				int const replyCode = static_cast<COperationNotification const&>(*pNotification.get()).nReplyCode;
+
+				t_listingEngine const listingEngine = m_listingEngines[index];
+				if ((replyCode != FZ_REPLY_OK && !listingEngine.connected) || (replyCode & FZ_REPLY_DISCONNECTED) == FZ_REPLY_DISCONNECTED)
+				{
+					// Don't try to connect again, the directories are left to
+					// the remaining engines.
+					if (m_pMainFrame->GetAsyncRequestQueue())
+						m_pMainFrame->GetAsyncRequestQueue()->ClearPending(pEngine);
+					delete pEngine;
+					m_listingEngines.erase(m_listingEngines.begin() + index);
+					if (m_pMainFrame->GetQueue())
+						m_pMainFrame->GetQueue()->ConnectionsClosed();
+				}
+				else if (!listingEngine.connected)
+					m_listingEngines[index].connected = true;
+				else
+					m_listingEngines[index].busy = false;
+
+				if (listingEngine.busy)
+				{
+					CDirectoryListing listing;
+					if (replyCode == FZ_REPLY_OK && !listingEngine.listedPath.empty() &&
+						m_pState->IsRemoteConnected() &&
+						pEngine->CacheLookup(listingEngine.listedPath, listing) == FZ_REPLY_OK)
+						ProcessDirectoryListing(listingEngine.dir, listing);
+					else
+						RetryDirectory(listingEngine.dir, replyCode);
+				}
+				NextOperation();
+
+				// Processing the result may have stopped the operation
+				index = find(pEngine);
+				if (index == -1)
+					return;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
@@ -4,14 +4,18 @@
 #include "state.h"
 #include <set>
 #include "filter.h"
+#include "filter_matcher.h"
 
 class CChmodDialog;
+class CListingEngineHandler;
+class CMainFrame;
 class CQueueView;
+class CSynchronization;
 
 class CRecursiveOperation : public CStateEventHandler
 {
 public:
-	CRecursiveOperation(CState* pState);
+	CRecursiveOperation(CState* pState, CMainFrame* pMainFrame);
 	~CRecursiveOperation();
 
 	enum OperationMode
@@ -23,7 +27,8 @@ public:
 		recursive_addtoqueue_flatten,
 		recursive_delete,
 		recursive_chmod,
-		recursive_list
+		recursive_list,
+		recursive_synchronize
 	};
 
 	void StartRecursiveOperation(enum OperationMode mode, const CServerPath& startDir, const std::list<CFilter> &filters, bool allowParent = false, const CServerPath& finalDir = CServerPath());
@@ -34,9 +39,15 @@ public:
 
 	enum OperationMode GetOperationMode() const { return m_operationMode; }
 
+	// Connections to the server in addition to the one of the state's engine
+	int GetListingEngineCount() const { return static_cast<int>(m_listingEngines.size()); }
+
 	// Needed for recursive_chmod
 	void SetChmodDialog(CChmodDialog* pChmodDialog);
 
+	// Needed for recursive_synchronize
+	void SetSynchronization(CSynchronization* pSynchronization);
+
 	void ListingFailed(int error);
 	void LinkIsNotDir();
 
@@ -49,6 +60,13 @@ protected:
 	void ProcessDirectoryListing(const CDirectoryListing* pDirectoryListing);
 	bool NextOperation();
 
+	// Only operations which just read the remote tree list directories on
+	// additional engines. All others need the results in order.
+	bool CanListInParallel() const;
+	void StartListingEngines();
+	void StopListingEngines();
+	void OnListingEngineEvent(CFileZillaEngine* pEngine);
+
 	virtual void OnStateChange(CState* pState, enum t_statechange_notifications notification, const wxString&, const void* data2);
 
 	enum OperationMode m_operationMode;
@@ -79,21 +97,48 @@ protected:
 
 	bool BelowRecursionRoot(const CServerPath& path, CNewDir &dir);
 
+	void ProcessDirectoryListing(CNewDir dir, const CDirectoryListing& directoryListing);
+
+	// Fresh listings in the cache are used without listing the directory again
+	bool ProcessCachedListing(const CNewDir& dir);
+	void RetryDirectory(CNewDir dir, int error);
+
+	CMainFrame* const m_pMainFrame;
+
 	CServerPath m_startDir;
 	CServerPath m_finalDir;
 	std::set<CServerPath> m_visitedDirs;
 	std::list<CNewDir> m_dirsToVisit;
 
+	// The directory currently listed through the state's own engine
+	CNewDir m_primaryDir;
+	bool m_primaryBusy{};
+
+	struct t_listingEngine
+	{
+		CFileZillaEngine* pEngine{};
+		bool connected{};
+		bool busy{};
+		CNewDir dir;
+		CServerPath listedPath;
+	};
+	std::vector<t_listingEngine> m_listingEngines;
+	CListingEngineHandler* m_pListingEngineHandler{};
+
 	bool m_allowParent{};
 
 	// Needed for recursive_chmod
 	CChmodDialog* m_pChmodDlg{};
 
+	// Needed for recursive_synchronize
+	CSynchronization* m_pSynchronization{};
+
 	CQueueView* m_pQueue{};
 
-	std::list<CFilter> m_filters;
+	CFilterMatcher m_filters;
 
 	friend class CCommandQueue;
+	friend class CListingEngineHandler;
 };
 
 #endif //__RECURSIVE_OPERATION_H__
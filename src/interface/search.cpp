@@ -47,7 +47,7 @@ private:
 	virtual bool CanStartComparison(wxString*) { return false; }
 	virtual void StartComparison() {}
 	virtual bool GetNextFile(wxString&, bool &, wxLongLong &, CDateTime&) { return false; }
-	virtual void CompareAddFile(CComparableListing::t_fileEntryFlags) {}
+	virtual void CompareAddFile(CComparableListing::t_fileEntryFlags, int) {}
 	virtual void FinishComparison() {}
 	virtual void ScrollTopItem(int) {}
 	virtual void OnExitComparisonMode() {}
@@ -205,6 +205,7 @@ EVT_MENU(XRCID("ID_MENU_SEARCH_DOWNLOAD"), CSearchDialog::OnDownload)
 EVT_MENU(XRCID("ID_MENU_SEARCH_EDIT"), CSearchDialog::OnEdit)
 EVT_MENU(XRCID("ID_MENU_SEARCH_DELETE"), CSearchDialog::OnDelete)
 EVT_CHAR_HOOK(CSearchDialog::OnCharHook)
+EVT_TIMER(wxID_ANY, CSearchDialog::OnTimer)
 END_EVENT_TABLE()
 
 CSearchDialog::CSearchDialog(wxWindow* parent, CState* pState, CQueueView* pQueue)
@@ -215,6 +216,7 @@ CSearchDialog::CSearchDialog(wxWindow* parent, CState* pState, CQueueView* pQueu
 	, m_pWindowStateManager(0)
 	, m_searching(false)
 {
+	m_results_timer.SetOwner(this);
 }
 
 CSearchDialog::~CSearchDialog()
@@ -235,6 +237,10 @@ bool CSearchDialog::Load()
 	CFilelistStatusBar* pStatusBar = new CFilelistStatusBar(this);
 	pStatusBar->SetEmptyString(_("No search results"));
 
+	// Second field shows the search progress
+	const int widths[2] = { -2, -1 };
+	pStatusBar->SetFieldsCount(2, widths);
+
 	GetSizer()->Add(pStatusBar, 0, wxGROW);
 
 	if (!CreateListControl(filter_name | filter_size | filter_path | filter_date))
@@ -273,7 +279,7 @@ void CSearchDialog::Run()
 
 	m_pState->BlockHandlers(STATECHANGE_REMOTE_DIR);
 	m_pState->BlockHandlers(STATECHANGE_REMOTE_DIR_MODIFIED);
-	m_pState->RegisterHandler(this, STATECHANGE_REMOTE_DIR, false);
+	m_pState->RegisterHandler(this, STATECHANGE_REMOTE_RECURSION_LISTING, false);
 	m_pState->RegisterHandler(this, STATECHANGE_REMOTE_IDLE, false);
 
 	ShowModal();
@@ -281,7 +287,8 @@ void CSearchDialog::Run()
 	SaveConditions();
 
 	m_pState->UnregisterHandler(this, STATECHANGE_REMOTE_IDLE);
-	m_pState->UnregisterHandler(this, STATECHANGE_REMOTE_DIR);
+	m_pState->UnregisterHandler(this, STATECHANGE_REMOTE_RECURSION_LISTING);
+	m_results_timer.Stop();
 	m_pState->UnblockHandlers(STATECHANGE_REMOTE_DIR);
 	m_pState->UnblockHandlers(STATECHANGE_REMOTE_DIR_MODIFIED);
 
@@ -301,42 +308,46 @@ void CSearchDialog::Run()
 
 void CSearchDialog::OnStateChange(CState* pState, enum t_statechange_notifications notification, const wxString& data, const void* data2)
 {
-	if (notification == STATECHANGE_REMOTE_DIR)
-		ProcessDirectoryListing();
+	if (notification == STATECHANGE_REMOTE_RECURSION_LISTING)
+	{
+		wxASSERT(data2);
+		if (m_searching && data2)
+			ProcessDirectoryListing(*static_cast<const CDirectoryListing*>(data2));
+	}
 	else if (notification == STATECHANGE_REMOTE_IDLE)
 	{
-		if (pState->IsRemoteIdle())
+		if (pState->IsRemoteIdle() && m_searching) {
 			m_searching = false;
+			ShowResults();
+		}
 		SetCtrlState();
 	}
 }
 
-void CSearchDialog::ProcessDirectoryListing()
+void CSearchDialog::ProcessDirectoryListing(const CDirectoryListing& listing)
 {
-	std::shared_ptr<CDirectoryListing> listing = m_pState->GetRemoteDir();
-
-	if (!listing || listing->failed())
+	if (listing.failed())
 		return;
 
 	// Do not process same directory multiple times
-	if (!m_visited.insert(listing->path).second)
+	if (!m_visited.insert(listing.path).second)
 		return;
 
-	int old_count = m_results->m_fileData.size();
-	int added = 0;
+	++m_listed_dirs;
 
-	m_results->m_fileData.reserve(m_results->m_fileData.size() + listing->GetCount());
-	m_results->m_indexMapping.reserve(m_results->m_indexMapping.size() + listing->GetCount());
+	int const old_count = m_results->m_fileData.size();
+	int added = 0;
 
-	for (unsigned int i = 0; i < listing->GetCount(); ++i) {
-		const CDirentry& entry = (*listing)[i];
+	const wxString path = listing.path.GetPath();
+	for (unsigned int i = 0; i < listing.GetCount(); ++i) {
+		const CDirentry& entry = listing[i];
 
-		if (!CFilterManager::FilenameFilteredByFilter(m_search_filter, entry.name, listing->path.GetPath(), entry.is_dir(), entry.size, 0, entry.time))
+		if (!m_search_matcher.Matches(entry.name, path, entry.is_dir(), entry.size, 0, entry.time))
 			continue;
 
 		CSearchFileData data;
 		static_cast<CDirentry&>(data) = entry;
-		data.path = listing->path;
+		data.path = listing.path;
 		data.icon = entry.is_dir() ? m_results->m_dirIcon : -2;
 		m_results->m_fileData.push_back(data);
 		m_results->m_indexMapping.push_back(old_count + added++);
@@ -347,11 +358,36 @@ void CSearchDialog::ProcessDirectoryListing()
 			m_results->GetFilelistStatusBar()->AddFile(entry.size);
 	}
 
-	if (added) {
-		m_results->SetItemCount(old_count + added);
+	if (!m_results_timer.IsRunning())
+		m_results_timer.Start(250, true);
+}
+
+void CSearchDialog::ShowResults()
+{
+	m_results_timer.Stop();
+
+	if (m_results->GetItemCount() != static_cast<int>(m_results->m_indexMapping.size())) {
+		m_results->SetItemCount(m_results->m_indexMapping.size());
 		m_results->SortList(-1, -1, true);
 		m_results->RefreshListOnly(false);
 	}
+
+	wxString status;
+	long const elapsed = m_stop_watch.Time();
+	if (elapsed > 0)
+		status = wxString::Format(wxPLURAL("%d directory searched, %.1f per second", "%d directories searched, %.1f per second", m_listed_dirs), m_listed_dirs, m_listed_dirs * 1000.0 / elapsed);
+	else
+		status = wxString::Format(wxPLURAL("%d directory searched", "%d directories searched", m_listed_dirs), m_listed_dirs);
+	m_results->GetFilelistStatusBar()->SetStatusText(status, 1);
+}
+
+void CSearchDialog::OnTimer(wxTimerEvent&)
+{
+	ShowResults();
+
+	// Keep updating the speed even if nothing was found
+	if (m_searching)
+		m_results_timer.Start(1000, true);
 }
 
 void CSearchDialog::OnSearch(wxCommandEvent& event)
@@ -394,6 +430,7 @@ void CSearchDialog::OnSearch(wxCommandEvent& event)
 	m_search_filter.matchCase = xrc_call(*this, "ID_CASE", &wxCheckBox::GetValue);
 	m_search_filter.filterFiles = xrc_call(*this, "ID_FIND_FILES", &wxCheckBox::GetValue);
 	m_search_filter.filterDirs = xrc_call(*this, "ID_FIND_DIRS", &wxCheckBox::GetValue);
+	m_search_matcher = CFilterMatcher(std::vector<CFilter>(1, m_search_filter));
 
 	// Delete old results
 	m_results->ClearSelection();
@@ -404,6 +441,9 @@ void CSearchDialog::OnSearch(wxCommandEvent& event)
 	m_results->RefreshListOnly(true);
 
 	m_results->GetFilelistStatusBar()->Clear();
+	m_results->GetFilelistStatusBar()->SetStatusText(wxString(), 1);
+	m_listed_dirs = 0;
+	m_stop_watch.Start();
 
 	// Start
 	m_searching = true;
@@ -2,9 +2,13 @@
 #define __SEARCH_H__
 
 #include "filter_conditions_dialog.h"
+#include "filter_matcher.h"
 #include "state.h"
 #include <set>
 
+#include <wx/stopwatch.h>
+#include <wx/timer.h>
+
 class CWindowStateManager;
 class CSearchDialogFileList;
 class CQueueView;
@@ -20,7 +24,11 @@ public:
 	void Run();
 
 protected:
-	void ProcessDirectoryListing();
+	void ProcessDirectoryListing(const CDirectoryListing& listing);
+
+	// Results are shown in batches, re-sorting the list for every
+	// directory gets slow with many results.
+	void ShowResults();
 
 	void SetCtrlState();
 
@@ -36,6 +44,7 @@ protected:
 	CWindowStateManager* m_pWindowStateManager;
 
 	CFilter m_search_filter;
+	CFilterMatcher m_search_matcher;
 
 	bool m_searching;
 
@@ -52,10 +61,15 @@ protected:
 	void OnEdit(wxCommandEvent&);
 	void OnDelete(wxCommandEvent&);
 	void OnCharHook(wxKeyEvent& event);
+	void OnTimer(wxTimerEvent& event);
 
 	std::set<CServerPath> m_visited;
 
 	CServerPath m_search_root;
+
+	wxTimer m_results_timer;
+	wxStopWatch m_stop_watch;
+	int m_listed_dirs{};
 };
 
 #endif //__SEARCH_H__
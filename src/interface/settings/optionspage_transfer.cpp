@@ -41,6 +41,7 @@ bool COptionsPageTransfer::LoadPage()
 	XRCCTRL(*this, "ID_NUMTRANSFERS", wxSpinCtrl)->SetValue(m_pOptions->GetOptionVal(OPTION_NUMTRANSFERS));
 	XRCCTRL(*this, "ID_NUMDOWNLOADS", wxSpinCtrl)->SetValue(m_pOptions->GetOptionVal(OPTION_CONCURRENTDOWNLOADLIMIT));
 	XRCCTRL(*this, "ID_NUMUPLOADS", wxSpinCtrl)->SetValue(m_pOptions->GetOptionVal(OPTION_CONCURRENTUPLOADLIMIT));
+	XRCCTRL(*this, "ID_DOWNLOADSEGMENTS", wxSpinCtrl)->SetValue(m_pOptions->GetOptionVal(OPTION_DOWNLOAD_SEGMENTS));
 
 	SetChoice(XRCID("ID_BURSTTOLERANCE"), m_pOptions->GetOptionVal(OPTION_SPEEDLIMIT_BURSTTOLERANCE), failure);
 	XRCCTRL(*this, "ID_BURSTTOLERANCE", wxChoice)->Enable(enable_speedlimits);
@@ -82,6 +83,7 @@ bool COptionsPageTransfer::SavePage()
 	m_pOptions->SetOption(OPTION_NUMTRANSFERS,				XRCCTRL(*this, "ID_NUMTRANSFERS", wxSpinCtrl)->GetValue());
 	m_pOptions->SetOption(OPTION_CONCURRENTDOWNLOADLIMIT,	XRCCTRL(*this, "ID_NUMDOWNLOADS", wxSpinCtrl)->GetValue());
 	m_pOptions->SetOption(OPTION_CONCURRENTUPLOADLIMIT,		XRCCTRL(*this, "ID_NUMUPLOADS", wxSpinCtrl)->GetValue());
+	m_pOptions->SetOption(OPTION_DOWNLOAD_SEGMENTS,			XRCCTRL(*this, "ID_DOWNLOADSEGMENTS", wxSpinCtrl)->GetValue());
 
 	SetOptionFromText(XRCID("ID_DOWNLOADLIMIT"), OPTION_SPEEDLIMIT_INBOUND);
 	SetOptionFromText(XRCID("ID_UPLOADLIMIT"), OPTION_SPEEDLIMIT_OUTBOUND);
@@ -116,6 +118,11 @@ bool COptionsPageTransfer::Validate()
 	if (spinValue < 0 || spinValue > 10)
 		return DisplayError(pSpinCtrl, _("Please enter a number between 0 and 10 for the number of concurrent uploads."));
 
+	pSpinCtrl = XRCCTRL(*this, "ID_DOWNLOADSEGMENTS", wxSpinCtrl);
+	spinValue = pSpinCtrl->GetValue();
+	if (spinValue < 1 || spinValue > 10)
+		return DisplayError(pSpinCtrl, _("Please enter a number between 1 and 10 for the number of connections per download."));
+
 	pCtrl = XRCCTRL(*this, "ID_DOWNLOADLIMIT", wxTextCtrl);
 	if (!pCtrl->GetValue().ToLong(&tmp) || (tmp < 0))
 	{
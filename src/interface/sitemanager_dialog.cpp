@@ -35,6 +35,7 @@ EVT_CHOICE(XRCID("ID_LOGONTYPE"), CSiteManagerDialog::OnLogontypeSelChanged)
 EVT_BUTTON(XRCID("ID_BROWSE"), CSiteManagerDialog::OnRemoteDirBrowse)
 EVT_TREE_ITEM_ACTIVATED(XRCID("ID_SITETREE"), CSiteManagerDialog::OnItemActivated)
 EVT_CHECKBOX(XRCID("ID_LIMITMULTIPLE"), CSiteManagerDialog::OnLimitMultipleConnectionsChanged)
+EVT_CHECKBOX(XRCID("ID_COMPRESSION"), CSiteManagerDialog::OnCompressionChanged)
 EVT_RADIOBUTTON(XRCID("ID_CHARSET_AUTO"), CSiteManagerDialog::OnCharsetChange)
 EVT_RADIOBUTTON(XRCID("ID_CHARSET_UTF8"), CSiteManagerDialog::OnCharsetChange)
 EVT_RADIOBUTTON(XRCID("ID_CHARSET_CUSTOM"), CSiteManagerDialog::OnCharsetChange)
@@ -1397,6 +1398,11 @@ bool CSiteManagerDialog::UpdateServer(CSiteManagerItemData_Site &server, const w
 	else
 		server.m_server.MaximumMultipleConnections(0);
 
+	if (XRCCTRL(*this, "ID_COMPRESSION", wxCheckBox)->GetValue())
+		server.m_server.SetCompressionLevel(XRCCTRL(*this, "ID_COMPRESSION_LEVEL", wxSpinCtrl)->GetValue());
+	else
+		server.m_server.SetCompressionLevel(0);
+
 	if (XRCCTRL(*this, "ID_CHARSET_UTF8", wxRadioButton)->GetValue())
 		server.m_server.SetEncodingType(ENCODING_UTF8);
 	else if (XRCCTRL(*this, "ID_CHARSET_CUSTOM", wxRadioButton)->GetValue())
@@ -1498,6 +1504,11 @@ void CSiteManagerDialog::OnLimitMultipleConnectionsChanged(wxCommandEvent& event
 	XRCCTRL(*this, "ID_MAXMULTIPLE", wxSpinCtrl)->Enable(event.IsChecked());
 }
 
+void CSiteManagerDialog::OnCompressionChanged(wxCommandEvent& event)
+{
+	XRCCTRL(*this, "ID_COMPRESSION_LEVEL", wxSpinCtrl)->Enable(event.IsChecked());
+}
+
 void CSiteManagerDialog::SetCtrlState()
 {
 	wxTreeCtrl *pTree = XRCCTRL(*this, "ID_SITETREE", wxTreeCtrl);
@@ -1554,6 +1565,8 @@ void CSiteManagerDialog::SetCtrlState()
 		XRCCTRL(*this, "ID_TRANSFERMODE_DEFAULT", wxRadioButton)->SetValue(true);
 		XRCCTRL(*this, "ID_LIMITMULTIPLE", wxCheckBox)->SetValue(false);
 		XRCCTRL(*this, "ID_MAXMULTIPLE", wxSpinCtrl)->SetValue(1);
+		XRCCTRL(*this, "ID_COMPRESSION", wxCheckBox)->SetValue(false);
+		XRCCTRL(*this, "ID_COMPRESSION_LEVEL", wxSpinCtrl)->SetValue(1);
 
 		XRCCTRL(*this, "ID_CHARSET_AUTO", wxRadioButton)->SetValue(true);
 		XRCCTRL(*this, "ID_ENCODING", wxTextCtrl)->SetValue(_T(""));
@@ -1645,6 +1658,12 @@ void CSiteManagerDialog::SetCtrlState()
 			XRCCTRL(*this, "ID_MAXMULTIPLE", wxSpinCtrl)->SetValue(1);
 		}
 
+		int compressionLevel = site_data->m_server.GetCompressionLevel();
+		XRCCTRL(*this, "ID_COMPRESSION", wxCheckBox)->SetValue(compressionLevel != 0);
+		XRCCTRL(*this, "ID_COMPRESSION", wxWindow)->Enable(!predefined);
+		XRCCTRL(*this, "ID_COMPRESSION_LEVEL", wxSpinCtrl)->Enable(!predefined && compressionLevel != 0);
+		XRCCTRL(*this, "ID_COMPRESSION_LEVEL", wxSpinCtrl)->SetValue(compressionLevel != 0 ? compressionLevel : 1);
+
 		switch (site_data->m_server.GetEncodingType())
 		{
 		default:
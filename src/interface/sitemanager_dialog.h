@@ -79,6 +79,7 @@ protected:
 	void OnRemoteDirBrowse(wxCommandEvent& event);
 	void OnItemActivated(wxTreeEvent& event);
 	void OnLimitMultipleConnectionsChanged(wxCommandEvent& event);
+	void OnCompressionChanged(wxCommandEvent& event);
 	void OnCharsetChange(wxCommandEvent& event);
 	void OnProtocolSelChanged(wxCommandEvent& event);
 	void OnBeginDrag(wxTreeEvent& event);
@@ -7,6 +7,7 @@
 #include "queue.h"
 #include "filezillaapp.h"
 #include "recursive_operation.h"
+#include "synchronization.h"
 #include "statusbar.h"
 #include "local_filesys.h"
 #include "listingcomparison.h"
@@ -203,7 +204,8 @@ CState::CState(CMainFrame* pMainFrame)
 	m_pCommandQueue = 0;
 	m_pComparisonManager = new CComparisonManager(this);
 
-	m_pRecursiveOperation = new CRecursiveOperation(this);
+	m_pRecursiveOperation = new CRecursiveOperation(this, pMainFrame);
+	m_pSynchronization = new CSynchronization(this, pMainFrame);
 
 	m_sync_browse.is_changing = false;
 	m_sync_browse.compare = false;
@@ -232,6 +234,7 @@ CState::~CState()
 	}
 
 	delete m_pRecursiveOperation;
+	delete m_pSynchronization;
 }
 
 CLocalPath CState::GetLocalDir() const
@@ -479,7 +482,8 @@ void CState::SetServer(const CServer* server)
 	if (m_pServer) {
 		if (server && *server == *m_pServer &&
 			server->GetName() == m_pServer->GetName() &&
-			server->MaximumMultipleConnections() == m_pServer->MaximumMultipleConnections())
+			server->MaximumMultipleConnections() == m_pServer->MaximumMultipleConnections() &&
+			server->GetCompressionLevel() == m_pServer->GetCompressionLevel())
 		{
 			// Nothing changes
 			return;
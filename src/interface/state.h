@@ -14,6 +14,11 @@ enum t_statechange_notifications
 	STATECHANGE_REMOTE_RECV,
 	STATECHANGE_REMOTE_SEND,
 	STATECHANGE_REMOTE_LINKNOTDIR,
+
+	// data2 is the CDirectoryListing of each directory visited by a
+	// recursive operation, no matter which engine listed it
+	STATECHANGE_REMOTE_RECURSION_LISTING,
+
 	STATECHANGE_LOCAL_DIR,
 
 	// data contains name (excluding path) of file to refresh
@@ -44,6 +49,7 @@ class CMainFrame;
 class CStateEventHandler;
 class CRemoteDataObject;
 class CRecursiveOperation;
+class CSynchronization;
 class CComparisonManager;
 
 class CState;
@@ -146,6 +152,7 @@ public:
 	bool IsRemoteIdle() const;
 
 	CRecursiveOperation* GetRecursiveOperationHandler() { return m_pRecursiveOperation; }
+	CSynchronization* GetSynchronization() { return m_pSynchronization; }
 
 	void NotifyHandlers(enum t_statechange_notifications notification, const wxString& data = _T(""), const void* data2 = 0);
 
@@ -191,6 +198,7 @@ protected:
 	CMainFrame* m_pMainFrame;
 
 	CRecursiveOperation* m_pRecursiveOperation;
+	CSynchronization* m_pSynchronization;
 
 	CComparisonManager* m_pComparisonManager;
 
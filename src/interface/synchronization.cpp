@@ -0,0 +1,390 @@
+#include <filezilla.h>
+#include "synchronization.h"
+#include "filter_matcher.h"
+#include "local_filesys.h"
+#include "Mainfrm.h"
+#include "Options.h"
+#include "queue.h"
+#include "recursive_operation.h"
+#include "sizeformatting.h"
+#include "state.h"
+#include "StatusView.h"
+
+#include <wx/tokenzr.h>
+
+#include <deque>
+
+DECLARE_EVENT_TYPE(fzEVT_LOCALTREESCAN_COMPLETE, -1)
+DEFINE_EVENT_TYPE(fzEVT_LOCALTREESCAN_COMPLETE)
+
+BEGIN_EVENT_TABLE(CSynchronization, wxEvtHandler)
+EVT_COMMAND(wxID_ANY, fzEVT_LOCALTREESCAN_COMPLETE, CSynchronization::OnLocalScanComplete)
+END_EVENT_TABLE()
+
+// Lists a local directory tree into a CComparisonEngine::tree
+class CLocalTreeScanner final : public wxThread
+{
+public:
+	CLocalTreeScanner(wxEvtHandler* pOwner, CLocalPath const& root, std::list<CFilter> const& filters)
+		: wxThread(wxTHREAD_JOINABLE)
+		, m_pOwner(pOwner)
+		, m_root(root)
+	{
+		// wxRegEx isn't thread-safe, use our own ones.
+		std::vector<CFilter> ownFilters(filters.begin(), filters.end());
+		for (auto & filter : ownFilters)
+			CFilterManager::CompileRegexes(filter);
+		m_filters = CFilterMatcher(ownFilters);
+	}
+
+	void Stop()
+	{
+		m_stop = true;
+	}
+
+	CComparisonEngine::tree& GetTree() { return m_tree; }
+	CComparisonEngine::unknown_dirs& GetFailed() { return m_failed; }
+
+protected:
+	virtual ExitCode Entry()
+	{
+		std::deque<std::pair<wxString, CLocalPath>> dirs;
+		dirs.emplace_back(wxString(), m_root);
+
+		CLocalFileSystem local_filesystem;
+
+		while (!dirs.empty() && !m_stop) {
+			wxString const relative = dirs.front().first;
+			CLocalPath const path = dirs.front().second;
+			dirs.pop_front();
+
+			if (!local_filesystem.BeginFindFiles(path.GetPath(), false)) {
+				m_failed.insert(relative);
+				continue;
+			}
+
+			std::vector<CComparisonEntry>& entries = m_tree[relative];
+
+			CComparisonEntry entry;
+			bool is_link;
+			int attributes;
+			while (local_filesystem.GetNextFile(entry.name, is_link, entry.dir, &entry.size, &entry.date, &attributes)) {
+				if (is_link)
+					continue;
+
+				if (m_filters.Matches(entry.name, path.GetPath(), entry.dir, entry.size, attributes, entry.date))
+					continue;
+
+				if (entry.dir) {
+					CLocalPath subdir = path;
+					subdir.AddSegment(entry.name);
+					dirs.emplace_back(relative + entry.name + _T("/"), subdir);
+				}
+				entries.push_back(entry);
+			}
+		}
+
+		m_pOwner->QueueEvent(new wxCommandEvent(fzEVT_LOCALTREESCAN_COMPLETE, wxID_ANY));
+		return 0;
+	}
+
+	wxEvtHandler* const m_pOwner;
+	CLocalPath const m_root;
+	CFilterMatcher m_filters;
+
+	CComparisonEngine::tree m_tree;
+	CComparisonEngine::unknown_dirs m_failed;
+
+	volatile bool m_stop{};
+};
+
+CSynchronization::CSynchronization(CState* pState, CMainFrame* pMainFrame)
+	: m_pState(pState)
+	, m_pMainFrame(pMainFrame)
+{
+}
+
+CSynchronization::~CSynchronization()
+{
+	// Too late to log anything
+	m_running = false;
+	Stop();
+}
+
+bool CSynchronization::Start(bool download, bool dryRun)
+{
+	if (m_running || !m_pMainFrame->GetQueue())
+		return false;
+
+	if (!m_pState->IsRemoteConnected() || !m_pState->IsRemoteIdle())
+		return false;
+
+	auto const pListing = m_pState->GetRemoteDir();
+	if (!pListing)
+		return false;
+
+	CRecursiveOperation* pRecursiveOperation = m_pState->GetRecursiveOperationHandler();
+	if (!pRecursiveOperation || pRecursiveOperation->GetOperationMode() != CRecursiveOperation::recursive_none)
+		return false;
+
+	m_download = download;
+	m_dryRun = dryRun;
+	m_localRoot = m_pState->GetLocalDir();
+	m_remoteRoot = pListing->path;
+
+	m_localTree.clear();
+	m_remoteTree.clear();
+	m_localFailed.clear();
+	m_remoteFailed.clear();
+	m_localComplete = false;
+	m_remoteComplete = false;
+	m_localTime = 0;
+	m_remoteTime = 0;
+
+	CFilterManager filter;
+
+	m_pScanner = new CLocalTreeScanner(this, m_localRoot, filter.GetActiveFilters(true));
+	if (m_pScanner->Create() != wxTHREAD_NO_ERROR || m_pScanner->Run() != wxTHREAD_NO_ERROR) {
+		delete m_pScanner;
+		m_pScanner = 0;
+		return false;
+	}
+
+	m_running = true;
+	m_stopWatch.Start();
+
+	Log(wxString::Format(_("Comparing local directory \"%s\" and remote directory \"%s\""), m_localRoot.GetPath(), m_remoteRoot.GetPath()));
+
+	pRecursiveOperation->SetSynchronization(this);
+	pRecursiveOperation->AddDirectoryToVisit(m_remoteRoot, wxString());
+	pRecursiveOperation->StartRecursiveOperation(CRecursiveOperation::recursive_synchronize, m_remoteRoot, filter.GetActiveFilters(false), true);
+
+	return true;
+}
+
+void CSynchronization::Stop()
+{
+	if (m_pScanner) {
+		m_pScanner->Stop();
+		m_pScanner->Wait();
+		delete m_pScanner;
+		m_pScanner = 0;
+	}
+
+	if (m_running) {
+		m_running = false;
+		Log(_("Synchronization aborted"));
+	}
+
+	m_localTree.clear();
+	m_remoteTree.clear();
+	m_localFailed.clear();
+	m_remoteFailed.clear();
+}
+
+void CSynchronization::AddRemoteListing(CServerPath const& path, std::vector<CComparisonEntry> && entries)
+{
+	if (!m_running)
+		return;
+
+	m_remoteTree[GetRelativePath(path)] = std::move(entries);
+}
+
+void CSynchronization::RemoteListingFailed(CServerPath const& path)
+{
+	if (!m_running)
+		return;
+
+	// Paths outside of the root map to the root itself, skipping everything
+	// is the safe choice then.
+	m_remoteFailed.insert(GetRelativePath(path));
+}
+
+void CSynchronization::RemoteListingComplete()
+{
+	if (!m_running)
+		return;
+
+	m_remoteComplete = true;
+	m_remoteTime = m_stopWatch.Time();
+
+	if (m_localComplete)
+		Finish();
+}
+
+void CSynchronization::OnLocalScanComplete(wxCommandEvent&)
+{
+	if (!m_pScanner)
+		return;
+
+	m_pScanner->Wait();
+	m_localTree.swap(m_pScanner->GetTree());
+	m_localFailed.swap(m_pScanner->GetFailed());
+	delete m_pScanner;
+	m_pScanner = 0;
+
+	if (!m_running)
+		return;
+
+	m_localComplete = true;
+	m_localTime = m_stopWatch.Time();
+
+	if (m_remoteComplete)
+		Finish();
+}
+
+void CSynchronization::Finish()
+{
+	m_running = false;
+
+	long const start = m_stopWatch.Time();
+
+	const int mode = COptions::Get()->GetOptionVal(OPTION_COMPARISONMODE);
+	const wxTimeSpan threshold = wxTimeSpan::Minutes(COptions::Get()->GetOptionVal(OPTION_COMPARISON_THRESHOLD));
+
+	// A directory that could not be listed would look empty, its contents on
+	// the other side would then overwrite whatever is really there.
+	for (auto const& relative : m_localFailed)
+		Log(wxString::Format(_("Could not list local directory \"%s\", skipping it"), GetLocalPath(relative).GetPath()));
+	for (auto const& relative : m_remoteFailed)
+		Log(wxString::Format(_("Could not list remote directory \"%s\", skipping it"), GetRemotePath(relative).GetPath()));
+
+	// Sizes always get compared, dates only if the user compares them
+	CComparisonEngine engine(true, mode != 0, threshold);
+	auto const differences = engine.CompareTrees(m_localTree, m_remoteTree, m_localFailed, m_remoteFailed);
+
+	long const compareTime = m_stopWatch.Time() - start;
+
+	wxLongLong totalSize = 0;
+	int const count = Queue(differences, totalSize);
+
+	Log(wxString::Format(_("Listed %d local directories in %ld ms and %d remote directories in %ld ms, compared in %ld ms"),
+		static_cast<int>(m_localTree.size()), m_localTime, static_cast<int>(m_remoteTree.size()), m_remoteTime, compareTime));
+
+	wxString const size = CSizeFormat::Format(totalSize, true);
+	if (m_dryRun)
+		Log(wxString::Format(wxPLURAL("%d file with %s would be transferred", "%d files with %s would be transferred", count), count, size));
+	else
+		Log(wxString::Format(wxPLURAL("%d file with %s queued for transfer", "%d files with %s queued for transfer", count), count, size));
+
+	m_localTree.clear();
+	m_remoteTree.clear();
+	m_localFailed.clear();
+	m_remoteFailed.clear();
+}
+
+int CSynchronization::Queue(std::vector<CComparisonEngine::difference> const& differences, wxLongLong& totalSize)
+{
+	const CServer* pServer = m_pState->GetServer();
+	CQueueView* pQueue = m_pMainFrame->GetQueue();
+	if (!pServer || !pQueue)
+		return 0;
+
+	int count = 0;
+	for (auto const& d : differences) {
+		// Local is left, remote is right
+		CComparisonEntry const* source = m_download ? d.right : d.left;
+		CComparisonEntry const* target = m_download ? d.left : d.right;
+		if (!source)
+			continue;
+
+		if (target) {
+			bool const sourceNewer = m_download ? (d.r.rightFlags == CComparisonEngine::newer) : (d.r.leftFlags == CComparisonEngine::newer);
+			bool const targetNewer = m_download ? (d.r.leftFlags == CComparisonEngine::newer) : (d.r.rightFlags == CComparisonEngine::newer);
+
+			// Never overwrite newer files
+			if (targetNewer || (!sourceNewer && source->size == target->size))
+				continue;
+		}
+
+		wxString const& sourcePath = m_download ? d.rightPath : d.leftPath;
+		wxString const& targetPath = m_download ? d.leftPath : d.rightPath;
+
+		if (source->dir) {
+			// Only needed for empty directories, everything else creates its
+			// directory anyhow.
+			auto const& sourceTree = m_download ? m_remoteTree : m_localTree;
+			auto const it = sourceTree.find(sourcePath + source->name + _T("/"));
+			if (it != sourceTree.end() && !it->second.empty())
+				continue;
+
+			if (m_dryRun)
+				Log(wxString::Format(_("Would create directory \"%s\""), targetPath + source->name));
+			else if (m_download) {
+				CLocalPath localPath = GetLocalPath(targetPath);
+				localPath.AddSegment(CQueueView::ReplaceInvalidCharacters(source->name));
+				pQueue->QueueFile(true, true, _T(""), _T(""), localPath, CServerPath(), *pServer, -1);
+			}
+			else
+				pQueue->QueueFile(true, false, _T(""), source->name, CLocalPath(), GetRemotePath(targetPath), *pServer, -1);
+			continue;
+		}
+
+		++count;
+		if (source->size > 0)
+			totalSize += source->size;
+
+		if (m_dryRun) {
+			Log(wxString::Format(m_download ? _("Would download \"%s\"") : _("Would upload \"%s\""), sourcePath + source->name));
+			continue;
+		}
+
+		if (m_download) {
+			wxString const localFile = CQueueView::ReplaceInvalidCharacters(source->name);
+			pQueue->QueueFile(true, true, source->name, (source->name == localFile) ? wxString() : localFile,
+				GetLocalPath(targetPath), GetRemotePath(sourcePath), *pServer, source->size,
+				CEditHandler::none, QueuePriority::normal, CFileExistsNotification::overwrite);
+		}
+		else {
+			pQueue->QueueFile(true, false, source->name, wxString(),
+				GetLocalPath(sourcePath), GetRemotePath(targetPath), *pServer, source->size,
+				CEditHandler::none, QueuePriority::normal, CFileExistsNotification::overwrite);
+		}
+	}
+
+	if (!m_dryRun)
+		pQueue->QueueFile_Finish(true);
+
+	return count;
+}
+
+wxString CSynchronization::GetRelativePath(CServerPath path) const
+{
+	wxString relative;
+	while (path != m_remoteRoot) {
+		if (!path.HasParent())
+			return wxString();
+		relative = path.GetLastSegment() + _T("/") + relative;
+		path = path.GetParent();
+	}
+
+	return relative;
+}
+
+CLocalPath CSynchronization::GetLocalPath(wxString const& relative) const
+{
+	CLocalPath path = m_localRoot;
+
+	wxStringTokenizer tokens(relative, _T("/"), wxTOKEN_STRTOK);
+	while (tokens.HasMoreTokens())
+		path.AddSegment(tokens.GetNextToken());
+
+	return path;
+}
+
+CServerPath CSynchronization::GetRemotePath(wxString const& relative) const
+{
+	CServerPath path = m_remoteRoot;
+
+	wxStringTokenizer tokens(relative, _T("/"), wxTOKEN_STRTOK);
+	while (tokens.HasMoreTokens())
+		path.AddSegment(tokens.GetNextToken());
+
+	return path;
+}
+
+void CSynchronization::Log(wxString const& message)
+{
+	if (m_pMainFrame->GetStatusView())
+		m_pMainFrame->GetStatusView()->AddToLog(MessageType::Status, message, wxDateTime::Now());
+}
@@ -0,0 +1,75 @@
+#ifndef __SYNCHRONIZATION_H__
+#define __SYNCHRONIZATION_H__
+
+#include "comparison_engine.h"
+#include "filter.h"
+
+#include <wx/stopwatch.h>
+
+class CLocalTreeScanner;
+class CMainFrame;
+class CState;
+
+// Makes one side of the current local and remote directory the same as the
+// other. Both trees get walked at the same time: the remote one through
+// CRecursiveOperation, the local one on a worker thread. Once both are
+// complete, only the files which are missing or differ in size or are newer
+// on the source side get queued, all in one batch. Nothing gets deleted.
+// Directories which could not be listed on either side get skipped.
+//
+// With a dry run, the files that would be transferred only get logged.
+class CSynchronization final : public wxEvtHandler
+{
+public:
+	CSynchronization(CState* pState, CMainFrame* pMainFrame);
+	virtual ~CSynchronization();
+
+	// Uses the current local and remote directory
+	bool Start(bool download, bool dryRun);
+	void Stop();
+
+	bool IsRunning() const { return m_running; }
+
+	// Called by CRecursiveOperation for each listed remote directory
+	void AddRemoteListing(CServerPath const& path, std::vector<CComparisonEntry> && entries);
+	void RemoteListingFailed(CServerPath const& path);
+	void RemoteListingComplete();
+
+protected:
+	void OnLocalScanComplete(wxCommandEvent& event);
+
+	void Finish();
+	int Queue(std::vector<CComparisonEngine::difference> const& differences, wxLongLong& totalSize);
+
+	wxString GetRelativePath(CServerPath path) const;
+	CLocalPath GetLocalPath(wxString const& relative) const;
+	CServerPath GetRemotePath(wxString const& relative) const;
+
+	void Log(wxString const& message);
+
+	CState* const m_pState;
+	CMainFrame* const m_pMainFrame;
+
+	bool m_running{};
+	bool m_download{};
+	bool m_dryRun{};
+
+	CLocalPath m_localRoot;
+	CServerPath m_remoteRoot;
+
+	CLocalTreeScanner* m_pScanner{};
+	CComparisonEngine::tree m_localTree;
+	CComparisonEngine::tree m_remoteTree;
+	CComparisonEngine::unknown_dirs m_localFailed;
+	CComparisonEngine::unknown_dirs m_remoteFailed;
+	bool m_localComplete{};
+	bool m_remoteComplete{};
+
+	wxStopWatch m_stopWatch;
+	long m_localTime{};
+	long m_remoteTime{};
+
+	DECLARE_EVENT_TABLE()
+};
+
+#endif //__SYNCHRONIZATION_H__
@@ -550,6 +550,8 @@ bool GetServer(TiXmlElement *node, CServer& server)
 	int maximumMultipleConnections = GetTextElementInt(node, "MaximumMultipleConnections");
 	server.MaximumMultipleConnections(maximumMultipleConnections);
 
+	server.SetCompressionLevel(GetTextElementInt(node, "CompressionLevel"));
+
 	wxString encodingType = GetTextElement(node, "EncodingType");
 	if (encodingType == _T("Auto"))
 		server.SetEncodingType(ENCODING_AUTO);
@@ -644,6 +646,7 @@ void SetServer(TiXmlElement *node, const CServer& server)
 		break;
 	}
 	AddTextElement(node, "MaximumMultipleConnections", server.MaximumMultipleConnections());
+	AddTextElement(node, "CompressionLevel", server.GetCompressionLevel());
 
 	switch (server.GetEncodingType())
 	{
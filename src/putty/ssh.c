@@ -434,9 +434,14 @@ const static struct ssh_compress ssh_comp_none = {
     ssh_comp_none_init, ssh_comp_none_cleanup, ssh_comp_none_block,
     ssh_comp_none_disable, NULL
 };
-extern const struct ssh_compress ssh_zlib;
+/* The zlib implementation used for both SSH-1 and SSH-2. */
+#ifdef USE_SYSTEM_ZLIB
+#define ssh_zlib_impl ssh_zlib_system
+#else
+#define ssh_zlib_impl ssh_zlib
+#endif
 const static struct ssh_compress *compressions[] = {
-    &ssh_zlib, &ssh_comp_none
+    &ssh_zlib_impl, &ssh_comp_none
 };
 
 enum {				       /* channel types */
@@ -1502,9 +1507,9 @@ static struct Packet *ssh1_rdpkt(Ssh ssh, unsigned char **data, int *datalen)
     if (ssh->v1_compressing) {
 	unsigned char *decompblk;
 	int decomplen;
-	if (!zlib_decompress_block(ssh->sc_comp_ctx,
-				   st->pktin->body - 1, st->pktin->length + 1,
-				   &decompblk, &decomplen)) {
+	if (!ssh_zlib_impl.decompress(ssh->sc_comp_ctx,
+				      st->pktin->body - 1, st->pktin->length + 1,
+				      &decompblk, &decomplen)) {
 	    bombout(("Zlib decompression encountered invalid data"));
 	    ssh_free_packet(st->pktin);
 	    crStop(NULL);
@@ -1705,8 +1710,60 @@ static struct Packet *ssh2_rdpkt(Ssh ssh, unsigned char **data, int *datalen)
 	st->cipherblk = 8;
     st->maclen = ssh->scmac ? ssh->scmac->len : 0;
 
-    if (ssh->sccipher && (ssh->sccipher->flags & SSH_CIPHER_IS_CBC) &&
-	ssh->scmac) {
+    if (ssh->sccipher && (ssh->sccipher->flags & SSH_CIPHER_IS_AEAD)) {
+	/*
+	 * An AEAD cipher authenticates and decrypts the whole packet
+	 * in one pass once it has all arrived, so we only need the
+	 * length up front. Nothing else is used before the tag has
+	 * been checked.
+	 */
+	st->maclen = ssh->sccipher->taglen;
+	st->pktin->data = snewn(4 + APIEXTRA, unsigned char);
+
+	for (st->i = 0; st->i < 4; st->i++) {
+	    while ((*datalen) == 0)
+		crReturn(NULL);
+	    st->pktin->data[st->i] = *(*data)++;
+	    (*datalen)--;
+	}
+
+	{
+	    unsigned char lenbuf[4];
+	    ssh->sccipher->decrypt_length(ssh->sc_cipher_ctx,
+					  st->pktin->data, lenbuf,
+					  st->incoming_sequence);
+	    st->len = toint(GET_32BIT(lenbuf));
+	}
+
+	if (st->len < 0 || st->len > OUR_V2_PACKETLIMIT ||
+	    st->len % st->cipherblk != 0) {
+	    bombout(("Incoming packet length field was garbled"));
+	    ssh_free_packet(st->pktin);
+	    crStop(NULL);
+	}
+
+	st->packetlen = st->len + 4;
+	st->pktin->maxlen = st->packetlen + st->maclen;
+	st->pktin->data = sresize(st->pktin->data,
+				  st->pktin->maxlen + APIEXTRA,
+				  unsigned char);
+
+	for (st->i = 4; st->i < st->packetlen + st->maclen; st->i++) {
+	    while ((*datalen) == 0)
+		crReturn(NULL);
+	    st->pktin->data[st->i] = *(*data)++;
+	    (*datalen)--;
+	}
+
+	if (!ssh->sccipher->decrypt_pkt(ssh->sc_cipher_ctx, st->pktin->data,
+					st->packetlen,
+					st->incoming_sequence)) {
+	    bombout(("Incorrect MAC received on packet"));
+	    ssh_free_packet(st->pktin);
+	    crStop(NULL);
+	}
+    } else if (ssh->sccipher && (ssh->sccipher->flags & SSH_CIPHER_IS_CBC) &&
+	       ssh->scmac) {
 	/*
 	 * When dealing with a CBC-mode cipher, we want to avoid the
 	 * possibility of an attacker's tweaking the ciphertext stream
@@ -1985,9 +2042,9 @@ static int s_wrpkt_prepare(Ssh ssh, struct Packet *pkt, int *offset_p)
     if (ssh->v1_compressing) {
 	unsigned char *compblk;
 	int complen;
-	zlib_compress_block(ssh->cs_comp_ctx,
-			    pkt->data + 12, pkt->length - 12,
-			    &compblk, &complen);
+	ssh_zlib_impl.compress(ssh->cs_comp_ctx,
+			       pkt->data + 12, pkt->length - 12,
+			       &compblk, &complen);
 	ssh_pkt_ensure(pkt, complen + 2);   /* just in case it's got bigger */
 	memcpy(pkt->data + 12, compblk, complen);
 	sfree(compblk);
@@ -2286,7 +2343,7 @@ static struct Packet *ssh2_pkt_init(int pkt_type)
  */
 static int ssh2_pkt_construct(Ssh ssh, struct Packet *pkt)
 {
-    int cipherblk, maclen, padding, i;
+    int cipherblk, maclen, padding, unpadded, aead, i;
 
     if (ssh->logctx)
         ssh2_log_outgoing_packet(ssh, pkt);
@@ -2326,27 +2383,40 @@ static int ssh2_pkt_construct(Ssh ssh, struct Packet *pkt)
      */
     cipherblk = ssh->cscipher ? ssh->cscipher->blksize : 8;  /* block size */
     cipherblk = cipherblk < 8 ? 8 : cipherblk;	/* or 8 if blksize < 8 */
+    aead = ssh->cscipher && (ssh->cscipher->flags & SSH_CIPHER_IS_AEAD);
+    /* AEAD ciphers don't encrypt the length field as part of a block. */
+    unpadded = aead ? pkt->length - 4 : pkt->length;
     padding = 4;
     if (pkt->length + padding < pkt->forcepad)
 	padding = pkt->forcepad - pkt->length;
     padding +=
-	(cipherblk - (pkt->length + padding) % cipherblk) % cipherblk;
+	(cipherblk - (unpadded + padding) % cipherblk) % cipherblk;
     assert(padding <= 255);
-    maclen = ssh->csmac ? ssh->csmac->len : 0;
+    if (aead)
+	maclen = ssh->cscipher->taglen;
+    else
+	maclen = ssh->csmac ? ssh->csmac->len : 0;
     ssh2_pkt_ensure(pkt, pkt->length + padding + maclen);
     pkt->data[4] = padding;
     for (i = 0; i < padding; i++)
 	pkt->data[pkt->length + i] = random_byte();
     PUT_32BIT(pkt->data, pkt->length + padding - 4);
-    if (ssh->csmac)
-	ssh->csmac->generate(ssh->cs_mac_ctx, pkt->data,
-			     pkt->length + padding,
-			     ssh->v2_outgoing_sequence);
-    ssh->v2_outgoing_sequence++;       /* whether or not we MACed */
+    if (aead) {
+	ssh->cscipher->encrypt_pkt(ssh->cs_cipher_ctx, pkt->data,
+				   pkt->length + padding,
+				   ssh->v2_outgoing_sequence);
+	ssh->v2_outgoing_sequence++;
+    } else {
+	if (ssh->csmac)
+	    ssh->csmac->generate(ssh->cs_mac_ctx, pkt->data,
+				 pkt->length + padding,
+				 ssh->v2_outgoing_sequence);
+	ssh->v2_outgoing_sequence++;       /* whether or not we MACed */
 
-    if (ssh->cscipher)
-	ssh->cscipher->encrypt(ssh->cs_cipher_ctx,
-			       pkt->data, pkt->length + padding);
+	if (ssh->cscipher)
+	    ssh->cscipher->encrypt(ssh->cs_cipher_ctx,
+				   pkt->data, pkt->length + padding);
+    }
 
     pkt->encrypted_len = pkt->length + padding;
 
@@ -4086,6 +4156,8 @@ static int do_ssh1_login(Ssh ssh, unsigned char *in, int inlen,
 	    } else if (next_cipher == CIPHER_AES) {
 		/* XXX Probably don't need to mention this. */
 		logevent("AES not supported in SSH-1, skipping");
+	    } else if (next_cipher == CIPHER_CHACHA20) {
+		logevent("ChaCha20 not supported in SSH-1, skipping");
 	    } else {
 		switch (next_cipher) {
 		  case CIPHER_3DES:     s->cipher_type = SSH_CIPHER_3DES;
@@ -6035,10 +6107,12 @@ static void do_ssh1_connection(Ssh ssh, unsigned char *in, int inlen,
 	}
 	logevent("Started compression");
 	ssh->v1_compressing = TRUE;
-	ssh->cs_comp_ctx = zlib_compress_init();
-	logevent("Initialised zlib (RFC1950) compression");
-	ssh->sc_comp_ctx = zlib_decompress_init();
-	logevent("Initialised zlib (RFC1950) decompression");
+	ssh->cs_comp_ctx = ssh_zlib_impl.compress_init();
+	logeventf(ssh, "Initialised %s compression",
+		  ssh_zlib_impl.text_name);
+	ssh->sc_comp_ctx = ssh_zlib_impl.decompress_init();
+	logeventf(ssh, "Initialised %s decompression",
+		  ssh_zlib_impl.text_name);
     }
 
     /*
@@ -6244,15 +6318,18 @@ static void ssh2_pkt_addstring_commasep(struct Packet *pkt, const char *data)
 
 /*
  * SSH-2 key creation method.
- * (Currently assumes 2 lots of any hash are sufficient to generate
- * keys/IVs for any cipher/MAC. SSH2_MKKEY_ITERS documents this assumption.)
+ * (Currently assumes 4 lots of any hash are sufficient to generate
+ * keys/IVs for any cipher/MAC; the largest user is the 64-byte key
+ * of chacha20-poly1305 with a SHA-1 based key exchange.
+ * SSH2_MKKEY_ITERS documents this assumption.)
  */
-#define SSH2_MKKEY_ITERS (2)
+#define SSH2_MKKEY_ITERS (4)
 static void ssh2_mkkey(Ssh ssh, Bignum K, unsigned char *H, char chr,
 		       unsigned char *keyspace)
 {
     const struct ssh_hash *h = ssh->kex->hash;
     void *s;
+    int i;
     /* First hlen bytes. */
     s = h->init();
     if (!(ssh->remote_bugs & BUG_SSH2_DERIVEKEY))
@@ -6261,13 +6338,15 @@ static void ssh2_mkkey(Ssh ssh, Bignum K, unsigned char *H, char chr,
     h->bytes(s, &chr, 1);
     h->bytes(s, ssh->v2_session_id, ssh->v2_session_id_len);
     h->final(s, keyspace);
-    /* Next hlen bytes. */
-    s = h->init();
-    if (!(ssh->remote_bugs & BUG_SSH2_DERIVEKEY))
-	hash_mpint(h, s, K);
-    h->bytes(s, H, h->hlen);
-    h->bytes(s, keyspace, h->hlen);
-    h->final(s, keyspace + h->hlen);
+    /* Each further hlen bytes hash everything generated so far. */
+    for (i = 1; i < SSH2_MKKEY_ITERS; i++) {
+	s = h->init();
+	if (!(ssh->remote_bugs & BUG_SSH2_DERIVEKEY))
+	    hash_mpint(h, s, K);
+	h->bytes(s, H, h->hlen);
+	h->bytes(s, keyspace, i * h->hlen);
+	h->final(s, keyspace + i * h->hlen);
+    }
 }
 
 /*
@@ -6394,6 +6473,9 @@ static void do_ssh2_transport(Ssh ssh, void *vin, int inlen,
 	      case CIPHER_AES:
 		s->preferred_ciphers[s->n_preferred_ciphers++] = &ssh2_aes;
 		break;
+	      case CIPHER_CHACHA20:
+		s->preferred_ciphers[s->n_preferred_ciphers++] = &ssh2_ccp;
+		break;
 	      case CIPHER_ARCFOUR:
 		s->preferred_ciphers[s->n_preferred_ciphers++] = &ssh2_arcfour;
 		break;
@@ -6411,7 +6493,7 @@ static void do_ssh2_transport(Ssh ssh, void *vin, int inlen,
 	 * Set up preferred compression.
 	 */
 	if (conf_get_int(ssh->conf, CONF_compression))
-	    s->preferred_comp = &ssh_zlib;
+	    s->preferred_comp = &ssh_zlib_impl;
 	else
 	    s->preferred_comp = &ssh_comp_none;
 
@@ -6644,15 +6726,27 @@ static void do_ssh2_transport(Ssh ssh, void *vin, int inlen,
 	    crStopV;
 	}
 
+	/*
+	 * AEAD ciphers authenticate the packets themselves, so like
+	 * OpenSSH we ignore the MAC lists for them. Otherwise a MAC
+	 * has to be agreed.
+	 */
 	ssh_pkt_getstring(pktin, &str, &len);    /* client->server mac */
         if (!str) {
             bombout(("KEXINIT packet was incomplete"));
             crStopV;
         }
-	for (i = 0; i < s->nmacs; i++) {
-	    if (in_commasep_string(s->maclist[i]->name, str, len)) {
-		s->csmac_tobe = s->maclist[i];
-		break;
+	if (!(s->cscipher_tobe->flags & SSH_CIPHER_IS_AEAD)) {
+	    for (i = 0; i < s->nmacs; i++) {
+		if (in_commasep_string(s->maclist[i]->name, str, len)) {
+		    s->csmac_tobe = s->maclist[i];
+		    break;
+		}
+	    }
+	    if (!s->csmac_tobe) {
+		bombout(("Couldn't agree a client-to-server MAC"
+			 " (available: %.*s)", len, str));
+		crStopV;
 	    }
 	}
 	ssh_pkt_getstring(pktin, &str, &len);    /* server->client mac */
@@ -6660,10 +6754,17 @@ static void do_ssh2_transport(Ssh ssh, void *vin, int inlen,
             bombout(("KEXINIT packet was incomplete"));
             crStopV;
         }
-	for (i = 0; i < s->nmacs; i++) {
-	    if (in_commasep_string(s->maclist[i]->name, str, len)) {
-		s->scmac_tobe = s->maclist[i];
-		break;
+	if (!(s->sccipher_tobe->flags & SSH_CIPHER_IS_AEAD)) {
+	    for (i = 0; i < s->nmacs; i++) {
+		if (in_commasep_string(s->maclist[i]->name, str, len)) {
+		    s->scmac_tobe = s->maclist[i];
+		    break;
+		}
+	    }
+	    if (!s->scmac_tobe) {
+		bombout(("Couldn't agree a server-to-client MAC"
+			 " (available: %.*s)", len, str));
+		crStopV;
 	    }
 	}
 	ssh_pkt_getstring(pktin, &str, &len);  /* client->server compression */
@@ -7205,8 +7306,14 @@ static void do_ssh2_transport(Ssh ssh, void *vin, int inlen,
 
     if (ssh->cs_mac_ctx)
 	ssh->csmac->free_context(ssh->cs_mac_ctx);
-    ssh->csmac = s->csmac_tobe;
-    ssh->cs_mac_ctx = ssh->csmac->make_context();
+    if (ssh->cscipher->flags & SSH_CIPHER_IS_AEAD) {
+	/* The cipher authenticates the packets itself. */
+	ssh->csmac = NULL;
+	ssh->cs_mac_ctx = NULL;
+    } else {
+	ssh->csmac = s->csmac_tobe;
+	ssh->cs_mac_ctx = ssh->csmac->make_context();
+    }
 
     if (ssh->cs_comp_ctx)
 	ssh->cscomp->compress_cleanup(ssh->cs_comp_ctx);
@@ -7228,19 +7335,28 @@ static void do_ssh2_transport(Ssh ssh, void *vin, int inlen,
 	assert(ssh->cscipher->blksize <=
 	       ssh->kex->hash->hlen * SSH2_MKKEY_ITERS);
 	ssh->cscipher->setiv(ssh->cs_cipher_ctx, keyspace);
-	ssh2_mkkey(ssh,s->K,s->exchange_hash,'E',keyspace);
-	assert(ssh->csmac->len <=
-	       ssh->kex->hash->hlen * SSH2_MKKEY_ITERS);
-	ssh->csmac->setkey(ssh->cs_mac_ctx, keyspace);
+	if (ssh->csmac) {
+	    ssh2_mkkey(ssh,s->K,s->exchange_hash,'E',keyspace);
+	    assert(ssh->csmac->len <=
+		   ssh->kex->hash->hlen * SSH2_MKKEY_ITERS);
+	    ssh->csmac->setkey(ssh->cs_mac_ctx, keyspace);
+	}
 	smemclr(keyspace, sizeof(keyspace));
     }
 
     fzprintf(sftpCipherClientToServer, ssh->cscipher->text_name);
-    fzprintf(sftpMacClientToServer, ssh->csmac->text_name);
-    logeventf(ssh, "Initialised %.200s client->server encryption",
-	      ssh->cscipher->text_name);
-    logeventf(ssh, "Initialised %.200s client->server MAC algorithm",
-	      ssh->csmac->text_name);
+    if (ssh->csmac) {
+	fzprintf(sftpMacClientToServer, ssh->csmac->text_name);
+	logeventf(ssh, "Initialised %.200s client->server encryption",
+		  ssh->cscipher->text_name);
+	logeventf(ssh, "Initialised %.200s client->server MAC algorithm",
+		  ssh->csmac->text_name);
+    } else {
+	fzprintf(sftpMacClientToServer, ssh->cscipher->mac_text_name);
+	logeventf(ssh, "Initialised %.200s client->server encryption "
+		  "with %.200s authentication",
+		  ssh->cscipher->text_name, ssh->cscipher->mac_text_name);
+    }
     if (ssh->cscomp->text_name)
 	logeventf(ssh, "Initialised %s compression",
 		  ssh->cscomp->text_name);
@@ -7273,8 +7389,13 @@ static void do_ssh2_transport(Ssh ssh, void *vin, int inlen,
 
     if (ssh->sc_mac_ctx)
 	ssh->scmac->free_context(ssh->sc_mac_ctx);
-    ssh->scmac = s->scmac_tobe;
-    ssh->sc_mac_ctx = ssh->scmac->make_context();
+    if (ssh->sccipher->flags & SSH_CIPHER_IS_AEAD) {
+	ssh->scmac = NULL;
+	ssh->sc_mac_ctx = NULL;
+    } else {
+	ssh->scmac = s->scmac_tobe;
+	ssh->sc_mac_ctx = ssh->scmac->make_context();
+    }
 
     if (ssh->sc_comp_ctx)
 	ssh->sccomp->decompress_cleanup(ssh->sc_comp_ctx);
@@ -7296,18 +7417,27 @@ static void do_ssh2_transport(Ssh ssh, void *vin, int inlen,
 	assert(ssh->sccipher->blksize <=
 	       ssh->kex->hash->hlen * SSH2_MKKEY_ITERS);
 	ssh->sccipher->setiv(ssh->sc_cipher_ctx, keyspace);
-	ssh2_mkkey(ssh,s->K,s->exchange_hash,'F',keyspace);
-	assert(ssh->scmac->len <=
-	       ssh->kex->hash->hlen * SSH2_MKKEY_ITERS);
-	ssh->scmac->setkey(ssh->sc_mac_ctx, keyspace);
+	if (ssh->scmac) {
+	    ssh2_mkkey(ssh,s->K,s->exchange_hash,'F',keyspace);
+	    assert(ssh->scmac->len <=
+		   ssh->kex->hash->hlen * SSH2_MKKEY_ITERS);
+	    ssh->scmac->setkey(ssh->sc_mac_ctx, keyspace);
+	}
 	smemclr(keyspace, sizeof(keyspace));
     }
     fzprintf(sftpCipherServerToClient, ssh->sccipher->text_name);
-    fzprintf(sftpMacServerToClient, ssh->scmac->text_name);
-    logeventf(ssh, "Initialised %.200s server->client encryption",
-	      ssh->sccipher->text_name);
-    logeventf(ssh, "Initialised %.200s server->client MAC algorithm",
-	      ssh->scmac->text_name);
+    if (ssh->scmac) {
+	fzprintf(sftpMacServerToClient, ssh->scmac->text_name);
+	logeventf(ssh, "Initialised %.200s server->client encryption",
+		  ssh->sccipher->text_name);
+	logeventf(ssh, "Initialised %.200s server->client MAC algorithm",
+		  ssh->scmac->text_name);
+    } else {
+	fzprintf(sftpMacServerToClient, ssh->sccipher->mac_text_name);
+	logeventf(ssh, "Initialised %.200s server->client encryption "
+		  "with %.200s authentication",
+		  ssh->sccipher->text_name, ssh->sccipher->mac_text_name);
+    }
     if (ssh->sccomp->text_name)
 	logeventf(ssh, "Initialised %s decompression",
 		  ssh->sccomp->text_name);
@@ -11123,13 +11253,13 @@ static void ssh_free(void *handle)
 	if (ssh->cscomp)
 	    ssh->cscomp->compress_cleanup(ssh->cs_comp_ctx);
 	else
-	    zlib_compress_cleanup(ssh->cs_comp_ctx);
+	    ssh_zlib_impl.compress_cleanup(ssh->cs_comp_ctx);
     }
     if (ssh->sc_comp_ctx) {
 	if (ssh->sccomp)
 	    ssh->sccomp->decompress_cleanup(ssh->sc_comp_ctx);
 	else
-	    zlib_decompress_cleanup(ssh->sc_comp_ctx);
+	    ssh_zlib_impl.decompress_cleanup(ssh->sc_comp_ctx);
     }
     if (ssh->kex_ctx)
 	dh_cleanup(ssh->kex_ctx);
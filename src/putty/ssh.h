@@ -237,6 +237,11 @@ void SHA256_Init(SHA256_State * s);
 void SHA256_Bytes(SHA256_State * s, const void *p, int len);
 void SHA256_Final(SHA256_State * s, unsigned char *output);
 void SHA256_Simple(const void *p, int len, unsigned char *output);
+/*
+ * As for AES: nonzero if SHA-256 uses the CPU's SHA instructions.
+ */
+int sha256_hw_available(void);
+void sha256_disable_hw(int disable);
 
 typedef struct {
     uint64 h[8];
@@ -276,7 +281,24 @@ struct ssh2_cipher {
     int keylen;
     unsigned int flags;
 #define SSH_CIPHER_IS_CBC	1
+#define SSH_CIPHER_IS_AEAD	2
     char *text_name;
+    /*
+     * Ciphers with SSH_CIPHER_IS_AEAD authenticate the packet
+     * themselves, so no MAC is negotiated, and encrypt and decrypt
+     * above are unused. Instead each whole packet, starting with its
+     * length field, is processed in one pass, with a tag of taglen
+     * bytes following it. decrypt_length recovers the packet length
+     * from the first four bytes without modifying them.
+     */
+    int taglen;
+    char *mac_text_name;
+    void (*decrypt_length) (void *, unsigned char const *blk,
+			    unsigned char *len, unsigned long seq);
+    void (*encrypt_pkt) (void *, unsigned char *blk, int len,
+			 unsigned long seq);
+    int (*decrypt_pkt) (void *, unsigned char *blk, int len,
+			unsigned long seq);
 };
 
 struct ssh2_ciphers {
@@ -375,6 +397,7 @@ extern const struct ssh_cipher ssh_blowfish_ssh1;
 extern const struct ssh2_ciphers ssh2_3des;
 extern const struct ssh2_ciphers ssh2_des;
 extern const struct ssh2_ciphers ssh2_aes;
+extern const struct ssh2_ciphers ssh2_ccp;
 extern const struct ssh2_ciphers ssh2_blowfish;
 extern const struct ssh2_ciphers ssh2_arcfour;
 extern const struct ssh_hash ssh_sha1;
@@ -406,6 +429,13 @@ void aes256_key(void *handle, unsigned char *key);
 void aes_iv(void *handle, unsigned char *iv);
 void aes_ssh2_encrypt_blk(void *handle, unsigned char *blk, int len);
 void aes_ssh2_decrypt_blk(void *handle, unsigned char *blk, int len);
+/*
+ * Nonzero if newly keyed AES contexts will use the CPU's AES
+ * instructions. aes_disable_hw() forces the portable implementation,
+ * e.g. for benchmarking the two against each other.
+ */
+int aes_hw_available(void);
+void aes_disable_hw(int disable);
 
 /*
  * PuTTY version number formatted as an SSH version string. 
@@ -687,6 +717,10 @@ void invent_firstbits(unsigned *one, unsigned *two);
 /*
  * zlib compression.
  */
+extern const struct ssh_compress ssh_zlib;
+#ifdef USE_SYSTEM_ZLIB
+extern const struct ssh_compress ssh_zlib_system;
+#endif
 void *zlib_compress_init(void);
 void zlib_compress_cleanup(void *);
 void *zlib_decompress_init(void);
@@ -32,6 +32,24 @@
 
 #include "ssh.h"
 
+/*
+ * On x86 and x86-64 we can additionally use the AES-NI instructions,
+ * selected at run time after checking CPUID. This needs a compiler
+ * that supports per-function target attributes, so that the rest of
+ * the file (and the rest of fzsftp) still runs on CPUs without them.
+ * Define NO_HW_AES to build the portable implementation only.
+ */
+#if !defined NO_HW_AES && (defined __x86_64__ || defined __i386__) && \
+    (defined __clang__ || \
+     (defined __GNUC__ && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define HW_AES_NI
+#include <cpuid.h>
+#include <wmmintrin.h>
+#include <tmmintrin.h>
+#define AES_NI_FUNC __attribute__((target("aes,sse2")))
+#define CLMUL_FUNC __attribute__((target("aes,pclmul,ssse3,sse2")))
+#endif
+
 #define MAX_NR 14		       /* max no of rounds */
 #define MAX_NK 8		       /* max no of words in input key */
 #define MAX_NB 8		       /* max no of words in cipher blk */
@@ -47,8 +65,19 @@ struct AESContext {
     void (*decrypt) (AESContext * ctx, word32 * block);
     word32 iv[MAX_NB];
     int Nb, Nr;
+#ifdef HW_AES_NI
+    /*
+     * The same key schedules as above, stored as bytes in the order
+     * AESENC and AESDEC expect. Only filled in if hw is set.
+     */
+    int hw;
+    unsigned char hw_keysched[(MAX_NR + 1) * 16];
+    unsigned char hw_invkeysched[(MAX_NR + 1) * 16];
+#endif
 };
 
+static int aes_hw_disabled = 0;
+
 static const unsigned char Sbox[256] = {
     0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5,
     0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
@@ -1013,8 +1042,231 @@ static void aes_setup(AESContext * ctx, int blocklen,
 	    ctx->invkeysched[i * ctx->Nb + j] = temp;
 	}
     }
+
+#ifdef HW_AES_NI
+    /*
+     * The hardware instructions operate on the same round keys: the
+     * encryption schedule is used as is, and the inverse schedule
+     * computed above is exactly the "equivalent inverse cipher" key
+     * schedule that AESDEC needs. They just want them as bytes.
+     */
+    ctx->hw = (ctx->Nb == 4 && aes_hw_available());
+    if (ctx->hw) {
+	for (i = 0; i < (ctx->Nr + 1) * 4; i++) {
+	    PUT_32BIT_MSB_FIRST(ctx->hw_keysched + 4 * i, ctx->keysched[i]);
+	    PUT_32BIT_MSB_FIRST(ctx->hw_invkeysched + 4 * i,
+				ctx->invkeysched[i]);
+	}
+    }
+#endif
+}
+
+int aes_hw_available(void)
+{
+#ifdef HW_AES_NI
+    static int checked = 0, available = 0;
+
+    if (!checked) {
+	unsigned int eax, ebx, ecx, edx;
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+	    available = (ecx & bit_AES) && (edx & bit_SSE2);
+	checked = 1;
+    }
+    return available && !aes_hw_disabled;
+#else
+    return 0;
+#endif
+}
+
+void aes_disable_hw(int disable)
+{
+    aes_hw_disabled = disable;
+}
+
+#ifdef HW_AES_NI
+
+/*
+ * AES-NI implementations of the three modes we use. CBC encryption
+ * is inherently serial, but CBC decryption and SDCTR can keep several
+ * blocks in flight at once, which is where most of the speedup comes
+ * from: AESENC/AESDEC have a latency of several cycles but can be
+ * issued every cycle.
+ */
+#define AES_NI_PARALLEL 4
+
+static AES_NI_FUNC void aes_ni_load_keys(__m128i *ks,
+					 const unsigned char *sched, int Nr)
+{
+    int i;
+    for (i = 0; i <= Nr; i++)
+	ks[i] = _mm_loadu_si128((const __m128i *)(sched + 16 * i));
+}
+
+static void aes_ni_get_iv(AESContext *ctx, unsigned char *iv)
+{
+    int i;
+    for (i = 0; i < 4; i++)
+	PUT_32BIT_MSB_FIRST(iv + 4 * i, ctx->iv[i]);
+}
+
+static void aes_ni_set_iv(AESContext *ctx, const unsigned char *iv)
+{
+    int i;
+    for (i = 0; i < 4; i++)
+	ctx->iv[i] = GET_32BIT_MSB_FIRST(iv + 4 * i);
+}
+
+/*
+ * Run all rounds of AESENC or AESDEC over AES_NI_PARALLEL blocks at
+ * once, interleaved so the instructions can overlap.
+ */
+#define AES_NI_ROUNDS_X4(x, ks, Nr, round, last) do {			\
+    int r_;								\
+    x[0] = _mm_xor_si128(x[0], ks[0]);					\
+    x[1] = _mm_xor_si128(x[1], ks[0]);					\
+    x[2] = _mm_xor_si128(x[2], ks[0]);					\
+    x[3] = _mm_xor_si128(x[3], ks[0]);					\
+    for (r_ = 1; r_ < Nr; r_++) {					\
+	x[0] = round(x[0], ks[r_]);					\
+	x[1] = round(x[1], ks[r_]);					\
+	x[2] = round(x[2], ks[r_]);					\
+	x[3] = round(x[3], ks[r_]);					\
+    }									\
+    x[0] = last(x[0], ks[Nr]);						\
+    x[1] = last(x[1], ks[Nr]);						\
+    x[2] = last(x[2], ks[Nr]);						\
+    x[3] = last(x[3], ks[Nr]);						\
+} while (0)
+
+#define AES_NI_ROUNDS_X1(x, ks, Nr, round, last) do {			\
+    int r_;								\
+    x = _mm_xor_si128(x, ks[0]);					\
+    for (r_ = 1; r_ < Nr; r_++)						\
+	x = round(x, ks[r_]);						\
+    x = last(x, ks[Nr]);						\
+} while (0)
+
+static AES_NI_FUNC void aes_ni_encrypt_cbc(unsigned char *blk, int len,
+					   AESContext *ctx)
+{
+    __m128i ks[MAX_NR + 1], state;
+    unsigned char iv[16];
+    int Nr = ctx->Nr;
+
+    assert((len & 15) == 0);
+
+    aes_ni_load_keys(ks, ctx->hw_keysched, Nr);
+    aes_ni_get_iv(ctx, iv);
+    state = _mm_loadu_si128((const __m128i *)iv);
+
+    while (len > 0) {
+	state = _mm_xor_si128(state, _mm_loadu_si128((const __m128i *)blk));
+	AES_NI_ROUNDS_X1(state, ks, Nr, _mm_aesenc_si128, _mm_aesenclast_si128);
+	_mm_storeu_si128((__m128i *)blk, state);
+	blk += 16;
+	len -= 16;
+    }
+
+    _mm_storeu_si128((__m128i *)iv, state);
+    aes_ni_set_iv(ctx, iv);
 }
 
+static AES_NI_FUNC void aes_ni_decrypt_cbc(unsigned char *blk, int len,
+					   AESContext *ctx)
+{
+    __m128i ks[MAX_NR + 1], iv, ct[AES_NI_PARALLEL], x[AES_NI_PARALLEL];
+    unsigned char ivbuf[16];
+    int j, Nr = ctx->Nr;
+
+    assert((len & 15) == 0);
+
+    aes_ni_load_keys(ks, ctx->hw_invkeysched, Nr);
+    aes_ni_get_iv(ctx, ivbuf);
+    iv = _mm_loadu_si128((const __m128i *)ivbuf);
+
+    while (len >= 16 * AES_NI_PARALLEL) {
+	for (j = 0; j < AES_NI_PARALLEL; j++)
+	    x[j] = ct[j] = _mm_loadu_si128((const __m128i *)(blk + 16 * j));
+	AES_NI_ROUNDS_X4(x, ks, Nr, _mm_aesdec_si128, _mm_aesdeclast_si128);
+	for (j = 0; j < AES_NI_PARALLEL; j++) {
+	    _mm_storeu_si128((__m128i *)(blk + 16 * j),
+			     _mm_xor_si128(x[j], iv));
+	    iv = ct[j];
+	}
+	blk += 16 * AES_NI_PARALLEL;
+	len -= 16 * AES_NI_PARALLEL;
+    }
+
+    while (len > 0) {
+	x[0] = ct[0] = _mm_loadu_si128((const __m128i *)blk);
+	AES_NI_ROUNDS_X1(x[0], ks, Nr, _mm_aesdec_si128, _mm_aesdeclast_si128);
+	_mm_storeu_si128((__m128i *)blk, _mm_xor_si128(x[0], iv));
+	iv = ct[0];
+	blk += 16;
+	len -= 16;
+    }
+
+    _mm_storeu_si128((__m128i *)ivbuf, iv);
+    aes_ni_set_iv(ctx, ivbuf);
+}
+
+/*
+ * The SDCTR counter is a 128-bit big-endian integer; keep it as two
+ * native 64-bit halves and byte-swap it into each counter block.
+ */
+static AES_NI_FUNC __m128i aes_ni_counter_block(unsigned long long hi,
+						unsigned long long lo)
+{
+    return _mm_set_epi64x((long long)__builtin_bswap64(lo),
+			  (long long)__builtin_bswap64(hi));
+}
+
+static AES_NI_FUNC void aes_ni_sdctr(unsigned char *blk, int len,
+				     AESContext *ctx)
+{
+    __m128i ks[MAX_NR + 1], x[AES_NI_PARALLEL];
+    unsigned long long hi, lo;
+    int j, Nr = ctx->Nr;
+
+    assert((len & 15) == 0);
+
+    aes_ni_load_keys(ks, ctx->hw_keysched, Nr);
+    hi = ((unsigned long long)ctx->iv[0] << 32) | ctx->iv[1];
+    lo = ((unsigned long long)ctx->iv[2] << 32) | ctx->iv[3];
+
+    while (len >= 16 * AES_NI_PARALLEL) {
+	for (j = 0; j < AES_NI_PARALLEL; j++) {
+	    x[j] = aes_ni_counter_block(hi, lo);
+	    if (++lo == 0)
+		hi++;
+	}
+	AES_NI_ROUNDS_X4(x, ks, Nr, _mm_aesenc_si128, _mm_aesenclast_si128);
+	for (j = 0; j < AES_NI_PARALLEL; j++)
+	    _mm_storeu_si128((__m128i *)(blk + 16 * j), _mm_xor_si128(x[j],
+		_mm_loadu_si128((const __m128i *)(blk + 16 * j))));
+	blk += 16 * AES_NI_PARALLEL;
+	len -= 16 * AES_NI_PARALLEL;
+    }
+
+    while (len > 0) {
+	x[0] = aes_ni_counter_block(hi, lo);
+	if (++lo == 0)
+	    hi++;
+	AES_NI_ROUNDS_X1(x[0], ks, Nr, _mm_aesenc_si128, _mm_aesenclast_si128);
+	_mm_storeu_si128((__m128i *)blk, _mm_xor_si128(x[0],
+	    _mm_loadu_si128((const __m128i *)blk)));
+	blk += 16;
+	len -= 16;
+    }
+
+    ctx->iv[0] = (word32)(hi >> 32);
+    ctx->iv[1] = (word32)hi;
+    ctx->iv[2] = (word32)(lo >> 32);
+    ctx->iv[3] = (word32)lo;
+}
+
+#endif /* HW_AES_NI */
+
 static void aes_encrypt(AESContext * ctx, word32 * block)
 {
     ctx->encrypt(ctx, block);
@@ -1030,6 +1282,13 @@ static void aes_encrypt_cbc(unsigned char *blk, int len, AESContext * ctx)
     word32 iv[4];
     int i;
 
+#ifdef HW_AES_NI
+    if (ctx->hw) {
+	aes_ni_encrypt_cbc(blk, len, ctx);
+	return;
+    }
+#endif
+
     assert((len & 15) == 0);
 
     memcpy(iv, ctx->iv, sizeof(iv));
@@ -1052,6 +1311,13 @@ static void aes_decrypt_cbc(unsigned char *blk, int len, AESContext * ctx)
     word32 iv[4], x[4], ct[4];
     int i;
 
+#ifdef HW_AES_NI
+    if (ctx->hw) {
+	aes_ni_decrypt_cbc(blk, len, ctx);
+	return;
+    }
+#endif
+
     assert((len & 15) == 0);
 
     memcpy(iv, ctx->iv, sizeof(iv));
@@ -1076,6 +1342,13 @@ static void aes_sdctr(unsigned char *blk, int len, AESContext *ctx)
     word32 iv[4], b[4], tmp;
     int i;
 
+#ifdef HW_AES_NI
+    if (ctx->hw) {
+	aes_ni_sdctr(blk, len, ctx);
+	return;
+    }
+#endif
+
     assert((len & 15) == 0);
 
     memcpy(iv, ctx->iv, sizeof(iv));
@@ -1169,6 +1442,439 @@ void aes256_decrypt_pubkey(unsigned char *key, unsigned char *blk, int len)
     smemclr(&ctx, sizeof(ctx));
 }
 
+/* ----------------------------------------------------------------------
+ * AES-GCM for SSH-2, as specified in RFC 5647 with the OpenSSH
+ * naming and negotiation rules:
+ *
+ *   aes128-gcm@openssh.com, aes256-gcm@openssh.com
+ *
+ * The packet length is sent in the clear and authenticated as the
+ * additional data; the rest of the packet is encrypted in counter
+ * mode and authenticated by GHASH in the same pass over the data, so
+ * no separate MAC is needed. With AES-NI, GHASH uses PCLMULQDQ.
+ */
+
+typedef unsigned long long gcm_u64;
+
+typedef struct AESGCMContext {
+    AESContext aes;
+    unsigned char iv[12];	       /* fixed field, invocation counter */
+    unsigned char hkey[16];	       /* H = E(K, 0^128) */
+    gcm_u64 hl[16], hh[16];	       /* multiples of H, for the portable GHASH */
+    int clmul;
+} AESGCMContext;
+
+#define GCM_TAGLEN 16
+
+#define GET_64BIT_MSB_FIRST(cp) \
+    (((gcm_u64)GET_32BIT_MSB_FIRST(cp) << 32) | GET_32BIT_MSB_FIRST((cp) + 4))
+#define PUT_64BIT_MSB_FIRST(cp, value) ( \
+    PUT_32BIT_MSB_FIRST(cp, (word32)((value) >> 32)), \
+    PUT_32BIT_MSB_FIRST((cp) + 4, (word32)(value)) )
+
+static int gcm_clmul_available(void)
+{
+#ifdef HW_AES_NI
+    static int checked = 0, available = 0;
+
+    if (!checked) {
+	unsigned int eax, ebx, ecx, edx;
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+	    available = (ecx & bit_PCLMUL) && (ecx & bit_SSSE3);
+	checked = 1;
+    }
+    return available && aes_hw_available();
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Encrypt a single block held as bytes.
+ */
+static void aes_encrypt_bytes(AESContext *ctx, const unsigned char *in,
+			      unsigned char *out)
+{
+    word32 block[4];
+    int i;
+
+    for (i = 0; i < 4; i++)
+	block[i] = GET_32BIT_MSB_FIRST(in + 4 * i);
+    aes_encrypt(ctx, block);
+    for (i = 0; i < 4; i++)
+	PUT_32BIT_MSB_FIRST(out + 4 * i, block[i]);
+}
+
+/*
+ * Portable GHASH, using Shoup's method with a 16-entry table of
+ * multiples of H, processing the input four bits at a time.
+ */
+static void gcm_gen_table(AESGCMContext *ctx)
+{
+    gcm_u64 vh, vl;
+    int i, j;
+
+    vh = GET_64BIT_MSB_FIRST(ctx->hkey);
+    vl = GET_64BIT_MSB_FIRST(ctx->hkey + 8);
+
+    ctx->hl[8] = vl;
+    ctx->hh[8] = vh;
+    ctx->hl[0] = ctx->hh[0] = 0;
+
+    for (i = 4; i > 0; i >>= 1) {
+	gcm_u64 t = (vl & 1) * 0xe1000000U;
+	vl = (vh << 63) | (vl >> 1);
+	vh = (vh >> 1) ^ (t << 32);
+	ctx->hl[i] = vl;
+	ctx->hh[i] = vh;
+    }
+
+    for (i = 2; i <= 8; i *= 2) {
+	vh = ctx->hh[i];
+	vl = ctx->hl[i];
+	for (j = 1; j < i; j++) {
+	    ctx->hh[i + j] = vh ^ ctx->hh[j];
+	    ctx->hl[i + j] = vl ^ ctx->hl[j];
+	}
+    }
+}
+
+static void gcm_mult(AESGCMContext *ctx, unsigned char *x)
+{
+    static const gcm_u64 last4[16] = {
+	0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+	0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+    };
+    gcm_u64 zh, zl;
+    int i, lo, hi, rem;
+
+    lo = x[15] & 0xf;
+    zh = ctx->hh[lo];
+    zl = ctx->hl[lo];
+
+    for (i = 15; i >= 0; i--) {
+	lo = x[i] & 0xf;
+	hi = (x[i] >> 4) & 0xf;
+
+	if (i != 15) {
+	    rem = (int)(zl & 0xf);
+	    zl = (zh << 60) | (zl >> 4);
+	    zh = (zh >> 4) ^ (last4[rem] << 48);
+	    zh ^= ctx->hh[lo];
+	    zl ^= ctx->hl[lo];
+	}
+
+	rem = (int)(zl & 0xf);
+	zl = (zh << 60) | (zl >> 4);
+	zh = (zh >> 4) ^ (last4[rem] << 48);
+	zh ^= ctx->hh[hi];
+	zl ^= ctx->hl[hi];
+    }
+
+    PUT_64BIT_MSB_FIRST(x, zh);
+    PUT_64BIT_MSB_FIRST(x + 8, zl);
+}
+
+#ifdef HW_AES_NI
+
+/*
+ * GF(2^128) multiplication using carry-less multiply, on operands in
+ * reflected bit order, as described in Intel's white paper on
+ * PCLMULQDQ and GCM.
+ */
+static CLMUL_FUNC __m128i gcm_clmul_mult(__m128i a, __m128i b)
+{
+    __m128i t2, t3, t4, t5, t6, t7, t8, t9;
+
+    t3 = _mm_clmulepi64_si128(a, b, 0x00);
+    t4 = _mm_clmulepi64_si128(a, b, 0x10);
+    t5 = _mm_clmulepi64_si128(a, b, 0x01);
+    t6 = _mm_clmulepi64_si128(a, b, 0x11);
+
+    t4 = _mm_xor_si128(t4, t5);
+    t5 = _mm_slli_si128(t4, 8);
+    t4 = _mm_srli_si128(t4, 8);
+    t3 = _mm_xor_si128(t3, t5);
+    t6 = _mm_xor_si128(t6, t4);
+
+    /* Shift the 256-bit product left by one bit. */
+    t7 = _mm_srli_epi32(t3, 31);
+    t8 = _mm_srli_epi32(t6, 31);
+    t3 = _mm_slli_epi32(t3, 1);
+    t6 = _mm_slli_epi32(t6, 1);
+    t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    t3 = _mm_or_si128(t3, t7);
+    t6 = _mm_or_si128(t6, t8);
+    t6 = _mm_or_si128(t6, t9);
+
+    /* Reduce modulo x^128 + x^7 + x^2 + x + 1. */
+    t7 = _mm_slli_epi32(t3, 31);
+    t8 = _mm_slli_epi32(t3, 30);
+    t9 = _mm_slli_epi32(t3, 25);
+    t7 = _mm_xor_si128(t7, t8);
+    t7 = _mm_xor_si128(t7, t9);
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    t3 = _mm_xor_si128(t3, t7);
+
+    t2 = _mm_srli_epi32(t3, 1);
+    t4 = _mm_srli_epi32(t3, 2);
+    t5 = _mm_srli_epi32(t3, 7);
+    t2 = _mm_xor_si128(t2, t4);
+    t2 = _mm_xor_si128(t2, t5);
+    t2 = _mm_xor_si128(t2, t8);
+    t3 = _mm_xor_si128(t3, t2);
+    return _mm_xor_si128(t6, t3);
+}
+
+static CLMUL_FUNC void gcm_clmul_ghash(AESGCMContext *ctx, unsigned char *y,
+				       const unsigned char *data, int len)
+{
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+				       8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i h, acc, x;
+    unsigned char last[16];
+
+    h = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)ctx->hkey), bswap);
+    acc = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)y), bswap);
+
+    while (len > 0) {
+	if (len < 16) {
+	    memset(last, 0, sizeof(last));
+	    memcpy(last, data, len);
+	    data = last;
+	    len = 16;
+	}
+	x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), bswap);
+	acc = gcm_clmul_mult(_mm_xor_si128(acc, x), h);
+	data += 16;
+	len -= 16;
+    }
+
+    _mm_storeu_si128((__m128i *)y, _mm_shuffle_epi8(acc, bswap));
+}
+
+/*
+ * GCM's counter mode, which unlike SDCTR only increments the last
+ * 32 bits of the counter block.
+ */
+static AES_NI_FUNC void aes_ni_gcm_ctr(AESGCMContext *gctx,
+				       unsigned char *blk, int len,
+				       word32 ctr)
+{
+    AESContext *ctx = &gctx->aes;
+    __m128i ks[MAX_NR + 1], x[AES_NI_PARALLEL];
+    unsigned char last[16];
+    int j, Nr = ctx->Nr;
+    const int iv0 = (int)GET_32BIT_LSB_FIRST(gctx->iv);
+    const int iv1 = (int)GET_32BIT_LSB_FIRST(gctx->iv + 4);
+    const int iv2 = (int)GET_32BIT_LSB_FIRST(gctx->iv + 8);
+
+    aes_ni_load_keys(ks, ctx->hw_keysched, Nr);
+
+    while (len >= 16 * AES_NI_PARALLEL) {
+	for (j = 0; j < AES_NI_PARALLEL; j++)
+	    x[j] = _mm_set_epi32((int)__builtin_bswap32(ctr++), iv2, iv1, iv0);
+	AES_NI_ROUNDS_X4(x, ks, Nr, _mm_aesenc_si128, _mm_aesenclast_si128);
+	for (j = 0; j < AES_NI_PARALLEL; j++)
+	    _mm_storeu_si128((__m128i *)(blk + 16 * j), _mm_xor_si128(x[j],
+		_mm_loadu_si128((const __m128i *)(blk + 16 * j))));
+	blk += 16 * AES_NI_PARALLEL;
+	len -= 16 * AES_NI_PARALLEL;
+    }
+
+    while (len > 0) {
+	int n = len < 16 ? len : 16;
+	x[0] = _mm_set_epi32((int)__builtin_bswap32(ctr++), iv2, iv1, iv0);
+	AES_NI_ROUNDS_X1(x[0], ks, Nr, _mm_aesenc_si128, _mm_aesenclast_si128);
+	_mm_storeu_si128((__m128i *)last, x[0]);
+	for (j = 0; j < n; j++)
+	    blk[j] ^= last[j];
+	blk += n;
+	len -= n;
+    }
+}
+
+#endif /* HW_AES_NI */
+
+static void gcm_ghash(AESGCMContext *ctx, unsigned char *y,
+		      const unsigned char *data, int len)
+{
+    int i;
+
+#ifdef HW_AES_NI
+    if (ctx->clmul) {
+	gcm_clmul_ghash(ctx, y, data, len);
+	return;
+    }
+#endif
+
+    while (len > 0) {
+	int n = len < 16 ? len : 16;
+	for (i = 0; i < n; i++)
+	    y[i] ^= data[i];
+	gcm_mult(ctx, y);
+	data += n;
+	len -= n;
+    }
+}
+
+static void aes_gcm_ctr(AESGCMContext *ctx, unsigned char *blk, int len,
+			word32 ctr)
+{
+    unsigned char cb[16], ks[16];
+    int i, n;
+
+#ifdef HW_AES_NI
+    if (ctx->aes.hw) {
+	aes_ni_gcm_ctr(ctx, blk, len, ctr);
+	return;
+    }
+#endif
+
+    memcpy(cb, ctx->iv, 12);
+    while (len > 0) {
+	PUT_32BIT_MSB_FIRST(cb + 12, ctr);
+	ctr++;
+	aes_encrypt_bytes(&ctx->aes, cb, ks);
+	n = len < 16 ? len : 16;
+	for (i = 0; i < n; i++)
+	    blk[i] ^= ks[i];
+	blk += n;
+	len -= n;
+    }
+}
+
+/*
+ * Compute the tag over aadlen bytes of additional data and the
+ * ciphertext following it, for the current IV.
+ */
+static void aes_gcm_tag(AESGCMContext *ctx, const unsigned char *blk,
+			int aadlen, int len, unsigned char *tag)
+{
+    unsigned char lengths[16], j0[16];
+    gcm_u64 bits;
+    int i;
+
+    memset(tag, 0, 16);
+    gcm_ghash(ctx, tag, blk, aadlen);
+    gcm_ghash(ctx, tag, blk + aadlen, len - aadlen);
+    bits = (gcm_u64)aadlen * 8;
+    PUT_64BIT_MSB_FIRST(lengths, bits);
+    bits = (gcm_u64)(len - aadlen) * 8;
+    PUT_64BIT_MSB_FIRST(lengths + 8, bits);
+    gcm_ghash(ctx, tag, lengths, 16);
+
+    memcpy(j0, ctx->iv, 12);
+    PUT_32BIT_MSB_FIRST(j0 + 12, 1);
+    aes_encrypt_bytes(&ctx->aes, j0, j0);
+    for (i = 0; i < 16; i++)
+	tag[i] ^= j0[i];
+}
+
+/*
+ * RFC 5647 7.1: the low 64 bits of the IV count packets.
+ */
+static void aes_gcm_next_iv(AESGCMContext *ctx)
+{
+    int i;
+    for (i = 11; i >= 4; i--)
+	if (++ctx->iv[i] != 0)
+	    break;
+}
+
+static void *aes_gcm_make_context(void)
+{
+    return snew(AESGCMContext);
+}
+
+static void aes_gcm_free_context(void *handle)
+{
+    smemclr(handle, sizeof(AESGCMContext));
+    sfree(handle);
+}
+
+static void aes_gcm_setup(AESGCMContext *ctx, unsigned char *key, int keylen)
+{
+    aes_setup(&ctx->aes, 16, key, keylen);
+    memset(ctx->hkey, 0, sizeof(ctx->hkey));
+    aes_encrypt_bytes(&ctx->aes, ctx->hkey, ctx->hkey);
+    ctx->clmul = gcm_clmul_available();
+    if (!ctx->clmul)
+	gcm_gen_table(ctx);
+}
+
+static void aes_gcm128_key(void *handle, unsigned char *key)
+{
+    aes_gcm_setup((AESGCMContext *)handle, key, 16);
+}
+
+static void aes_gcm256_key(void *handle, unsigned char *key)
+{
+    aes_gcm_setup((AESGCMContext *)handle, key, 32);
+}
+
+static void aes_gcm_iv(void *handle, unsigned char *iv)
+{
+    AESGCMContext *ctx = (AESGCMContext *)handle;
+    memcpy(ctx->iv, iv, 12);
+}
+
+static void aes_gcm_decrypt_length(void *handle, unsigned char const *blk,
+				   unsigned char *len, unsigned long seq)
+{
+    memcpy(len, blk, 4);
+}
+
+static void aes_gcm_encrypt_pkt(void *handle, unsigned char *blk, int len,
+				unsigned long seq)
+{
+    AESGCMContext *ctx = (AESGCMContext *)handle;
+
+    aes_gcm_ctr(ctx, blk + 4, len - 4, 2);
+    aes_gcm_tag(ctx, blk, 4, len, blk + len);
+    aes_gcm_next_iv(ctx);
+}
+
+static int aes_gcm_decrypt_pkt(void *handle, unsigned char *blk, int len,
+			       unsigned long seq)
+{
+    AESGCMContext *ctx = (AESGCMContext *)handle;
+    unsigned char tag[GCM_TAGLEN];
+    unsigned diff = 0;
+    int i;
+
+    aes_gcm_tag(ctx, blk, 4, len, tag);
+    for (i = 0; i < GCM_TAGLEN; i++)
+	diff |= tag[i] ^ blk[len + i];
+    if (diff)
+	return FALSE;
+
+    aes_gcm_ctr(ctx, blk + 4, len - 4, 2);
+    aes_gcm_next_iv(ctx);
+    return TRUE;
+}
+
+static const struct ssh2_cipher ssh_aes128_gcm = {
+    aes_gcm_make_context, aes_gcm_free_context, aes_gcm_iv, aes_gcm128_key,
+    NULL, NULL,
+    "aes128-gcm@openssh.com",
+    16, 128, SSH_CIPHER_IS_AEAD, "AES-128 GCM",
+    GCM_TAGLEN, "GCM",
+    aes_gcm_decrypt_length, aes_gcm_encrypt_pkt, aes_gcm_decrypt_pkt
+};
+
+static const struct ssh2_cipher ssh_aes256_gcm = {
+    aes_gcm_make_context, aes_gcm_free_context, aes_gcm_iv, aes_gcm256_key,
+    NULL, NULL,
+    "aes256-gcm@openssh.com",
+    16, 256, SSH_CIPHER_IS_AEAD, "AES-256 GCM",
+    GCM_TAGLEN, "GCM",
+    aes_gcm_decrypt_length, aes_gcm_encrypt_pkt, aes_gcm_decrypt_pkt
+};
+
 static const struct ssh2_cipher ssh_aes128_ctr = {
     aes_make_context, aes_free_context, aes_iv, aes128_key,
     aes_ssh2_sdctr, aes_ssh2_sdctr,
@@ -1219,6 +1925,8 @@ static const struct ssh2_cipher ssh_rijndael_lysator = {
 };
 
 static const struct ssh2_cipher *const aes_list[] = {
+    &ssh_aes256_gcm,
+    &ssh_aes128_gcm,
     &ssh_aes256_ctr,
     &ssh_aes256,
     &ssh_rijndael_lysator,
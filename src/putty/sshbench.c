@@ -0,0 +1,670 @@
+/*
+ * sshbench: throughput benchmark for the bulk crypto, MAC and
+ * compression primitives used by fzsftp. Where a primitive has a
+ * hardware accelerated or library implementation, it is measured
+ * both ways.
+ *
+ * Not built by default; use `make sshbench' and run
+ *
+ *   ./sshbench [megabytes per run]
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "putty.h"
+#include "ssh.h"
+
+#if !defined _WINDOWS && !defined NO_NET_READER
+#define BENCH_PIPELINE
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#endif
+
+#define BENCH_PACKET 32768
+
+/*
+ * Stubs to let everything else link sensibly.
+ */
+void modalfatalbox(char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    exit(1);
+}
+
+void nonfatal(char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+}
+
+static double elapsed(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void report(const char *name, const char *variant,
+		   double megabytes, double seconds)
+{
+    printf("%-24s %-10s %10.1f MB/s\n", name, variant,
+	   seconds > 0 ? megabytes / seconds : 0.0);
+}
+
+static void bench_cipher(const struct ssh2_cipher *cipher, int decrypt,
+			 const char *variant, int megabytes)
+{
+    unsigned char key[64], iv[32], *buf;
+    void *ctx;
+    long i, packets;
+    clock_t start;
+    char name[64];
+
+    memset(key, 0x5a, sizeof(key));
+    memset(iv, 0xa5, sizeof(iv));
+    buf = snewn(BENCH_PACKET + 16, unsigned char);
+    memset(buf, 0, BENCH_PACKET);
+
+    ctx = cipher->make_context();
+    cipher->setkey(ctx, key);
+    cipher->setiv(ctx, iv);
+
+    packets = (long)megabytes * 1024 * 1024 / BENCH_PACKET;
+    start = clock();
+    for (i = 0; i < packets; i++) {
+	if (cipher->flags & SSH_CIPHER_IS_AEAD)
+	    cipher->encrypt_pkt(ctx, buf, BENCH_PACKET, (unsigned long)i);
+	else if (decrypt)
+	    cipher->decrypt(ctx, buf, BENCH_PACKET);
+	else
+	    cipher->encrypt(ctx, buf, BENCH_PACKET);
+    }
+
+    if (cipher->flags & SSH_CIPHER_IS_AEAD)
+	sprintf(name, "%s", cipher->name);
+    else
+	sprintf(name, "%s %s", cipher->name, decrypt ? "dec" : "enc");
+    report(name, variant, megabytes, elapsed(start));
+
+    cipher->free_context(ctx);
+    sfree(buf);
+}
+
+/*
+ * Check that the accelerated and portable implementations agree,
+ * both across a whole buffer and when the data arrives in odd-sized
+ * (but block-aligned) pieces, as it does for packet headers. AEAD
+ * ciphers are checked a packet at a time, including that a packet
+ * decrypts back to what went in.
+ */
+static int check_cipher(const struct ssh2_cipher *cipher)
+{
+    unsigned char key[64], iv[32], a[1024 + 16], b[1024 + 16];
+    void *hw, *sw;
+    int i, pos, ok;
+
+    for (i = 0; i < 64; i++)
+	key[i] = (unsigned char)(i * 7 + 1);
+    for (i = 0; i < 32; i++)
+	iv[i] = (unsigned char)(0xff - i);
+    for (i = 0; i < (int)sizeof(a); i++)
+	a[i] = b[i] = (unsigned char)(i * 13);
+    /* Start the counter just short of a carry across words. */
+    memset(iv + 8, 0xff, 8);
+
+    aes_disable_hw(0);
+    hw = cipher->make_context();
+    cipher->setkey(hw, key);
+    cipher->setiv(hw, iv);
+    aes_disable_hw(1);
+    sw = cipher->make_context();
+    cipher->setkey(sw, key);
+    cipher->setiv(sw, iv);
+    aes_disable_hw(0);
+
+    if (cipher->flags & SSH_CIPHER_IS_AEAD) {
+	cipher->encrypt_pkt(hw, a, 1024, 5);
+	cipher->encrypt_pkt(sw, b, 1024, 5);
+	ok = !memcmp(a, b, sizeof(a));
+	cipher->setiv(sw, iv);
+	ok = ok && cipher->decrypt_pkt(sw, a, 1024, 5);
+	for (i = 4; ok && i < 1024; i++)
+	    ok = a[i] == (unsigned char)(i * 13);
+    } else {
+	for (pos = 0; pos < 1024; pos += 16 * (pos % 5 + 1)) {
+	    int len = 16 * (pos % 5 + 1);
+	    if (pos + len > 1024)
+		len = 1024 - pos;
+	    cipher->encrypt(hw, a + pos, len);
+	    cipher->encrypt(sw, b + pos, len);
+	}
+	ok = !memcmp(a, b, 1024);
+
+	cipher->setiv(hw, iv);
+	cipher->setiv(sw, iv);
+	cipher->decrypt(hw, a, 1024);
+	cipher->decrypt(sw, b, 1024);
+	ok = ok && !memcmp(a, b, 1024);
+	for (i = 0; ok && i < 1024; i++)
+	    ok = a[i] == (unsigned char)(i * 13);
+    }
+
+    cipher->free_context(hw);
+    cipher->free_context(sw);
+
+    if (!ok)
+	printf("%-24s MISMATCH between implementations\n", cipher->name);
+    return ok;
+}
+
+static int bench_ciphers(const struct ssh2_ciphers *ciphers, int megabytes)
+{
+    int i, ok = 1;
+
+    for (i = 0; i < ciphers->nciphers; i++) {
+	const struct ssh2_cipher *cipher = ciphers->list[i];
+	int decrypt, passes;
+
+	if (aes_hw_available())
+	    ok &= check_cipher(cipher);
+
+	/* AEAD ciphers cost the same in both directions. */
+	passes = (cipher->flags & SSH_CIPHER_IS_AEAD) ? 1 : 2;
+	for (decrypt = 0; decrypt < passes; decrypt++) {
+	    if (aes_hw_available()) {
+		bench_cipher(cipher, decrypt, "aes-ni", megabytes);
+		aes_disable_hw(1);
+		bench_cipher(cipher, decrypt, "portable", megabytes);
+		aes_disable_hw(0);
+	    }
+	    else
+		bench_cipher(cipher, decrypt, "portable", megabytes);
+	}
+    }
+
+    return ok;
+}
+
+static void bench_mac(const struct ssh_mac *mac, const char *variant,
+		      int megabytes)
+{
+    unsigned char key[64], *buf;
+    void *ctx;
+    long i, packets;
+    clock_t start;
+
+    memset(key, 0x3c, sizeof(key));
+    buf = snewn(BENCH_PACKET + mac->len, unsigned char);
+    memset(buf, 0, BENCH_PACKET);
+
+    ctx = mac->make_context();
+    mac->setkey(ctx, key);
+
+    packets = (long)megabytes * 1024 * 1024 / BENCH_PACKET;
+    start = clock();
+    for (i = 0; i < packets; i++)
+	mac->generate(ctx, buf, BENCH_PACKET, (unsigned long)i);
+
+    report(mac->name, variant, megabytes, elapsed(start));
+
+    mac->free_context(ctx);
+    sfree(buf);
+}
+
+static void bench_hash(const struct ssh_hash *hash, int megabytes)
+{
+    unsigned char *buf, out[64];
+    void *ctx;
+    long i, packets;
+    clock_t start;
+
+    buf = snewn(BENCH_PACKET, unsigned char);
+    memset(buf, 0, BENCH_PACKET);
+
+    packets = (long)megabytes * 1024 * 1024 / BENCH_PACKET;
+    start = clock();
+    ctx = hash->init();
+    for (i = 0; i < packets; i++)
+	hash->bytes(ctx, buf, BENCH_PACKET);
+    hash->final(ctx, out);
+
+    report(hash->text_name, "", megabytes, elapsed(start));
+
+    sfree(buf);
+}
+
+/*
+ * Hash the same data, fed in irregular pieces, with and without the
+ * SHA instructions and compare.
+ */
+static int check_sha256(void)
+{
+    unsigned char data[3000], hw[32], sw[32];
+    SHA256_State s;
+    int i, pos, ok = 1;
+
+    for (i = 0; i < (int)sizeof(data); i++)
+	data[i] = (unsigned char)(i * 31 + 7);
+
+    for (i = 0; ok && i < 2; i++) {
+	unsigned char *out = i ? sw : hw;
+	sha256_disable_hw(i);
+	SHA256_Init(&s);
+	for (pos = 0; pos < (int)sizeof(data); pos += pos % 211 + 1) {
+	    int len = pos % 211 + 1;
+	    if (pos + len > (int)sizeof(data))
+		len = sizeof(data) - pos;
+	    SHA256_Bytes(&s, data + pos, len);
+	}
+	SHA256_Final(&s, out);
+    }
+    sha256_disable_hw(0);
+
+    ok = !memcmp(hw, sw, sizeof(hw));
+    if (!ok)
+	printf("%-24s MISMATCH between implementations\n", "SHA-256");
+    return ok;
+}
+
+static int bench_macs(int megabytes)
+{
+    int ok = 1;
+
+    if (sha256_hw_available()) {
+	ok &= check_sha256();
+	bench_mac(&ssh_hmac_sha256, "sha-ni", megabytes);
+	sha256_disable_hw(1);
+	bench_mac(&ssh_hmac_sha256, "portable", megabytes);
+	sha256_disable_hw(0);
+    }
+    else
+	bench_mac(&ssh_hmac_sha256, "portable", megabytes);
+
+    bench_mac(&ssh_hmac_sha1, "portable", megabytes);
+    bench_hash(&ssh_sha512, megabytes);
+
+    return ok;
+}
+
+/*
+ * Compression: speed and ratio of each zlib implementation on a few
+ * kinds of payload, fed through a packet at a time as ssh.c does.
+ */
+
+#define COMP_CORPUS (4 * 1024 * 1024)
+
+enum { PAYLOAD_TEXT, PAYLOAD_BINARY, PAYLOAD_RANDOM };
+
+static unsigned long bench_rand(unsigned long *state)
+{
+    *state = *state * 1103515245UL + 12345UL;
+    return (*state >> 16) & 0x7fff;
+}
+
+static void make_payload(int kind, unsigned char *buf, int len)
+{
+    static const char *const words[] = {
+	"GET", "PUT", "/var/log/messages", "/home/user/src/main.c",
+	"200", "404", "Connection closed", "session opened for user",
+	"sftp-server", "debug1:", "kernel:", "error", "OK",
+    };
+    unsigned long state = 1;
+    int pos = 0, i;
+
+    while (pos < len) {
+	char line[256];
+	int n = 0;
+
+	switch (kind) {
+	  case PAYLOAD_TEXT:
+	    /* Log-file like lines. */
+	    n = sprintf(line, "Jan %2lu %02lu:%02lu:%02lu host%lu ",
+			bench_rand(&state) % 31 + 1, bench_rand(&state) % 24,
+			bench_rand(&state) % 60, bench_rand(&state) % 60,
+			bench_rand(&state) % 4);
+	    for (i = bench_rand(&state) % 6 + 2; i > 0; i--)
+		n += sprintf(line + n, "%s ", words[bench_rand(&state) %
+					       lenof(words)]);
+	    n += sprintf(line + n, "[%lu]\n", bench_rand(&state));
+	    break;
+	  case PAYLOAD_BINARY:
+	    /* Fixed-size records with counters and small fields, like
+	     * an object file or a database page. */
+	    PUT_32BIT_LSB_FIRST(line, pos / 16);
+	    PUT_32BIT_LSB_FIRST(line + 4, bench_rand(&state) % 256);
+	    PUT_32BIT_LSB_FIRST(line + 8, 0x08048000UL + pos);
+	    PUT_32BIT_LSB_FIRST(line + 12, bench_rand(&state) << 8);
+	    n = 16;
+	    break;
+	  case PAYLOAD_RANDOM:
+	    /* Already compressed data. */
+	    for (n = 0; n < 64; n++)
+		line[n] = (char)(bench_rand(&state) >> 3);
+	    break;
+	}
+
+	if (n > len - pos)
+	    n = len - pos;
+	memcpy(buf + pos, line, n);
+	pos += n;
+    }
+}
+
+/*
+ * Compress the corpus with comp, decompress it again with decomp
+ * and check it survived. Returns the compressed size, or -1.
+ */
+static long comp_roundtrip(const struct ssh_compress *comp,
+			   const struct ssh_compress *decomp,
+			   const unsigned char *corpus, double *ctime,
+			   double *dtime)
+{
+    unsigned char **packets, *out;
+    int *lens, npackets, i, ok = 1, outlen;
+    long total = 0;
+    void *ctx;
+    clock_t start;
+
+    npackets = COMP_CORPUS / BENCH_PACKET;
+    packets = snewn(npackets, unsigned char *);
+    lens = snewn(npackets, int);
+
+    ctx = comp->compress_init();
+    start = clock();
+    for (i = 0; i < npackets; i++) {
+	comp->compress(ctx, (unsigned char *)corpus + i * BENCH_PACKET,
+		       BENCH_PACKET, &packets[i], &lens[i]);
+	total += lens[i];
+    }
+    if (ctime)
+	*ctime += elapsed(start);
+    comp->compress_cleanup(ctx);
+
+    ctx = decomp->decompress_init();
+    start = clock();
+    for (i = 0; i < npackets; i++) {
+	if (!decomp->decompress(ctx, packets[i], lens[i], &out, &outlen)) {
+	    ok = 0;
+	    break;
+	}
+	ok &= outlen == BENCH_PACKET &&
+	    !memcmp(out, corpus + i * BENCH_PACKET, BENCH_PACKET);
+	sfree(out);
+    }
+    if (dtime)
+	*dtime += elapsed(start);
+    decomp->decompress_cleanup(ctx);
+
+    for (i = 0; i < npackets; i++)
+	sfree(packets[i]);
+    sfree(packets);
+    sfree(lens);
+
+    return ok ? total : -1;
+}
+
+static int bench_compress(const struct ssh_compress *comp,
+			  const char *variant, int megabytes)
+{
+    static const char *const kinds[] = { "text", "binary", "random" };
+    unsigned char *corpus = snewn(COMP_CORPUS, unsigned char);
+    int kind, passes, i, ok = 1;
+
+    passes = megabytes * 1024 * 1024 / COMP_CORPUS;
+    if (passes < 1)
+	passes = 1;
+
+    for (kind = 0; kind < lenof(kinds); kind++) {
+	double ctime = 0, dtime = 0, mb;
+	long size = 0;
+	char name[64];
+
+	make_payload(kind, corpus, COMP_CORPUS);
+	for (i = 0; i < passes && size >= 0; i++)
+	    size = comp_roundtrip(comp, comp, corpus, &ctime, &dtime);
+
+	sprintf(name, "zlib %s", kinds[kind]);
+	if (size < 0) {
+	    printf("%-24s %-10s roundtrip FAILED\n", name, variant);
+	    ok = 0;
+	    continue;
+	}
+	mb = (double)passes * COMP_CORPUS / 1048576.0;
+	printf("%-24s %-10s %8.1f MB/s comp %8.1f MB/s decomp %5.1f%%\n",
+	       name, variant, ctime > 0 ? mb / ctime : 0.0,
+	       dtime > 0 ? mb / dtime : 0.0, 100.0 * size / COMP_CORPUS);
+    }
+
+    sfree(corpus);
+    return ok;
+}
+
+static int bench_compression(int megabytes)
+{
+    int ok = 1;
+
+    ok &= bench_compress(&ssh_zlib, "builtin", megabytes);
+#ifdef USE_SYSTEM_ZLIB
+    ok &= bench_compress(&ssh_zlib_system, "system", megabytes);
+
+    /* Each implementation must be able to read the other's output. */
+    {
+	unsigned char *corpus = snewn(COMP_CORPUS, unsigned char);
+	make_payload(PAYLOAD_TEXT, corpus, COMP_CORPUS);
+	if (comp_roundtrip(&ssh_zlib, &ssh_zlib_system, corpus,
+			   NULL, NULL) < 0 ||
+	    comp_roundtrip(&ssh_zlib_system, &ssh_zlib, corpus,
+			   NULL, NULL) < 0) {
+	    printf("%-24s MISMATCH between implementations\n", "zlib");
+	    ok = 0;
+	}
+	sfree(corpus);
+    }
+#endif
+
+    return ok;
+}
+
+#ifdef BENCH_PIPELINE
+
+/*
+ * Receive-side pipeline benchmark. A thread standing in for sshd
+ * writes aes256-ctr/hmac-sha2-256 packets into a socketpair as fast
+ * as it can, and the client decrypts and MACs them the way
+ * ssh2_rdpkt does, either reading the socket itself or through a
+ * netreader thread as uxnet.c does.
+ *
+ * The stand-in replays one canned packet, so the client does the
+ * full amount of crypto but doesn't check the results.
+ */
+
+#define PIPE_READ 20480		       /* as net_select_result */
+
+struct pipe_server {
+    int fd;
+    long packets;
+    unsigned char *pkt;
+    int pktlen;
+};
+
+static void *pipe_server_thread(void *param)
+{
+    struct pipe_server *srv = (struct pipe_server *)param;
+    long i;
+
+    for (i = 0; i < srv->packets; i++) {
+	int pos = 0;
+	while (pos < srv->pktlen) {
+	    int ret = send(srv->fd, srv->pkt + pos, srv->pktlen - pos, 0);
+	    if (ret < 0) {
+		if (errno == EINTR)
+		    continue;
+		return NULL;
+	    }
+	    pos += ret;
+	}
+    }
+    shutdown(srv->fd, SHUT_WR);
+    return NULL;
+}
+
+static int pipe_fill(int fd, struct netreader *reader, unsigned char *buf)
+{
+    int ret;
+
+    if (!reader)
+	return recv(fd, buf, PIPE_READ, 0);
+
+    for (;;) {
+	struct pollfd pfd;
+	ret = netreader_recv(reader, buf, PIPE_READ);
+	if (ret >= 0 || errno != EWOULDBLOCK)
+	    return ret;
+	pfd.fd = netreader_wakefd(reader);
+	pfd.events = POLLIN;
+	poll(&pfd, 1, -1);
+    }
+}
+
+static void bench_pipeline(int threaded, int megabytes)
+{
+    const struct ssh2_cipher *cipher = NULL;
+    const struct ssh_mac *mac = &ssh_hmac_sha256;
+    struct pipe_server srv;
+    struct netreader *reader = NULL;
+    pthread_t thread;
+    unsigned char key[64], iv[32], *buf, *pkt;
+    void *cctx, *mctx;
+    int sv[2], pktlen, have, ret;
+    long seq, total;
+    struct timeval start, end;
+
+    for (seq = 0; seq < ssh2_aes.nciphers; seq++)
+	if (!strcmp(ssh2_aes.list[seq]->name, "aes256-ctr"))
+	    cipher = ssh2_aes.list[seq];
+    assert(cipher);
+
+    memset(key, 0x5a, sizeof(key));
+    memset(iv, 0xa5, sizeof(iv));
+    pktlen = BENCH_PACKET + mac->len;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+	perror("socketpair");
+	return;
+    }
+
+    srv.fd = sv[0];
+    srv.packets = (long)megabytes * 1024 * 1024 / BENCH_PACKET;
+    srv.pktlen = pktlen;
+    srv.pkt = snewn(pktlen, unsigned char);
+    memset(srv.pkt, 0x42, pktlen);
+
+    cctx = cipher->make_context();
+    cipher->setkey(cctx, key);
+    cipher->setiv(cctx, iv);
+    mctx = mac->make_context();
+    mac->setkey(mctx, key);
+
+    buf = snewn(PIPE_READ, unsigned char);
+    pkt = snewn(pktlen, unsigned char);
+
+    if (threaded && !(reader = netreader_start(sv[1]))) {
+	printf("%-24s %-10s %15s\n", "socket aes256-ctr+sha256", "reader",
+	       "not available");
+	close(sv[0]);
+	close(sv[1]);
+	goto cleanup;
+    }
+
+    gettimeofday(&start, NULL);
+    pthread_create(&thread, NULL, pipe_server_thread, &srv);
+
+    /*
+     * Split the stream back into packets and process each one when
+     * it is complete: decrypt the first block to get the length,
+     * then the rest, then MAC the lot.
+     */
+    seq = total = 0;
+    have = 0;
+    while ((ret = pipe_fill(sv[1], reader, buf)) > 0) {
+	int pos = 0;
+	while (pos < ret) {
+	    int n = pktlen - have;
+	    if (n > ret - pos)
+		n = ret - pos;
+	    memcpy(pkt + have, buf + pos, n);
+	    have += n;
+	    pos += n;
+	    if (have == pktlen) {
+		cipher->decrypt(cctx, pkt, cipher->blksize);
+		cipher->decrypt(cctx, pkt + cipher->blksize,
+				BENCH_PACKET - cipher->blksize);
+		mac->verify(mctx, pkt, BENCH_PACKET, seq++);
+		total += BENCH_PACKET;
+		have = 0;
+	    }
+	}
+    }
+
+    pthread_join(thread, NULL);
+    gettimeofday(&end, NULL);
+    if (reader)
+	netreader_stop(reader);
+
+    report("socket aes256-ctr+sha256", threaded ? "reader" : "inline",
+	   total / 1048576.0, (end.tv_sec - start.tv_sec) +
+	   (end.tv_usec - start.tv_usec) / 1000000.0);
+
+    close(sv[0]);
+    close(sv[1]);
+  cleanup:
+    cipher->free_context(cctx);
+    mac->free_context(mctx);
+    sfree(srv.pkt);
+    sfree(buf);
+    sfree(pkt);
+}
+
+#endif /* BENCH_PIPELINE */
+
+int main(int argc, char **argv)
+{
+    int megabytes = 256, ok = 1;
+
+    if (argc > 1)
+	megabytes = atoi(argv[1]);
+    if (megabytes <= 0) {
+	fprintf(stderr, "usage: sshbench [megabytes per run]\n");
+	return 1;
+    }
+
+    printf("AES instructions: %s\n",
+	   aes_hw_available() ? "available" : "not available");
+    printf("SHA instructions: %s\n",
+	   sha256_hw_available() ? "available" : "not available");
+
+    ok &= bench_ciphers(&ssh2_aes, megabytes);
+    bench_cipher(ssh2_ccp.list[0], 0, "", megabytes);
+    ok &= bench_macs(megabytes);
+    ok &= bench_compression(megabytes);
+#ifdef BENCH_PIPELINE
+    bench_pipeline(0, megabytes);
+    bench_pipeline(1, megabytes);
+#endif
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,458 @@
+/*
+ * ChaCha20-Poly1305 implementation for SSH-2, as specified for
+ * OpenSSH in PROTOCOL.chacha20poly1305:
+ *
+ *   chacha20-poly1305@openssh.com
+ *
+ * The packet length is encrypted with one ChaCha20 instance, the
+ * rest of the packet with a second one, and the whole ciphertext is
+ * authenticated with a one-time Poly1305 key taken from the second
+ * instance's keystream. There is no separate MAC.
+ *
+ * ChaCha20 and Poly1305 are both designed to be fast in portable C
+ * on 32-bit machines: no tables, no secret-dependent branches, and
+ * only 32x32->64 bit multiplications.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "ssh.h"
+
+/*
+ * On x86 and x86-64, ChaCha20 additionally has an SSE2 version that
+ * computes four blocks at once; see sshaes.c for the compiler
+ * requirements.
+ */
+#if !defined NO_HW_CHACHA && (defined __x86_64__ || defined __i386__) && \
+    (defined __clang__ || \
+     (defined __GNUC__ && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define SSE2_CHACHA
+#include <cpuid.h>
+#include <emmintrin.h>
+#define SSE2_FUNC __attribute__((target("sse2")))
+#endif
+
+typedef unsigned long long ccp_u64;
+
+/* ----------------------------------------------------------------------
+ * ChaCha20, in the original 64-bit nonce, 64-bit counter variant.
+ */
+
+struct chacha20 {
+    /* constants, key, counter, nonce */
+    word32 state[16];
+};
+
+#define ROTL32(x, n) ( (word32)(((x) << (n)) | ((x) >> (32 - (n)))) )
+
+#define QUARTERROUND(a, b, c, d) ( \
+    x[a] += x[b], x[d] = ROTL32(x[d] ^ x[a], 16), \
+    x[c] += x[d], x[b] = ROTL32(x[b] ^ x[c], 12), \
+    x[a] += x[b], x[d] = ROTL32(x[d] ^ x[a],  8), \
+    x[c] += x[d], x[b] = ROTL32(x[b] ^ x[c],  7) )
+
+static void chacha20_key(struct chacha20 *ctx, const unsigned char *key)
+{
+    static const unsigned char sigma[16] = "expand 32-byte k";
+    int i;
+
+    for (i = 0; i < 4; i++)
+	ctx->state[i] = GET_32BIT_LSB_FIRST(sigma + 4 * i);
+    for (i = 0; i < 8; i++)
+	ctx->state[4 + i] = GET_32BIT_LSB_FIRST(key + 4 * i);
+    for (i = 12; i < 16; i++)
+	ctx->state[i] = 0;
+}
+
+/*
+ * SSH uses the packet sequence number as the nonce, encoded as a
+ * 64-bit big-endian integer.
+ */
+static void chacha20_seq(struct chacha20 *ctx, unsigned long seq,
+			 word32 counter)
+{
+    unsigned char nonce[8];
+
+    PUT_32BIT_MSB_FIRST(nonce, 0);
+    PUT_32BIT_MSB_FIRST(nonce + 4, seq);
+    ctx->state[12] = counter;
+    ctx->state[13] = 0;
+    ctx->state[14] = GET_32BIT_LSB_FIRST(nonce);
+    ctx->state[15] = GET_32BIT_LSB_FIRST(nonce + 4);
+}
+
+static void chacha20_block(struct chacha20 *ctx, unsigned char *out)
+{
+    word32 x[16];
+    int i;
+
+    memcpy(x, ctx->state, sizeof(x));
+    for (i = 0; i < 10; i++) {
+	QUARTERROUND(0, 4,  8, 12);
+	QUARTERROUND(1, 5,  9, 13);
+	QUARTERROUND(2, 6, 10, 14);
+	QUARTERROUND(3, 7, 11, 15);
+	QUARTERROUND(0, 5, 10, 15);
+	QUARTERROUND(1, 6, 11, 12);
+	QUARTERROUND(2, 7,  8, 13);
+	QUARTERROUND(3, 4,  9, 14);
+    }
+    for (i = 0; i < 16; i++)
+	PUT_32BIT_LSB_FIRST(out + 4 * i, x[i] + ctx->state[i]);
+
+    if (++ctx->state[12] == 0)
+	ctx->state[13]++;
+}
+
+#ifdef SSE2_CHACHA
+
+static int chacha20_sse2_available(void)
+{
+    static int checked = 0, available = 0;
+
+    if (!checked) {
+	unsigned int eax, ebx, ecx, edx;
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+	    available = (edx & bit_SSE2) != 0;
+	checked = 1;
+    }
+    return available;
+}
+
+#define VROTL32(v, n) \
+    _mm_or_si128(_mm_slli_epi32(v, n), _mm_srli_epi32(v, 32 - (n)))
+
+#define VQUARTERROUND(a, b, c, d) ( \
+    x[a] = _mm_add_epi32(x[a], x[b]), \
+    x[d] = VROTL32(_mm_xor_si128(x[d], x[a]), 16), \
+    x[c] = _mm_add_epi32(x[c], x[d]), \
+    x[b] = VROTL32(_mm_xor_si128(x[b], x[c]), 12), \
+    x[a] = _mm_add_epi32(x[a], x[b]), \
+    x[d] = VROTL32(_mm_xor_si128(x[d], x[a]),  8), \
+    x[c] = _mm_add_epi32(x[c], x[d]), \
+    x[b] = VROTL32(_mm_xor_si128(x[b], x[c]),  7) )
+
+/*
+ * Encrypt four consecutive blocks (256 bytes), with one block in
+ * each 32-bit lane. The caller makes sure the low counter word
+ * doesn't wrap in between.
+ */
+static SSE2_FUNC void chacha20_crypt_x4(struct chacha20 *ctx,
+					unsigned char *blk)
+{
+    __m128i x[16], orig[16];
+    int i, g, j;
+
+    for (i = 0; i < 16; i++)
+	orig[i] = _mm_set1_epi32((int)ctx->state[i]);
+    orig[12] = _mm_add_epi32(orig[12], _mm_set_epi32(3, 2, 1, 0));
+    memcpy(x, orig, sizeof(x));
+
+    for (i = 0; i < 10; i++) {
+	VQUARTERROUND(0, 4,  8, 12);
+	VQUARTERROUND(1, 5,  9, 13);
+	VQUARTERROUND(2, 6, 10, 14);
+	VQUARTERROUND(3, 7, 11, 15);
+	VQUARTERROUND(0, 5, 10, 15);
+	VQUARTERROUND(1, 6, 11, 12);
+	VQUARTERROUND(2, 7,  8, 13);
+	VQUARTERROUND(3, 4,  9, 14);
+    }
+
+    /* Transpose back from lanes to blocks, four words at a time. */
+    for (g = 0; g < 4; g++) {
+	__m128i a = _mm_add_epi32(x[4*g], orig[4*g]);
+	__m128i b = _mm_add_epi32(x[4*g+1], orig[4*g+1]);
+	__m128i c = _mm_add_epi32(x[4*g+2], orig[4*g+2]);
+	__m128i d = _mm_add_epi32(x[4*g+3], orig[4*g+3]);
+	__m128i t0 = _mm_unpacklo_epi32(a, b), t1 = _mm_unpacklo_epi32(c, d);
+	__m128i t2 = _mm_unpackhi_epi32(a, b), t3 = _mm_unpackhi_epi32(c, d);
+	__m128i o[4];
+	o[0] = _mm_unpacklo_epi64(t0, t1);
+	o[1] = _mm_unpackhi_epi64(t0, t1);
+	o[2] = _mm_unpacklo_epi64(t2, t3);
+	o[3] = _mm_unpackhi_epi64(t2, t3);
+	for (j = 0; j < 4; j++) {
+	    __m128i *p = (__m128i *)(blk + 64 * j + 16 * g);
+	    _mm_storeu_si128(p, _mm_xor_si128(o[j], _mm_loadu_si128(p)));
+	}
+    }
+
+    ctx->state[12] += 4;
+}
+
+#endif /* SSE2_CHACHA */
+
+static void chacha20_crypt(struct chacha20 *ctx, unsigned char *blk, int len)
+{
+    unsigned char ks[64];
+    int i, n;
+
+#ifdef SSE2_CHACHA
+    if (chacha20_sse2_available()) {
+	while (len >= 256 && ctx->state[12] <= 0xfffffffbU) {
+	    chacha20_crypt_x4(ctx, blk);
+	    blk += 256;
+	    len -= 256;
+	}
+    }
+#endif
+
+    while (len > 0) {
+	chacha20_block(ctx, ks);
+	n = len < 64 ? len : 64;
+	for (i = 0; i < n; i++)
+	    blk[i] ^= ks[i];
+	blk += n;
+	len -= n;
+    }
+    smemclr(ks, sizeof(ks));
+}
+
+/* ----------------------------------------------------------------------
+ * Poly1305, using five 26-bit limbs so that all the products fit in
+ * 64 bits without needing a double-width type.
+ */
+
+struct poly1305 {
+    word32 r[5], h[5], pad[4];
+};
+
+static void poly1305_key(struct poly1305 *ctx, const unsigned char *key)
+{
+    /* r is clamped as the specification requires. */
+    ctx->r[0] = (GET_32BIT_LSB_FIRST(key +  0)     ) & 0x3ffffff;
+    ctx->r[1] = (GET_32BIT_LSB_FIRST(key +  3) >> 2) & 0x3ffff03;
+    ctx->r[2] = (GET_32BIT_LSB_FIRST(key +  6) >> 4) & 0x3ffc0ff;
+    ctx->r[3] = (GET_32BIT_LSB_FIRST(key +  9) >> 6) & 0x3f03fff;
+    ctx->r[4] = (GET_32BIT_LSB_FIRST(key + 12) >> 8) & 0x00fffff;
+
+    memset(ctx->h, 0, sizeof(ctx->h));
+
+    ctx->pad[0] = GET_32BIT_LSB_FIRST(key + 16);
+    ctx->pad[1] = GET_32BIT_LSB_FIRST(key + 20);
+    ctx->pad[2] = GET_32BIT_LSB_FIRST(key + 24);
+    ctx->pad[3] = GET_32BIT_LSB_FIRST(key + 28);
+}
+
+/*
+ * Absorb len bytes, which must be a multiple of 16 except for the
+ * final call. A short final block is padded with a 1 byte.
+ */
+static void poly1305_blocks(struct poly1305 *ctx, const unsigned char *m,
+			    int len)
+{
+    const word32 r0 = ctx->r[0], r1 = ctx->r[1], r2 = ctx->r[2],
+	r3 = ctx->r[3], r4 = ctx->r[4];
+    const word32 s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    word32 h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2],
+	h3 = ctx->h[3], h4 = ctx->h[4];
+    word32 hibit, c;
+    ccp_u64 d0, d1, d2, d3, d4;
+    unsigned char last[16];
+
+    while (len > 0) {
+	hibit = 1 << 24;
+	if (len < 16) {
+	    memset(last, 0, sizeof(last));
+	    memcpy(last, m, len);
+	    last[len] = 1;
+	    m = last;
+	    len = 16;
+	    hibit = 0;
+	}
+
+	h0 += (GET_32BIT_LSB_FIRST(m +  0)     ) & 0x3ffffff;
+	h1 += (GET_32BIT_LSB_FIRST(m +  3) >> 2) & 0x3ffffff;
+	h2 += (GET_32BIT_LSB_FIRST(m +  6) >> 4) & 0x3ffffff;
+	h3 += (GET_32BIT_LSB_FIRST(m +  9) >> 6) & 0x3ffffff;
+	h4 += (GET_32BIT_LSB_FIRST(m + 12) >> 8) | hibit;
+
+	d0 = (ccp_u64)h0 * r0 + (ccp_u64)h1 * s4 + (ccp_u64)h2 * s3 +
+	    (ccp_u64)h3 * s2 + (ccp_u64)h4 * s1;
+	d1 = (ccp_u64)h0 * r1 + (ccp_u64)h1 * r0 + (ccp_u64)h2 * s4 +
+	    (ccp_u64)h3 * s3 + (ccp_u64)h4 * s2;
+	d2 = (ccp_u64)h0 * r2 + (ccp_u64)h1 * r1 + (ccp_u64)h2 * r0 +
+	    (ccp_u64)h3 * s4 + (ccp_u64)h4 * s3;
+	d3 = (ccp_u64)h0 * r3 + (ccp_u64)h1 * r2 + (ccp_u64)h2 * r1 +
+	    (ccp_u64)h3 * r0 + (ccp_u64)h4 * s4;
+	d4 = (ccp_u64)h0 * r4 + (ccp_u64)h1 * r3 + (ccp_u64)h2 * r2 +
+	    (ccp_u64)h3 * r1 + (ccp_u64)h4 * r0;
+
+	c = (word32)(d0 >> 26); h0 = (word32)d0 & 0x3ffffff;
+	d1 += c; c = (word32)(d1 >> 26); h1 = (word32)d1 & 0x3ffffff;
+	d2 += c; c = (word32)(d2 >> 26); h2 = (word32)d2 & 0x3ffffff;
+	d3 += c; c = (word32)(d3 >> 26); h3 = (word32)d3 & 0x3ffffff;
+	d4 += c; c = (word32)(d4 >> 26); h4 = (word32)d4 & 0x3ffffff;
+	h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+	h1 += c;
+
+	m += 16;
+	len -= 16;
+    }
+
+    ctx->h[0] = h0; ctx->h[1] = h1; ctx->h[2] = h2;
+    ctx->h[3] = h3; ctx->h[4] = h4;
+}
+
+static void poly1305_finish(struct poly1305 *ctx, unsigned char *mac)
+{
+    word32 h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2],
+	h3 = ctx->h[3], h4 = ctx->h[4];
+    word32 g0, g1, g2, g3, g4, c, mask;
+    ccp_u64 f;
+
+    /* Fully carry h. */
+    c = h1 >> 26; h1 &= 0x3ffffff;
+    h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+    h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+    h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+    h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+    h1 += c;
+
+    /* Compute h - p and select it if it didn't go negative. */
+    g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+    g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+    g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+    g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+    g4 = h4 + c - (1 << 26);
+
+    mask = (g4 >> 31) - 1;
+    g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+    mask = ~mask;
+    h0 = (h0 & mask) | g0;
+    h1 = (h1 & mask) | g1;
+    h2 = (h2 & mask) | g2;
+    h3 = (h3 & mask) | g3;
+    h4 = (h4 & mask) | g4;
+
+    /* h = h % 2^128, then add the pad. */
+    h0 = (h0      ) | (h1 << 26);
+    h1 = (h1 >>  6) | (h2 << 20);
+    h2 = (h2 >> 12) | (h3 << 14);
+    h3 = (h3 >> 18) | (h4 <<  8);
+
+    f = (ccp_u64)h0 + ctx->pad[0];             h0 = (word32)f;
+    f = (ccp_u64)h1 + ctx->pad[1] + (f >> 32); h1 = (word32)f;
+    f = (ccp_u64)h2 + ctx->pad[2] + (f >> 32); h2 = (word32)f;
+    f = (ccp_u64)h3 + ctx->pad[3] + (f >> 32); h3 = (word32)f;
+
+    PUT_32BIT_LSB_FIRST(mac +  0, h0);
+    PUT_32BIT_LSB_FIRST(mac +  4, h1);
+    PUT_32BIT_LSB_FIRST(mac +  8, h2);
+    PUT_32BIT_LSB_FIRST(mac + 12, h3);
+}
+
+/* ----------------------------------------------------------------------
+ * The SSH-2 cipher built from the two.
+ */
+
+struct ccp_context {
+    struct chacha20 a_cipher;	       /* used for the length field */
+    struct chacha20 b_cipher;	       /* used for everything else */
+    struct poly1305 mac;
+};
+
+#define CCP_TAGLEN 16
+
+static void *ccp_make_context(void)
+{
+    return snew(struct ccp_context);
+}
+
+static void ccp_free_context(void *handle)
+{
+    smemclr(handle, sizeof(struct ccp_context));
+    sfree(handle);
+}
+
+static void ccp_iv(void *handle, unsigned char *iv)
+{
+    /* The nonce is the sequence number; there is no IV. */
+}
+
+static void ccp_key(void *handle, unsigned char *key)
+{
+    struct ccp_context *ctx = (struct ccp_context *)handle;
+
+    /* The first 32 bytes are K_2, for the payload, then K_1. */
+    chacha20_key(&ctx->b_cipher, key);
+    chacha20_key(&ctx->a_cipher, key + 32);
+}
+
+/*
+ * Start a packet: set both ciphers up for this sequence number, and
+ * take the Poly1305 key from the first keystream block of the second.
+ */
+static void ccp_start(struct ccp_context *ctx, unsigned long seq)
+{
+    unsigned char ks[64];
+
+    chacha20_seq(&ctx->a_cipher, seq, 0);
+    chacha20_seq(&ctx->b_cipher, seq, 0);
+    chacha20_block(&ctx->b_cipher, ks);
+    poly1305_key(&ctx->mac, ks);
+    smemclr(ks, sizeof(ks));
+}
+
+static void ccp_decrypt_length(void *handle, unsigned char const *blk,
+			       unsigned char *out, unsigned long seq)
+{
+    struct ccp_context *ctx = (struct ccp_context *)handle;
+
+    memcpy(out, blk, 4);
+    chacha20_seq(&ctx->a_cipher, seq, 0);
+    chacha20_crypt(&ctx->a_cipher, out, 4);
+}
+
+static void ccp_encrypt_pkt(void *handle, unsigned char *blk, int len,
+			    unsigned long seq)
+{
+    struct ccp_context *ctx = (struct ccp_context *)handle;
+
+    ccp_start(ctx, seq);
+    chacha20_crypt(&ctx->a_cipher, blk, 4);
+    chacha20_crypt(&ctx->b_cipher, blk + 4, len - 4);
+    poly1305_blocks(&ctx->mac, blk, len);
+    poly1305_finish(&ctx->mac, blk + len);
+}
+
+static int ccp_decrypt_pkt(void *handle, unsigned char *blk, int len,
+			   unsigned long seq)
+{
+    struct ccp_context *ctx = (struct ccp_context *)handle;
+    unsigned char tag[CCP_TAGLEN];
+    unsigned diff = 0;
+    int i;
+
+    ccp_start(ctx, seq);
+    poly1305_blocks(&ctx->mac, blk, len);
+    poly1305_finish(&ctx->mac, tag);
+    for (i = 0; i < CCP_TAGLEN; i++)
+	diff |= tag[i] ^ blk[len + i];
+    if (diff)
+	return FALSE;
+
+    chacha20_crypt(&ctx->a_cipher, blk, 4);
+    chacha20_crypt(&ctx->b_cipher, blk + 4, len - 4);
+    return TRUE;
+}
+
+static const struct ssh2_cipher ssh2_chacha20_poly1305 = {
+    ccp_make_context, ccp_free_context, ccp_iv, ccp_key,
+    NULL, NULL,
+    "chacha20-poly1305@openssh.com",
+    8, 512, SSH_CIPHER_IS_AEAD, "ChaCha20",
+    CCP_TAGLEN, "Poly1305",
+    ccp_decrypt_length, ccp_encrypt_pkt, ccp_decrypt_pkt
+};
+
+static const struct ssh2_cipher *const ccp_list[] = {
+    &ssh2_chacha20_poly1305
+};
+
+const struct ssh2_ciphers ssh2_ccp = {
+    sizeof(ccp_list) / sizeof(*ccp_list),
+    ccp_list
+};
@@ -6,6 +6,21 @@
 
 #include "ssh.h"
 
+/*
+ * On x86 and x86-64 we can additionally use the SHA extensions
+ * (SHA-NI), selected at run time after checking CPUID; see sshaes.c
+ * for the compiler requirements. Define NO_HW_SHA to build the
+ * portable implementation only.
+ */
+#if !defined NO_HW_SHA && (defined __x86_64__ || defined __i386__) && \
+    (defined __clang__ || \
+     (defined __GNUC__ && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define HW_SHA_NI
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA_NI_FUNC __attribute__((target("sha,sse4.1,ssse3")))
+#endif
+
 /* ----------------------------------------------------------------------
  * Core SHA256 algorithm: processes 16-word blocks into a message digest.
  */
@@ -85,6 +100,169 @@ void SHA256_Block(SHA256_State *s, uint32 *block) {
     s->h[4] += e; s->h[5] += f; s->h[6] += g; s->h[7] += h;
 }
 
+/* ----------------------------------------------------------------------
+ * SHA-NI version of the core algorithm. This works directly on the
+ * input bytes and can process any number of consecutive blocks
+ * without going back to memory for the state in between.
+ */
+
+static int sha256_hw_disabled = 0;
+
+int sha256_hw_available(void)
+{
+#ifdef HW_SHA_NI
+    static int checked = 0, available = 0;
+
+    if (!checked) {
+	unsigned int eax, ebx, ecx, edx;
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+	    (ecx & bit_SSSE3) && (ecx & bit_SSE4_1) &&
+	    __get_cpuid_max(0, NULL) >= 7) {
+	    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+	    available = (ebx & (1 << 29)) != 0;   /* SHA extensions */
+	}
+	checked = 1;
+    }
+    return available && !sha256_hw_disabled;
+#else
+    return 0;
+#endif
+}
+
+void sha256_disable_hw(int disable)
+{
+    sha256_hw_disabled = disable;
+}
+
+#ifdef HW_SHA_NI
+
+static const uint32 sha256_ni_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/*
+ * Four rounds, using message words w (already including the
+ * schedule) and constants from group g.
+ */
+#define SHA_NI_4ROUNDS(g, w) do {					\
+    __m128i m_ = _mm_add_epi32(w, _mm_loadu_si128(			\
+	(const __m128i *)(sha256_ni_k + 4 * (g))));			\
+    state1 = _mm_sha256rnds2_epu32(state1, state0, m_);		\
+    m_ = _mm_shuffle_epi32(m_, 0x0E);					\
+    state0 = _mm_sha256rnds2_epu32(state0, state1, m_);		\
+} while (0)
+
+/*
+ * Message schedule: w0..w3 hold words t-16..t-1, and w0 is replaced
+ * with words t..t+3.
+ */
+#define SHA_NI_SCHEDULE(w0, w1, w2, w3)					\
+    (w0 = _mm_sha256msg2_epu32(_mm_add_epi32(				\
+	_mm_sha256msg1_epu32(w0, w1), _mm_alignr_epi8(w3, w2, 4)), w3))
+
+static SHA_NI_FUNC void sha256_ni_blocks(uint32 *h, const unsigned char *p,
+					 int nblocks)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					 0x0405060700010203ULL);
+    __m128i state0, state1, tmp, save0, save1, w0, w1, w2, w3;
+    int g;
+
+    /* Rearrange the state into the ABEF/CDGH order the rounds use. */
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)h), 0xB1);
+    state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(h + 4)),
+			       0x1B);
+    state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    while (nblocks-- > 0) {
+	save0 = state0;
+	save1 = state1;
+
+	w0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), bswap);
+	w1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 16)),
+			      bswap);
+	w2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 32)),
+			      bswap);
+	w3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 48)),
+			      bswap);
+
+	SHA_NI_4ROUNDS(0, w0);
+	SHA_NI_4ROUNDS(1, w1);
+	SHA_NI_4ROUNDS(2, w2);
+	SHA_NI_4ROUNDS(3, w3);
+	for (g = 4; g < 16; g += 4) {
+	    SHA_NI_SCHEDULE(w0, w1, w2, w3);
+	    SHA_NI_4ROUNDS(g, w0);
+	    SHA_NI_SCHEDULE(w1, w2, w3, w0);
+	    SHA_NI_4ROUNDS(g + 1, w1);
+	    SHA_NI_SCHEDULE(w2, w3, w0, w1);
+	    SHA_NI_4ROUNDS(g + 2, w2);
+	    SHA_NI_SCHEDULE(w3, w0, w1, w2);
+	    SHA_NI_4ROUNDS(g + 3, w3);
+	}
+
+	state0 = _mm_add_epi32(state0, save0);
+	state1 = _mm_add_epi32(state1, save1);
+	p += 64;
+    }
+
+    /* And back into h[0..7] order. */
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128((__m128i *)h, state0);
+    _mm_storeu_si128((__m128i *)(h + 4), state1);
+}
+
+#endif /* HW_SHA_NI */
+
+/*
+ * Process nblocks consecutive 64-byte blocks starting at p.
+ */
+static void SHA256_Blocks(SHA256_State *s, const unsigned char *p,
+			  int nblocks)
+{
+    uint32 wordblock[16];
+    int i;
+
+#ifdef HW_SHA_NI
+    if (sha256_hw_available()) {
+	sha256_ni_blocks(s->h, p, nblocks);
+	return;
+    }
+#endif
+
+    while (nblocks-- > 0) {
+	/* Gather bytes big-endian into words */
+	for (i = 0; i < 16; i++) {
+	    wordblock[i] =
+		( ((uint32)p[i*4+0]) << 24 ) |
+		( ((uint32)p[i*4+1]) << 16 ) |
+		( ((uint32)p[i*4+2]) <<  8 ) |
+		( ((uint32)p[i*4+3]) <<  0 );
+	}
+	SHA256_Block(s, wordblock);
+	p += 64;
+    }
+}
+
 /* ----------------------------------------------------------------------
  * Outer SHA256 algorithm: take an arbitrary length byte string,
  * convert it into 16-word blocks with the prescribed padding at
@@ -101,9 +279,7 @@ void SHA256_Init(SHA256_State *s) {
 
 void SHA256_Bytes(SHA256_State *s, const void *p, int len) {
     unsigned char *q = (unsigned char *)p;
-    uint32 wordblock[16];
     uint32 lenw = len;
-    int i;
 
     /*
      * Update the length field.
@@ -121,21 +297,19 @@ void SHA256_Bytes(SHA256_State *s, const void *p, int len) {
         /*
          * We must complete and process at least one block.
          */
-        while (s->blkused + len >= BLKSIZE) {
+        if (s->blkused) {
             memcpy(s->block + s->blkused, q, BLKSIZE - s->blkused);
             q += BLKSIZE - s->blkused;
             len -= BLKSIZE - s->blkused;
-            /* Now process the block. Gather bytes big-endian into words */
-            for (i = 0; i < 16; i++) {
-                wordblock[i] =
-                    ( ((uint32)s->block[i*4+0]) << 24 ) |
-                    ( ((uint32)s->block[i*4+1]) << 16 ) |
-                    ( ((uint32)s->block[i*4+2]) <<  8 ) |
-                    ( ((uint32)s->block[i*4+3]) <<  0 );
-            }
-            SHA256_Block(s, wordblock);
+            SHA256_Blocks(s, s->block, 1);
             s->blkused = 0;
         }
+        /* Whole blocks can be processed straight from the input. */
+        if (len >= BLKSIZE) {
+            SHA256_Blocks(s, q, len / BLKSIZE);
+            q += len - len % BLKSIZE;
+            len %= BLKSIZE;
+        }
         memcpy(s->block, q, len);
         s->blkused = len;
     }
@@ -0,0 +1,209 @@
+/*
+ * Zlib (RFC1950 / RFC1951) compression for SSH, using the system
+ * zlib instead of the implementation in sshzlib.c.
+ *
+ * sshzlib.c only ever emits static-tree blocks and does a minimal
+ * amount of match searching, which keeps it small but makes it
+ * both slow and a poor compressor. When fzsftp is configured with
+ * --with-system-zlib, this module is used for SSH compression
+ * instead. Anything providing the zlib API can be linked in here,
+ * including zlib-ng in compat mode and the other SIMD-optimised
+ * forks.
+ *
+ * As in sshzlib.c, each packet is terminated with a partial flush,
+ * which is what OpenSSH does and what every SSH peer can cope with.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "putty.h"
+#include "ssh.h"
+
+#ifdef USE_SYSTEM_ZLIB
+
+#include <zlib.h>
+
+/*
+ * Compression has to keep up with the link to be worth having at
+ * all. Level 1 is about ten times as fast as sshzlib.c while still
+ * compressing at least as well; zlib's default of 6 gains a few
+ * percent on text for a quarter of the speed. See sshbench.
+ */
+#ifndef SYSTEM_ZLIB_LEVEL
+#define SYSTEM_ZLIB_LEVEL 1
+#endif
+
+struct syszlib_compress_ctx {
+    z_stream z;
+    int comp_disabled;
+};
+
+static void *syszlib_alloc(void *opaque, unsigned items, unsigned size)
+{
+    return snewn(items * size, char);
+}
+
+static void syszlib_free(void *opaque, void *ptr)
+{
+    sfree(ptr);
+}
+
+static void *syszlib_compress_init(void)
+{
+    struct syszlib_compress_ctx *ctx = snew(struct syszlib_compress_ctx);
+
+    memset(&ctx->z, 0, sizeof(ctx->z));
+    ctx->z.zalloc = syszlib_alloc;
+    ctx->z.zfree = syszlib_free;
+    ctx->comp_disabled = FALSE;
+    if (deflateInit(&ctx->z, SYSTEM_ZLIB_LEVEL) != Z_OK)
+	modalfatalbox("Unable to initialise zlib: %s", ctx->z.msg);
+
+    return ctx;
+}
+
+static void syszlib_compress_cleanup(void *handle)
+{
+    struct syszlib_compress_ctx *ctx = (struct syszlib_compress_ctx *)handle;
+
+    deflateEnd(&ctx->z);
+    smemclr(ctx, sizeof(*ctx));
+    sfree(ctx);
+}
+
+/*
+ * Store the next block without compressing it, so that an IGNORE
+ * packet padded to a precise length stays that length. Returns the
+ * length adjustment: the zlib header on the very first block, plus
+ * one byte of block header and four of length/~length. The few
+ * bits of partial flush trailer aren't counted, so unlike
+ * sshzlib.c the result can still be a byte or two out.
+ */
+static int syszlib_disable_compression(void *handle)
+{
+    struct syszlib_compress_ctx *ctx = (struct syszlib_compress_ctx *)handle;
+
+    ctx->comp_disabled = TRUE;
+    return (ctx->z.total_out == 0 ? 2 : 0) + 1 + 4;
+}
+
+static int syszlib_compress_block(void *handle, unsigned char *block,
+				  int len, unsigned char **outblock,
+				  int *outlen)
+{
+    struct syszlib_compress_ctx *ctx = (struct syszlib_compress_ctx *)handle;
+    unsigned char *out;
+    int outsize, ret;
+
+    outsize = deflateBound(&ctx->z, len) + 16;
+    out = snewn(outsize, unsigned char);
+
+    ctx->z.next_in = block;
+    ctx->z.avail_in = 0;
+    ctx->z.next_out = out;
+    ctx->z.avail_out = outsize;
+
+    /* Changing level may flush, so only with a valid output buffer. */
+    if (ctx->comp_disabled)
+	deflateParams(&ctx->z, 0, Z_DEFAULT_STRATEGY);
+
+    ctx->z.avail_in = len;
+
+    for (;;) {
+	ret = deflate(&ctx->z, Z_PARTIAL_FLUSH);
+	assert(ret == Z_OK || ret == Z_BUF_ERROR);
+	if (ctx->z.avail_out != 0)
+	    break;
+	/* Ran out of room; deflateBound was too tight. Grow and go on. */
+	out = sresize(out, outsize * 2, unsigned char);
+	ctx->z.next_out = out + outsize;
+	ctx->z.avail_out = outsize;
+	outsize *= 2;
+    }
+
+    if (ctx->comp_disabled) {
+	deflateParams(&ctx->z, SYSTEM_ZLIB_LEVEL, Z_DEFAULT_STRATEGY);
+	ctx->comp_disabled = FALSE;
+    }
+
+    *outblock = out;
+    *outlen = outsize - ctx->z.avail_out;
+    return 1;
+}
+
+static void *syszlib_decompress_init(void)
+{
+    z_stream *z = snew(z_stream);
+
+    memset(z, 0, sizeof(*z));
+    z->zalloc = syszlib_alloc;
+    z->zfree = syszlib_free;
+    if (inflateInit(z) != Z_OK)
+	modalfatalbox("Unable to initialise zlib: %s", z->msg);
+
+    return z;
+}
+
+static void syszlib_decompress_cleanup(void *handle)
+{
+    z_stream *z = (z_stream *)handle;
+
+    inflateEnd(z);
+    smemclr(z, sizeof(*z));
+    sfree(z);
+}
+
+static int syszlib_decompress_block(void *handle, unsigned char *block,
+				    int len, unsigned char **outblock,
+				    int *outlen)
+{
+    z_stream *z = (z_stream *)handle;
+    unsigned char *out;
+    int outsize, ret;
+
+    outsize = len * 4 + 256;
+    out = snewn(outsize, unsigned char);
+
+    z->next_in = block;
+    z->avail_in = len;
+    z->next_out = out;
+    z->avail_out = outsize;
+
+    for (;;) {
+	ret = inflate(z, Z_SYNC_FLUSH);
+	if (ret != Z_OK && ret != Z_BUF_ERROR) {
+	    /* Corrupt data, or a stream end SSH never sends. */
+	    sfree(out);
+	    *outblock = NULL;
+	    *outlen = 0;
+	    return 0;
+	}
+	if (z->avail_out != 0)
+	    break;
+	out = sresize(out, outsize * 2, unsigned char);
+	z->next_out = out + outsize;
+	z->avail_out = outsize;
+	outsize *= 2;
+    }
+
+    *outblock = out;
+    *outlen = outsize - z->avail_out;
+    return 1;
+}
+
+const struct ssh_compress ssh_zlib_system = {
+    "zlib",
+    "zlib@openssh.com", /* delayed version */
+    syszlib_compress_init,
+    syszlib_compress_cleanup,
+    syszlib_compress_block,
+    syszlib_decompress_init,
+    syszlib_decompress_cleanup,
+    syszlib_decompress_block,
+    syszlib_disable_compression,
+    "zlib (RFC1950, system library)"
+};
+
+#endif /* USE_SYSTEM_ZLIB */
@@ -23,6 +23,9 @@
 #ifndef HAVE_SYS_SELECT_H
 # define HAVE_NO_SYS_SELECT_H
 #endif
+#ifndef HAVE_PTHREAD_H
+# define NO_NET_READER
+#endif
 
 #include <stdio.h>		       /* for FILENAME_MAX */
 #include <stdint.h>		       /* C99 int types */
@@ -145,6 +148,14 @@ int next_fd(int *state, int *rwx);
 int uxsel_input_add(int fd, int rwx);  /* returns an id */
 void uxsel_input_remove(int id);
 
+/* uxnetrd.c: background socket reader. netreader_start returns NULL
+ * if no thread could be started, including in NO_NET_READER builds. */
+struct netreader;
+struct netreader *netreader_start(int fd);
+int netreader_wakefd(struct netreader *r);
+int netreader_recv(struct netreader *r, void *buf, int len);
+void netreader_stop(struct netreader *r);
+
 /* uxcfg.c */
 struct controlbox;
 void unix_setup_config_box(struct controlbox *b, int midsession, int protocol);
@@ -94,6 +94,7 @@ struct Socket_tag {
     SockAddrStep step;
 
     _fztimer send_timer, recv_timer;
+    struct netreader *reader;	       /* see net_start_reader */
     /*
      * We sometimes need pairs of Socket structures to be linked:
      * if we are listening on the same IPv6 and v4 port, for
@@ -523,6 +524,7 @@ static Socket sk_tcp_accept(accept_ctx_t ctx, Plug plug)
     ret->incomingeof = FALSE;
     ret->listener = 0;
     ret->parent = ret->child = NULL;
+    ret->reader = NULL;
     ret->addr = NULL;
     ret->connected = 1;
 
@@ -767,6 +769,7 @@ Socket sk_new(SockAddr addr, int port, int privport, int oobinline,
     ret->localhost_only = 0;	       /* unused, but best init anyway */
     ret->pending_error = 0;
     ret->parent = ret->child = NULL;
+    ret->reader = NULL;
     ret->oobpending = FALSE;
     ret->outgoingeof = EOF_NO;
     ret->incomingeof = FALSE;
@@ -822,6 +825,7 @@ Socket sk_newlistener(char *srcaddr, int port, Plug plug, int local_host_only, i
     ret->localhost_only = local_host_only;
     ret->pending_error = 0;
     ret->parent = ret->child = NULL;
+    ret->reader = NULL;
     ret->oobpending = FALSE;
     ret->outgoingeof = EOF_NO;
     ret->incomingeof = FALSE;
@@ -1004,6 +1008,10 @@ static void sk_tcp_close(Socket sock)
     if (s->child)
         sk_tcp_close((Socket)s->child);
 
+    if (s->reader) {
+	uxsel_del(netreader_wakefd(s->reader));
+	netreader_stop(s->reader);
+    }
     uxsel_del(s->s);
     del234(sktree, s);
     close(s->s);
@@ -1252,6 +1260,37 @@ static void sk_tcp_write_eof(Socket sock)
     uxsel_tell(s);
 }
 
+/*
+ * Once an outgoing connection has delivered its first data, hand
+ * reading over to a background thread (see uxnetrd.c). The socket
+ * then stays in the select set only for writing, and its read events
+ * come from the reader's wakeup pipe instead, so that network I/O
+ * overlaps with the SSH layer decrypting what has already arrived.
+ *
+ * Only plain data streams qualify: the reader has no way to deliver
+ * urgent data.
+ */
+static void net_start_reader(Actual_Socket s)
+{
+    s->reader = netreader_start(s->s);
+    if (s->reader)
+	uxsel_tell(s);
+}
+
+static int net_select_result(int fd, int event);
+
+static int net_reader_select_result(int fd, int event)
+{
+    Actual_Socket s;
+    int i;
+
+    for (i = 0; (s = index234(sktree, i)) != NULL; i++)
+	if (s->reader && netreader_wakefd(s->reader) == fd)
+	    return net_select_result(s->s, 1);
+
+    return 1;
+}
+
 static int net_select_result(int fd, int event)
 {
     int ret;
@@ -1361,7 +1400,10 @@ static int net_select_result(int fd, int event)
 	    atmark = 1;
 
 	toRecv = RequestQuota(0, s->oobpending ? 1 : sizeof(buf));
-	ret = recv(s->s, buf, toRecv, 0);
+	if (s->reader)
+	    ret = netreader_recv(s->reader, buf, toRecv);
+	else
+	    ret = recv(s->s, buf, toRecv, 0);
 	noise_ultralight(ret);
 	if (ret < 0) {
 	    if (errno == EWOULDBLOCK) {
@@ -1400,6 +1442,8 @@ static int net_select_result(int fd, int event)
             if (s->addr) {
                 sk_addr_free(s->addr);
                 s->addr = NULL;
+		if (!s->oobinline)
+		    net_start_reader(s);
             }
 	    return plug_receive(s->plug, atmark ? 0 : 1, buf, ret);
 	}
@@ -1467,6 +1511,11 @@ static void uxsel_tell(Actual_Socket s)
                 rwx |= 2;              /* write */
         }
     }
+    if (s->reader) {
+	uxsel_set(netreader_wakefd(s->reader), rwx & 1,
+		  net_reader_select_result);
+	rwx &= ~(1 | 4);
+    }
     uxsel_set(s->s, rwx, net_select_result);
 }
 
@@ -1578,6 +1627,7 @@ Socket new_unix_listener(SockAddr listenaddr, Plug plug)
     ret->localhost_only = TRUE;
     ret->pending_error = 0;
     ret->parent = ret->child = NULL;
+    ret->reader = NULL;
     ret->oobpending = FALSE;
     ret->outgoingeof = EOF_NO;
     ret->incomingeof = FALSE;
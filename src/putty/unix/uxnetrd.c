@@ -0,0 +1,250 @@
+/*
+ * uxnetrd.c: a background thread which reads from a socket into a
+ * buffer, so that the next packets can be arriving off the network
+ * while the main loop is busy decrypting and processing the current
+ * ones.
+ *
+ * The main thread never touches the socket for reading once a
+ * reader is running. Instead it selects on a wakeup pipe, which is
+ * readable whenever there is buffered data, an EOF or an error to
+ * collect with netreader_recv(). The thread stops reading once
+ * NETREADER_LIMIT bytes are waiting, so a frozen socket still
+ * pushes back on the sender.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "putty.h"
+
+#ifndef NO_NET_READER
+
+#include <pthread.h>
+
+#define NETREADER_CHUNK 65536
+#define NETREADER_LIMIT (16 * NETREADER_CHUNK)
+
+struct netreader {
+    int fd;
+    int wake[2];		       /* main loop selects on wake[0] */
+    int stoppipe[2];		       /* interrupts the thread's poll() */
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    /* Everything below is protected by lock. */
+    bufchain data;
+    int signalled;		       /* a byte is waiting in wake[] */
+    int eof, error;
+    int stop;
+};
+
+/* Must be called with the lock held. */
+static void netreader_signal(struct netreader *r)
+{
+    if (!r->signalled) {
+	char c = 0;
+	r->signalled = TRUE;
+	if (write(r->wake[1], &c, 1) < 0)
+	    assert(errno == EAGAIN);   /* pipe already full, fine */
+    }
+}
+
+static void *netreader_thread(void *param)
+{
+    struct netreader *r = (struct netreader *)param;
+    char *buf = snewn(NETREADER_CHUNK, char);
+    struct pollfd pfd[2];
+    int ret, stop;
+
+    for (;;) {
+	pthread_mutex_lock(&r->lock);
+	while (!r->stop && bufchain_size(&r->data) >= NETREADER_LIMIT)
+	    pthread_cond_wait(&r->cond, &r->lock);
+	stop = r->stop;
+	pthread_mutex_unlock(&r->lock);
+	if (stop)
+	    break;
+
+	pfd[0].fd = r->fd;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = r->stoppipe[0];
+	pfd[1].events = POLLIN;
+	ret = poll(pfd, 2, -1);
+	if (ret < 0 && errno != EINTR)
+	    break;
+	if (ret <= 0)
+	    continue;
+	if (pfd[1].revents)
+	    break;
+
+	ret = recv(r->fd, buf, NETREADER_CHUNK, 0);
+	if (ret < 0 && (errno == EINTR || errno == EWOULDBLOCK ||
+			errno == EAGAIN))
+	    continue;
+
+	pthread_mutex_lock(&r->lock);
+	if (ret > 0)
+	    bufchain_add(&r->data, buf, ret);
+	else if (ret == 0)
+	    r->eof = TRUE;
+	else
+	    r->error = errno;
+	netreader_signal(r);
+	pthread_mutex_unlock(&r->lock);
+
+	if (ret <= 0)
+	    break;
+    }
+
+    sfree(buf);
+    return NULL;
+}
+
+struct netreader *netreader_start(int fd)
+{
+    struct netreader *r;
+
+#ifdef _SC_NPROCESSORS_ONLN
+    /* On a single core the extra thread only adds overhead. */
+    if (sysconf(_SC_NPROCESSORS_ONLN) == 1)
+	return NULL;
+#endif
+
+    r = snew(struct netreader);
+    r->fd = fd;
+    bufchain_init(&r->data);
+    r->signalled = r->eof = r->error = r->stop = FALSE;
+
+    if (pipe(r->wake) < 0) {
+	sfree(r);
+	return NULL;
+    }
+    if (pipe(r->stoppipe) < 0) {
+	close(r->wake[0]);
+	close(r->wake[1]);
+	sfree(r);
+	return NULL;
+    }
+    nonblock(r->wake[0]);
+    nonblock(r->wake[1]);
+    cloexec(r->wake[0]);
+    cloexec(r->wake[1]);
+    cloexec(r->stoppipe[0]);
+    cloexec(r->stoppipe[1]);
+
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->cond, NULL);
+
+    if (pthread_create(&r->thread, NULL, netreader_thread, r) != 0) {
+	pthread_cond_destroy(&r->cond);
+	pthread_mutex_destroy(&r->lock);
+	close(r->wake[0]);
+	close(r->wake[1]);
+	close(r->stoppipe[0]);
+	close(r->stoppipe[1]);
+	sfree(r);
+	return NULL;
+    }
+
+    return r;
+}
+
+int netreader_wakefd(struct netreader *r)
+{
+    return r->wake[0];
+}
+
+/*
+ * Behaves like a non-blocking recv() on the socket: returns the
+ * number of bytes copied, 0 at EOF, or -1 with errno set
+ * (EWOULDBLOCK if nothing has arrived yet).
+ */
+int netreader_recv(struct netreader *r, void *buf, int len)
+{
+    char drain[64];
+    int size, ret;
+
+    while (read(r->wake[0], drain, sizeof(drain)) > 0);
+
+    pthread_mutex_lock(&r->lock);
+    r->signalled = FALSE;
+
+    size = bufchain_size(&r->data);
+    if (size > 0) {
+	ret = size < len ? size : len;
+	bufchain_fetch(&r->data, buf, ret);
+	bufchain_consume(&r->data, ret);
+	if (size >= NETREADER_LIMIT && size - ret < NETREADER_LIMIT)
+	    pthread_cond_signal(&r->cond);
+	/* Come back for the rest, or for the EOF/error behind it. */
+	if (size > ret || r->eof || r->error)
+	    netreader_signal(r);
+    } else if (r->eof) {
+	ret = 0;
+    } else if (r->error) {
+	errno = r->error;
+	ret = -1;
+    } else {
+	errno = EWOULDBLOCK;
+	ret = -1;
+    }
+
+    pthread_mutex_unlock(&r->lock);
+    return ret;
+}
+
+void netreader_stop(struct netreader *r)
+{
+    char c = 0;
+
+    pthread_mutex_lock(&r->lock);
+    r->stop = TRUE;
+    pthread_cond_signal(&r->cond);
+    pthread_mutex_unlock(&r->lock);
+    if (write(r->stoppipe[1], &c, 1) < 0)
+	assert(0);
+
+    pthread_join(r->thread, NULL);
+
+    pthread_cond_destroy(&r->cond);
+    pthread_mutex_destroy(&r->lock);
+    bufchain_clear(&r->data);
+    close(r->wake[0]);
+    close(r->wake[1]);
+    close(r->stoppipe[0]);
+    close(r->stoppipe[1]);
+    sfree(r);
+}
+
+#else /* NO_NET_READER */
+
+/*
+ * Without threads, sockets are always read directly from the
+ * select loop.
+ */
+struct netreader *netreader_start(int fd)
+{
+    return NULL;
+}
+
+int netreader_wakefd(struct netreader *r)
+{
+    return -1;
+}
+
+int netreader_recv(struct netreader *r, void *buf, int len)
+{
+    errno = EWOULDBLOCK;
+    return -1;
+}
+
+void netreader_stop(struct netreader *r)
+{
+}
+
+#endif /* NO_NET_READER */
@@ -0,0 +1,204 @@
+#include <libfilezilla.h>
+#include <wx/imaglist.h>
+#include <wx/scrolwin.h>
+#include <wx/listctrl.h>
+#include <wx/init.h>
+#include <wx/stopwatch.h>
+#include <../interface/filelistctrl.h>
+#include <../interface/filter_matcher.h>
+#include "filterhelpers.h"
+#include "local_filesys.h"
+
+#include <algorithm>
+#include <iostream>
+#include <locale.h>
+
+#ifndef __WXMSW__
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Timings of code paths the unit tests only check for correctness.
+ * Not part of `make check', build with `make benchmark'.
+ */
+
+namespace {
+void BenchmarkSortKeys()
+{
+	// A large listing with lots of shared prefixes and numbers. Sorts it
+	// once with the comparison function and once with precomputed keys.
+	std::vector<wxString> listing;
+	unsigned int seed = 42;
+	for (int i = 0; i < 100000; ++i) {
+		seed = seed * 1103515245 + 12345;
+		listing.push_back(wxString::Format(_T("Backup_%u-part%d.TAR.gz"), (seed >> 8) % 5000, i));
+	}
+
+	std::vector<int> byFunction(listing.size());
+	for (size_t i = 0; i < listing.size(); ++i)
+		byFunction[i] = i;
+	std::vector<int> byKey = byFunction;
+
+	wxStopWatch functionTime;
+	std::sort(byFunction.begin(), byFunction.end(), [&](int a, int b) {
+		return CFileListCtrlSortBase::CmpNatural(listing[a], listing[b]) < 0;
+	});
+	functionTime.Pause();
+
+	wxStopWatch keyTime;
+	std::vector<std::wstring> keys;
+	keys.reserve(listing.size());
+	for (auto const& name : listing)
+		keys.push_back(CFileListCtrlSortBase::MakeSortKey(name, CFileListCtrlSortBase::namesort_natural));
+	std::sort(byKey.begin(), byKey.end(), [&](int a, int b) {
+		return keys[a] < keys[b];
+	});
+	keyTime.Pause();
+
+	if (byFunction != byKey)
+		std::cout << "Sort keys and CmpNatural sort differently" << std::endl;
+
+	std::cout << "Natural sort of " << listing.size() << " names: "
+		<< functionTime.Time() << " ms using CmpNatural, "
+		<< keyTime.Time() << " ms using sort keys" << std::endl;
+}
+
+void BenchmarkFilterMatcher()
+{
+	std::vector<CFilter> const filters = ManyFilters();
+	std::vector<wxString> const listing = RandomNames(100000, 42);
+
+	wxStopWatch naiveTime;
+	std::vector<bool> naive;
+	for (auto const& name : listing)
+		naive.push_back(NaiveMatch(filters, name));
+	naiveTime.Pause();
+
+	wxStopWatch compiledTime;
+	CFilterMatcher const m(filters);
+	std::vector<bool> compiled;
+	for (auto const& name : listing)
+		compiled.push_back(m.Matches(name, _T("/home"), false, 0, -1, CDateTime()));
+	compiledTime.Pause();
+
+	if (naive != compiled)
+		std::cout << "Compiled filters match differently" << std::endl;
+
+	std::cout << "Matching " << listing.size() << " names against " << filters.size() << " filters: "
+		<< naiveTime.Time() << " ms condition by condition, "
+		<< compiledTime.Time() << " ms compiled" << std::endl;
+}
+
+#ifndef __WXMSW__
+// Best of five, so the directory is in the cache for all but the first run
+template<typename F>
+long BestOfFive(F const& f)
+{
+	long best = -1;
+	for (int i = 0; i < 5; ++i) {
+		wxStopWatch sw;
+		int const count = f();
+		long const time = sw.Time();
+		if (count != 100000)
+			std::cout << "Enumerated " << count << " instead of 100000 files" << std::endl;
+		if (best == -1 || time < best)
+			best = time;
+	}
+	return best;
+}
+
+void BenchmarkLocalEnumeration()
+{
+	// A single directory with 100k empty files
+	std::string dir = "/tmp/fzbenchXXXXXX";
+	if (!mkdtemp(&dir[0])) {
+		std::cout << "Could not create temporary directory" << std::endl;
+		return;
+	}
+
+	std::vector<std::string> names;
+	for (int i = 0; i < 100000; ++i) {
+		names.push_back(dir + "/file" + std::to_string(i));
+		int fd = open(names.back().c_str(), O_CREAT | O_WRONLY, 0644);
+		if (fd != -1)
+			close(fd);
+	}
+
+	// What CLocalFileSystem did before: lstat on the full path of each entry
+	long const lstatTime = BestOfFive([&]() {
+		int count = 0;
+		DIR* d = opendir(dir.c_str());
+		if (!d)
+			return count;
+		struct dirent* entry;
+		while ((entry = readdir(d))) {
+			if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+				continue;
+			struct stat buf;
+			if (!lstat((dir + "/" + entry->d_name).c_str(), &buf) && S_ISREG(buf.st_mode))
+				++count;
+		}
+		closedir(d);
+		return count;
+	});
+
+	// With metadata, entries get stat'ed relative to the directory if fstatat
+	// is available. Without, d_type is enough for regular files.
+	auto enumerate = [&](bool metadata) {
+		int count = 0;
+		CLocalFileSystem fs;
+		if (!fs.BeginFindFiles(wxString(dir.c_str(), wxConvLocal), false, metadata))
+			return count;
+		wxString name;
+		bool isLink, isDir;
+		wxLongLong size;
+		CDateTime date;
+		int mode;
+		while (fs.GetNextFile(name, isLink, isDir, &size, &date, &mode)) {
+			if (!isDir)
+				++count;
+		}
+		return count;
+	};
+	long const metadataTime = BestOfFive([&]() { return enumerate(true); });
+	long const typeTime = BestOfFive([&]() { return enumerate(false); });
+
+	for (auto const& name : names)
+		unlink(name.c_str());
+	rmdir(dir.c_str());
+
+	std::cout << "Enumerating " << names.size() << " files: "
+		<< lstatTime << " ms using readdir and lstat, "
+		<< metadataTime << " ms using CLocalFileSystem, "
+		<< typeTime << " ms using CLocalFileSystem without metadata" << std::endl;
+#if !HAVE_FSTATAT
+	std::cout << "  fstatat not available, CLocalFileSystem uses lstat as well" << std::endl;
+#endif
+}
+#endif
+}
+
+int main()
+{
+	setlocale(LC_ALL, "");
+
+	if (!wxInitialize())
+	{
+		std::cout << "Failed to initialize wxWidgets" << std::endl;
+		return 1;
+	}
+
+	BenchmarkSortKeys();
+	BenchmarkFilterMatcher();
+#ifndef __WXMSW__
+	BenchmarkLocalEnumeration();
+#endif
+
+	wxUninitialize();
+	return 0;
+}
@@ -0,0 +1,311 @@
+#include <libfilezilla.h>
+#include <../interface/comparison_engine.h>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+/*
+ * This testsuite asserts that the comparison engine pairs entries
+ * by name and flags them like the directory comparison expects.
+ */
+
+class CComparisonEngineTest : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(CComparisonEngineTest);
+	CPPUNIT_TEST(testPairing);
+	CPPUNIT_TEST(testOrder);
+	CPPUNIT_TEST(testUnsorted);
+	CPPUNIT_TEST(testSizes);
+	CPPUNIT_TEST(testDates);
+	CPPUNIT_TEST(testSizesAndDates);
+	CPPUNIT_TEST(testTrees);
+	CPPUNIT_TEST(testUnknownDefault);
+	CPPUNIT_TEST(testUnknownBelow);
+	CPPUNIT_TEST(testUnknownLonely);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp() {}
+	void tearDown() {}
+
+	void testPairing();
+	void testOrder();
+	void testUnsorted();
+	void testSizes();
+	void testDates();
+	void testSizesAndDates();
+	void testTrees();
+	void testUnknownDefault();
+	void testUnknownBelow();
+	void testUnknownLonely();
+
+protected:
+	static CComparisonEntry File(wxString const& name, wxLongLong size = 0, CDateTime const& date = CDateTime())
+	{
+		CComparisonEntry entry;
+		entry.name = name;
+		entry.size = size;
+		entry.date = date;
+		return entry;
+	}
+
+	static CComparisonEntry Dir(wxString const& name)
+	{
+		CComparisonEntry entry;
+		entry.name = name;
+		entry.dir = true;
+		return entry;
+	}
+
+	static bool Less(CComparisonEntry const& a, CComparisonEntry const& b)
+	{
+		return a.name < b.name;
+	}
+
+	// Rows as "left:right", with - for missing entries
+	static wxString Rows(std::vector<CComparisonEntry> const& left, std::vector<CComparisonEntry> const& right, std::vector<CComparisonEngine::row> const& rows)
+	{
+		wxString ret;
+		for (auto const& r : rows) {
+			if (!ret.empty())
+				ret += _T(" ");
+			ret += (r.left != -1) ? left[r.left].name : wxString(_T("-"));
+			ret += _T(":");
+			ret += (r.right != -1) ? right[r.right].name : wxString(_T("-"));
+		}
+		return ret;
+	}
+
+	// Differences as "left:right" with their paths, empty for missing entries
+	static wxString Differences(std::vector<CComparisonEngine::difference> const& differences)
+	{
+		wxString ret;
+		for (auto const& d : differences) {
+			if (!ret.empty())
+				ret += _T(" ");
+			if (d.left)
+				ret += d.leftPath + d.left->name;
+			ret += _T(":");
+			if (d.right)
+				ret += d.rightPath + d.right->name;
+		}
+		return ret;
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CComparisonEngineTest);
+
+void CComparisonEngineTest::testPairing()
+{
+	CComparisonEngine engine(true, false, wxTimeSpan());
+
+	std::vector<CComparisonEntry> left{ Dir(_T("a")), File(_T("b")), File(_T("c")) };
+	std::vector<CComparisonEntry> right{ File(_T("a")), File(_T("b")), File(_T("d")) };
+
+	// A directory and a file of the same name are different entries
+	auto rows = engine.Compare(left, right, Less);
+	CPPUNIT_ASSERT(Rows(left, right, rows) == _T("a:- -:a b:b c:- -:d"));
+
+	CPPUNIT_ASSERT(rows[0].leftFlags == CComparisonEngine::lonely);
+	CPPUNIT_ASSERT(rows[1].rightFlags == CComparisonEngine::lonely);
+	CPPUNIT_ASSERT(rows[2].leftFlags == CComparisonEngine::normal);
+	CPPUNIT_ASSERT(rows[2].identical);
+
+	std::vector<CComparisonEntry> upper{ File(_T("B")) };
+	rows = engine.Compare(upper, right, Less);
+#ifdef __WXMSW__
+	CPPUNIT_ASSERT(Rows(upper, right, rows) == _T("-:a B:b -:d"));
+#else
+	CPPUNIT_ASSERT(Rows(upper, right, rows) == _T("B:- -:a -:b -:d"));
+#endif
+
+	CPPUNIT_ASSERT(engine.Compare(std::vector<CComparisonEntry>(), std::vector<CComparisonEntry>()).empty());
+}
+
+void CComparisonEngineTest::testOrder()
+{
+	CComparisonEngine engine(true, false, wxTimeSpan());
+
+	std::vector<CComparisonEntry> left{ File(_T("a")), File(_T("c")), File(_T("e")), File(_T("g")) };
+	std::vector<CComparisonEntry> right{ File(_T("b")), File(_T("d")), File(_T("e")), File(_T("f")) };
+
+	// Entries from both sides between two pairs get interleaved
+	CPPUNIT_ASSERT(Rows(left, right, engine.Compare(left, right, Less)) == _T("a:- -:b c:- -:d e:e -:f g:-"));
+
+	// Without an order, left comes first
+	CPPUNIT_ASSERT(Rows(left, right, engine.Compare(left, right)) == _T("a:- c:- -:b -:d e:e g:- -:f"));
+}
+
+void CComparisonEngineTest::testUnsorted()
+{
+	CComparisonEngine engine(true, false, wxTimeSpan());
+
+	// Sorted differently, all pairs still get found
+	std::vector<CComparisonEntry> left{ File(_T("file10")), File(_T("file2")), File(_T("file1")), File(_T("x")) };
+	std::vector<CComparisonEntry> right{ File(_T("file1")), File(_T("y")), File(_T("file10")), File(_T("file2")) };
+
+	CPPUNIT_ASSERT(Rows(left, right, engine.Compare(left, right)) == _T("-:y file10:file10 file2:file2 file1:file1 x:-"));
+}
+
+void CComparisonEngineTest::testSizes()
+{
+	CComparisonEngine engine(true, false, wxTimeSpan());
+
+	std::vector<CComparisonEntry> left{ Dir(_T("dir")), File(_T("same"), 5), File(_T("other"), 5) };
+	std::vector<CComparisonEntry> right{ Dir(_T("dir")), File(_T("same"), 5), File(_T("other"), 6) };
+
+	auto const rows = engine.Compare(left, right);
+	CPPUNIT_ASSERT(rows.size() == 3);
+
+	CPPUNIT_ASSERT(rows[0].identical);
+	CPPUNIT_ASSERT(rows[1].identical);
+	CPPUNIT_ASSERT(!rows[2].identical);
+	CPPUNIT_ASSERT(rows[2].leftFlags == CComparisonEngine::different);
+	CPPUNIT_ASSERT(rows[2].rightFlags == CComparisonEngine::different);
+}
+
+void CComparisonEngineTest::testDates()
+{
+	CComparisonEngine engine(false, true, wxTimeSpan::Minutes(1));
+
+	CDateTime const t(2015, 3, 1, 12, 0, 0);
+	CDateTime const close(2015, 3, 1, 12, 0, 30);
+	CDateTime const later(2015, 3, 1, 12, 5, 0);
+
+	std::vector<CComparisonEntry> left{ File(_T("a"), 0, t), File(_T("b"), 0, t), File(_T("c"), 0, later), File(_T("d"), 0, t), File(_T("e")) };
+	std::vector<CComparisonEntry> right{ File(_T("a"), 1, close), File(_T("b"), 0, later), File(_T("c"), 0, t), File(_T("d")), File(_T("e")) };
+
+	auto const rows = engine.Compare(left, right);
+	CPPUNIT_ASSERT(rows.size() == 5);
+
+	// Within threshold, size doesn't matter
+	CPPUNIT_ASSERT(rows[0].identical);
+	CPPUNIT_ASSERT(rows[0].leftFlags == CComparisonEngine::normal);
+
+	CPPUNIT_ASSERT(!rows[1].identical);
+	CPPUNIT_ASSERT(rows[1].leftFlags == CComparisonEngine::normal);
+	CPPUNIT_ASSERT(rows[1].rightFlags == CComparisonEngine::newer);
+
+	CPPUNIT_ASSERT(rows[2].leftFlags == CComparisonEngine::newer);
+	CPPUNIT_ASSERT(rows[2].rightFlags == CComparisonEngine::normal);
+
+	// Only one date known, nothing to flag but not identical either
+	CPPUNIT_ASSERT(!rows[3].identical);
+	CPPUNIT_ASSERT(rows[3].leftFlags == CComparisonEngine::normal);
+	CPPUNIT_ASSERT(rows[3].rightFlags == CComparisonEngine::normal);
+
+	CPPUNIT_ASSERT(rows[4].identical);
+}
+
+void CComparisonEngineTest::testSizesAndDates()
+{
+	CComparisonEngine engine(true, true, wxTimeSpan::Minutes(1));
+
+	CDateTime const t(2015, 3, 1, 12, 0, 0);
+	CDateTime const later(2015, 3, 1, 12, 5, 0);
+
+	std::vector<CComparisonEntry> left{ File(_T("a"), 1, t), File(_T("b"), 1, t), File(_T("c"), 1, t) };
+	std::vector<CComparisonEntry> right{ File(_T("a"), 1, t), File(_T("b"), 2, t), File(_T("c"), 2, later) };
+
+	auto const rows = engine.Compare(left, right);
+	CPPUNIT_ASSERT(rows.size() == 3);
+
+	CPPUNIT_ASSERT(rows[0].identical);
+
+	CPPUNIT_ASSERT(!rows[1].identical);
+	CPPUNIT_ASSERT(rows[1].leftFlags == CComparisonEngine::different);
+	CPPUNIT_ASSERT(rows[1].rightFlags == CComparisonEngine::different);
+
+	// Dates take precedence
+	CPPUNIT_ASSERT(!rows[2].identical);
+	CPPUNIT_ASSERT(rows[2].leftFlags == CComparisonEngine::normal);
+	CPPUNIT_ASSERT(rows[2].rightFlags == CComparisonEngine::newer);
+}
+
+void CComparisonEngineTest::testTrees()
+{
+	CComparisonEngine engine(true, false, wxTimeSpan());
+
+	CComparisonEngine::tree left, right;
+	left[_T("")] = { Dir(_T("common")), Dir(_T("onlyleft")), File(_T("f"), 1) };
+	left[_T("common/")] = { File(_T("same"), 1), File(_T("changed"), 1) };
+	left[_T("onlyleft/")] = { Dir(_T("sub")) };
+	left[_T("onlyleft/sub/")] = { File(_T("deep")) };
+
+	right[_T("")] = { Dir(_T("common")), File(_T("f"), 1), File(_T("g")) };
+	right[_T("common/")] = { File(_T("changed"), 2), File(_T("same"), 1), File(_T("new")) };
+
+	auto const differences = engine.CompareTrees(left, right);
+	CPPUNIT_ASSERT(Differences(differences) == _T("common/changed:common/changed :common/new onlyleft: onlyleft/sub: onlyleft/sub/deep: :g"));
+
+	// The other side's path is where the entry would go
+	CPPUNIT_ASSERT(differences[1].leftPath == _T("common/"));
+	CPPUNIT_ASSERT(differences[4].rightPath == _T("onlyleft/sub/"));
+}
+
+void CComparisonEngineTest::testUnknownDefault()
+{
+	CComparisonEngine engine(true, false, wxTimeSpan());
+
+	// Listings which are simply missing from the tree look empty
+	CComparisonEngine::tree left, right;
+	left[_T("")] = { Dir(_T("common")), Dir(_T("onlyleft")) };
+	left[_T("onlyleft/")] = { File(_T("x")) };
+	right[_T("")] = { Dir(_T("common")) };
+	right[_T("common/")] = { File(_T("a")) };
+
+	wxString const expected = _T(":common/a onlyleft: onlyleft/x:");
+	CPPUNIT_ASSERT(Differences(engine.CompareTrees(left, right)) == expected);
+
+	CComparisonEngine::unknown_dirs const none;
+	CPPUNIT_ASSERT(Differences(engine.CompareTrees(left, right, none, none)) == expected);
+}
+
+void CComparisonEngineTest::testUnknownBelow()
+{
+	CComparisonEngine engine(true, false, wxTimeSpan());
+
+	// common/ could not be listed on the left, so it's missing from the tree.
+	// Its contents on the right, however deep, must not look like they only
+	// exist there. Everything else still gets compared.
+	CComparisonEngine::tree left, right;
+	left[_T("")] = { Dir(_T("common")), File(_T("f"), 1) };
+	right[_T("")] = { Dir(_T("common")), File(_T("f"), 2) };
+	right[_T("common/")] = { File(_T("a")), Dir(_T("sub")) };
+	right[_T("common/sub/")] = { File(_T("b")) };
+
+	CComparisonEngine::unknown_dirs leftUnknown, rightUnknown;
+	leftUnknown.insert(_T("common/"));
+	CPPUNIT_ASSERT(Differences(engine.CompareTrees(left, right, leftUnknown, rightUnknown)) == _T("f:f"));
+
+	// Same the other way around, and for a directory further down
+	CPPUNIT_ASSERT(Differences(engine.CompareTrees(right, left, rightUnknown, leftUnknown)) == _T("f:f"));
+
+	left[_T("common/")] = { Dir(_T("sub")) };
+	leftUnknown.clear();
+	rightUnknown.insert(_T("common/sub/"));
+	CPPUNIT_ASSERT(Differences(engine.CompareTrees(left, right, leftUnknown, rightUnknown)) == _T(":common/a f:f"));
+
+	// Nothing at all if the root failed
+	leftUnknown.insert(_T(""));
+	CPPUNIT_ASSERT(engine.CompareTrees(left, right, leftUnknown, rightUnknown).empty());
+}
+
+void CComparisonEngineTest::testUnknownLonely()
+{
+	CComparisonEngine engine(true, false, wxTimeSpan());
+
+	// onlyright/ exists on the right only, but its own listing failed. It
+	// must not be reported as an empty directory, nor its subdirectories.
+	CComparisonEngine::tree left, right;
+	left[_T("")] = { File(_T("f")) };
+	right[_T("")] = { File(_T("f")), Dir(_T("onlyright")), Dir(_T("other")) };
+	right[_T("other/")] = { Dir(_T("deep")) };
+
+	CComparisonEngine::unknown_dirs leftUnknown, rightUnknown;
+	rightUnknown.insert(_T("onlyright/"));
+	CPPUNIT_ASSERT(Differences(engine.CompareTrees(left, right, leftUnknown, rightUnknown)) == _T(":other :other/deep"));
+
+	// Further down a lonely directory
+	rightUnknown.insert(_T("other/deep/"));
+	CPPUNIT_ASSERT(Differences(engine.CompareTrees(left, right, leftUnknown, rightUnknown)) == _T(":other"));
+}
@@ -0,0 +1,72 @@
+#include <libfilezilla.h>
+#include <../interface/download_segment.h>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+/*
+ * This testsuite asserts that the first segment of a split download knows
+ * whether it still has to get the rest of the file once the server turned
+ * out to ignore Range requests.
+ */
+
+class CDownloadSegmentTest : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(CDownloadSegmentTest);
+	CPPUNIT_TEST(testRange);
+	CPPUNIT_TEST(testWholeFile);
+	CPPUNIT_TEST(testMergedThenRange);
+	CPPUNIT_TEST(testMergedThenWholeFile);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp() {}
+	void tearDown() {}
+
+	void testRange();
+	void testWholeFile();
+	void testMergedThenRange();
+	void testMergedThenWholeFile();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CDownloadSegmentTest);
+
+void CDownloadSegmentTest::testRange()
+{
+	CDownloadSegment segment(0, 100);
+	CPPUNIT_ASSERT(!segment.GetsWholeFile(100));
+	CPPUNIT_ASSERT(!segment.Merged());
+	CPPUNIT_ASSERT(segment.FileSize() == 100);
+}
+
+void CDownloadSegmentTest::testWholeFile()
+{
+	// The first segment gets a 200 before the others found out anything
+	CDownloadSegment segment(0, 100);
+	CPPUNIT_ASSERT(segment.GetsWholeFile(300));
+	CPPUNIT_ASSERT(segment.GetsWholeFile(-1));
+}
+
+void CDownloadSegmentTest::testMergedThenRange()
+{
+	// Another segment got refused while the first one waited for its reply,
+	// which then is a 206. The rest has to be downloaded afterwards.
+	CDownloadSegment segment(0, 100);
+	segment.Merge(300);
+	CPPUNIT_ASSERT(segment.Merged());
+	CPPUNIT_ASSERT(segment.FileSize() == 300);
+	CPPUNIT_ASSERT(!segment.GetsWholeFile(100));
+}
+
+void CDownloadSegmentTest::testMergedThenWholeFile()
+{
+	// Same, but the first segment gets a 200 as well. Its transfer size must
+	// still tell it apart, it already gets everything.
+	CDownloadSegment segment(0, 100);
+	segment.Merge(300);
+	CPPUNIT_ASSERT(segment.GetsWholeFile(300));
+	CPPUNIT_ASSERT(segment.FileSize() == 300);
+
+	// A smaller size from a later merge doesn't shrink the file
+	segment.Merge(200);
+	CPPUNIT_ASSERT(segment.FileSize() == 300);
+}
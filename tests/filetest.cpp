@@ -0,0 +1,63 @@
+#include <filezilla.h>
+#include "file.h"
+#include <cppunit/extensions/HelperMacros.h>
+#include <wx/filename.h>
+
+/*
+ * This testsuite asserts the correctness of the CFile class.
+ */
+
+class CFileTest : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(CFileTest);
+	CPPUNIT_TEST(testConcurrentWrites);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp();
+	void tearDown();
+
+	void testConcurrentWrites();
+
+protected:
+	wxString m_name;
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CFileTest);
+
+void CFileTest::setUp()
+{
+	m_name = wxFileName::CreateTempFileName(_T("fztest"));
+}
+
+void CFileTest::tearDown()
+{
+	if (!m_name.empty())
+		wxRemoveFile(m_name);
+}
+
+void CFileTest::testConcurrentWrites()
+{
+	CPPUNIT_ASSERT(!m_name.empty());
+
+	// Like the segments of a download, each with its own handle to the same
+	// file. On MSW this needs FILE_SHARE_WRITE.
+	CFile first, second;
+	CPPUNIT_ASSERT(first.Open(m_name, CFile::write, CFile::truncate));
+	CPPUNIT_ASSERT(second.Open(m_name, CFile::write, CFile::existing));
+
+	CPPUNIT_ASSERT(second.Seek(4, CFile::begin) == 4);
+	CPPUNIT_ASSERT(second.Write("5678", 4) == 4);
+	CPPUNIT_ASSERT(first.Write("1234", 4) == 4);
+
+	first.Close();
+	second.Close();
+
+	CFile f;
+	CPPUNIT_ASSERT(f.Open(m_name, CFile::read));
+	CPPUNIT_ASSERT(f.Length() == 8);
+
+	char buf[8];
+	CPPUNIT_ASSERT(f.Read(buf, 8) == 8);
+	CPPUNIT_ASSERT(!memcmp(buf, "12345678", 8));
+}
@@ -0,0 +1,108 @@
+#ifndef __FILTERHELPERS_H__
+#define __FILTERHELPERS_H__
+
+#include <../interface/filter.h>
+
+// Shared by the filter matcher tests and the benchmark
+
+inline CFilterCondition Condition(t_filterType type, int condition, wxString const& value)
+{
+	CFilterCondition c;
+	c.type = type;
+	c.condition = condition;
+	c.strValue = value;
+	if (type == filter_size) {
+		wxLongLong_t size = 0;
+		value.ToLongLong(&size);
+		c.value = size;
+	}
+	if (condition == 4)
+		c.pRegEx = std::make_shared<wxRegEx>(value);
+	return c;
+}
+
+inline CFilter Filter(CFilter::t_matchType matchType, std::vector<CFilterCondition> const& conditions, bool matchCase = true)
+{
+	CFilter f;
+	f.name = _T("test");
+	f.matchType = matchType;
+	f.matchCase = matchCase;
+	f.filters = conditions;
+	return f;
+}
+
+// How conditions were evaluated before, one after the other
+inline bool NaiveMatch(std::vector<CFilter> const& filters, wxString const& name)
+{
+	for (auto const& filter : filters) {
+		for (auto const& c : filter.filters) {
+			wxString const subject = filter.matchCase ? name : name.Lower();
+			wxString const value = filter.matchCase ? c.strValue : c.strValue.Lower();
+			bool match = false;
+			switch (c.condition) {
+			case 0:
+				match = subject.Contains(value);
+				break;
+			case 1:
+				match = subject == value;
+				break;
+			case 2:
+				match = subject.Left(value.Len()) == value;
+				break;
+			case 3:
+				match = subject.Right(value.Len()) == value;
+				break;
+			}
+			if (match)
+				return true;
+		}
+	}
+	return false;
+}
+
+namespace filterhelpers {
+wxChar const* const extensions[] = {
+	_T(".bak"), _T(".tmp"), _T(".swp"), _T(".o"), _T(".obj"), _T(".pyc"), _T(".class"), _T(".log"),
+	_T(".old"), _T(".orig"), _T(".rej"), _T(".part"), _T(".crdownload"), _T(".lock"), _T(".pid"), _T(".cache")
+};
+wxChar const* const names[] = {
+	_T("Thumbs.db"), _T("desktop.ini"), _T(".DS_Store"), _T("CVS"), _T(".svn"), _T(".git"), _T(".hg"), _T("node_modules")
+};
+wxChar const* const prefixes[] = { _T("~$"), _T(".#"), _T("#"), _T("._") };
+}
+
+// Lots of enabled single-purpose filters, like users tend to accumulate
+inline std::vector<CFilter> ManyFilters()
+{
+	std::vector<CFilter> filters;
+	for (auto const& ext : filterhelpers::extensions)
+		filters.push_back(Filter(CFilter::any, { Condition(filter_name, 3, ext) }, false));
+	for (auto const& name : filterhelpers::names)
+		filters.push_back(Filter(CFilter::any, { Condition(filter_name, 1, name) }, false));
+	for (auto const& prefix : filterhelpers::prefixes)
+		filters.push_back(Filter(CFilter::any, { Condition(filter_name, 2, prefix) }));
+	filters.push_back(Filter(CFilter::any, { Condition(filter_name, 0, _T("backup")), Condition(filter_name, 0, _T("cache")) }, false));
+	return filters;
+}
+
+// Names of which some get filtered by ManyFilters
+inline std::vector<wxString> RandomNames(int count, unsigned int seed)
+{
+	std::vector<wxString> listing;
+	for (int i = 0; i < count; ++i) {
+		seed = seed * 1103515245 + 12345;
+		wxString name = wxString::Format(_T("Document_%u"), (seed >> 8) % 100000);
+		if (!(i % 5))
+			name += filterhelpers::extensions[(seed >> 4) % 16];
+		else if (!(i % 7))
+			name = filterhelpers::names[(seed >> 4) % 8];
+		else if (!(i % 11))
+			name = filterhelpers::prefixes[(seed >> 4) % 4] + name;
+		else
+			name += _T(".txt");
+		listing.push_back(name);
+	}
+	return listing;
+}
+
+#endif //__FILTERHELPERS_H__
@@ -0,0 +1,206 @@
+#include <libfilezilla.h>
+#include <../interface/filter_matcher.h>
+#include "filterhelpers.h"
+
+#include <cppunit/extensions/HelperMacros.h>
+
+/*
+ * This testsuite asserts that the compiled filters match
+ * exactly like the filter conditions they are built from.
+ */
+
+class CFilterMatcherTest : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(CFilterMatcherTest);
+	CPPUNIT_TEST(testNames);
+	CPPUNIT_TEST(testCase);
+	CPPUNIT_TEST(testFilesDirs);
+	CPPUNIT_TEST(testMatchTypes);
+	CPPUNIT_TEST(testRegex);
+	CPPUNIT_TEST(testUsesMetadata);
+	CPPUNIT_TEST(testNaiveEquivalence);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp() {}
+	void tearDown() {}
+
+	void testNames();
+	void testCase();
+	void testFilesDirs();
+	void testMatchTypes();
+	void testRegex();
+	void testUsesMetadata();
+	void testNaiveEquivalence();
+
+protected:
+	static bool File(CFilterMatcher const& m, wxString const& name, wxLongLong size = 0, wxString const& path = _T("/home"))
+	{
+		return m.Matches(name, path, false, size, -1, CDateTime());
+	}
+
+	static bool Dir(CFilterMatcher const& m, wxString const& name, wxString const& path = _T("/home"))
+	{
+		return m.Matches(name, path, true, -1, -1, CDateTime());
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CFilterMatcherTest);
+
+void CFilterMatcherTest::testNames()
+{
+	std::vector<CFilter> filters;
+	filters.push_back(Filter(CFilter::any, {
+		Condition(filter_name, 1, _T("Thumbs.db")),
+		Condition(filter_name, 2, _T("#")),
+		Condition(filter_name, 3, _T(".bak")),
+		Condition(filter_name, 3, _T("~")),
+		Condition(filter_name, 0, _T("tmp")),
+		Condition(filter_path, 2, _T("/var/cache"))
+	}));
+	CFilterMatcher const m(filters);
+
+	CPPUNIT_ASSERT(File(m, _T("Thumbs.db")));
+	CPPUNIT_ASSERT(!File(m, _T("Thumbs.db2")));
+	CPPUNIT_ASSERT(!File(m, _T("xThumbs.db")));
+	CPPUNIT_ASSERT(File(m, _T("#autosave#")));
+	CPPUNIT_ASSERT(File(m, _T("file.bak")));
+	CPPUNIT_ASSERT(File(m, _T(".bak")));
+	CPPUNIT_ASSERT(!File(m, _T("bak")));
+	CPPUNIT_ASSERT(!File(m, _T("file.bak2")));
+	CPPUNIT_ASSERT(File(m, _T("file~")));
+	CPPUNIT_ASSERT(File(m, _T("mytmpfile")));
+	CPPUNIT_ASSERT(!File(m, _T("file")));
+	CPPUNIT_ASSERT(File(m, _T("file"), 0, _T("/var/cache/x")));
+	CPPUNIT_ASSERT(!File(m, _T("file"), 0, _T("/var/cach")));
+	CPPUNIT_ASSERT(!File(m, _T("")));
+}
+
+void CFilterMatcherTest::testCase()
+{
+	std::vector<CFilter> filters;
+	filters.push_back(Filter(CFilter::any, { Condition(filter_name, 1, _T("Desktop.INI")), Condition(filter_name, 0, _T("TeMp")) }, false));
+	filters.push_back(Filter(CFilter::all, { Condition(filter_name, 3, _T(".LOG")) }, true));
+	CFilterMatcher const m(filters);
+
+	CPPUNIT_ASSERT(File(m, _T("desktop.ini")));
+	CPPUNIT_ASSERT(File(m, _T("DESKTOP.INI")));
+	CPPUNIT_ASSERT(File(m, _T("my TEMP file")));
+	CPPUNIT_ASSERT(File(m, _T("error.LOG")));
+	CPPUNIT_ASSERT(!File(m, _T("error.log")));
+}
+
+void CFilterMatcherTest::testFilesDirs()
+{
+	std::vector<CFilter> filters;
+	filters.push_back(Filter(CFilter::any, { Condition(filter_name, 1, _T("build")) }));
+	filters.back().filterFiles = false;
+	filters.push_back(Filter(CFilter::any, { Condition(filter_name, 3, _T(".o")) }));
+	filters.back().filterDirs = false;
+	CFilterMatcher const m(filters);
+
+	CPPUNIT_ASSERT(Dir(m, _T("build")));
+	CPPUNIT_ASSERT(!File(m, _T("build")));
+	CPPUNIT_ASSERT(File(m, _T("main.o")));
+	CPPUNIT_ASSERT(!Dir(m, _T("main.o")));
+}
+
+void CFilterMatcherTest::testMatchTypes()
+{
+	{
+		std::vector<CFilter> filters;
+		filters.push_back(Filter(CFilter::all, { Condition(filter_name, 2, _T("a")), Condition(filter_size, 0, _T("100")) }));
+		CFilterMatcher const m(filters);
+		CPPUNIT_ASSERT(File(m, _T("abc"), 101));
+		CPPUNIT_ASSERT(!File(m, _T("abc"), 100));
+		CPPUNIT_ASSERT(!File(m, _T("xbc"), 101));
+
+		// Unknown sizes are skipped
+		CPPUNIT_ASSERT(File(m, _T("abc"), -1));
+	}
+
+	{
+		// Single conditions that are skipped match
+		std::vector<CFilter> filters;
+		filters.push_back(Filter(CFilter::all, { Condition(filter_size, 3, _T("10")) }));
+		CFilterMatcher const m(filters);
+		CPPUNIT_ASSERT(File(m, _T("a"), 5));
+		CPPUNIT_ASSERT(!File(m, _T("a"), 50));
+		CPPUNIT_ASSERT(File(m, _T("a"), -1));
+	}
+
+	{
+		std::vector<CFilter> filters;
+		filters.push_back(Filter(CFilter::none, { Condition(filter_name, 3, _T(".txt")), Condition(filter_name, 3, _T(".md")) }));
+		CFilterMatcher const m(filters);
+		CPPUNIT_ASSERT(!File(m, _T("a.txt")));
+		CPPUNIT_ASSERT(!File(m, _T("a.md")));
+		CPPUNIT_ASSERT(File(m, _T("a.exe")));
+	}
+
+	{
+		// Skipped conditions of a filter matching any condition don't match
+		std::vector<CFilter> filters;
+		filters.push_back(Filter(CFilter::any, { Condition(filter_name, 1, _T("x")), Condition(filter_size, 0, _T("10")) }));
+		CFilterMatcher const m(filters);
+		CPPUNIT_ASSERT(File(m, _T("x"), -1));
+		CPPUNIT_ASSERT(File(m, _T("y"), 11));
+		CPPUNIT_ASSERT(!File(m, _T("y"), -1));
+	}
+
+	{
+		std::vector<CFilter> filters;
+		filters.push_back(Filter(CFilter::any, {}));
+		CFilterMatcher const m(filters);
+		CPPUNIT_ASSERT(File(m, _T("anything")));
+	}
+
+	CPPUNIT_ASSERT(!File(CFilterMatcher(), _T("anything")));
+	CPPUNIT_ASSERT(CFilterMatcher().empty());
+}
+
+void CFilterMatcherTest::testRegex()
+{
+	std::vector<CFilter> filters;
+	filters.push_back(Filter(CFilter::any, { Condition(filter_name, 4, _T("^core\\.[0-9]+$")), Condition(filter_name, 4, _T("\\.sw[op]$")) }));
+	filters.push_back(Filter(CFilter::any, { Condition(filter_path, 4, _T("^/srv/")) }));
+	CFilterMatcher const m(filters);
+
+	CPPUNIT_ASSERT(m.HasRegexes());
+	CPPUNIT_ASSERT(File(m, _T("core.1234")));
+	CPPUNIT_ASSERT(!File(m, _T("core.")));
+	CPPUNIT_ASSERT(!File(m, _T("xcore.1")));
+	CPPUNIT_ASSERT(File(m, _T(".main.c.swp")));
+	CPPUNIT_ASSERT(!File(m, _T(".main.c.swx")));
+	CPPUNIT_ASSERT(File(m, _T("index.html"), 0, _T("/srv/www")));
+	CPPUNIT_ASSERT(!File(m, _T("index.html"), 0, _T("/home/srv/")));
+	CPPUNIT_ASSERT(!File(m, _T("/srv/")));
+
+	std::vector<CFilter> plain;
+	plain.push_back(Filter(CFilter::any, { Condition(filter_name, 1, _T("x")) }));
+	CPPUNIT_ASSERT(!CFilterMatcher(plain).HasRegexes());
+}
+
+void CFilterMatcherTest::testUsesMetadata()
+{
+	std::vector<CFilter> filters;
+	filters.push_back(Filter(CFilter::any, { Condition(filter_name, 1, _T("Thumbs.db")), Condition(filter_name, 4, _T("^\\.")) }));
+	filters.push_back(Filter(CFilter::all, { Condition(filter_path, 0, _T("tmp")) }));
+	CPPUNIT_ASSERT(!CFilterMatcher(filters).UsesMetadata());
+
+	filters.push_back(Filter(CFilter::all, { Condition(filter_name, 2, _T("a")), Condition(filter_size, 3, _T("10")) }));
+	CPPUNIT_ASSERT(CFilterMatcher(filters).UsesMetadata());
+
+	CPPUNIT_ASSERT(!CFilterMatcher(std::vector<CFilter>()).UsesMetadata());
+}
+
+void CFilterMatcherTest::testNaiveEquivalence()
+{
+	// Compiled filters have to give the same results as evaluating
+	// the conditions one after the other
+	std::vector<CFilter> const filters = ManyFilters();
+	CFilterMatcher const m(filters);
+
+	for (auto const& name : RandomNames(1000, 42))
+		CPPUNIT_ASSERT(NaiveMatch(filters, name) == File(m, name));
+}
@@ -0,0 +1,90 @@
+#include <libfilezilla.h>
+#include <../interface/parallel.h>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+/*
+ * This testsuite asserts that the parallel helpers used for
+ * huge file listings give the same results as the serial code.
+ */
+
+class CParallelTest : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(CParallelTest);
+	CPPUNIT_TEST(testTaskCount);
+	CPPUNIT_TEST(testFilter);
+	CPPUNIT_TEST(testSort);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp() {}
+	void tearDown() {}
+
+	void testTaskCount();
+	void testFilter();
+	void testSort();
+
+protected:
+	static std::vector<unsigned int> MakeData(size_t count)
+	{
+		std::vector<unsigned int> data;
+		unsigned int seed = 42;
+		for (size_t i = 0; i < count; ++i) {
+			seed = seed * 1103515245 + 12345;
+			data.push_back((seed >> 8) % 10000);
+		}
+		return data;
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CParallelTest);
+
+void CParallelTest::testTaskCount()
+{
+	CPPUNIT_ASSERT_EQUAL(1u, GetParallelTaskCount(0, 100));
+	CPPUNIT_ASSERT_EQUAL(1u, GetParallelTaskCount(199, 100));
+	CPPUNIT_ASSERT(GetParallelTaskCount(100000, 100) >= 1);
+	CPPUNIT_ASSERT(GetParallelTaskCount(100000, 100) <= 16);
+}
+
+void CParallelTest::testFilter()
+{
+	std::vector<unsigned int> const data = MakeData(100000);
+	auto const keep = [&](unsigned int i) { return data[i] % 3 != 0; };
+
+	for (unsigned int first : { 0u, 1u, 77777u }) {
+		std::vector<unsigned int> expected(1, 12345);
+		for (unsigned int i = first; i < data.size(); ++i) {
+			if (keep(i))
+				expected.push_back(i);
+		}
+
+		std::vector<unsigned int> serial(1, 12345);
+		ParallelFilter(serial, first, data.size(), false, keep);
+		CPPUNIT_ASSERT(serial == expected);
+
+		std::vector<unsigned int> concurrent(1, 12345);
+		ParallelFilter(concurrent, first, data.size(), true, keep);
+		CPPUNIT_ASSERT(concurrent == expected);
+	}
+}
+
+void CParallelTest::testSort()
+{
+	for (size_t count : { 0, 1, PARALLEL_SORT_MIN * 2 - 1, PARALLEL_SORT_MIN * 5 + 3, 300000 }) {
+		std::vector<unsigned int> const data = MakeData(count);
+
+		// Ties are broken by index like the file list comparisons do
+		std::vector<unsigned int> expected;
+		for (unsigned int i = 0; i < count; ++i)
+			expected.push_back(i);
+		std::vector<unsigned int> sorted = expected;
+
+		auto const cmp = [&](unsigned int a, unsigned int b) {
+			return data[a] < data[b] || (data[a] == data[b] && a < b);
+		};
+		std::sort(expected.begin(), expected.end(), cmp);
+		ParallelSort(sorted.begin(), sorted.end(), cmp);
+		CPPUNIT_ASSERT(sorted == expected);
+	}
+}
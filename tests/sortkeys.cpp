@@ -0,0 +1,112 @@
+#include <libfilezilla.h>
+#include <wx/imaglist.h>
+#include <wx/scrolwin.h>
+#include <wx/listctrl.h>
+#include <../interface/filelistctrl.h>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+/*
+ * This testsuite asserts that the precomputed sort keys
+ * sort like the comparison functions they replace.
+ */
+
+class CSortKeyTest : public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(CSortKeyTest);
+	CPPUNIT_TEST(testCaseSensitive);
+	CPPUNIT_TEST(testCaseInsensitive);
+	CPPUNIT_TEST(testNatural);
+	CPPUNIT_TEST(testLeadingZeros);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void setUp() {}
+	void tearDown() {}
+
+	void testCaseSensitive();
+	void testCaseInsensitive();
+	void testNatural();
+	void testLeadingZeros();
+
+protected:
+	static int Sign(int v) { return (v > 0) - (v < 0); }
+
+	static int CmpKey(wxString const& str1, wxString const& str2, CFileListCtrlSortBase::NameSortMode mode)
+	{
+		return Sign(CFileListCtrlSortBase::MakeSortKey(str1, mode).compare(CFileListCtrlSortBase::MakeSortKey(str2, mode)));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CSortKeyTest);
+
+namespace {
+wxChar const* const names[] = {
+	_T(""), _T("a"), _T("A"), _T("b"), _T("B"), _T("ab"), _T("aB"), _T("abc"),
+	_T("0"), _T("1"), _T("2"), _T("10"), _T("15"), _T("17"), _T("25"), _T("2100"),
+	_T("a0"), _T("a1"), _T("a1a"), _T("a1b"), _T("a2"), _T("a10"), _T("a20"),
+	_T("abc1xx"), _T("abc2xx"), _T("abc1bb"), _T("abc2aa"), _T("abc2"),
+	_T("10abc"), _T("10def"), _T("10abc2"), _T("10abc3"), _T("1abc"), _T("1def"),
+	_T("x2-g8"), _T("x2-y7"), _T("x8-y8"), _T("1.1"), _T("1.3"), _T("1.15"),
+	_T("file.txt"), _T("File.txt"), _T("file_2.txt"), _T("file-2.txt"), _T("file 2.txt"),
+	_T("[a]"), _T("~a"), _T("\u00e4"), _T("\u00c4b"), _T("z")
+};
+}
+
+void CSortKeyTest::testCaseSensitive()
+{
+	for (auto const& name1 : names) {
+		for (auto const& name2 : names) {
+			CPPUNIT_ASSERT_EQUAL(Sign(CFileListCtrlSortBase::CmpCase(name1, name2)), CmpKey(name1, name2, CFileListCtrlSortBase::namesort_casesensitive));
+		}
+	}
+}
+
+void CSortKeyTest::testCaseInsensitive()
+{
+	CPPUNIT_ASSERT(CmpKey(_T("a"), _T("A"), CFileListCtrlSortBase::namesort_caseinsensitive) == 0);
+	CPPUNIT_ASSERT(CmpKey(_T("afFasFAc"), _T("aFfaSFaC"), CFileListCtrlSortBase::namesort_caseinsensitive) == 0);
+
+	for (auto const& name1 : names) {
+		for (auto const& name2 : names) {
+			int res = CmpKey(name1, name2, CFileListCtrlSortBase::namesort_caseinsensitive);
+			if (!res)
+				res = Sign(CFileListCtrlSortBase::CmpCase(name1, name2));
+			CPPUNIT_ASSERT_EQUAL(Sign(CFileListCtrlSortBase::CmpNoCase(name1, name2)), res);
+		}
+	}
+}
+
+void CSortKeyTest::testNatural()
+{
+	CPPUNIT_ASSERT(CmpKey(_T("a"), _T("A"), CFileListCtrlSortBase::namesort_natural) == 0);
+	CPPUNIT_ASSERT(CmpKey(_T("x2"), _T("X2"), CFileListCtrlSortBase::namesort_natural) == 0);
+
+	for (auto const& name1 : names) {
+		for (auto const& name2 : names) {
+			int const expected = Sign(CFileListCtrlSortBase::CmpNatural(name1, name2));
+			if (expected)
+				CPPUNIT_ASSERT_EQUAL(expected, CmpKey(name1, name2, CFileListCtrlSortBase::namesort_natural));
+		}
+	}
+}
+
+void CSortKeyTest::testLeadingZeros()
+{
+	CPPUNIT_ASSERT(CmpKey(_T("2"), _T("02"), CFileListCtrlSortBase::namesort_natural) < 0);
+	CPPUNIT_ASSERT(CmpKey(_T("02"), _T("1"), CFileListCtrlSortBase::namesort_natural) > 0);
+	CPPUNIT_ASSERT(CmpKey(_T("02"), _T("3"), CFileListCtrlSortBase::namesort_natural) < 0);
+	CPPUNIT_ASSERT(CmpKey(_T("25"), _T("021"), CFileListCtrlSortBase::namesort_natural) > 0);
+	CPPUNIT_ASSERT(CmpKey(_T("2100"), _T("02005"), CFileListCtrlSortBase::namesort_natural) > 0);
+	CPPUNIT_ASSERT(CmpKey(_T("010"), _T("02"), CFileListCtrlSortBase::namesort_natural) > 0);
+	CPPUNIT_ASSERT(CmpKey(_T("x2-y7"), _T("x2-y08"), CFileListCtrlSortBase::namesort_natural) < 0);
+	CPPUNIT_ASSERT(CmpKey(_T("x2-y08"), _T("x8-y8"), CFileListCtrlSortBase::namesort_natural) < 0);
+	CPPUNIT_ASSERT(CmpKey(_T("1.001"), _T("1.002"), CFileListCtrlSortBase::namesort_natural) < 0);
+	CPPUNIT_ASSERT(CmpKey(_T("1.002"), _T("1.010"), CFileListCtrlSortBase::namesort_natural) < 0);
+
+	// Only after the rest of the name
+	CPPUNIT_ASSERT(CmpKey(_T("02a"), _T("2b"), CFileListCtrlSortBase::namesort_natural) < 0);
+	CPPUNIT_ASSERT(CmpKey(_T("02ab"), _T("2ac"), CFileListCtrlSortBase::namesort_natural) < 0);
+	CPPUNIT_ASSERT(CmpKey(_T("02"), _T("2a"), CFileListCtrlSortBase::namesort_natural) < 0);
+	CPPUNIT_ASSERT(CmpKey(_T("2a"), _T("02a"), CFileListCtrlSortBase::namesort_natural) < 0);
+}